@@ -27,6 +27,7 @@
 #include "cs4722/window.h"
 #include "cs4722/compile_shaders.h"
 #include "cs4722/callbacks.h"
+#include "cs4722/render_context.h"
 
 static cs4722::view *the_view;
 static GLuint program;
@@ -141,20 +142,14 @@ display()
 int
 main(int argc, char** argv)
 {
-    glfwInit();
-    auto *window = cs4722::setup_window("Animation With Camera", 0.9);
-    gladLoadGL(glfwGetProcAddress);
+    auto context = cs4722::render_context(argc, argv, "Animation With Camera", 0.9);
     cs4722::setup_debug_callbacks();
     init();
-    while (!glfwWindowShouldClose(window))
+    while (context.running())
     {
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_float());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
         display();
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        context.end_frame();
     }
-
-    glfwDestroyWindow(window);
-    glfwTerminate();
 }
@@ -45,6 +45,7 @@
 #include "cs4722/buffer_utilities.h"
 #include "cs4722/window.h"
 #include "cs4722/compile_shaders.h"
+#include "cs4722/render_context.h"
 
 static cs4722::view *the_view;
 static GLuint program;
@@ -162,8 +163,6 @@ display()
 
 int main(int argc, char** argv)
 {
-    glfwInit();
-
 
     /*
      * We can set the window aspect ratio when creating it.
@@ -173,25 +172,18 @@ int main(int argc, char** argv)
      *  - changing window size does not have any effect on the sizing of the scene
      */
     auto aspect_ratio = 1.0;
-    auto *window = cs4722::setup_window("Projection with View", 0.9, aspect_ratio);
-
-    gladLoadGL(glfwGetProcAddress);
+    auto context = cs4722::render_context(argc, argv, "Projection with View", 0.9, aspect_ratio);
     cs4722::setup_debug_callbacks();
 
     init();
 //    the_view->perspective_aspect = aspect_ratio;
 
-    while (!glfwWindowShouldClose(window))
+    while (context.running())
     {
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_float());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
 
         display();
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        context.end_frame();
     }
-
-    glfwDestroyWindow(window);
-
-    glfwTerminate();
 }
@@ -22,6 +22,7 @@
 #include "cs4722/buffer_utilities.h"
 #include "cs4722/window.h"
 #include "cs4722/compile_shaders.h"
+#include "cs4722/render_context.h"
 
 static cs4722::view *the_view;
 static GLuint program;
@@ -325,12 +326,9 @@ void move_callback(GLFWwindow* window, double xpos, double ypos)
 int
 main(int argc, char** argv)
 {
-    glfwInit();
-
     auto aspect_ratio = 16.0/9.0;
-    auto* window = cs4722::setup_window("User Interaction", 0.9, aspect_ratio);
-
-    gladLoadGL(glfwGetProcAddress);
+    auto context = cs4722::render_context(argc, argv, "User Interaction", 0.9, aspect_ratio);
+    auto *window = context.window;
     cs4722::setup_debug_callbacks();
 
     init();
@@ -353,24 +351,20 @@ main(int argc, char** argv)
     glfwSetKeyCallback(window, general_key_callback);
     glfwSetCursorPosCallback(window, move_callback);
 	
-    while (!glfwWindowShouldClose(window))
+    while (context.running())
     {
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_float());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
 
         display();
-        glfwSwapBuffers(window);
         /*
+         * end_frame shows the frame and then calls glfwPollEvents.
          * The glfwPollEvents function will make sure that all callback functions that have been registered
          * will be called.
          *
          * Note that event handling does not overlap rendering.
          * This saves potential problems relating to race conditions.
          */
-        glfwPollEvents();
+        context.end_frame();
     }
-
-    glfwDestroyWindow(window);
-
-    glfwTerminate();
 }
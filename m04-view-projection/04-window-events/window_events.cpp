@@ -24,6 +24,7 @@
 #include "cs4722/buffer_utilities.h"
 #include "cs4722/window.h"
 #include "cs4722/compile_shaders.h"
+#include "cs4722/render_context.h"
 
 
 static cs4722::view *the_view;
@@ -309,12 +310,9 @@ void move_callback(GLFWwindow* window, double xpos, double ypos)
 int
 main(int argc, char** argv)
 {
-    glfwInit();
-
     auto aspect_ratio = 1.0;
-    auto* window = cs4722::setup_window("Window Events", 0.1, aspect_ratio);
-
-    gladLoadGL(glfwGetProcAddress);
+    auto context = cs4722::render_context(argc, argv, "Window Events", 0.1, aspect_ratio);
+    auto *window = context.window;
     cs4722::setup_debug_callbacks();
 
     init();
@@ -326,16 +324,11 @@ main(int argc, char** argv)
     glfwSetWindowSizeCallback(window, window_size_callback);
 
 	
-    while (!glfwWindowShouldClose(window))
+    while (context.running())
     {
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_float());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
         display();
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        context.end_frame();
     }
-
-    glfwDestroyWindow(window);
-
-    glfwTerminate();
 }
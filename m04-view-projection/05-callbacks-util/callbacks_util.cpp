@@ -19,6 +19,7 @@
 #include "cs4722/buffer_utilities.h"
 #include "cs4722/window.h"
 #include "cs4722/compile_shaders.h"
+#include "cs4722/render_context.h"
 
 
 static cs4722::view *the_view;
@@ -115,11 +116,10 @@ display()
 int
 main(int argc, char** argv)
 {
-    glfwInit();
     auto aspect_ratio = 16.0/9.0;
-    auto* window = cs4722::setup_window("Window Events Using Library Callbacks", 0.5,
-                                        aspect_ratio);
-    gladLoadGL(glfwGetProcAddress);
+    auto context = cs4722::render_context(argc, argv, "Window Events Using Library Callbacks", 0.5,
+                                          aspect_ratio);
+    auto *window = context.window;
     glDebugMessageCallback(cs4722::message_callback, nullptr);
 
     init();
@@ -136,15 +136,12 @@ main(int argc, char** argv)
     glfwSetWindowSizeCallback(window, cs4722::window_size_callback);
 
 	
-    while (!glfwWindowShouldClose(window))
+    while (context.running())
     {
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_float());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
 
         display();
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        context.end_frame();
     }
-    glfwDestroyWindow(window);
-    glfwTerminate();
 }
@@ -0,0 +1,330 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "glad/gl.h"
+#include "GLFW/glfw3.h"
+
+#if defined(CS4722_HEADLESS_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include "cs4722/window.h"
+#include "cs4722/png_writer.h"
+
+/**
+ * \file
+ *
+ * Setting up an OpenGL context, either in a window or headless, and running the frame loop.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief How to run a program without a window.
+     *
+     * Headless mode is turned on by the `--headless` flag or by setting the environment variable
+     * `CS4722_HEADLESS` to anything other than 0.
+     * The other settings come from flags or from environment variables, flags taking precedence:
+     *
+     *  Flag | Environment variable | Meaning | Default
+     *  ---- | -------------------- | ------- | -------
+     *  `--frames=N` | `CS4722_FRAMES` | Number of frames to render | 100
+     *  `--size=WxH` | `CS4722_SIZE` | Size of the framebuffer | 800 pixels high, width set by the aspect ratio
+     *  `--png=path` | `CS4722_PNG` | Write the last frame to this PNG file | no file
+     */
+    struct headless_settings {
+        bool enabled = false;
+        int frames = 100;
+        int width = 0;
+        int height = 0;
+        std::string png_path;
+
+        static headless_settings from(int argc, char **argv)
+        {
+            auto settings = headless_settings();
+            auto apply = [&](const std::string &name, const char *value) {
+                if (!value) return;
+                if (name == "headless") settings.enabled = std::strcmp(value, "0") != 0;
+                else if (name == "frames") settings.frames = std::atoi(value);
+                else if (name == "png") settings.png_path = value;
+                else if (name == "size") {
+                    auto *x = std::strchr(value, 'x');
+                    settings.width = std::atoi(value);
+                    settings.height = x ? std::atoi(x + 1) : settings.width;
+                }
+            };
+            for (auto name: {"headless", "frames", "size", "png"}) {
+                auto variable = std::string("CS4722_") + name;
+                for (auto &c: variable) c = static_cast<char>(std::toupper(c));
+                apply(name, std::getenv(variable.c_str()));
+            }
+            for (auto i = 1; i < argc; ++i) {
+                auto arg = std::string(argv[i]);
+                if (arg.rfind("--", 0) != 0) continue;
+                auto equals = arg.find('=');
+                auto name = arg.substr(2, equals == std::string::npos ? std::string::npos : equals - 2);
+                apply(name, equals == std::string::npos ? "1" : argv[i] + equals + 1);
+            }
+            return settings;
+        }
+    };
+
+
+    /**
+     * \brief An OpenGL context for an example program, with or without a window.
+     *
+     * Normally this creates a window with `setup_window` and loads OpenGL through GLFW, so `main` works
+     * as before.
+     *
+     * In headless mode, see `headless_settings`, nothing is shown on the screen.
+     * On Linux builds with `CS4722_HEADLESS_EGL` defined the context comes from EGL on the surfaceless
+     * Mesa platform, so it needs no display server and runs on the CPU with llvmpipe.
+     * GLFW is not initialized then and `window` is null.
+     * GLFW functions called before initialization only report an error, so registering callbacks
+     * does nothing, and `glfwGetTime` returns 0, so animations stay at their starting point and the
+     * frames are repeatable.
+     * Elsewhere `window` is an invisible GLFW window that provides the context.
+     * Either way the frames are drawn into a framebuffer object, `framebuffer`, that stands in for
+     * the window.
+     * Code that binds framebuffer 0 to draw to the window should bind `window_framebuffer()` instead,
+     * and code asking GLFW for the framebuffer size should use `framebuffer_size`.
+     *
+     * The frame loop is
+     *
+     *      while (context.running()) {
+     *          // draw
+     *          context.end_frame();
+     *      }
+     *
+     * In headless mode the loop runs for the number of frames requested, then prints the time taken and
+     * writes the last frame to a PNG file if one was requested.
+     */
+    class render_context {
+    public:
+
+        render_context(int argc, char **argv, const char *title, double screen_ratio, double aspect_ratio = 1.0)
+                : settings(headless_settings::from(argc, argv))
+        {
+            current() = this;
+            if (!settings.enabled) {
+                glfwInit();
+                window = setup_window(title, screen_ratio, aspect_ratio);
+                gladLoadGL(glfwGetProcAddress);
+                return;
+            }
+
+            if (settings.height <= 0) settings.height = 800;
+            if (settings.width <= 0) settings.width = static_cast<int>(settings.height * aspect_ratio);
+            create_headless_context();
+
+            glCreateFramebuffers(1, &framebuffer);
+            glCreateRenderbuffers(1, &color_buffer);
+            glNamedRenderbufferStorage(color_buffer, GL_RGBA8, settings.width, settings.height);
+            glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buffer);
+            glCreateRenderbuffers(1, &depth_buffer);
+            glNamedRenderbufferStorage(depth_buffer, GL_DEPTH24_STENCIL8, settings.width, settings.height);
+            glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_buffer);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glViewport(0, 0, settings.width, settings.height);
+            start_time = std::chrono::steady_clock::now();
+        }
+
+        render_context(const render_context &) = delete;
+        render_context &operator=(const render_context &) = delete;
+
+        ~render_context()
+        {
+            if (window) {
+                glfwDestroyWindow(window);
+            }
+            if (framebuffer) {
+                glDeleteFramebuffers(1, &framebuffer);
+                glDeleteRenderbuffers(1, &color_buffer);
+                glDeleteRenderbuffers(1, &depth_buffer);
+            }
+#if defined(CS4722_HEADLESS_EGL)
+            if (display != EGL_NO_DISPLAY) {
+                eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+                eglDestroyContext(display, context);
+                eglTerminate(display);
+            }
+#endif
+            glfwTerminate();
+            current() = nullptr;
+        }
+
+        bool headless() const
+        {
+            return settings.enabled;
+        }
+
+        /**
+         * \brief True while the frame loop should continue.
+         */
+        bool running() const
+        {
+            return headless() ? frame < settings.frames : !glfwWindowShouldClose(window);
+        }
+
+        /**
+         * \brief Finish a frame: show it in the window, or count it when headless.
+         */
+        void end_frame()
+        {
+            if (!headless()) {
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+                return;
+            }
+            ++frame;
+            if (frame < settings.frames) {
+                return;
+            }
+            glFinish();
+            auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+            std::cout << frame << " frames in " << seconds << " s, " << 1000 * seconds / frame
+                      << " ms per frame" << std::endl;
+            if (!settings.png_path.empty()) {
+                save_png(settings.png_path);
+            }
+        }
+
+        /**
+         * \brief Write the current contents of the window, or headless framebuffer, to a PNG file.
+         */
+        bool save_png(const std::string &path)
+        {
+            auto width = 0, height = 0;
+            framebuffer_size(&width, &height);
+            auto pixels = std::vector<std::uint8_t>(static_cast<size_t>(width) * height * 4);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+            // OpenGL rows go from the bottom up, PNG rows from the top down
+            auto row_bytes = static_cast<size_t>(width) * 4;
+            for (auto y = 0; y < height / 2; ++y) {
+                std::swap_ranges(pixels.begin() + y * row_bytes, pixels.begin() + (y + 1) * row_bytes,
+                                 pixels.begin() + (height - 1 - y) * row_bytes);
+            }
+            auto written = write_png(path, width, height, pixels);
+            std::cout << (written ? "wrote " : "could not write ") << path << std::endl;
+            return written;
+        }
+
+        /**
+         * \brief Size of the window framebuffer, or of the headless framebuffer.
+         */
+        void framebuffer_size(int *width, int *height) const
+        {
+            if (!headless()) {
+                glfwGetFramebufferSize(window, width, height);
+            } else {
+                *width = settings.width;
+                *height = settings.height;
+            }
+        }
+
+        /**
+         * \brief The context being used by the program, if any.
+         */
+        static render_context *&current()
+        {
+            static render_context *context = nullptr;
+            return context;
+        }
+
+        GLFWwindow *window = nullptr;
+
+        /**
+         * \brief The framebuffer drawn into in headless mode, 0 otherwise.
+         */
+        GLuint framebuffer = 0;
+
+        headless_settings settings;
+
+    private:
+
+        void create_headless_context()
+        {
+#if defined(CS4722_HEADLESS_EGL)
+            auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+                    eglGetProcAddress("eglGetPlatformDisplayEXT"));
+            display = get_platform_display
+                      ? get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr)
+                      : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+            if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+                std::cerr << "could not initialize EGL" << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
+            eglBindAPI(EGL_OPENGL_API);
+            const EGLint config_attributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+            auto config = EGLConfig();
+            auto count = EGLint(0);
+            eglChooseConfig(display, config_attributes, &config, 1, &count);
+            // compatibility profile, as GLFW gives by default, since some examples draw without a vertex array
+            const EGLint context_attributes[] = {
+                    EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 5,
+                    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT, EGL_NONE};
+            context = eglCreateContext(display, count > 0 ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT,
+                                       context_attributes);
+            if (context == EGL_NO_CONTEXT
+                || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+                std::cerr << "could not create an OpenGL 4.5 context with EGL" << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
+            gladLoadGL(reinterpret_cast<GLADloadfunc>(eglGetProcAddress));
+#else
+            glfwInit();
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+            window = glfwCreateWindow(settings.width, settings.height, "", nullptr, nullptr);
+            glfwMakeContextCurrent(window);
+            gladLoadGL(glfwGetProcAddress);
+#endif
+        }
+
+        int frame = 0;
+        std::chrono::steady_clock::time_point start_time;
+        GLuint color_buffer = 0;
+        GLuint depth_buffer = 0;
+#if defined(CS4722_HEADLESS_EGL)
+        EGLDisplay display = EGL_NO_DISPLAY;
+        EGLContext context = EGL_NO_CONTEXT;
+#endif
+    };
+
+
+    /**
+     * \brief The framebuffer that stands for the window: 0 normally, the headless framebuffer otherwise.
+     */
+    inline GLuint window_framebuffer()
+    {
+        auto *context = render_context::current();
+        return context ? context->framebuffer : 0;
+    }
+
+
+    /**
+     * \brief The size of the framebuffer standing for `window`, see `window_framebuffer`.
+     */
+    inline void window_framebuffer_size(GLFWwindow *window, int *width, int *height)
+    {
+        auto *context = render_context::current();
+        if (context) {
+            context->framebuffer_size(width, height);
+        } else {
+            glfwGetFramebufferSize(window, width, height);
+        }
+    }
+
+}
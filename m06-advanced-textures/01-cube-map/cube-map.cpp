@@ -30,6 +30,7 @@
 #include "cs4722/buffer_utilities.h"
 #include "cs4722/window.h"
 #include "cs4722/compile_shaders.h"
+#include "cs4722/render_context.h"
 
 
 static cs4722::view* the_view;
@@ -214,12 +215,9 @@ void display()
 int
 main(int argc, char** argv)
 {
-    glfwInit();
 
-
-    auto* window = cs4722::setup_window("Cube Map", .9);
-
-    gladLoadGL(glfwGetProcAddress);
+    auto context = cs4722::render_context(argc, argv, "Cube Map", .9);
+    auto *window = context.window;
     cs4722::setup_debug_callbacks();
 
     init();
@@ -234,18 +232,13 @@ main(int argc, char** argv)
     cs4722::setup_user_callbacks(window);
 
 	
-    while (!glfwWindowShouldClose(window))
+    while (context.running())
     {
 
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_float());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
 
         display();
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        context.end_frame();
     }
-
-    glfwDestroyWindow(window);
-
-    glfwTerminate();
 }
@@ -22,6 +22,7 @@
 
 #include "cs4722/window.h"
 #include "cs4722/callbacks.h"
+#include "cs4722/render_context.h"
 
 
 static cs4722::view *the_view;
@@ -185,13 +186,10 @@ void display()
 int
 main(int argc, char** argv)
 {
-    glfwInit();
+    auto context = cs4722::render_context(argc, argv, "Skybox", .9);
+    auto *window = context.window;
 
-    auto *window = cs4722::setup_window("Skybox", .9);
 
-
-
-    gladLoadGL(glfwGetProcAddress);
     cs4722::setup_debug_callbacks();
 
     init();
@@ -207,17 +205,12 @@ main(int argc, char** argv)
     glfwSetCursorPosCallback(window, cs4722::move_callback);
     glfwSetWindowSizeCallback(window, cs4722::window_size_callback);
 	
-    while (!glfwWindowShouldClose(window))
+    while (context.running())
     {
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_float());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
         display();
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        context.end_frame();
 //        printf("view logging %d\n", the_view->enable_logging);
     }
-
-    glfwDestroyWindow(window);
-
-    glfwTerminate();
 }
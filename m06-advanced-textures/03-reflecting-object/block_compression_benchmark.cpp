@@ -0,0 +1,254 @@
+/*
+ * Measure cs4722::block_encoder on the images in the media directory.
+ *
+ * Every image in the directory and its subdirectories, which includes the cube map faces, is encoded
+ *      with BC1 and BC7 at each quality.
+ * For each format and quality the encoding rate and the average PSNR are printed, and then the memory the
+ *      images would take on the GPU with full mip chains, uncompressed and compressed.
+ * Two other uses are covered with textures made here:
+ *      four octaves of noise, each encoded as its own BC4 texture,
+ *      and a normal map made from the brightness of the tulip image, encoded as BC5.
+ *
+ * The first image is also encoded on one thread and on all of them, to report the speedup.
+ * The exit code is 1 if the two encodings differ.
+ *
+ * No window is opened, this program only does CPU work.
+ *
+ * Usage: 03-block-compression-benchmark [media directory]
+ * The default directory is ../media, as used by the examples.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <GLM/gtc/noise.hpp>
+
+#include "cs4722/block_compression.h"
+
+
+struct image {
+    std::string name;
+    int width;
+    int height;
+    std::vector<GLubyte> texels;
+};
+
+
+static std::vector<image> load_images(const std::filesystem::path &directory)
+{
+    auto images = std::vector<image>();
+    for (auto &entry: std::filesystem::recursive_directory_iterator(directory)) {
+        auto extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (extension != ".png" && extension != ".jpg" && extension != ".jpeg" && extension != ".tga") {
+            continue;
+        }
+        int width, height, channels;
+        auto *texels = stbi_load(entry.path().string().c_str(), &width, &height, &channels, 4);
+        if (!texels) {
+            continue;
+        }
+        auto name = std::filesystem::relative(entry.path(), directory).generic_string();
+        images.push_back({name, width, height, std::vector<GLubyte>(texels, texels + 4ull * width * height)});
+        stbi_image_free(texels);
+    }
+    std::sort(images.begin(), images.end(), [](const image &a, const image &b) { return a.name < b.name; });
+    return images;
+}
+
+
+/*
+ * Bytes taken by an image and all its mip levels, `bytes_for` giving the bytes for one level.
+ */
+template<typename F>
+static size_t chain_bytes(int width, int height, F bytes_for)
+{
+    auto total = size_t(0);
+    while (true) {
+        total += bytes_for(width, height);
+        if (width == 1 && height == 1) {
+            return total;
+        }
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+}
+
+
+static double psnr(const std::vector<GLubyte> &a, const std::vector<GLubyte> &b, int channels)
+{
+    auto sum = 0.0;
+    for (size_t i = 0; i < a.size(); i += 4) {
+        for (auto c = 0; c < channels; ++c) {
+            auto d = static_cast<double>(a[i + c]) - b[i + c];
+            sum += d * d;
+        }
+    }
+    auto mean = sum / (a.size() / 4 * channels);
+    return mean > 0 ? 10 * std::log10(255.0 * 255.0 / mean) : 99.0;
+}
+
+
+struct measurement {
+    double seconds = 0;
+    double pixels = 0;
+    double psnr_sum = 0;
+    int count = 0;
+};
+
+
+static std::vector<GLubyte> timed_encode(const cs4722::block_encoder &encoder, const image &img,
+                                         int channels, measurement &m)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto blocks = encoder.encode(img.texels.data(), img.width, img.height);
+    m.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    m.pixels += static_cast<double>(img.width) * img.height;
+    auto decoded = cs4722::block_encoder::decode(encoder.format, blocks.data(), img.width, img.height);
+    m.psnr_sum += psnr(img.texels, decoded, channels);
+    ++m.count;
+    return blocks;
+}
+
+
+static void report(const char *label, const measurement &m)
+{
+    std::cout << std::setw(14) << label << std::setw(12) << std::fixed << std::setprecision(2)
+              << m.pixels / m.seconds / 1e6 << " Mpx/s" << std::setw(10) << m.psnr_sum / m.count << " dB"
+              << std::endl;
+}
+
+
+int main(int argc, char **argv)
+{
+    auto directory = std::filesystem::path(argc > 1 ? argv[1] : "../media");
+    auto images = load_images(directory);
+    if (images.empty()) {
+        std::cerr << "no images found in " << directory << std::endl;
+        return 1;
+    }
+    auto pixels = 0.0;
+    for (auto &img: images) {
+        pixels += static_cast<double>(img.width) * img.height;
+    }
+    std::cout << images.size() << " images, " << pixels / 1e6 << " Mpx, from " << directory << std::endl;
+
+    const std::pair<const char *, cs4722::compression_quality> qualities[] = {
+            {"fast", cs4722::compression_quality::fast},
+            {"normal", cs4722::compression_quality::normal},
+            {"best", cs4722::compression_quality::best},
+    };
+    const std::pair<const char *, cs4722::block_format> photo_formats[] = {
+            {"BC1", cs4722::block_format::bc1},
+            {"BC7", cs4722::block_format::bc7},
+    };
+
+    std::cout << std::endl << "photos, all threads" << std::endl;
+    for (auto &[format_name, format]: photo_formats) {
+        for (auto &[quality_name, quality]: qualities) {
+            auto m = measurement();
+            auto encoder = cs4722::block_encoder(format, quality);
+            for (auto &img: images) {
+                timed_encode(encoder, img, format == cs4722::block_format::bc1 ? 3 : 4, m);
+            }
+            report((std::string(format_name) + " " + quality_name).c_str(), m);
+        }
+    }
+
+    std::cout << std::endl << "GPU memory with mip chains" << std::endl;
+    auto uncompressed = size_t(0), bc1 = size_t(0), bc7 = size_t(0);
+    for (auto &img: images) {
+        uncompressed += chain_bytes(img.width, img.height, [](int w, int h) { return 4ull * w * h; });
+        bc1 += chain_bytes(img.width, img.height, [](int w, int h) {
+            return cs4722::block_encoder::compressed_size(cs4722::block_format::bc1, w, h);
+        });
+        bc7 += chain_bytes(img.width, img.height, [](int w, int h) {
+            return cs4722::block_encoder::compressed_size(cs4722::block_format::bc7, w, h);
+        });
+    }
+    auto megabytes = [](size_t bytes) { return static_cast<double>(bytes) / (1 << 20); };
+    std::cout << std::setprecision(1) << "   RGBA8 " << std::setw(8) << megabytes(uncompressed) << " MB" << std::endl;
+    std::cout << "     BC7 " << std::setw(8) << megabytes(bc7) << " MB, saves "
+              << megabytes(uncompressed - bc7) << " MB" << std::endl;
+    std::cout << "     BC1 " << std::setw(8) << megabytes(bc1) << " MB, saves "
+              << megabytes(uncompressed - bc1) << " MB" << std::endl;
+
+    // four octaves of noise, as the procedural texture examples bake them, one texture each
+    std::cout << std::endl << "noise octaves, BC4" << std::endl;
+    const auto noise_size = 1024;
+    auto octaves = std::vector<image>();
+    auto frequency = 4.0f;
+    for (auto f = 0; f < 4; ++f, frequency *= 2) {
+        auto octave = image{"octave " + std::to_string(f), noise_size, noise_size,
+                            std::vector<GLubyte>(4ull * noise_size * noise_size, 255)};
+        for (auto y = 0; y < noise_size; ++y) {
+            for (auto x = 0; x < noise_size; ++x) {
+                auto sample = glm::simplex(glm::vec2(x, y) * frequency / static_cast<float>(noise_size));
+                octave.texels[4 * (static_cast<size_t>(y) * noise_size + x)] =
+                        static_cast<GLubyte>((sample + 1.0f) * 127.5f);
+            }
+        }
+        octaves.push_back(std::move(octave));
+    }
+    for (auto &[quality_name, quality]: qualities) {
+        auto m = measurement();
+        for (auto &octave: octaves) {
+            timed_encode(cs4722::block_encoder(cs4722::block_format::bc4, quality), octave, 1, m);
+        }
+        report((std::string("BC4 ") + quality_name).c_str(), m);
+    }
+    std::cout << "   4 octaves: " << megabytes(4ull * noise_size * noise_size) << " MB as RGBA8, "
+              << megabytes(4 * cs4722::block_encoder::compressed_size(cs4722::block_format::bc4,
+                                                                       noise_size, noise_size))
+              << " MB as four BC4 textures" << std::endl;
+
+    // a normal map from the brightness of a photo, x and y in red and green as BC5 stores them
+    std::cout << std::endl << "normal map, BC5" << std::endl;
+    auto source = std::find_if(images.begin(), images.end(),
+                               [](const image &img) { return img.name.find("tulips") != std::string::npos; });
+    if (source == images.end()) {
+        source = images.begin();
+    }
+    auto normals = image{"normals", source->width, source->height,
+                         std::vector<GLubyte>(4ull * source->width * source->height, 255)};
+    auto brightness = [&](int x, int y) {
+        x = std::clamp(x, 0, source->width - 1);
+        y = std::clamp(y, 0, source->height - 1);
+        const auto *t = &source->texels[4 * (static_cast<size_t>(y) * source->width + x)];
+        return (t[0] * 0.299f + t[1] * 0.587f + t[2] * 0.114f) / 255.0f;
+    };
+    for (auto y = 0; y < source->height; ++y) {
+        for (auto x = 0; x < source->width; ++x) {
+            auto dx = (brightness(x + 1, y) - brightness(x - 1, y)) * 4;
+            auto dy = (brightness(x, y + 1) - brightness(x, y - 1)) * 4;
+            auto length = std::sqrt(dx * dx + dy * dy + 1);
+            auto *t = &normals.texels[4 * (static_cast<size_t>(y) * source->width + x)];
+            t[0] = static_cast<GLubyte>(std::lround((-dx / length + 1) * 127.5f));
+            t[1] = static_cast<GLubyte>(std::lround((-dy / length + 1) * 127.5f));
+            t[2] = static_cast<GLubyte>(std::lround((1 / length + 1) * 127.5f));
+        }
+    }
+    for (auto &[quality_name, quality]: qualities) {
+        auto m = measurement();
+        timed_encode(cs4722::block_encoder(cs4722::block_format::bc5, quality), normals, 2, m);
+        report((std::string("BC5 ") + quality_name).c_str(), m);
+    }
+
+    std::cout << std::endl << "threads, BC7 normal, " << images.front().name << std::endl;
+    auto one = measurement(), all = measurement();
+    auto single = timed_encode(cs4722::block_encoder(cs4722::block_format::bc7,
+                                                     cs4722::compression_quality::normal, 1),
+                               images.front(), 4, one);
+    auto threaded = timed_encode(cs4722::block_encoder(cs4722::block_format::bc7), images.front(), 4, all);
+    report("1 thread", one);
+    report("all threads", all);
+    auto same = single == threaded;
+    std::cout << (same ? "threaded encoding matches" : "threaded encoding DIFFERS") << std::endl;
+    return same ? 0 : 1;
+}
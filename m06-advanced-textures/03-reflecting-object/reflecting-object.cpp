@@ -7,12 +7,27 @@
  *
  * This example does not reflect the scene objects.  How to do this is discussed in the notes.
  * We haven't implemented that in OpenGL, but there is a WebGL example you can examine.  See the notes.
+ *
+ * Run with --compress to upload the tulip image and the cube map block compressed with BC7,
+ *      which takes a quarter of the memory of the uncompressed textures.
+ *
+ * Run with --async to load the tulip image and the cube map with a cs4722::texture_loader.
+ *      The first frame is drawn at once with gray placeholders, and the textures replace them as
+ *      the images are decoded in the background.
+ *      The time each texture took is printed when it is ready.
+ *
+ * Run with --container to load ../media/tulips-bed-2048x2048.ctex and ../media/fjaderholmarna.ctex, texture
+ *      containers made from the image and the cube map directory by 03-texture-converter.
+ *      Nothing is decoded, the files are mapped and handed to OpenGL as they are.
+ *      A container that is missing or cannot be read is reported and the image is decoded instead.
  */
 
 
 #include <GLM/gtc/matrix_inverse.hpp>
  #include <GLM/gtc/type_ptr.hpp>
 
+#include <cstring>
+
 
 
 #include <glad/gl.h>
@@ -22,11 +37,15 @@
 #include "cs4722/artifact.h"
 #include "cs4722/buffer_utilities.h"
 #include "cs4722/texture_utilities.h"
+#include "cs4722/block_compression.h"
+#include "cs4722/async_texture_loader.h"
+#include "cs4722/texture_container.h"
 #include "cs4722/compile_shaders.h"
 
 
 #include "cs4722/window.h"
 #include "cs4722/callbacks.h"
+#include "cs4722/render_context.h"
 
 
 static cs4722::view *the_view;
@@ -40,6 +59,11 @@ static GLint surface_effect_loc;
 static GLint camera_position_loc;
 
 static GLuint vao;
+static bool compress_textures = false;
+static bool load_async = false;
+static bool load_containers = false;
+static cs4722::texture_loader *texture_loader = nullptr;
+static std::vector<std::shared_ptr<const cs4722::texture_handle>> loading_textures;
 
 
 void init()
@@ -75,9 +99,30 @@ void init()
     glEnable(GL_DEPTH_TEST);
 
 
-    cs4722::init_texture_from_file("../media/tulips-bed-2048x2048.png", 2);
+    if (load_async) {
+        texture_loader = new cs4722::texture_loader();
+    }
+    // a container that could not be read is replaced by decoding the image, as without --container
+    if (!load_containers || !cs4722::init_texture_from_container("../media/tulips-bed-2048x2048.ctex", 2)) {
+        if (load_async) {
+            loading_textures.push_back(texture_loader->load_texture("../media/tulips-bed-2048x2048.png", 2));
+        } else if (compress_textures) {
+            cs4722::init_compressed_texture_from_file("../media/tulips-bed-2048x2048.png", 2);
+        } else {
+            cs4722::init_texture_from_file("../media/tulips-bed-2048x2048.png", 2);
+        }
+    }
     cs4722::init_texture_computed(1, 8);
-    cs4722::init_cube_texture_from_path("../media/fjaderholmarna", 10, "png");
+    if (!load_containers || !cs4722::init_texture_from_container("../media/fjaderholmarna.ctex", 10)) {
+        if (load_async) {
+            loading_textures.push_back(texture_loader->load_cube_texture_from_path("../media/fjaderholmarna", 10,
+                                                                                   "png"));
+        } else if (compress_textures) {
+            cs4722::init_compressed_cube_texture_from_path("../media/fjaderholmarna", 10, "png");
+        } else {
+            cs4722::init_cube_texture_from_path("../media/fjaderholmarna", 10, "png");
+        }
+    }
 //    cs4722::init_cube_texture_from_path("../media/oriented-cube", 10, "png");
 
     cs4722::shape* b = new cs4722::sphere(15, 50);
@@ -234,15 +279,21 @@ void display()
 int
 main(int argc, char** argv)
 {
-    glfwInit();
-
-    auto *window = cs4722::setup_window("Skybox", .9);
+    auto context = cs4722::render_context(argc, argv, "Skybox", .9);
+    auto *window = context.window;
 
 
-
-    gladLoadGL(glfwGetProcAddress);
     cs4722::setup_debug_callbacks();
 
+    for (auto a = 1; a < argc; ++a) {
+        if (std::strcmp(argv[a], "--compress") == 0) {
+            compress_textures = true;
+        } else if (std::strcmp(argv[a], "--async") == 0) {
+            load_async = true;
+        } else if (std::strcmp(argv[a], "--container") == 0) {
+            load_containers = true;
+        }
+    }
     init();
 
     glfwSetWindowUserPointer(window, the_view);
@@ -257,17 +308,21 @@ main(int argc, char** argv)
     glfwSetCursorPosCallback(window, cs4722::move_callback);
     glfwSetWindowSizeCallback(window, cs4722::window_size_callback);
 	
-    while (!glfwWindowShouldClose(window))
+    while (context.running())
     {
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_float());
+        if (texture_loader) {
+            texture_loader->update();
+            std::erase_if(loading_textures, [](const std::shared_ptr<const cs4722::texture_handle> &handle) {
+                if (handle->ready()) {
+                    printf("texture unit %d ready after %.1f ms\n", handle->texture_unit, handle->milliseconds);
+                }
+                return !handle->loading();
+            });
+        }
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
         display();
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        context.end_frame();
 //        printf("view logging %d\n", the_view->enable_logging);
     }
-
-    glfwDestroyWindow(window);
-
-    glfwTerminate();
 }
@@ -0,0 +1,170 @@
+/*
+ * Convert images to texture containers, see cs4722/texture_container.h, so the examples can load them
+ *      without decoding them.
+ *
+ * Each input is an image file, which becomes a 2D texture, or a directory holding the files posx.*, negx.*,
+ *      posy.*, negy.*, posz.*, negz.*, which becomes a cube texture as with init_cube_texture_from_path.
+ *      A directory may lack some of the faces, as fjaderholmarna does; as in 03-texture-loading-benchmark,
+ *      a missing face is replaced by one of the faces that is there, and the replacements are listed.
+ * The container is written next to the input, with the extension replaced by .ctex, or .ctex added for
+ *      a directory, so ../media/fjaderholmarna becomes ../media/fjaderholmarna.ctex.
+ * Every mip level is stored, down to 1 by 1.
+ *
+ * Usage: 03-texture-converter [--raw | --bc1 | --bc7] [--fast | --best] input...
+ *      --raw  store RGBA8 texels, the default
+ *      --bc1, --bc7  block compress the texels with cs4722::block_encoder
+ *      --fast, --best  effort spent on each block, normal by default
+ *
+ * The exit code is 1 if any input could not be converted.
+ */
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cs4722/texture_container.h"
+
+
+struct rgba_image {
+    int width = 0;
+    int height = 0;
+    std::vector<GLubyte> texels;
+};
+
+
+static bool read_image(const std::filesystem::path &path, rgba_image &image)
+{
+    int channels;
+    auto *texels = stbi_load(path.string().c_str(), &image.width, &image.height, &channels, 4);
+    if (!texels) {
+        std::cerr << "could not read " << path.string() << std::endl;
+        return false;
+    }
+    image.texels.assign(texels, texels + 4ull * image.width * image.height);
+    stbi_image_free(texels);
+    return true;
+}
+
+
+/*
+ * The face files of a cube map directory, in the order of the cube map layers.
+ * False if there are none at all.
+ */
+static bool find_faces(const std::filesystem::path &directory, std::vector<std::filesystem::path> &faces)
+{
+    const char *names[] = {"posx", "negx", "posy", "negy", "posz", "negz"};
+    auto present = std::vector<std::filesystem::path>();
+    for (auto *name: names) {
+        auto found = std::filesystem::path();
+        for (auto &entry: std::filesystem::directory_iterator(directory)) {
+            if (entry.path().stem() == name) {
+                found = entry.path();
+                present.push_back(found);
+                break;
+            }
+        }
+        faces.push_back(found);
+    }
+    if (present.empty()) {
+        std::cerr << "no cube map faces in " << directory.string() << std::endl;
+        return false;
+    }
+    for (auto face = 0; face < 6; ++face) {
+        if (faces[face].empty()) {
+            auto &stand_in = present[face % present.size()];
+            std::cout << names[face] << " is missing, using " << stand_in.string() << std::endl;
+            faces[face] = stand_in;
+        }
+    }
+    return true;
+}
+
+
+static bool convert(const std::filesystem::path &input, const cs4722::block_encoder *encoder, GLenum internal_format)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto sources = std::vector<std::filesystem::path>();
+    auto output = input;
+    if (std::filesystem::is_directory(input)) {
+        if (!find_faces(input, sources)) {
+            return false;
+        }
+        output = input.string() + ".ctex";
+    } else {
+        sources.push_back(input);
+        output.replace_extension(".ctex");
+    }
+
+    auto faces = std::vector<std::vector<std::vector<GLubyte>>>();
+    int width = 0, height = 0;
+    for (auto &source: sources) {
+        rgba_image image;
+        if (!read_image(source, image)) {
+            return false;
+        }
+        if (faces.empty()) {
+            width = image.width;
+            height = image.height;
+        } else if (image.width != width || image.height != height) {
+            std::cerr << "cube faces must be squares of one size, " << source.string() << std::endl;
+            return false;
+        }
+        faces.push_back(cs4722::texture_container_levels(image.texels.data(), width, height, encoder));
+    }
+    if (!cs4722::write_texture_container(output.string().c_str(), internal_format, width, height, faces)) {
+        return false;
+    }
+
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << input.string() << " -> " << output.string() << ", " << width << "x" << height
+              << (faces.size() == 6 ? " cube, " : ", ") << faces.front().size() << " levels, "
+              << std::filesystem::file_size(output) / 1024 << " KiB, " << seconds << " s" << std::endl;
+    return true;
+}
+
+
+int
+main(int argc, char** argv)
+{
+    auto format = cs4722::block_format::bc7;
+    auto compress = false;
+    auto quality = cs4722::compression_quality::normal;
+    auto inputs = std::vector<std::filesystem::path>();
+    for (auto a = 1; a < argc; ++a) {
+        if (std::strcmp(argv[a], "--raw") == 0) {
+            compress = false;
+        } else if (std::strcmp(argv[a], "--bc1") == 0) {
+            compress = true;
+            format = cs4722::block_format::bc1;
+        } else if (std::strcmp(argv[a], "--bc7") == 0) {
+            compress = true;
+            format = cs4722::block_format::bc7;
+        } else if (std::strcmp(argv[a], "--fast") == 0) {
+            quality = cs4722::compression_quality::fast;
+        } else if (std::strcmp(argv[a], "--best") == 0) {
+            quality = cs4722::compression_quality::best;
+        } else if (argv[a][0] == '-') {
+            std::cerr << "unknown option " << argv[a] << std::endl;
+            return 2;
+        } else {
+            inputs.emplace_back(argv[a]);
+        }
+    }
+    if (inputs.empty()) {
+        std::cerr << "usage: " << argv[0] << " [--raw | --bc1 | --bc7] [--fast | --best] input..." << std::endl;
+        return 2;
+    }
+
+    auto encoder = cs4722::block_encoder(format, quality);
+    auto internal_format = compress ? cs4722::block_encoder::internal_format(format) : GL_RGBA8;
+    auto failed = false;
+    for (auto &input: inputs) {
+        if (!convert(input, compress ? &encoder : nullptr, internal_format)) {
+            failed = true;
+        }
+    }
+    return failed ? 1 : 0;
+}
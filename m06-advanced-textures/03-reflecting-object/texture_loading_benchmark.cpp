@@ -0,0 +1,234 @@
+/*
+ * Measure how long a program waits for a cube map at start up, loading it the way
+ *      init_cube_texture_from_path does, with cs4722::texture_loader, and from a texture container.
+ *
+ * Loading in order, each face is decoded and uploaded in turn and the first frame is drawn after the last one.
+ * With the loader, the first frame is drawn with the placeholder, and frames keep being drawn
+ *      while the faces are decoded on the loader's threads, until the cube map is bound.
+ *      These frames are paced at 60 a second, as a program waiting for the display would draw them,
+ *      so they leave the processor to the decoding threads between frames.
+ * For each, the time to the first frame and the time until the cube map is ready are printed.
+ * The loader is run with one thread and with the hardware concurrency, to separate the gain from
+ *      decoding in parallel from the gain from not blocking.
+ * The cube map is also written to a container, with RGBA8 texels, as 03-texture-converter writes them,
+ *      and loaded with init_texture_from_container; the time to read the whole file is printed beside it,
+ *      as the least that loading it could take.
+ *
+ * The files are read once before timing, so the times are for files in the operating system's cache.
+ * The fjaderholmarna directory has only some of the six faces; a missing face is replaced by one of the
+ *      faces that is there, so the cube map is the full size, and the replacements are listed.
+ *
+ * The cube maps made each way are read back and compared; the exit code is 1 if they differ.
+ *
+ * Usage: 03-texture-loading-benchmark [cube map directory] [--headless ...]
+ * The default directory is ../media/fjaderholmarna, as used by 03-reflecting-object.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "cs4722/async_texture_loader.h"
+#include "cs4722/parallel_for.h"
+#include "cs4722/texture_container.h"
+#include "cs4722/render_context.h"
+
+
+static double milliseconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+static void draw_frame()
+{
+    static const GLfloat gray[] = {.5f, .5f, .5f, 1.0f};
+    glClearBufferfv(GL_COLOR, 0, gray);
+    glFinish();
+}
+
+
+/*
+ * As init_cube_texture_from_path: each face decoded and uploaded before the next one is read.
+ */
+static GLuint load_in_order(const std::vector<std::string> &paths)
+{
+    GLuint texture = 0;
+    for (auto face = 0; face < 6; ++face) {
+        int width, height, channels;
+        auto *texels = stbi_load(paths[face].c_str(), &width, &height, &channels, 4);
+        if (!texels) {
+            std::cerr << "could not read " << paths[face] << std::endl;
+            return 0;
+        }
+        if (!texture) {
+            auto levels = 1;
+            while ((width >> levels) > 0) {
+                ++levels;
+            }
+            glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &texture);
+            glTextureStorage2D(texture, levels, GL_RGBA8, width, height);
+        }
+        glTextureSubImage3D(texture, 0, 0, 0, face, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+        stbi_image_free(texels);
+    }
+    glGenerateTextureMipmap(texture);
+    return texture;
+}
+
+
+static std::vector<GLubyte> read_back(GLuint texture, int level)
+{
+    int size;
+    glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_WIDTH, &size);
+    auto texels = std::vector<GLubyte>(6ull * 4 * size * size);
+    glGetTextureImage(texture, level, GL_RGBA, GL_UNSIGNED_BYTE, static_cast<GLsizei>(texels.size()),
+                      texels.data());
+    return texels;
+}
+
+
+int
+main(int argc, char** argv)
+{
+    auto directory = std::string("../media/fjaderholmarna");
+    for (auto a = 1; a < argc; ++a) {
+        if (std::strncmp(argv[a], "--", 2) != 0) {
+            directory = argv[a];
+        }
+    }
+
+    const char *faces[] = {"posx", "negx", "posy", "negy", "posz", "negz"};
+    auto present = std::vector<std::string>();
+    for (auto *face: faces) {
+        auto path = directory + "/" + face + ".png";
+        if (std::filesystem::exists(path)) {
+            present.push_back(path);
+        }
+    }
+    if (present.empty()) {
+        std::cerr << "no cube map faces in " << directory << std::endl;
+        return 2;
+    }
+    auto paths = std::vector<std::string>();
+    for (auto face = 0; face < 6; ++face) {
+        auto path = directory + "/" + faces[face] + ".png";
+        if (!std::filesystem::exists(path)) {
+            auto &stand_in = present[face % present.size()];
+            std::cout << faces[face] << " is missing, using " << stand_in << std::endl;
+            path = stand_in;
+        }
+        paths.push_back(path);
+    }
+    // read the files once, so every run finds them in the file cache
+    for (auto &path: paths) {
+        std::ifstream(path, std::ios::binary).ignore(std::numeric_limits<std::streamsize>::max());
+    }
+
+    auto context = cs4722::render_context(argc, argv, "Texture loading benchmark", .5);
+    const auto runs = 3;
+
+    std::cout << "\nloading in order" << std::endl;
+    GLuint in_order = 0;
+    for (auto run = 0; run < runs; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        if (in_order) glDeleteTextures(1, &in_order);
+        in_order = load_in_order(paths);
+        draw_frame();
+        auto ready = milliseconds_since(start);
+        if (!in_order) {
+            return 2;
+        }
+        printf("    first frame %8.1f ms   ready %8.1f ms\n", ready, ready);
+    }
+
+    auto hardware = cs4722::thread_count(0);
+    auto thread_counts = hardware > 1 ? std::vector<int>{1, hardware} : std::vector<int>{1};
+    const auto frame_time = std::chrono::microseconds(16667);
+    auto differ = false;
+    for (auto threads: thread_counts) {
+        std::cout << "\ntexture_loader with " << threads << (threads == 1 ? " thread" : " threads") << std::endl;
+        for (auto run = 0; run < runs; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            auto loader = cs4722::texture_loader(threads);
+            auto handle = loader.load_cube_texture(paths, 10);
+            draw_frame();
+            auto first_frame = milliseconds_since(start);
+            auto frames = 1;
+            auto longest_update = 0.0;
+            auto next_frame = start + frame_time;
+            while (handle->loading()) {
+                std::this_thread::sleep_until(next_frame);
+                next_frame += frame_time;
+                auto update_start = std::chrono::steady_clock::now();
+                loader.update();
+                longest_update = std::max(longest_update, milliseconds_since(update_start));
+                draw_frame();
+                ++frames;
+            }
+            auto ready = milliseconds_since(start);
+            if (handle->failed()) {
+                return 2;
+            }
+            printf("    first frame %8.1f ms   ready %8.1f ms   %d frames drawn, longest update %.1f ms\n",
+                   first_frame, ready, frames, longest_update);
+
+            if (run == 0 && read_back(handle->texture, 0) != read_back(in_order, 0)) {
+                std::cout << "    the cube map differs from the one loaded in order" << std::endl;
+                differ = true;
+            }
+            glDeleteTextures(1, &handle->texture);
+        }
+    }
+
+    auto container = (std::filesystem::temp_directory_path() / "texture_loading_benchmark.ctex").string();
+    auto levels = std::vector<std::vector<std::vector<GLubyte>>>();
+    int size = 0;
+    for (auto &path: paths) {
+        int width, height, channels;
+        auto *texels = stbi_load(path.c_str(), &width, &height, &channels, 4);
+        levels.push_back(cs4722::texture_container_levels(texels, width, height));
+        stbi_image_free(texels);
+        size = width;
+    }
+    if (!cs4722::write_texture_container(container.c_str(), GL_RGBA8, size, size, levels)) {
+        return 2;
+    }
+    levels.clear();
+    auto container_bytes = std::filesystem::file_size(container);
+    printf("\nfrom a container of %.1f MiB\n", static_cast<double>(container_bytes) / (1 << 20));
+    for (auto run = 0; run < runs; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        auto contents = std::vector<char>(container_bytes);
+        std::ifstream(container, std::ios::binary).read(contents.data(), static_cast<std::streamsize>(contents.size()));
+        auto read = milliseconds_since(start);
+
+        start = std::chrono::steady_clock::now();
+        auto texture = cs4722::init_texture_from_container(container.c_str(), 10);
+        draw_frame();
+        auto ready = milliseconds_since(start);
+        if (!texture) {
+            return 2;
+        }
+        printf("    first frame %8.1f ms   ready %8.1f ms   reading the file %.1f ms\n", ready, ready, read);
+
+        if (run == 0 && read_back(texture, 0) != read_back(in_order, 0)) {
+            std::cout << "    the cube map differs from the one loaded in order" << std::endl;
+            differ = true;
+        }
+        glDeleteTextures(1, &texture);
+    }
+    std::filesystem::remove(container);
+    glDeleteTextures(1, &in_order);
+
+    return differ ? 1 : 0;
+}
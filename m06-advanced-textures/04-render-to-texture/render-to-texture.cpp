@@ -4,6 +4,7 @@
 
 #include "cs4722/window.h"
 #include "cs4722/callbacks.h"
+#include "cs4722/render_context.h"
 
 /*
  * This example is more complex since there are two different shader programs to support
@@ -37,12 +38,9 @@
 int
 main(int argc, char** argv)
 {
-    glfwInit();
+    auto context = cs4722::render_context(argc, argv, "View in View", .9);
+    auto *window = context.window;
 
-    auto *window = cs4722::setup_window("View in View", .9);
-
-
-    gladLoadGL(glfwGetProcAddress);
     glDebugMessageCallback(cs4722::message_callback, nullptr);
 
 
@@ -66,12 +64,12 @@ main(int argc, char** argv)
     glfwSetCursorPosCallback(window, cs4722::move_callback);
     glfwSetWindowSizeCallback(window, cs4722::window_size_callback);
 	
-    while (!glfwWindowShouldClose(window))
+    while (context.running())
     {
         // set up the frame buffer for rendering to a texture
         scene_setup_for_fb();
         // clear that buffer
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::olive_drab.as_float());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::olive_drab.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
         // reverse the camera
         view->camera_forward = -view->camera_forward;
@@ -86,7 +84,7 @@ main(int argc, char** argv)
         //  shift the sub-scene rendering to the window
         scene_setup_for_window(window);
         // clear the window frame buffer
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_float());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
         // render the parts subscene into the window frame buffer
         scene_display();
@@ -94,11 +92,6 @@ main(int argc, char** argv)
         //    The texture created in the earlier rendering is used to cover the rectangle
         view_in_view_display();
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        context.end_frame();
     }
-
-    glfwDestroyWindow(window);
-
-    glfwTerminate();
 }
@@ -0,0 +1,38 @@
+#version 430 core
+
+/*
+ * The filters of fragment_shader05A.glsl, and a few more, applied one after another as the uniforms list them,
+ *      choosing each filter with a switch.
+ * This is what a chain of filters costs without cs4722::color_lut, which works the same chain out for
+ *      every color ahead of time so the fragment shader only fetches the result.
+ * The numbers of the filters are those of cs4722::color_filter, and apply_color_filter is
+ *      cs4722::color_filter_glsl, which color_grading_benchmark.cpp compiles after this file.
+ *
+ * Used by color_grading_benchmark.cpp to compare the two.
+ */
+
+out vec4 fColor;
+
+in vec2 vTextureCoord;
+in vec4 vPosition;
+
+uniform sampler2D  sampler2;
+
+const int max_steps = 16;
+uniform int count;
+uniform int filters[max_steps];
+uniform float amounts[max_steps];
+
+vec3 apply_color_filter(int number, float amount, vec3 c);
+
+void main()
+{
+    vec4 base_color = texture(sampler2, vTextureCoord);
+    vec3 c = base_color.rgb;
+
+    for (int s = 0; s < count; s++) {
+        c = apply_color_filter(filters[s], amounts[s], c);
+    }
+
+    fColor = vec4(c, base_color.a);
+}
@@ -0,0 +1,366 @@
+/*
+ * Measure what a chain of color filters costs in the fragment shader when each filter is applied in turn,
+ *      color_chain_fragment_shader.glsl with cs4722::color_filter_glsl, against the single fetch from the 3D texture of cs4722::color_lut,
+ *      fragment_shader05A.glsl with use_lut, as 05A-pixel-filters --grade draws it.
+ *
+ * The tulips photo is drawn into a texture of its size, 2048 by 2048, with each shader.
+ * The chains are 1, 2, 4, ... up to --max-steps filters taken in turn from saturation, contrast, sepia,
+ *      brightness and gamma, with small amounts, the sort of chain used to grade a picture.
+ * For each chain the table has, in milliseconds:
+ *      GPU chain, a frame drawn with color_chain_fragment_shader.glsl
+ *      GPU LUT 32 and GPU LUT 64, a frame drawn through textures of 32 and 64 colors a side
+ *      build 32 and build 64, working out the whole chain for every color of those textures on the CPU
+ *      update 64, working it out again after the amount of the last filter changed, which only redoes that filter
+ * and the errors, in 255ths, of:
+ *      err 32 and err 64, the largest difference between the texture filtered on the CPU and the chain
+ *          worked out exactly, over a grid of colors that falls between those of the textures
+ *      max diff, the largest difference between the frames of GPU chain and GPU LUT 64
+ * The exit code is 1 if max diff is more than 3.
+ * The first row, 0 filters, is the cost of drawing the frame with no filter at all.
+ * GPU times are from glFinish to glFinish around the draws.
+ *
+ * Usage: 05A-color-grading-benchmark [--max-steps=N] [--threads=N] [--headless ...]
+ *      --max-steps is 16 by default and at most 16, --threads is for building the textures, one per hardware
+ *      thread by default.
+ * Run from the build directory, where the shaders are copied.
+ */
+
+#include <GLM/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "cs4722/color_filter.h"
+#include "cs4722/color_lut.h"
+#include "cs4722/compile_shaders.h"
+#include "cs4722/parallel_for.h"
+#include "cs4722/render_context.h"
+#include "STB/stb_image.h"
+
+
+static const auto max_steps = 16;
+static const auto source_texture_unit = 2;
+static const auto lut_texture_unit = 11;
+
+
+template<typename F>
+static double cpu_milliseconds(F run, int repeats)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (auto r = 0; r < repeats; ++r) {
+        run();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+}
+
+
+/*
+ * The first steps of a chain of small adjustments, each filter with its amount.
+ */
+static std::vector<cs4722::color_step> grading_chain(int steps)
+{
+    const cs4722::color_step cycle[] = {
+            {cs4722::color_filter::saturation, 0.9f},
+            {cs4722::color_filter::contrast, 1.1f},
+            {cs4722::color_filter::sepia, 0.2f},
+            {cs4722::color_filter::brightness, 0.02f},
+            {cs4722::color_filter::gamma, 1.05f},
+    };
+    auto chain = std::vector<cs4722::color_step>();
+    for (auto s = 0; s < steps; ++s) {
+        chain.push_back(cycle[s % std::size(cycle)]);
+    }
+    return chain;
+}
+
+
+/*
+ * Largest difference between the filtered texture and the exact chain, in 255ths, over a grid of colors
+ *      whose spacing does not line up with the texture.
+ */
+static double lut_error(const cs4722::color_lut &lut)
+{
+    const auto n = 37;
+    auto error = 0.0f;
+    for (auto b = 0; b < n; ++b) {
+        for (auto g = 0; g < n; ++g) {
+            for (auto r = 0; r < n; ++r) {
+                auto c = glm::vec3(r, g, b) / static_cast<float>(n - 1);
+                // as the frame buffer clamps them
+                auto difference = glm::abs(glm::clamp(lut.lookup(c), 0.0f, 1.0f)
+                                           - glm::clamp(lut.exact(c), 0.0f, 1.0f));
+                error = std::max({error, difference.r, difference.g, difference.b});
+            }
+        }
+    }
+    return 255.0 * error;
+}
+
+
+/*
+ * The photo, or a gradient through many colors if it is missing, drawn with either shader into a
+ *      texture of the same size.
+ */
+class frame_drawer {
+public:
+
+    frame_drawer()
+    {
+        int channels;
+        auto *texels = stbi_load("../media/tulips-bed-2048x2048.png", &width, &height, &channels, 4);
+        auto rgba = std::vector<GLubyte>();
+        if (texels) {
+            rgba.assign(texels, texels + 4ull * width * height);
+            stbi_image_free(texels);
+        } else {
+            std::cerr << "could not read ../media/tulips-bed-2048x2048.png" << std::endl;
+            width = height = 2048;
+            rgba.resize(4ull * width * height);
+            for (auto y = 0; y < height; ++y) {
+                for (auto x = 0; x < width; ++x) {
+                    auto *texel = &rgba[4 * (static_cast<size_t>(y) * width + x)];
+                    texel[0] = static_cast<GLubyte>(x * 255 / (width - 1));
+                    texel[1] = static_cast<GLubyte>(y * 255 / (height - 1));
+                    texel[2] = static_cast<GLubyte>((x + y) % 256);
+                    texel[3] = 255;
+                }
+            }
+        }
+        glCreateTextures(GL_TEXTURE_2D, 1, &source);
+        glTextureStorage2D(source, 1, GL_RGBA8, width, height);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTextureSubImage2D(source, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTextureParameteri(source, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(source, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTextureUnit(source_texture_unit, source);
+
+        glCreateTextures(GL_TEXTURE_2D, 1, &result);
+        glTextureStorage2D(result, 1, GL_RGBA8, width, height);
+        glCreateFramebuffers(1, &frame_buffer);
+        glNamedFramebufferTexture(frame_buffer, GL_COLOR_ATTACHMENT0, result, 0);
+
+        chain_program = set_up(compile_chain());
+        count_loc = glGetUniformLocation(chain_program, "count");
+        filters_loc = glGetUniformLocation(chain_program, "filters");
+        amounts_loc = glGetUniformLocation(chain_program, "amounts");
+        lut_program = set_up(cs4722::compile_shaders("vertex_shader05A.glsl", "fragment_shader05A.glsl"));
+        glUniform1i(glGetUniformLocation(lut_program, "surface_effect"), 0);
+        glUniform1i(glGetUniformLocation(lut_program, "lut"), lut_texture_unit);
+        use_lut_loc = glGetUniformLocation(lut_program, "use_lut");
+
+        // two triangles covering the target, positions then texture coordinates
+        const GLfloat vertices[] = {
+                -1, -1, 0, 1, 0, 0,   1, -1, 0, 1, 1, 0,   1, 1, 0, 1, 1, 1,
+                -1, -1, 0, 1, 0, 0,   1, 1, 0, 1, 1, 1,   -1, 1, 0, 1, 0, 1,
+        };
+        glCreateBuffers(1, &vertex_buffer);
+        glNamedBufferStorage(vertex_buffer, sizeof(vertices), vertices, 0);
+        glCreateVertexArrays(1, &vao);
+        glVertexArrayVertexBuffer(vao, 0, vertex_buffer, 0, 6 * sizeof(GLfloat));
+        auto position = glGetAttribLocation(lut_program, "bPosition");
+        auto texture_coordinate = glGetAttribLocation(lut_program, "bTextureCoord");
+        glEnableVertexArrayAttrib(vao, position);
+        glVertexArrayAttribFormat(vao, position, 4, GL_FLOAT, GL_FALSE, 0);
+        glVertexArrayAttribBinding(vao, position, 0);
+        glEnableVertexArrayAttrib(vao, texture_coordinate);
+        glVertexArrayAttribFormat(vao, texture_coordinate, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat));
+        glVertexArrayAttribBinding(vao, texture_coordinate, 0);
+    }
+
+    void set_chain(const std::vector<cs4722::color_step> &chain)
+    {
+        GLint filters[max_steps];
+        GLfloat amounts[max_steps];
+        for (size_t s = 0; s < chain.size(); ++s) {
+            filters[s] = static_cast<GLint>(chain[s].filter);
+            amounts[s] = chain[s].amount;
+        }
+        glUseProgram(chain_program);
+        glUniform1i(count_loc, static_cast<GLint>(chain.size()));
+        if (!chain.empty()) {
+            glUniform1iv(filters_loc, static_cast<GLsizei>(chain.size()), filters);
+            glUniform1fv(amounts_loc, static_cast<GLsizei>(chain.size()), amounts);
+        }
+    }
+
+    /*
+     * Milliseconds for a frame, averaged over the repeats.
+     * With use_lut false the LUT shader draws the photo unchanged.
+     */
+    double milliseconds(bool chain, bool use_lut, int repeats)
+    {
+        glBindVertexArray(vao);
+        glUseProgram(chain ? chain_program : lut_program);
+        if (!chain) {
+            glUniform1i(use_lut_loc, use_lut);
+        }
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frame_buffer);
+        glViewport(0, 0, width, height);
+        // once untimed, so the time of compiling the shader for its first draw is left out
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        for (auto r = 0; r < repeats; ++r) {
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+        }
+        glFinish();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+    }
+
+    std::vector<GLubyte> read_result() const
+    {
+        auto texels = std::vector<GLubyte>(4ull * width * height);
+        glGetTextureImage(result, 0, GL_RGBA, GL_UNSIGNED_BYTE, static_cast<GLsizei>(texels.size()), texels.data());
+        return texels;
+    }
+
+    int width = 0;
+    int height = 0;
+
+private:
+
+    static std::string read_file(const char *path)
+    {
+        auto in = std::ifstream(path);
+        auto text = std::stringstream();
+        text << in.rdbuf();
+        return text.str();
+    }
+
+    /*
+     * The chain shader, followed in the same source by cs4722::color_filter_glsl for the apply_color_filter
+     *      it declares.
+     */
+    static GLuint compile_chain()
+    {
+        auto vertex = read_file("vertex_shader05A.glsl");
+        auto fragment = read_file("color_chain_fragment_shader.glsl");
+        const char *vertex_sources[] = {vertex.c_str()};
+        const char *fragment_sources[] = {fragment.c_str(), cs4722::color_filter_glsl};
+        const char *const *sources[] = {vertex_sources, fragment_sources};
+        const GLsizei counts[] = {1, 2};
+        const GLenum types[] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+        auto program = glCreateProgram();
+        for (auto i = 0; i < 2; ++i) {
+            auto shader = glCreateShader(types[i]);
+            glShaderSource(shader, counts[i], sources[i], nullptr);
+            glCompileShader(shader);
+            GLint ok;
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+            if (!ok) {
+                char log[2048];
+                glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+                std::cerr << "the chain shader did not compile:\n" << log << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
+            glAttachShader(program, shader);
+            glDeleteShader(shader);
+        }
+        glLinkProgram(program);
+        return program;
+    }
+
+    static GLuint set_up(GLuint program)
+    {
+        glUseProgram(program);
+        auto identity = glm::mat4(1);
+        glUniformMatrix4fv(glGetUniformLocation(program, "transform"), 1, GL_FALSE, glm::value_ptr(identity));
+        glUniform1i(glGetUniformLocation(program, "sampler2"), source_texture_unit);
+        return program;
+    }
+
+    GLuint source = 0, result = 0, frame_buffer = 0;
+    GLuint chain_program = 0, lut_program = 0;
+    GLint count_loc = -1, filters_loc = -1, amounts_loc = -1, use_lut_loc = -1;
+    GLuint vao = 0, vertex_buffer = 0;
+};
+
+
+int
+main(int argc, char** argv)
+{
+    auto steps_limit = max_steps;
+    auto threads = 0;
+    for (auto a = 1; a < argc; ++a) {
+        if (std::strncmp(argv[a], "--max-steps=", 12) == 0) {
+            steps_limit = std::clamp(std::atoi(argv[a] + 12), 1, max_steps);
+        } else if (std::strncmp(argv[a], "--threads=", 10) == 0) {
+            threads = std::max(0, std::atoi(argv[a] + 10));
+        }
+    }
+
+    auto context = cs4722::render_context(argc, argv, "Color grading benchmark", .5);
+    auto drawer = frame_drawer();
+    const auto repeats = 5;
+
+    std::cout << drawer.width << " x " << drawer.height << " frame, " << cs4722::thread_count(threads)
+              << " threads for building the textures, milliseconds\n\n";
+    printf("%6s %10s %10s %10s %10s %10s %10s %8s %8s %9s\n", "steps", "GPU chain", "GPU LUT 32", "GPU LUT 64",
+           "build 32", "build 64", "update 64", "err 32", "err 64", "max diff");
+    printf("%6d %10.2f\n", 0, drawer.milliseconds(false, false, repeats));
+
+    auto differ = false;
+    for (auto steps = 1; steps <= steps_limit; steps *= 2) {
+        auto chain = grading_chain(steps);
+        drawer.set_chain(chain);
+        auto gpu_chain = drawer.milliseconds(true, false, repeats);
+        auto chain_frame = drawer.read_result();
+
+        double gpu_lut[2], build[2], error[2];
+        auto update = 0.0;
+        auto lut_frame = std::vector<GLubyte>();
+        for (auto i = 0; i < 2; ++i) {
+            auto size = i == 0 ? 32 : 64;
+            auto add_chain = [&](cs4722::color_lut &lut) {
+                for (auto &step: chain) {
+                    lut.add(step.filter, step.amount);
+                }
+            };
+            build[i] = cpu_milliseconds([&]() {
+                auto lut = cs4722::color_lut(size, threads);
+                add_chain(lut);
+                lut.update();
+            }, 3);
+
+            // its texture is deleted at the end of the iteration
+            auto lut = cs4722::color_lut(size, threads);
+            add_chain(lut);
+            lut.upload(lut_texture_unit);
+            error[i] = lut_error(lut);
+            gpu_lut[i] = drawer.milliseconds(false, true, repeats);
+            if (size == 64) {
+                lut_frame = drawer.read_result();
+                update = cpu_milliseconds([&]() {
+                    lut.set_amount(steps - 1, lut.steps().back().amount + 0.001f);
+                    lut.update();
+                }, 3);
+            }
+        }
+
+        auto max_difference = 0;
+        for (size_t t = 0; t < chain_frame.size(); ++t) {
+            max_difference = std::max(max_difference, std::abs(chain_frame[t] - lut_frame[t]));
+        }
+        differ = differ || max_difference > 3;
+
+        printf("%6d %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f %8.2f %8.2f %9d\n", steps, gpu_chain, gpu_lut[0],
+               gpu_lut[1], build[0], build[1], update, error[0], error[1], max_difference);
+    }
+
+    if (differ) {
+        std::cout << "\nthe frames drawn with the chain and with the texture differ by more than 3" << std::endl;
+    }
+    return differ ? 1 : 0;
+}
@@ -19,6 +19,13 @@ uniform sampler2D  sampler2;
 uniform samplerCube  samplerC;
 uniform int surface_effect;
 
+/*
+ * When use_lut is true, the color chosen below is graded with the 3D texture made by cs4722::color_lut,
+ *      which holds a whole chain of filters like these for every color, see pixel_filters.cpp.
+ */
+uniform sampler3D lut;
+uniform bool use_lut;
+
 void main()
 {
     vec4 base_color;
@@ -125,6 +132,17 @@ void main()
 //      fColor = vec4(1.0 - base_color.r, 1.0 - base_color.g, 1.0 - base_color.b, 1.0);
 
 
+    /*
+     * The texture has n colors along each side, the first and last at the centers of its first and last
+     *      texels, so the color is scaled and moved by half a texel to fetch them exactly.
+     * Whatever the number of filters in the chain, this is a single fetch.
+     */
+    if (use_lut) {
+        float n = float(textureSize(lut, 0).x);
+        fColor = vec4(texture(lut, fColor.rgb * ((n - 1.0) / n) + 0.5 / n).rgb, fColor.a);
+    }
+
+
 
 
 }
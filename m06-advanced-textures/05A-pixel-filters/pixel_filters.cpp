@@ -12,11 +12,31 @@
  *
  * The next example, image processing, is more complex since that involves changing fragments based on the color
  * of multiple fragments.
+ *
+ * Run with --grade=filter,filter:amount,... to grade the colors with a chain of filters, in order, which
+ *      cs4722::color_lut works out for every color ahead of time and keeps in a 3D texture, so the fragment
+ *      shader applies the whole chain with one texture fetch.
+ *      The filters are those of the fragment shader, red, blue-as-green, luminance, coded-luminance,
+ *      luminance-blue-green, average-gray, red-gray, negative, and sepia, saturation, contrast, brightness
+ *      and gamma, which take an amount, 1 by default but for brightness, 0.
+ *      For instance --grade=saturation:0.5,contrast:1.3,sepia:0.4
+ *      --lut-size=N sets the colors along each side of the texture, 32 by default; use 64 for coded-luminance,
+ *      whose sudden changes of color are blurred over a texel of the texture.
+ *      While running, the keys 1 to 9 choose a filter of the chain and [ and ] change its amount; the texture
+ *      is then made again from that filter on, and the time it took is printed.
+ *      See 05A-color-grading-benchmark for how the texture compares with a shader that applies each filter.
  */
 
 
  #include <GLM/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
 
 
 #include <glad/gl.h>
@@ -27,10 +47,12 @@
 #include "cs4722/buffer_utilities.h"
 #include "cs4722/texture_utilities.h"
 #include "cs4722/compile_shaders.h"
+#include "cs4722/color_lut.h"
 
 
 #include "cs4722/window.h"
 #include "cs4722/callbacks.h"
+#include "cs4722/render_context.h"
 
 
 static cs4722::view *the_view;
@@ -40,6 +62,12 @@ static std::vector<cs4722::artifact*> artifact_list;
 static GLuint transform_loc;
 static GLuint sampler2_loc, samplerC_loc;
 static GLuint surface_effect_loc;
+static GLuint use_lut_loc;
+
+static const auto lut_texture_unit = 11;
+// the chain of filters from --grade, null without it, and the one the [ and ] keys change
+static cs4722::color_lut *grading;
+static int grading_step;
 
 static GLuint vao;
 
@@ -66,6 +94,8 @@ void init()
     sampler2_loc = glGetUniformLocation(program, "sampler2");
     samplerC_loc = glGetUniformLocation(program, "samplerC");
     surface_effect_loc = glGetUniformLocation(program, "surface_effect");
+    use_lut_loc = glGetUniformLocation(program, "use_lut");
+    glUniform1i(glGetUniformLocation(program, "lut"), lut_texture_unit);
 
     glEnable(GL_PROGRAM_POINT_SIZE);
     glEnable(GL_DEPTH_TEST);
@@ -161,26 +191,96 @@ void display()
         glUniform1i(samplerC_loc, artf->texture_unit);
 
         glUniform1i(surface_effect_loc, artf->surface_effect);
+        glUniform1i(use_lut_loc, grading != nullptr);
 
         glDrawArrays(GL_TRIANGLES, artf->the_shape->buffer_start, artf->the_shape->buffer_size);
     }
 }
 
 
+/*
+ * Add the filters named in spec, separated by commas, each with :amount after it if it is not the default.
+ * False if a name is not known.
+ */
+static bool build_grading(cs4722::color_lut &lut, const char *spec)
+{
+    auto names = std::string(spec);
+    for (size_t start = 0; start <= names.size();) {
+        auto end = std::min(names.find(',', start), names.size());
+        auto name = names.substr(start, end - start);
+        start = end + 1;
+        cs4722::color_filter filter;
+        float amount;
+        if (!cs4722::color_filter_from_name(name, filter, amount)) {
+            std::cerr << "unknown filter " << name << std::endl;
+            return false;
+        }
+        lut.add(filter, amount);
+    }
+    return true;
+}
+
+static void grade()
+{
+    auto start = std::chrono::steady_clock::now();
+    auto steps = grading->update();
+    grading->upload(lut_texture_unit);
+    auto milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "filter " << grading_step + 1 << " amount " << grading->steps()[grading_step].amount
+              << ", " << steps << " of " << grading->steps().size() << " filters worked out again in "
+              << milliseconds << " ms" << std::endl;
+}
+
+static void grading_key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    auto count = static_cast<int>(grading->steps().size());
+    if (key >= GLFW_KEY_1 && key <= GLFW_KEY_9 && action == GLFW_PRESS) {
+        grading_step = std::min(key - GLFW_KEY_1, count - 1);
+        std::cout << "filter " << grading_step + 1 << " amount " << grading->steps()[grading_step].amount
+                  << std::endl;
+        return;
+    }
+    if ((key == GLFW_KEY_LEFT_BRACKET || key == GLFW_KEY_RIGHT_BRACKET) && action != GLFW_RELEASE) {
+        auto amount = grading->steps()[grading_step].amount + (key == GLFW_KEY_RIGHT_BRACKET ? 0.05f : -0.05f);
+        if (grading->steps()[grading_step].filter == cs4722::color_filter::gamma) {
+            amount = std::max(0.05f, amount);
+        }
+        grading->set_amount(grading_step, amount);
+        grade();
+        return;
+    }
+    cs4722::general_key_callback(window, key, scancode, action, mods);
+}
+
 int
 main(int argc, char** argv)
 {
-    glfwInit();
-
-    auto *window = cs4722::setup_window("Skybox", .9);
+    const char *grade_spec = nullptr;
+    auto lut_size = 32;
+    for (auto a = 1; a < argc; ++a) {
+        if (std::strncmp(argv[a], "--grade=", 8) == 0) {
+            grade_spec = argv[a] + 8;
+        } else if (std::strncmp(argv[a], "--lut-size=", 11) == 0) {
+            lut_size = std::clamp(std::atoi(argv[a] + 11), 2, 256);
+        }
+    }
 
+    auto context = cs4722::render_context(argc, argv, "Skybox", .9);
+    auto *window = context.window;
 
 
-    gladLoadGL(glfwGetProcAddress);
     cs4722::setup_debug_callbacks();
 
     init();
 
+    if (grade_spec) {
+        grading = new cs4722::color_lut(lut_size);
+        if (!build_grading(*grading, grade_spec)) {
+            return 2;
+        }
+        grade();
+    }
+
     glfwSetWindowUserPointer(window, the_view);
 //    cs4722::setup_user_callbacks(window);
 
@@ -188,21 +288,16 @@ main(int argc, char** argv)
 
     printf("view logging %d\n", the_view->enable_logging);
 
-    glfwSetKeyCallback(window, cs4722::general_key_callback);
+    glfwSetKeyCallback(window, grading ? grading_key_callback : cs4722::general_key_callback);
     glfwSetCursorPosCallback(window, cs4722::move_callback);
     glfwSetWindowSizeCallback(window, cs4722::window_size_callback);
 	
-    while (!glfwWindowShouldClose(window))
+    while (context.running())
     {
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_float());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
         display();
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        context.end_frame();
 //        printf("view logging %d\n", the_view->enable_logging);
     }
-
-    glfwDestroyWindow(window);
-
-    glfwTerminate();
 }
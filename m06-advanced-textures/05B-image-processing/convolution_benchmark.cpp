@@ -0,0 +1,411 @@
+/*
+ * Measure how the cost of blurring a frame grows with the radius of the blur, on the CPU with
+ *      cs4722::separable_filter and on the GPU with separable_blur_fragment_shader.glsl.
+ *
+ * The frame is frame_buffer_width square, the size of the texture 05B-image-processing renders the scene to,
+ *      filled from the canyon photo in the media directory.
+ * For each radius the table has, in milliseconds per frame:
+ *      CPU Gaussian, separable, the taps done one direction at a time
+ *      CPU box, separable with running sums
+ *      CPU direct, all (2r+1)^2 samples for each texel, only for radii up to --max-direct-radius
+ *      GPU direct, all the samples in one pass, as image_processing_fragment_shader.glsl does it,
+ *          only up to --max-direct-radius
+ *      GPU separable, the two passes 05B-image-processing runs with --blur
+ * GPU times are from glFinish to glFinish around the passes.
+ *
+ * The CPU and GPU separable Gaussians are compared at each radius;
+ *      the exit code is 1 if any texel differs by more than 1.
+ *
+ * A second table compares the dual filter blur, cs4722::dual_filter_blur with dual_filter_fragment_shader.glsl,
+ *      with the square averages it stands in for, the loop of image_processing_fragment_shader.glsl.
+ *      For each radius it has the levels and offset for_radius chose, the standard deviation of the square
+ *      and of the dual filter, and in milliseconds per frame:
+ *      GPU direct, the box average of all (2r+1)^2 samples in one pass, only up to --max-direct-radius
+ *      GPU separable, the box average in two passes, only up to 64
+ *      GPU dual, the steps down the pyramid and back up
+ *      CPU dual, the reference on the CPU, which the GPU result is compared with;
+ *          the exit code is also 1 if they differ by more than 2, the half float levels of the GPU rounding
+ *          differently from the float levels of the CPU
+ *
+ * Usage: 05B-convolution-benchmark [--max-radius=N] [--max-direct-radius=N] [--max-dual-radius=N] [--headless ...]
+ *      The radii are 1, 2, 4, ... up to --max-radius, 64 by default; --max-direct-radius is 8 by default.
+ *      The radii of the second table go up to --max-dual-radius, 512 by default.
+ * Run from the build directory, where the shaders are copied.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "sharing.h"
+#include "cs4722/parallel_for.h"
+#include "cs4722/render_context.h"
+#include "STB/stb_image.h"
+
+
+static std::vector<GLubyte> load_frame(int size)
+{
+    auto frame = std::vector<GLubyte>(4ull * size * size);
+    int width, height, channels;
+    auto *texels = stbi_load("../media/colorado-river-canyonlands-national-park.jpg", &width, &height, &channels, 4);
+    for (auto y = 0; y < size; ++y) {
+        for (auto x = 0; x < size; ++x) {
+            auto *texel = &frame[4 * (static_cast<size_t>(y) * size + x)];
+            if (texels) {
+                // repeat the photo if it is smaller than the frame
+                std::memcpy(texel, texels + 4 * (static_cast<size_t>(y % height) * width + x % width), 4);
+            } else {
+                // a checkerboard with some detail in case the photo is missing
+                auto value = static_cast<GLubyte>(((x / 16 + y / 16) % 2) * 160 + (x * y) % 64);
+                texel[0] = texel[1] = texel[2] = value;
+                texel[3] = 255;
+            }
+        }
+    }
+    stbi_image_free(texels);
+    return frame;
+}
+
+
+template<typename F>
+static double cpu_milliseconds(F run, int repeats)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (auto r = 0; r < repeats; ++r) {
+        run();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+}
+
+
+/*
+ * A time for the table, or "-" for one not measured.
+ */
+static std::string time_text(double milliseconds)
+{
+    if (milliseconds < 0) {
+        return "-";
+    }
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.2f", milliseconds);
+    return text;
+}
+
+
+/*
+ * Every texel weighted by the product of the weights of its row and column, the way the single pass
+ *      shader does it.
+ */
+static void direct_filter(const cs4722::separable_filter &filter, const GLubyte *rgba, GLubyte *result, int size)
+{
+    auto radius = filter.radius;
+    for (auto y = 0; y < size; ++y) {
+        for (auto x = 0; x < size; ++x) {
+            float sum[4] = {0, 0, 0, 0};
+            for (auto j = -radius; j <= radius; ++j) {
+                const auto *row = rgba + 4ull * size * std::clamp(y + j, 0, size - 1);
+                for (auto i = -radius; i <= radius; ++i) {
+                    auto weight = filter.weights[i + radius] * filter.weights[j + radius];
+                    const auto *texel = row + 4 * std::clamp(x + i, 0, size - 1);
+                    for (auto c = 0; c < 4; ++c) sum[c] += weight * texel[c];
+                }
+            }
+            for (auto c = 0; c < 4; ++c) {
+                result[4 * (static_cast<size_t>(y) * size + x) + c] =
+                        static_cast<GLubyte>(std::min(255.0f, sum[c] + 0.5f));
+            }
+        }
+    }
+}
+
+
+/*
+ * The passes of the blur shader, drawn as a rectangle covering the whole target.
+ */
+class gpu_blur {
+public:
+
+    gpu_blur(const std::vector<GLubyte> &frame, int size)
+            : size(size)
+    {
+        program = cs4722::compile_shaders("image_processing_vertex_shader.glsl",
+                                          "separable_blur_fragment_shader.glsl");
+        glUseProgram(program);
+        auto identity = glm::mat4(1);
+        glUniformMatrix4fv(glGetUniformLocation(program, "transform"), 1, GL_FALSE, glm::value_ptr(identity));
+        sampler_loc = glGetUniformLocation(program, "sampler");
+        direction_loc = glGetUniformLocation(program, "direction");
+        radius_loc = glGetUniformLocation(program, "radius");
+        weights_loc = glGetUniformLocation(program, "weights");
+
+        // two triangles covering the target, positions then texture coordinates
+        const GLfloat vertices[] = {
+                -1, -1, 0, 1, 0, 0,   1, -1, 0, 1, 1, 0,   1, 1, 0, 1, 1, 1,
+                -1, -1, 0, 1, 0, 0,   1, 1, 0, 1, 1, 1,   -1, 1, 0, 1, 0, 1,
+        };
+        glCreateBuffers(1, &buffer);
+        glNamedBufferStorage(buffer, sizeof(vertices), vertices, 0);
+        glCreateVertexArrays(1, &vao);
+        glVertexArrayVertexBuffer(vao, 0, buffer, 0, 6 * sizeof(GLfloat));
+        auto position = glGetAttribLocation(program, "bPosition");
+        auto texture_coordinate = glGetAttribLocation(program, "bTextureCoord");
+        glEnableVertexArrayAttrib(vao, position);
+        glVertexArrayAttribFormat(vao, position, 4, GL_FLOAT, GL_FALSE, 0);
+        glVertexArrayAttribBinding(vao, position, 0);
+        glEnableVertexArrayAttrib(vao, texture_coordinate);
+        glVertexArrayAttribFormat(vao, texture_coordinate, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat));
+        glVertexArrayAttribBinding(vao, texture_coordinate, 0);
+
+        source = make_texture(GL_RGBA8);
+        glTextureSubImage2D(source, 0, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, frame.data());
+        rows = make_texture(GL_RGBA16F);
+        result = make_texture(GL_RGBA8);
+        glCreateFramebuffers(1, &rows_frame_buffer);
+        glNamedFramebufferTexture(rows_frame_buffer, GL_COLOR_ATTACHMENT0, rows, 0);
+        glCreateFramebuffers(1, &result_frame_buffer);
+        glNamedFramebufferTexture(result_frame_buffer, GL_COLOR_ATTACHMENT0, result, 0);
+
+        // the pyramid as in setup_view_in_view.cpp, with the same vertices as the other shader
+        dual_program = cs4722::compile_shaders("image_processing_vertex_shader.glsl",
+                                               "dual_filter_fragment_shader.glsl");
+        glUseProgram(dual_program);
+        glUniformMatrix4fv(glGetUniformLocation(dual_program, "transform"), 1, GL_FALSE, glm::value_ptr(identity));
+        dual_sampler_loc = glGetUniformLocation(dual_program, "sampler");
+        dual_upsample_loc = glGetUniformLocation(dual_program, "upsample");
+        dual_offset_loc = glGetUniformLocation(dual_program, "offset");
+        auto levels = cs4722::dual_filter_blur::max_levels(size, size);
+        glCreateTextures(GL_TEXTURE_2D, 1, &pyramid);
+        glTextureStorage2D(pyramid, levels, GL_RGBA16F, size / 2, size / 2);
+        pyramid_views.resize(levels);
+        pyramid_frame_buffers.resize(levels);
+        glGenTextures(levels, pyramid_views.data());
+        glCreateFramebuffers(levels, pyramid_frame_buffers.data());
+        for (auto level = 0; level < levels; ++level) {
+            glTextureView(pyramid_views[level], GL_TEXTURE_2D, pyramid, GL_RGBA16F, level, 1, 0, 1);
+            glNamedFramebufferTexture(pyramid_frame_buffers[level], GL_COLOR_ATTACHMENT0, pyramid, level);
+        }
+        glCreateSamplers(1, &linear_sampler);
+        glSamplerParameteri(linear_sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glSamplerParameteri(linear_sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glSamplerParameteri(linear_sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(linear_sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    void set_filter(const cs4722::separable_filter &filter)
+    {
+        glUseProgram(program);
+        glUniform1i(radius_loc, filter.radius);
+        glUniform1fv(weights_loc, static_cast<GLsizei>(filter.weights.size()), filter.weights.data());
+    }
+
+    /*
+     * Milliseconds for one blur, averaged over the repeats.
+     * The time is taken from glFinish to glFinish rather than with a GL_TIME_ELAPSED query,
+     *      because llvmpipe ends the query before it has drawn the triangles.
+     */
+    double milliseconds(bool separable, int repeats)
+    {
+        glBindVertexArray(vao);
+        glUseProgram(program);
+        glViewport(0, 0, size, size);
+        // once untimed, so the time of compiling the shader for its first draw is left out
+        passes(separable);
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        for (auto r = 0; r < repeats; ++r) {
+            passes(separable);
+        }
+        glFinish();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+    }
+
+    /*
+     * Milliseconds for one dual filter blur, averaged over the repeats, timed as the other blurs.
+     */
+    double dual_milliseconds(const cs4722::dual_filter_blur &blur, int repeats)
+    {
+        glBindVertexArray(vao);
+        glUseProgram(dual_program);
+        glUniform1f(dual_offset_loc, blur.offset);
+        glBindSampler(blur_texture_unit, linear_sampler);
+        dual_steps(blur);
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        for (auto r = 0; r < repeats; ++r) {
+            dual_steps(blur);
+        }
+        glFinish();
+        glBindSampler(blur_texture_unit, 0);
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+    }
+
+    std::vector<GLubyte> read_result() const
+    {
+        auto texels = std::vector<GLubyte>(4ull * size * size);
+        glGetTextureImage(result, 0, GL_RGBA, GL_UNSIGNED_BYTE, static_cast<GLsizei>(texels.size()), texels.data());
+        return texels;
+    }
+
+private:
+
+    GLuint make_texture(GLenum format) const
+    {
+        GLuint texture;
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+        glTextureStorage2D(texture, 1, format, size, size);
+        return texture;
+    }
+
+    void passes(bool separable) const
+    {
+        if (separable) {
+            draw(rows_frame_buffer, source, 1, 0);
+            draw(result_frame_buffer, rows, 0, 1);
+        } else {
+            draw(result_frame_buffer, source, 0, 0);
+        }
+    }
+
+    /*
+     * Level 0 is the source going down and the result coming up.
+     */
+    void dual_steps(const cs4722::dual_filter_blur &blur) const
+    {
+        auto levels = std::min(blur.levels, static_cast<int>(pyramid_views.size()));
+        auto step = [&](int from, int to, bool upsample) {
+            glBindTextureUnit(blur_texture_unit, from == 0 ? source : pyramid_views[from - 1]);
+            glUniform1i(dual_sampler_loc, blur_texture_unit);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, to == 0 ? result_frame_buffer : pyramid_frame_buffers[to - 1]);
+            glViewport(0, 0, std::max(1, size >> to), std::max(1, size >> to));
+            glUniform1i(dual_upsample_loc, upsample);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+        };
+        for (auto level = 1; level <= levels; ++level) {
+            step(level - 1, level, false);
+        }
+        for (auto level = levels; level >= 1; --level) {
+            step(level, level - 1, true);
+        }
+    }
+
+    void draw(GLuint frame_buffer, GLuint texture, int dx, int dy) const
+    {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frame_buffer);
+        glBindTextureUnit(blur_texture_unit, texture);
+        glUniform1i(sampler_loc, blur_texture_unit);
+        glUniform2i(direction_loc, dx, dy);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+
+    int size;
+    GLuint program, vao, buffer;
+    GLuint source, rows, result, rows_frame_buffer, result_frame_buffer;
+    GLint sampler_loc, direction_loc, radius_loc, weights_loc;
+    GLuint dual_program, pyramid, linear_sampler;
+    std::vector<GLuint> pyramid_views, pyramid_frame_buffers;
+    GLint dual_sampler_loc, dual_upsample_loc, dual_offset_loc;
+};
+
+
+int
+main(int argc, char** argv)
+{
+    auto max_radius = max_blur_radius;
+    auto max_direct_radius = 8;
+    auto max_dual_radius = 512;
+    for (auto a = 1; a < argc; ++a) {
+        if (std::strncmp(argv[a], "--max-radius=", 13) == 0) {
+            max_radius = std::clamp(std::atoi(argv[a] + 13), 1, max_blur_radius);
+        } else if (std::strncmp(argv[a], "--max-direct-radius=", 20) == 0) {
+            max_direct_radius = std::atoi(argv[a] + 20);
+        } else if (std::strncmp(argv[a], "--max-dual-radius=", 18) == 0) {
+            max_dual_radius = std::max(1, std::atoi(argv[a] + 18));
+        }
+    }
+
+    auto context = cs4722::render_context(argc, argv, "Convolution benchmark", .5);
+    const auto size = frame_buffer_width;
+    auto frame = load_frame(size);
+    auto output = std::vector<GLubyte>(frame.size());
+    auto blur = gpu_blur(frame, size);
+
+    std::cout << size << " x " << size << " frame, " << cs4722::thread_count(0)
+              << " threads for the CPU filters, milliseconds per frame\n\n";
+    printf("%6s %12s %12s %12s %12s %12s %10s\n", "radius", "CPU gauss", "CPU box", "CPU direct",
+           "GPU direct", "GPU separ.", "max diff");
+    auto differ = false;
+    for (auto radius = 1; radius <= max_radius; radius *= 2) {
+        auto gaussian = cs4722::separable_filter::gaussian(radius);
+        auto box = cs4722::separable_filter::box(radius);
+        auto repeats = radius <= 8 ? 3 : 1;
+
+        auto cpu_gaussian = cpu_milliseconds([&]() {
+            gaussian.apply(frame.data(), output.data(), size, size);
+        }, repeats);
+        auto cpu_result = output;
+        auto cpu_box = cpu_milliseconds([&]() {
+            box.apply(frame.data(), output.data(), size, size);
+        }, repeats);
+        auto cpu_direct = radius <= max_direct_radius
+                ? cpu_milliseconds([&]() { direct_filter(gaussian, frame.data(), output.data(), size); }, 1)
+                : -1.0;
+
+        blur.set_filter(gaussian);
+        auto gpu_direct = radius <= max_direct_radius ? blur.milliseconds(false, repeats) : -1.0;
+        auto gpu_separable = blur.milliseconds(true, repeats);
+
+        auto gpu_result = blur.read_result();
+        auto max_difference = 0;
+        for (size_t i = 0; i < gpu_result.size(); ++i) {
+            max_difference = std::max(max_difference, std::abs(gpu_result[i] - cpu_result[i]));
+        }
+        differ = differ || max_difference > 1;
+
+        printf("%6d %12.2f %12.2f %12s %12s %12.2f %10d\n", radius, cpu_gaussian, cpu_box, time_text(cpu_direct).c_str(),
+               time_text(gpu_direct).c_str(), gpu_separable, max_difference);
+    }
+
+    if (differ) {
+        std::cout << "\nthe CPU and GPU Gaussians differ by more than 1" << std::endl;
+    }
+
+    std::cout << "\ndual filter blur against the box average of the same spread, milliseconds per frame\n\n";
+    printf("%6s %6s %6s %8s %8s %12s %12s %12s %12s %10s\n", "radius", "levels", "offset", "box sd", "dual sd",
+           "GPU direct", "GPU separ.", "GPU dual", "CPU dual", "max diff");
+    auto dual_differ = false;
+    auto max_levels = cs4722::dual_filter_blur::max_levels(size, size);
+    for (auto radius = 1; radius <= max_dual_radius; radius *= 2) {
+        auto dual = cs4722::dual_filter_blur::for_radius(static_cast<float>(radius), max_levels);
+        auto box = cs4722::separable_filter::box(std::min(radius, max_blur_radius));
+        auto repeats = 3;
+
+        blur.set_filter(box);
+        auto gpu_direct = radius <= max_direct_radius ? blur.milliseconds(false, repeats) : -1.0;
+        auto gpu_separable = radius <= max_blur_radius ? blur.milliseconds(true, repeats) : -1.0;
+        auto gpu_dual = blur.dual_milliseconds(dual, repeats);
+        auto gpu_result = blur.read_result();
+        auto cpu_dual = cpu_milliseconds([&]() {
+            dual.apply(frame.data(), output.data(), size, size);
+        }, 1);
+
+        auto max_difference = 0;
+        for (size_t i = 0; i < gpu_result.size(); ++i) {
+            max_difference = std::max(max_difference, std::abs(gpu_result[i] - output[i]));
+        }
+        dual_differ = dual_differ || max_difference > 2;
+
+        printf("%6d %6d %6.2f %8.1f %8.1f %12s %12s %12.2f %12.2f %10d\n", radius, dual.levels, dual.offset,
+               cs4722::dual_filter_blur::box_sigma(radius), dual.sigma(), time_text(gpu_direct).c_str(),
+               time_text(gpu_separable).c_str(), gpu_dual, cpu_dual, max_difference);
+    }
+
+    if (dual_differ) {
+        std::cout << "\nthe CPU and GPU dual filter blurs differ by more than 2" << std::endl;
+    }
+    return differ || dual_differ ? 1 : 0;
+}
@@ -0,0 +1,57 @@
+#version 430 core
+
+/**
+ * One step of the dual filter blur of cs4722::dual_filter_blur, which blurs by hundreds of texels at about
+ *      the cost of blurring by a few.
+ *
+ * The 'averaging more samples' example of image_processing_fragment_shader.glsl takes (2*lim+1)*(2*lim+1)
+ *      samples for every fragment, so doubling lim makes it four times slower.
+ * This shader is drawn once for each step down a chain of textures each half the size of the last,
+ *      and once for each step back up.
+ * A step takes only five or eight samples, but a texel of the smaller textures covers many texels of the
+ *      scene, so the blur spreads twice as far for each level added, while the smaller levels take
+ *      a quarter of the time of the level above them.
+ *
+ * Stepping down, the fragment is between four texels of the larger texture.
+ *      The sample there is the average of the four, and four more are taken around it, offset half a texel
+ *      times offset diagonally.
+ * Stepping up, the fragment is over a quarter of a texel of the smaller texture.
+ *      Eight samples are taken around it, on the axes offset a texel times offset and on the diagonals
+ *      half that, the nearer ones counting twice.
+ *
+ * The sampler must filter linearly and clamp to the edge, as cs4722::dual_filter_blur samples on the CPU.
+ */
+
+out vec4 fColor;
+
+in vec2 vTextureCoord;
+
+uniform sampler2D sampler;
+uniform bool upsample;
+uniform float offset;
+
+void main()
+{
+    vec2 uv = vTextureCoord;
+    // half a texel of the texture read, times the offset
+    vec2 d = 0.5 / vec2(textureSize(sampler, 0)) * offset;
+
+    if (upsample) {
+        vec4 sum = texture(sampler, uv + vec2(-2.0 * d.x, 0.0));
+        sum += 2.0 * texture(sampler, uv + vec2(-d.x, d.y));
+        sum += texture(sampler, uv + vec2(0.0, 2.0 * d.y));
+        sum += 2.0 * texture(sampler, uv + vec2(d.x, d.y));
+        sum += texture(sampler, uv + vec2(2.0 * d.x, 0.0));
+        sum += 2.0 * texture(sampler, uv + vec2(d.x, -d.y));
+        sum += texture(sampler, uv + vec2(0.0, -2.0 * d.y));
+        sum += 2.0 * texture(sampler, uv + vec2(-d.x, -d.y));
+        fColor = sum / 12.0;
+    } else {
+        vec4 sum = 4.0 * texture(sampler, uv);
+        sum += texture(sampler, uv - d);
+        sum += texture(sampler, uv + d);
+        sum += texture(sampler, uv + vec2(d.x, -d.y));
+        sum += texture(sampler, uv + vec2(-d.x, d.y));
+        fColor = sum / 8.0;
+    }
+}
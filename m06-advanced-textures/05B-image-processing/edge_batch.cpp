@@ -0,0 +1,226 @@
+/*
+ * Find the edges in every image in a directory with cs4722::edge_detector, the Canny edge detector,
+ *      and measure how fast it goes with more threads.
+ *
+ * The images are read first, then the whole directory is run through the detector with 1, 2, 4, ...
+ *      threads up to --max-threads, the number of hardware threads by default.
+ * For each number of threads the table has the seconds taken, the megapixels per second, and the speedup
+ *      over one thread.
+ * Reading the images is not timed.
+ *
+ * With --output=DIRECTORY the edges of each image are written there as NAME-edges.png, white on black.
+ * With --gpu the images are also run through the same detector on the GPU, see setup_edges.cpp, and the
+ *      megapixels per second and the share of texels where the GPU and CPU agree are shown for each image.
+ *      The GPU works in half floats, so texels whose derivative is right at a threshold or equal to their
+ *      neighbor's can come out differently.
+ *
+ * Usage: 05B-edge-batch [DIRECTORY] [--output=DIRECTORY] [--max-threads=N] [--tile=N]
+ *              [--low=X] [--high=X] [--smoothing=N] [--gpu [--headless]]
+ *      DIRECTORY is ../media by default.
+ *      --low and --high are the thresholds, as fractions of the derivative of a step from black to white,
+ *      0.1 and 0.25 by default; --smoothing is the radius of the Gaussian applied first, 2 by default.
+ * Run from the build directory, where the shaders are copied, to use --gpu.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "sharing.h"
+#include "cs4722/parallel_for.h"
+#include "cs4722/png_writer.h"
+#include "cs4722/render_context.h"
+#include "STB/stb_image.h"
+
+
+struct rgba_image {
+    std::filesystem::path path;
+    int width = 0;
+    int height = 0;
+    std::vector<GLubyte> texels;
+    std::vector<GLubyte> edges;
+};
+
+
+static std::vector<rgba_image> read_images(const std::filesystem::path &directory)
+{
+    auto paths = std::vector<std::filesystem::path>();
+    for (auto &entry: std::filesystem::directory_iterator(directory)) {
+        auto extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (entry.is_regular_file() && (extension == ".png" || extension == ".jpg" || extension == ".jpeg"
+                                        || extension == ".tga" || extension == ".bmp")) {
+            paths.push_back(entry.path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    auto images = std::vector<rgba_image>();
+    for (auto &path: paths) {
+        rgba_image image;
+        int channels;
+        auto *texels = stbi_load(path.string().c_str(), &image.width, &image.height, &channels, 4);
+        if (!texels) {
+            std::cerr << "could not read " << path.string() << std::endl;
+            continue;
+        }
+        image.path = path;
+        image.texels.assign(texels, texels + 4ull * image.width * image.height);
+        image.edges.resize(static_cast<size_t>(image.width) * image.height);
+        stbi_image_free(texels);
+        images.push_back(std::move(image));
+    }
+    return images;
+}
+
+
+static bool write_edges(const std::filesystem::path &directory, const rgba_image &image)
+{
+    auto rgba = std::vector<std::uint8_t>(4 * image.edges.size());
+    for (size_t i = 0; i < image.edges.size(); ++i) {
+        rgba[4 * i] = rgba[4 * i + 1] = rgba[4 * i + 2] = image.edges[i];
+        rgba[4 * i + 3] = 255;
+    }
+    auto path = directory / (image.path.stem().string() + "-edges.png");
+    if (!cs4722::write_png(path.string(), image.width, image.height, rgba)) {
+        std::cerr << "could not write " << path.string() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+/*
+ * Run each image through the detector on the GPU and compare the edges with those found on the CPU.
+ */
+static void run_on_gpu(int argc, char **argv, const cs4722::edge_detector &detector,
+                       const std::vector<rgba_image> &images)
+{
+    auto context = cs4722::render_context(argc, argv, "Edge batch", .5);
+    std::cout << "\nGPU\n\n";
+    printf("%-48s %12s %8s %8s %10s\n", "image", "size", "passes", "Mpx/s", "agree %");
+    for (auto &image: images) {
+        GLuint source, result, frame_buffer;
+        glCreateTextures(GL_TEXTURE_2D, 1, &source);
+        glTextureStorage2D(source, 1, GL_RGBA8, image.width, image.height);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTextureSubImage2D(source, 0, 0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE,
+                            image.texels.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glCreateTextures(GL_TEXTURE_2D, 1, &result);
+        glTextureStorage2D(result, 1, GL_RGBA8, image.width, image.height);
+        glCreateFramebuffers(1, &frame_buffer);
+        glNamedFramebufferTexture(frame_buffer, GL_COLOR_ATTACHMENT0, result, 0);
+
+        edges_setup(&detector, image.width, image.height);
+        glBindTextureUnit(fb_texture_unit, source);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frame_buffer);
+        glViewport(0, 0, image.width, image.height);
+        // once untimed, so the time of compiling the shaders for their first draw is left out
+        edges_display(fb_texture_unit);
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        auto passes = edges_display(fb_texture_unit);
+        glFinish();
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        auto rgba = std::vector<GLubyte>(4 * image.edges.size());
+        glGetTextureImage(result, 0, GL_RGBA, GL_UNSIGNED_BYTE, static_cast<GLsizei>(rgba.size()), rgba.data());
+        auto agree = size_t(0);
+        for (size_t i = 0; i < image.edges.size(); ++i) {
+            agree += (rgba[4 * i] > 127) == (image.edges[i] > 127);
+        }
+
+        auto size = std::to_string(image.width) + "x" + std::to_string(image.height);
+        printf("%-48s %12s %8d %8.1f %10.3f\n", image.path.filename().string().c_str(), size.c_str(), passes,
+               static_cast<double>(image.edges.size()) / seconds / 1e6,
+               100.0 * static_cast<double>(agree) / static_cast<double>(image.edges.size()));
+
+        glDeleteFramebuffers(1, &frame_buffer);
+        glDeleteTextures(1, &result);
+        glDeleteTextures(1, &source);
+    }
+}
+
+
+int
+main(int argc, char** argv)
+{
+    auto directory = std::filesystem::path("../media");
+    auto output = std::filesystem::path();
+    auto max_threads = cs4722::thread_count(0);
+    auto detector = cs4722::edge_detector();
+    auto gpu = false;
+    for (auto a = 1; a < argc; ++a) {
+        if (std::strncmp(argv[a], "--output=", 9) == 0) {
+            output = argv[a] + 9;
+        } else if (std::strncmp(argv[a], "--max-threads=", 14) == 0) {
+            max_threads = std::max(1, std::atoi(argv[a] + 14));
+        } else if (std::strncmp(argv[a], "--tile=", 7) == 0) {
+            detector.tile_size = std::max(8, std::atoi(argv[a] + 7));
+        } else if (std::strncmp(argv[a], "--low=", 6) == 0) {
+            detector.low = static_cast<float>(std::atof(argv[a] + 6));
+        } else if (std::strncmp(argv[a], "--high=", 7) == 0) {
+            detector.high = static_cast<float>(std::atof(argv[a] + 7));
+        } else if (std::strncmp(argv[a], "--smoothing=", 12) == 0) {
+            detector.smoothing_radius = std::clamp(std::atoi(argv[a] + 12), 0, max_blur_radius);
+        } else if (std::strcmp(argv[a], "--gpu") == 0) {
+            gpu = true;
+        } else if (argv[a][0] != '-') {
+            directory = argv[a];
+        }
+    }
+
+    auto images = read_images(directory);
+    if (images.empty()) {
+        std::cerr << "no images in " << directory.string() << std::endl;
+        return 1;
+    }
+    auto megapixels = 0.0;
+    for (auto &image: images) {
+        megapixels += static_cast<double>(image.edges.size()) / 1e6;
+    }
+    std::cout << images.size() << " images, " << megapixels << " megapixels, tiles of " << detector.tile_size
+              << ", thresholds " << detector.low << " and " << detector.high << ", smoothing radius "
+              << detector.smoothing_radius << "\n\n";
+
+    auto thread_counts = std::vector<int>();
+    for (auto threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    printf("%8s %10s %10s %10s\n", "threads", "seconds", "Mpx/s", "speedup");
+    auto one_thread = 0.0;
+    for (auto threads: thread_counts) {
+        detector.number_of_threads = threads;
+        auto start = std::chrono::steady_clock::now();
+        for (auto &image: images) {
+            detector.detect(image.texels.data(), image.edges.data(), image.width, image.height);
+        }
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (threads == 1) {
+            one_thread = seconds;
+        }
+        printf("%8d %10.3f %10.1f %10.2f\n", threads, seconds, megapixels / seconds, one_thread / seconds);
+    }
+
+    auto failed = false;
+    if (!output.empty()) {
+        std::filesystem::create_directories(output);
+        for (auto &image: images) {
+            failed = !write_edges(output, image) || failed;
+        }
+    }
+    if (gpu) {
+        run_on_gpu(argc, argv, detector, images);
+    }
+    return failed ? 1 : 0;
+}
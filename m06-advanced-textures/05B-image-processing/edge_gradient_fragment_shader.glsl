@@ -0,0 +1,45 @@
+#version 430 core
+
+/**
+ * The first step of the Canny edge detector of cs4722::edge_detector: the Sobel derivative of the luminance.
+ *
+ * This is the derivative of the 'Sobel' example of image_processing_fragment_shader.glsl, taken of the
+ *      luminance rather than each color, and kept with its direction so the next step can thin the edges.
+ * The image is usually smoothed first with separable_blur_fragment_shader.glsl, since smoothing the colors
+ *      smooths the luminance just the same.
+ *
+ * The result is (x derivative, y derivative, magnitude, 1), scaled so a step from black to white has
+ *      magnitude 1, for a half float texture.
+ * Texels are fetched directly and clamped to the edges, as the detector on the CPU does.
+ */
+
+out vec4 fColor;
+
+in vec2 vTextureCoord;
+
+uniform sampler2D sampler;
+
+float luminance(ivec2 texel, ivec2 size)
+{
+    vec4 c = texelFetch(sampler, clamp(texel, ivec2(0), size - 1), 0);
+    return 0.2126 * c.r + 0.7152 * c.g + 0.0722 * c.b;
+}
+
+void main()
+{
+    ivec2 size = textureSize(sampler, 0);
+    ivec2 texel = min(ivec2(vTextureCoord * vec2(size)), size - 1);
+
+    float above_left = luminance(texel + ivec2(-1, -1), size);
+    float above = luminance(texel + ivec2(0, -1), size);
+    float above_right = luminance(texel + ivec2(1, -1), size);
+    float left = luminance(texel + ivec2(-1, 0), size);
+    float right = luminance(texel + ivec2(1, 0), size);
+    float below_left = luminance(texel + ivec2(-1, 1), size);
+    float below = luminance(texel + ivec2(0, 1), size);
+    float below_right = luminance(texel + ivec2(1, 1), size);
+
+    float gx = (above_right + 2.0 * right + below_right - above_left - 2.0 * left - below_left) / 4.0;
+    float gy = (below_left + 2.0 * below + below_right - above_left - 2.0 * above - above_right) / 4.0;
+    fColor = vec4(gx, gy, sqrt(gx * gx + gy * gy), 1.0);
+}
@@ -0,0 +1,46 @@
+#version 430 core
+
+/**
+ * The last step of the Canny edge detector: following edges from strong texels into weak ones.
+ *
+ * Each pass makes a weak texel, 0.5, strong, 1, if any of its eight neighbors is strong, and counts it in
+ *      promoted, so edges grow by a texel a pass.
+ * The passes are drawn until a few in a row promote nothing.
+ * With draw_edges set the texel is drawn white if it is strong and black otherwise, which is the result.
+ */
+
+out vec4 fColor;
+
+in vec2 vTextureCoord;
+
+uniform sampler2D sampler;
+uniform bool draw_edges;
+
+layout(binding = 0, offset = 0) uniform atomic_uint promoted;
+
+void main()
+{
+    ivec2 size = textureSize(sampler, 0);
+    ivec2 texel = min(ivec2(vTextureCoord * vec2(size)), size - 1);
+    float strength = texelFetch(sampler, texel, 0).r;
+
+    if (draw_edges) {
+        float edge = strength > 0.75 ? 1.0 : 0.0;
+        fColor = vec4(edge, edge, edge, 1.0);
+        return;
+    }
+
+    if (strength > 0.25 && strength < 0.75) {
+        for (int j = -1; j <= 1; j++) {
+            for (int i = -1; i <= 1; i++) {
+                if (texelFetch(sampler, clamp(texel + ivec2(i, j), ivec2(0), size - 1), 0).r > 0.75) {
+                    strength = 1.0;
+                }
+            }
+        }
+        if (strength == 1.0) {
+            atomicCounterIncrement(promoted);
+        }
+    }
+    fColor = vec4(strength, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,50 @@
+#version 430 core
+
+/**
+ * The second step of the Canny edge detector: thinning the edges and sorting them by strength.
+ *
+ * The derivative from edge_gradient_fragment_shader.glsl is large for a few texels across each edge.
+ * Only the texel where it is largest is kept: the direction of the derivative is rounded to a multiple
+ *      of 45 degrees, and the texel is kept if its magnitude is no smaller than the neighbor behind it
+ *      in that direction and larger than the one ahead.
+ * A kept texel is strong, 1, if its magnitude is at least high, and weak, 0.5, if it is at least low.
+ * Everything else is 0.
+ */
+
+out vec4 fColor;
+
+in vec2 vTextureCoord;
+
+uniform sampler2D sampler;
+uniform float low;
+uniform float high;
+
+float magnitude(ivec2 texel, ivec2 size)
+{
+    return texelFetch(sampler, clamp(texel, ivec2(0), size - 1), 0).z;
+}
+
+void main()
+{
+    ivec2 size = textureSize(sampler, 0);
+    ivec2 texel = min(ivec2(vTextureCoord * vec2(size)), size - 1);
+    vec4 gradient = texelFetch(sampler, texel, 0);
+
+    // tan(22.5 degrees) and tan(67.5 degrees)
+    float ax = abs(gradient.x), ay = abs(gradient.y);
+    ivec2 step;
+    if (ay <= 0.41421356 * ax) {
+        step = ivec2(1, 0);
+    } else if (ay >= 2.41421356 * ax) {
+        step = ivec2(0, 1);
+    } else if (gradient.x * gradient.y > 0.0) {
+        step = ivec2(1, 1);
+    } else {
+        step = ivec2(-1, 1);
+    }
+
+    float m = gradient.z;
+    bool kept = m >= magnitude(texel - step, size) && m > magnitude(texel + step, size);
+    float strength = !kept ? 0.0 : m >= high ? 1.0 : m >= low ? 0.5 : 0.0;
+    fColor = vec4(strength, 0.0, 0.0, 1.0);
+}
@@ -4,6 +4,12 @@
 
 #include "cs4722/window.h"
 #include "cs4722/callbacks.h"
+#include "cs4722/render_context.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
 
 /*
  * The main content of this example is in the image_processing_fragment_shader.glsl.
@@ -31,17 +37,100 @@
  *  The 'image_processing_fragment_shader'  is shading a rectangle covering the entire window.  The texture
  *      created in the previous step is used to get the pixel data needed.  This rendering is displayed
  *      in the window.
+ *
+ * Run with --blur=box or --blur=gaussian to blur the image in two passes with separable_blur_fragment_shader.glsl
+ *      instead, one along the rows and one along the columns, and --radius=N to set the radius, 5 by default.
+ *      See 05B-convolution-benchmark for how the cost grows with the radius, on the GPU and on the CPU.
+ *
+ * Run with --blur=dual to blur with cs4722::dual_filter_blur and dual_filter_fragment_shader.glsl, stepping
+ *      down a pyramid of textures and back up, which blurs as widely as averaging a square of --radius
+ *      texels at about the same cost for any radius.
+ *      The radius may go up to several hundred and is changed while running with the [ and ] keys.
+ *
+ * Run with --edges to draw the edges found by the Canny edge detector of cs4722::edge_detector, done on the GPU
+ *      by the shaders in setup_edges.cpp, in place of the noisy raw Sobel derivative.
+ *      See 05B-edge-batch for the detector on the CPU, run over a directory of images.
+ *
+ * Run with --postfx=node,node,... to draw the image through a cs4722::postfx_graph instead, each node
+ *      filtering the result of the one before it.
+ *      The nodes are gaussian, box (blurs of --radius), sobel, the color filters of 05A-pixel-filters
+ *      red, blue-as-green, luminance, coded-luminance, luminance-blue-green, average-gray, red-gray, negative,
+ *      and sepia, saturation, contrast, brightness and gamma, written filter:amount as for --grade there,
+ *      the tone maps reinhard and aces, and bloom, which adds a Gaussian blur of the image to it.
+ *      For instance --postfx=gaussian,gaussian,sobel,aces is done in five passes, aces fused into the pass
+ *      of sobel, with two textures between passes where one for each pass would be four.
+ *      The passes and the memory they take are printed after the first frame.
  */
 
-int
-main(int argc, char** argv)
+/*
+ * Add the nodes named in spec, separated by commas, after the source of graph and make the last the output.
+ * False if a name is not known.
+ */
+static bool build_postfx(cs4722::postfx_graph &graph, const char *spec, const cs4722::separable_filter &gaussian,
+                         const cs4722::separable_filter &box)
 {
-    glfwInit();
+    auto node = graph.source();
+    auto names = std::string(spec);
+    for (size_t start = 0; start <= names.size();) {
+        auto end = std::min(names.find(',', start), names.size());
+        auto name = names.substr(start, end - start);
+        start = end + 1;
+        auto known = true;
+        if (name == "gaussian") {
+            node = graph.blur(node, gaussian);
+        } else if (name == "box") {
+            node = graph.blur(node, box);
+        } else if (name == "sobel") {
+            node = graph.sobel(node);
+        } else if (name == "reinhard") {
+            node = graph.tone_map(node, 1.0f, cs4722::tone_map_operator::reinhard);
+        } else if (name == "aces") {
+            node = graph.tone_map(node, 1.0f, cs4722::tone_map_operator::aces);
+        } else if (name == "bloom") {
+            node = graph.mix(node, graph.blur(node, gaussian), 1.0f, 1.0f);
+        } else {
+            cs4722::color_filter filter;
+            float amount;
+            known = cs4722::color_filter_from_name(name, filter, amount);
+            if (known) {
+                node = graph.color(node, filter, amount);
+            }
+        }
+        if (!known) {
+            std::cerr << "unknown postfx node " << name << std::endl;
+            return false;
+        }
+    }
+    graph.output(node);
+    return true;
+}
 
-    auto *window = cs4722::setup_window("Image Processing", .9);
+static float dual_radius;
+static const auto dual_max_levels = cs4722::dual_filter_blur::max_levels(frame_buffer_width, frame_buffer_height);
+static cs4722::dual_filter_blur dual_blur;
+
+/*
+ * [ and ] make the radius of the dual filter blur smaller and larger, other keys do what they always do.
+ */
+static void dual_blur_key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    if ((key == GLFW_KEY_LEFT_BRACKET || key == GLFW_KEY_RIGHT_BRACKET) && action != GLFW_RELEASE) {
+        dual_radius = key == GLFW_KEY_RIGHT_BRACKET ? std::max(1.0f, dual_radius * 1.25f)
+                : (dual_radius < 1.0f ? 0.0f : dual_radius / 1.25f);
+        dual_blur = cs4722::dual_filter_blur::for_radius(dual_radius, dual_max_levels);
+        std::cout << "radius " << dual_radius << ", " << dual_blur.levels << " levels, offset "
+                  << dual_blur.offset << std::endl;
+        return;
+    }
+    cs4722::general_key_callback(window, key, scancode, action, mods);
+}
 
+int
+main(int argc, char** argv)
+{
+    auto context = cs4722::render_context(argc, argv, "Image Processing", .9);
+    auto *window = context.window;
 
-    gladLoadGL(glfwGetProcAddress);
     cs4722::setup_debug_callbacks();
 
 
@@ -55,17 +144,58 @@ main(int argc, char** argv)
 
 //    view->perspective_fovy = (.9 * M_PI);
 
+    auto blur_radius = 5;
+    auto requested_radius = 5;
+    const char *blur_kind = nullptr;
+    const char *postfx_spec = nullptr;
+    auto edges = false;
+    for (auto a = 1; a < argc; ++a) {
+        if (std::strncmp(argv[a], "--blur=", 7) == 0) {
+            blur_kind = argv[a] + 7;
+        } else if (std::strncmp(argv[a], "--radius=", 9) == 0) {
+            requested_radius = std::max(0, std::atoi(argv[a] + 9));
+            blur_radius = std::min(requested_radius, max_blur_radius);
+        } else if (std::strcmp(argv[a], "--edges") == 0) {
+            edges = true;
+        } else if (std::strncmp(argv[a], "--postfx=", 9) == 0) {
+            postfx_spec = argv[a] + 9;
+        }
+    }
+    auto box = cs4722::separable_filter::box(blur_radius);
+    auto gaussian = cs4722::separable_filter::gaussian(blur_radius);
+    if (blur_kind && std::strcmp(blur_kind, "dual") == 0) {
+        dual_radius = static_cast<float>(requested_radius);
+        dual_blur = cs4722::dual_filter_blur::for_radius(dual_radius, dual_max_levels);
+        view_in_view_dual_blur(&dual_blur);
+    } else if (blur_kind) {
+        view_in_view_blur(std::strcmp(blur_kind, "box") == 0 ? &box : &gaussian);
+    }
+    auto detector = cs4722::edge_detector();
+    if (edges) {
+        view_in_view_edges(&detector);
+    }
+    auto postfx = cs4722::postfx_graph();
+    if (postfx_spec) {
+        if (!build_postfx(postfx, postfx_spec, gaussian, box)) {
+            return 2;
+        }
+        view_in_view_postfx(&postfx);
+    }
+
     parts_setup(view);
     view_in_view_setup(view);
 
     glfwSetWindowUserPointer(window, view);
 
     cs4722::setup_user_callbacks(window);
+    if (blur_kind && std::strcmp(blur_kind, "dual") == 0) {
+        glfwSetKeyCallback(window, dual_blur_key_callback);
+    }
 	
-    while (!glfwWindowShouldClose(window))
+    while (context.running())
     {
         parts_setup_for_fb();
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_float());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
         // parts only in the framebuffer this time
         parts_display();
@@ -78,15 +208,10 @@ main(int argc, char** argv)
         parts_setup_for_window(window);
         // we will actually not see the olive drab since the view-in-view rectangle will
         //  cover the entire window
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::olive_drab.as_float());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::olive_drab.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
         view_in_view_display();
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        context.end_frame();
     }
-
-    glfwDestroyWindow(window);
-
-    glfwTerminate();
 }
@@ -0,0 +1,52 @@
+#version 430 core
+
+/**
+ * The 'averaging more samples' example of image_processing_fragment_shader.glsl done in two passes.
+ *
+ * That example adds up (2*lim+1)*(2*lim+1) samples for every fragment, 121 with lim = 5, which is why
+ *      rendering slows down as lim grows.
+ * When the weight of a sample is the product of a weight for its column and a weight for its row, as it is
+ *      for the plain average and for a Gaussian, the sum can be done one direction at a time:
+ *      the first pass adds up the samples along each row into a texture, the second adds up those sums
+ *      along each column.
+ *      That takes (2*radius+1) samples in each pass, 22 in all with radius 5.
+ *
+ * The weights come from a cs4722::separable_filter, so this gives the same result as filtering the image
+ *      on the CPU with it.
+ * Texels are fetched directly and clamped to the edges, as the CPU filter does.
+ *
+ * direction is (1, 0) for the pass along the rows and (0, 1) for the pass along the columns.
+ * With direction (0, 0) all the samples are added up in one pass, as the original example does,
+ *      which is kept for comparison.
+ */
+
+out vec4 fColor;
+
+in vec2 vTextureCoord;
+
+uniform sampler2D sampler;
+uniform ivec2 direction;
+uniform int radius;
+uniform float weights[129];
+
+void main()
+{
+    ivec2 size = textureSize(sampler, 0);
+    ivec2 texel = min(ivec2(vTextureCoord * vec2(size)), size - 1);
+
+    vec4 sum = vec4(0);
+    if (direction == ivec2(0)) {
+        for (int j = -radius; j <= radius; j++) {
+            for (int i = -radius; i <= radius; i++) {
+                ivec2 at = clamp(texel + ivec2(i, j), ivec2(0), size - 1);
+                sum += weights[i + radius] * weights[j + radius] * texelFetch(sampler, at, 0);
+            }
+        }
+    } else {
+        for (int k = -radius; k <= radius; k++) {
+            ivec2 at = clamp(texel + k * direction, ivec2(0), size - 1);
+            sum += weights[k + radius] * texelFetch(sampler, at, 0);
+        }
+    }
+    fColor = sum;
+}
@@ -0,0 +1,155 @@
+#include "sharing.h"
+
+/*
+ * The Canny edge detector of cs4722::edge_detector done on the GPU, with the same thresholds and smoothing.
+ *
+ * The passes, each drawing a rectangle over the whole target:
+ *      the smoothing, along the rows and then the columns, with separable_blur_fragment_shader.glsl
+ *      the derivative of the luminance, edge_gradient_fragment_shader.glsl
+ *      the thinning and sorting into strong and weak, edge_suppression_fragment_shader.glsl
+ *      following the edges, edge_hysteresis_fragment_shader.glsl, back and forth between two textures
+ *          in groups of hysteresis_group passes until a group makes no weak texel strong
+ *      and drawing the result into the framebuffer that was current, with the same shader
+ * The edges only grow by a texel a pass, where the CPU follows them all the way at once,
+ *      so there may be many passes for long edges of weak texels.
+ */
+
+static const auto hysteresis_group = 8;
+static const auto max_hysteresis_passes = 1024;
+
+static const cs4722::edge_detector *detector;
+static int width, height;
+
+static GLuint blur_program, gradient_program, suppression_program, hysteresis_program;
+static GLint blur_sampler_loc, blur_direction_loc, gradient_sampler_loc, suppression_sampler_loc,
+        hysteresis_sampler_loc, hysteresis_draw_edges_loc;
+static GLuint vao, vertex_buffer, counter_buffer;
+// two half float textures for the smoothing and the derivative, and two for the strengths
+static GLuint textures[4], frame_buffers[4];
+
+static GLuint compile(const char *fragment_shader) {
+    auto program = cs4722::compile_shaders("image_processing_vertex_shader.glsl", fragment_shader);
+    glUseProgram(program);
+    auto identity = glm::mat4(1);
+    glUniformMatrix4fv(glGetUniformLocation(program, "transform"), 1, GL_FALSE, glm::value_ptr(identity));
+    return program;
+}
+
+void edges_setup(const cs4722::edge_detector *the_detector, int the_width, int the_height) {
+    if (!vao) {
+        blur_program = compile("separable_blur_fragment_shader.glsl");
+        blur_sampler_loc = glGetUniformLocation(blur_program, "sampler");
+        blur_direction_loc = glGetUniformLocation(blur_program, "direction");
+        gradient_program = compile("edge_gradient_fragment_shader.glsl");
+        gradient_sampler_loc = glGetUniformLocation(gradient_program, "sampler");
+        suppression_program = compile("edge_suppression_fragment_shader.glsl");
+        suppression_sampler_loc = glGetUniformLocation(suppression_program, "sampler");
+        hysteresis_program = compile("edge_hysteresis_fragment_shader.glsl");
+        hysteresis_sampler_loc = glGetUniformLocation(hysteresis_program, "sampler");
+        hysteresis_draw_edges_loc = glGetUniformLocation(hysteresis_program, "draw_edges");
+
+        // two triangles covering the target, positions then texture coordinates
+        const GLfloat vertices[] = {
+                -1, -1, 0, 1, 0, 0,   1, -1, 0, 1, 1, 0,   1, 1, 0, 1, 1, 1,
+                -1, -1, 0, 1, 0, 0,   1, 1, 0, 1, 1, 1,   -1, 1, 0, 1, 0, 1,
+        };
+        glCreateBuffers(1, &vertex_buffer);
+        glNamedBufferStorage(vertex_buffer, sizeof(vertices), vertices, 0);
+        glCreateVertexArrays(1, &vao);
+        glVertexArrayVertexBuffer(vao, 0, vertex_buffer, 0, 6 * sizeof(GLfloat));
+        auto position = glGetAttribLocation(gradient_program, "bPosition");
+        auto texture_coordinate = glGetAttribLocation(gradient_program, "bTextureCoord");
+        glEnableVertexArrayAttrib(vao, position);
+        glVertexArrayAttribFormat(vao, position, 4, GL_FLOAT, GL_FALSE, 0);
+        glVertexArrayAttribBinding(vao, position, 0);
+        glEnableVertexArrayAttrib(vao, texture_coordinate);
+        glVertexArrayAttribFormat(vao, texture_coordinate, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat));
+        glVertexArrayAttribBinding(vao, texture_coordinate, 0);
+
+        glCreateBuffers(1, &counter_buffer);
+        glNamedBufferStorage(counter_buffer, sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    }
+
+    detector = the_detector;
+    auto weights = detector->smoothing_weights();
+    glUseProgram(blur_program);
+    glUniform1i(glGetUniformLocation(blur_program, "radius"), static_cast<GLint>(weights.size() / 2));
+    glUniform1fv(glGetUniformLocation(blur_program, "weights"), static_cast<GLsizei>(weights.size()),
+                 weights.data());
+    glUseProgram(suppression_program);
+    glUniform1f(glGetUniformLocation(suppression_program, "low"), detector->low);
+    glUniform1f(glGetUniformLocation(suppression_program, "high"), detector->high);
+
+    if (the_width != width || the_height != height) {
+        if (textures[0]) {
+            glDeleteFramebuffers(4, frame_buffers);
+            glDeleteTextures(4, textures);
+        }
+        width = the_width;
+        height = the_height;
+        glCreateTextures(GL_TEXTURE_2D, 4, textures);
+        glCreateFramebuffers(4, frame_buffers);
+        for (auto i = 0; i < 4; ++i) {
+            glTextureStorage2D(textures[i], 1, i < 2 ? GL_RGBA16F : GL_R8, width, height);
+            glNamedFramebufferTexture(frame_buffers[i], GL_COLOR_ATTACHMENT0, textures[i], 0);
+        }
+    }
+}
+
+static void draw(GLuint frame_buffer, GLint sampler_loc, GLuint texture) {
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frame_buffer);
+    glBindTextureUnit(blur_texture_unit, texture);
+    glUniform1i(sampler_loc, blur_texture_unit);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+int edges_display(int texture_unit) {
+    GLint window_frame_buffer, viewport[4], program;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &window_frame_buffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    glBindVertexArray(vao);
+    glViewport(0, 0, width, height);
+
+    // the source is on texture_unit, the passes after it read their input from blur_texture_unit
+    if (detector->smoothing_radius > 0) {
+        glUseProgram(blur_program);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frame_buffers[0]);
+        glUniform1i(blur_sampler_loc, texture_unit);
+        glUniform2i(blur_direction_loc, 1, 0);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        glUniform2i(blur_direction_loc, 0, 1);
+        draw(frame_buffers[1], blur_sampler_loc, textures[0]);
+        glUseProgram(gradient_program);
+        draw(frame_buffers[0], gradient_sampler_loc, textures[1]);
+    } else {
+        glUseProgram(gradient_program);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frame_buffers[0]);
+        glUniform1i(gradient_sampler_loc, texture_unit);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+    glUseProgram(suppression_program);
+    draw(frame_buffers[2], suppression_sampler_loc, textures[0]);
+
+    glUseProgram(hysteresis_program);
+    glUniform1i(hysteresis_draw_edges_loc, false);
+    glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, counter_buffer);
+    auto current = 2;
+    auto passes = 0;
+    for (GLuint promoted = 1; promoted > 0 && passes < max_hysteresis_passes;) {
+        const GLuint zero = 0;
+        glNamedBufferSubData(counter_buffer, 0, sizeof(zero), &zero);
+        for (auto p = 0; p < hysteresis_group; ++p, ++passes) {
+            draw(frame_buffers[5 - current], hysteresis_sampler_loc, textures[current]);
+            current = 5 - current;
+        }
+        glMemoryBarrier(GL_ATOMIC_COUNTER_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+        glGetNamedBufferSubData(counter_buffer, 0, sizeof(promoted), &promoted);
+    }
+
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glUniform1i(hysteresis_draw_edges_loc, true);
+    draw(window_frame_buffer, hysteresis_sampler_loc, textures[current]);
+    glUseProgram(program);
+    return passes;
+}
@@ -2,6 +2,7 @@
 
 
 #include "sharing.h"
+#include "cs4722/render_context.h"
 
 static cs4722::view *the_view;
 static GLuint program;
@@ -192,9 +193,9 @@ void parts_setup_for_fb() {
 }
 
 void parts_setup_for_window(GLFWwindow* window) {
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, cs4722::window_framebuffer());
     int w_width, w_height;
-    glfwGetFramebufferSize(window, &w_width, &w_height);
+    cs4722::window_framebuffer_size(window, &w_width, &w_height);
     glViewport(0, 0, w_width, w_height);
 
 }
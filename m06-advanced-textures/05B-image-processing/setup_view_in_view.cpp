@@ -17,6 +17,155 @@ static std::vector<cs4722::artifact*> parts_list;
 
 static GLuint vao;
 
+static const cs4722::separable_filter *blur = nullptr;
+static GLuint blur_program;
+static GLuint blur_frame_buffer;
+static GLint blur_transform_loc, blur_sampler_loc, blur_direction_loc;
+
+void view_in_view_blur(const cs4722::separable_filter *filter) {
+    blur = filter;
+}
+
+static cs4722::postfx_graph *postfx = nullptr;
+static GLuint fb_texture;
+
+void view_in_view_postfx(cs4722::postfx_graph *graph) {
+    postfx = graph;
+}
+
+static const cs4722::dual_filter_blur *dual_blur = nullptr;
+static GLuint dual_program;
+static GLuint dual_sampler;
+static GLint dual_transform_loc, dual_sampler_loc, dual_upsample_loc, dual_offset_loc;
+// level k of the pyramid, for k from 1, is mip level k - 1 of one texture, with a view and framebuffer each
+static std::vector<GLuint> dual_views, dual_frame_buffers;
+
+void view_in_view_dual_blur(const cs4722::dual_filter_blur *blur) {
+    dual_blur = blur;
+}
+
+static const cs4722::edge_detector *edge_detector = nullptr;
+
+void view_in_view_edges(const cs4722::edge_detector *detector) {
+    edge_detector = detector;
+}
+
+/*
+ * The pyramid of the dual filter blur is a texture half the size of the scene texture with all its mip levels,
+ *      in half floats like the separable blur.
+ * Each level is also made a texture of its own with a view, so a step can read one level while drawing
+ *      into the next.
+ * The steps sample through a sampler object that filters linearly and clamps to the edge, whatever the
+ *      scene texture's own parameters.
+ */
+static void dual_blur_setup() {
+    dual_program = cs4722::compile_shaders("image_processing_vertex_shader.glsl",
+                                           "dual_filter_fragment_shader.glsl");
+    std::cout << "dual filter program " << dual_program << std::endl;
+    dual_transform_loc = glGetUniformLocation(dual_program, "transform");
+    dual_sampler_loc = glGetUniformLocation(dual_program, "sampler");
+    dual_upsample_loc = glGetUniformLocation(dual_program, "upsample");
+    dual_offset_loc = glGetUniformLocation(dual_program, "offset");
+
+    auto levels = cs4722::dual_filter_blur::max_levels(frame_buffer_width, frame_buffer_height);
+    GLuint texture;
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+    glTextureStorage2D(texture, levels, GL_RGBA16F, frame_buffer_width / 2, frame_buffer_height / 2);
+    dual_views.resize(levels);
+    dual_frame_buffers.resize(levels);
+    glGenTextures(levels, dual_views.data());
+    glCreateFramebuffers(levels, dual_frame_buffers.data());
+    for (auto level = 0; level < levels; ++level) {
+        glTextureView(dual_views[level], GL_TEXTURE_2D, texture, GL_RGBA16F, level, 1, 0, 1);
+        glNamedFramebufferTexture(dual_frame_buffers[level], GL_COLOR_ATTACHMENT0, texture, level);
+    }
+
+    glCreateSamplers(1, &dual_sampler);
+    glSamplerParameteri(dual_sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glSamplerParameteri(dual_sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glSamplerParameteri(dual_sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(dual_sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+/*
+ * The steps down from the scene texture to the smallest level and back up into the window.
+ * Level 0 is the scene texture going down and the window coming up.
+ */
+static void dual_blur_display(const cs4722::artifact *obj, const glm::mat4 &model_transform) {
+    GLint window_frame_buffer, viewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &window_frame_buffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    glUseProgram(dual_program);
+    glUniformMatrix4fv(dual_transform_loc, 1, GL_FALSE, glm::value_ptr(model_transform));
+    glUniform1f(dual_offset_loc, dual_blur->offset);
+    glBindSampler(fb_texture_unit, dual_sampler);
+    glBindSampler(blur_texture_unit, dual_sampler);
+
+    auto levels = std::min(dual_blur->levels, static_cast<int>(dual_views.size()));
+    auto step = [&](int from, int to, bool upsample) {
+        if (from == 0) {
+            glUniform1i(dual_sampler_loc, fb_texture_unit);
+        } else {
+            glBindTextureUnit(blur_texture_unit, dual_views[from - 1]);
+            glUniform1i(dual_sampler_loc, blur_texture_unit);
+        }
+        if (to == 0) {
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, window_frame_buffer);
+            glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        } else {
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, dual_frame_buffers[to - 1]);
+            glViewport(0, 0, std::max(1, frame_buffer_width >> to), std::max(1, frame_buffer_height >> to));
+        }
+        glUniform1i(dual_upsample_loc, upsample);
+        glDrawArrays(GL_TRIANGLES, obj->the_shape->buffer_start, obj->the_shape->buffer_size);
+    };
+    if (levels == 0) {
+        // no blur, a step down with no offset samples each texel where it is
+        glUniform1f(dual_offset_loc, 0.0f);
+        step(0, 0, false);
+    }
+    for (auto level = 1; level <= levels; ++level) {
+        step(level - 1, level, false);
+    }
+    for (auto level = levels; level >= 1; --level) {
+        step(level, level - 1, true);
+    }
+
+    glBindSampler(fb_texture_unit, 0);
+    glBindSampler(blur_texture_unit, 0);
+    glUseProgram(program);
+}
+
+/*
+ * The separable blur renders the rectangle twice.
+ * The first pass blurs along the rows of the scene texture into a texture of the same size,
+ *      which is kept in half floats so the second pass does not add the rounding of 8 bit colors.
+ * The second pass blurs that texture along its columns into the window.
+ */
+static void blur_setup() {
+    blur_program = cs4722::compile_shaders("image_processing_vertex_shader.glsl",
+                                           "separable_blur_fragment_shader.glsl");
+    std::cout << "blur program " << blur_program << std::endl;
+    glUseProgram(blur_program);
+    blur_transform_loc = glGetUniformLocation(blur_program, "transform");
+    blur_sampler_loc = glGetUniformLocation(blur_program, "sampler");
+    blur_direction_loc = glGetUniformLocation(blur_program, "direction");
+    glUniform1i(glGetUniformLocation(blur_program, "radius"), blur->radius);
+    glUniform1fv(glGetUniformLocation(blur_program, "weights"), static_cast<GLsizei>(blur->weights.size()),
+                 blur->weights.data());
+
+    GLuint texture;
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+    glTextureStorage2D(texture, 1, GL_RGBA16F, frame_buffer_width, frame_buffer_height);
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTextureUnit(blur_texture_unit, texture);
+
+    glCreateFramebuffers(1, &blur_frame_buffer);
+    glNamedFramebufferTexture(blur_frame_buffer, GL_COLOR_ATTACHMENT0, texture, 0);
+}
+
 void view_in_view_setup(cs4722::view *the_view) {
 
     view = the_view;
@@ -44,10 +193,48 @@ void view_in_view_setup(cs4722::view *the_view) {
 
     vao  = cs4722::init_buffers(program, parts_list, "bPosition","", "bTextureCoord");
 
+    if (blur) {
+        blur_setup();
+    }
+
+    if (dual_blur) {
+        dual_blur_setup();
+    }
+
+    if (edge_detector) {
+        edges_setup(edge_detector, frame_buffer_width, frame_buffer_height);
+    }
+
+    if (postfx) {
+        // the graph is given the texture itself, which parts_setup left bound to fb_texture_unit
+        GLint texture;
+        glActiveTexture(GL_TEXTURE0 + fb_texture_unit);
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture);
+        fb_texture = texture;
+        postfx->compile();
+    }
+
 }
 
 void view_in_view_display() {
 
+    if (edge_detector) {
+        // the edges are drawn over the whole viewport, like the rectangle
+        edges_display(fb_texture_unit);
+        return;
+    }
+
+    if (postfx) {
+        // the graph draws its last pass over the whole viewport, so the rectangle is not needed
+        static auto reported = false;
+        postfx->run(fb_texture, frame_buffer_width, frame_buffer_height);
+        if (!reported) {
+            std::cout << "postfx " << postfx->report() << std::endl;
+            reported = true;
+        }
+        return;
+    }
+
     glBindVertexArray(vao);
     glUseProgram(program);
 
@@ -76,6 +263,34 @@ void view_in_view_display() {
         glUniformMatrix4fv(transform_loc, 1, GL_FALSE, glm::value_ptr(model_transform));
         glUniform1i(sampler_loc, fb_texture_unit);
 
+        if (blur) {
+            // the blur program reads the vertices the same way, so the same vertex array works for it
+            GLint window_frame_buffer, viewport[4];
+            glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &window_frame_buffer);
+            glGetIntegerv(GL_VIEWPORT, viewport);
+
+            glUseProgram(blur_program);
+            glUniformMatrix4fv(blur_transform_loc, 1, GL_FALSE, glm::value_ptr(model_transform));
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, blur_frame_buffer);
+            glViewport(0, 0, frame_buffer_width, frame_buffer_height);
+            glUniform1i(blur_sampler_loc, fb_texture_unit);
+            glUniform2i(blur_direction_loc, 1, 0);
+            glDrawArrays(GL_TRIANGLES, obj->the_shape->buffer_start, obj->the_shape->buffer_size);
+
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, window_frame_buffer);
+            glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+            glUniform1i(blur_sampler_loc, blur_texture_unit);
+            glUniform2i(blur_direction_loc, 0, 1);
+            glDrawArrays(GL_TRIANGLES, obj->the_shape->buffer_start, obj->the_shape->buffer_size);
+            glUseProgram(program);
+            continue;
+        }
+
+        if (dual_blur) {
+            dual_blur_display(obj, model_transform);
+            continue;
+        }
+
         glDrawArrays(GL_TRIANGLES, obj->the_shape->buffer_start, obj->the_shape->buffer_size);
     }
 }
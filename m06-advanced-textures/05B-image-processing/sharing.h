@@ -13,11 +13,18 @@
 #include "cs4722/buffer_utilities.h"
 #include "cs4722/texture_utilities.h"
 #include "cs4722/compile_shaders.h"
+#include "cs4722/separable_filter.h"
+#include "cs4722/postfx_graph.h"
+#include "cs4722/dual_filter_blur.h"
+#include "cs4722/edge_detector.h"
 
 
 const auto fb_texture_unit = 61;
 const auto frame_buffer_width = 2048;
 const auto frame_buffer_height = frame_buffer_width;
+// holds the rows blurred by the first pass of a separable blur
+const auto blur_texture_unit = 62;
+const auto max_blur_radius = 64;
 
 
 void parts_setup(cs4722::view* view);
@@ -33,6 +40,28 @@ void parts_setup_for_window(GLFWwindow* window);
 
 void view_in_view_setup(cs4722::view *the_view);
 
+// blur the view in view rectangle in two passes with the weights of filter, call before view_in_view_setup
+void view_in_view_blur(const cs4722::separable_filter *filter);
+
+// draw the scene texture through graph instead of the rectangle, call before view_in_view_setup
+void view_in_view_postfx(cs4722::postfx_graph *graph);
+
+// blur the view in view rectangle with a pyramid of textures, call before view_in_view_setup
+// blur may be changed between frames, up to max_levels of the frame buffer
+void view_in_view_dual_blur(const cs4722::dual_filter_blur *blur);
+
+// draw the edges of the view in view rectangle found on the GPU as detector finds them, call before
+// view_in_view_setup
+void view_in_view_edges(const cs4722::edge_detector *detector);
+
+// the passes of the edge detector on the GPU, for textures width by height, in setup_edges.cpp
+// edges_setup can be called again to change the detector or the size
+void edges_setup(const cs4722::edge_detector *detector, int width, int height);
+
+// draw the edges of the texture on texture_unit into the framebuffer and viewport that are current,
+// returning the number of passes that followed the edges
+int edges_display(int texture_unit);
+
 void view_in_view_display();
 
 
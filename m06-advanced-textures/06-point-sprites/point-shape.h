@@ -36,27 +36,28 @@ public:
     }
 
     /**
-     * Return an empty list
+     * Return an empty list.
+     * The same list is returned on every call, so nothing is allocated.
      */
     inline std::vector<cs4722::color>* colors() override
     {
-        return new std::vector<cs4722::color>();
+        return &color_list;
     }
     /**
-     * Return an empty list
+     * Return an empty list, shared between calls.
      */
 
     inline std::vector<glm::vec2>* texture_coordinates() override
     {
-        return new std::vector<glm::vec2>();
+        return &texture_coordinate_list;
     }
 
     /**
-     * Return an empty list
+     * Return an empty list, shared between calls.
      */
     inline std::vector<glm::vec4>* normals() override
     {
-        return new std::vector<glm::vec4>();
+        return &normal_list;
     }
 
     /**
@@ -67,4 +68,14 @@ public:
         return position_list->size();
     }
 
+private:
+
+    /*
+     * Empty lists handed out by the getters above.
+     * Like position_list, they belong to the shape and must not be deleted by the caller.
+     */
+    std::vector<cs4722::color> color_list;
+    std::vector<glm::vec2> texture_coordinate_list;
+    std::vector<glm::vec4> normal_list;
+
 };
@@ -37,6 +37,7 @@
 #include "cs4722/callbacks.h"
 #include "cs4722/texture_utilities.h"
 #include "cs4722/compile_shaders.h"
+#include "cs4722/render_context.h"
 #include "point-shape.h"
 
 static GLuint program;
@@ -161,11 +162,8 @@ void display()
 int
 main(int argc, char** argv)
 {
-	glfwInit();
-
-    auto *window = cs4722::setup_window("Point Sprites", .9);
-
-    gladLoadGL(glfwGetProcAddress);
+    auto context = cs4722::render_context(argc, argv, "Point Sprites", .9);
+    auto *window = context.window;
 	// gladLoadGL();
 	cs4722::setup_debug_callbacks();
 
@@ -182,16 +180,11 @@ main(int argc, char** argv)
 	glfwSetWindowUserPointer(window, the_view);
     cs4722::setup_user_callbacks(window);
 
-	while (!glfwWindowShouldClose(window))
+	while (context.running())
 	{
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_float());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
     	display();
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		context.end_frame();
 	}
-
-	glfwDestroyWindow(window);
-
-	glfwTerminate();
 }
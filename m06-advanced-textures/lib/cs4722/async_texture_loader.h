@@ -0,0 +1,525 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "STB/stb_image.h"
+#include "cs4722/parallel_for.h"
+#include "cs4722/x11.h"
+
+/**
+ * \file
+ *
+ * Loading textures from files in the background, so a program can start drawing before its images
+ * are decoded.
+ */
+
+namespace cs4722 {
+
+    enum class texture_status {
+        loading, ready, failed
+    };
+
+    /**
+     * \brief A texture requested from a `texture_loader`.
+     *
+     * `texture` is the 1x1 placeholder until the images have been decoded and uploaded,
+     * then the texture made from them.
+     * Either one is bound to `texture_unit`, so the program only needs the unit, as with
+     * `init_texture_from_file`.
+     *
+     * The handle is only changed by `texture_loader::update` and `texture_loader::finish`, on the thread
+     * with the OpenGL context, so it can be read there without locking.
+     */
+    struct texture_handle {
+        GLuint texture = 0;
+        GLuint texture_unit = 0;
+        texture_status status = texture_status::loading;
+        /// Time from the request to the texture being bound
+        double milliseconds = 0.0;
+        std::string error;
+
+        bool loading() const
+        {
+            return status == texture_status::loading;
+        }
+
+        bool ready() const
+        {
+            return status == texture_status::ready;
+        }
+
+        bool failed() const
+        {
+            return status == texture_status::failed;
+        }
+    };
+
+    /**
+     * \brief Decodes image files on a pool of threads and uploads them through a pixel buffer.
+     *
+     * The `load_` functions take the same arguments as the `init_` functions in texture_utilities.h
+     * and return at once, with a placeholder bound to the texture unit.
+     * The files are decoded with stb_image by the worker threads, all the faces of a cube map at the same
+     * time when there are enough threads.
+     *
+     * `update` is called once a frame on the thread with the OpenGL context.
+     * It copies decoded images into a persistently mapped pixel unpack buffer and starts the transfers
+     * to the textures from there, so the driver does not copy the texels again before returning.
+     * At most `upload_bytes_per_frame` are copied in one call, except that one image is always copied,
+     * so a frame is not held up by a large batch of images.
+     * The buffer is split into two regions that are used in turn, each with a fence, so a region
+     * is not written while the transfers from it may still be running.
+     * When all the images of a texture are in, the mip maps are made and the texture is bound to its
+     * unit in place of the placeholder.
+     *
+     * Textures are made with `GL_RGBA8` and full mip chains, as `init_compressed_texture_from_file`
+     * makes them, and are not deleted by the loader.
+     * If a file cannot be read, or the faces of a cube map are not squares of one size, the placeholder
+     * stays bound and the handle reports the failure.
+     *
+     * Needs a current OpenGL context when constructed.
+     */
+    class texture_loader {
+    public:
+
+        /**
+         * @param number_of_threads  Number of decoding threads, 0 means use the hardware concurrency
+         * @param upload_bytes_per_frame  Bytes of texels copied by one call to `update`
+         * @param placeholder  Color of the texture bound while the images load
+         */
+        explicit texture_loader(int number_of_threads = 0, size_t upload_bytes_per_frame = 32u << 20,
+                                cs4722::color placeholder = cs4722::x11::gray50)
+                : upload_bytes_per_frame(upload_bytes_per_frame), placeholder(placeholder)
+        {
+            for (auto t = 0; t < thread_count(number_of_threads); ++t) {
+                workers.emplace_back([this]() { decode_images(); });
+            }
+        }
+
+        texture_loader(const texture_loader &) = delete;
+        texture_loader &operator=(const texture_loader &) = delete;
+
+        /**
+         * Images not yet decoded are dropped, and their units are left with nothing bound.
+         */
+        ~texture_loader()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+                jobs.clear();
+            }
+            work_available.notify_all();
+            for (auto &worker: workers) {
+                worker.join();
+            }
+            for (auto &fence: fences) {
+                if (fence) glDeleteSync(fence);
+            }
+            if (staging) {
+                glUnmapNamedBuffer(staging);
+                glDeleteBuffers(1, &staging);
+            }
+            if (placeholder_2d) glDeleteTextures(1, &placeholder_2d);
+            if (placeholder_cube) glDeleteTextures(1, &placeholder_cube);
+        }
+
+        /**
+         * \brief Start loading a texture from an image file, see `init_texture_from_file`.
+         */
+        std::shared_ptr<const texture_handle> load_texture(const char *path, GLuint texture_unit)
+        {
+            return start(GL_TEXTURE_2D, {path}, texture_unit);
+        }
+
+        /**
+         * \brief Start loading a cube texture from six image files, see `init_cube_texture_from_file`.
+         */
+        std::shared_ptr<const texture_handle> load_cube_texture(const std::vector<std::string> &paths,
+                                                                int environment_unit)
+        {
+            if (paths.size() != 6) {
+                std::cerr << "a cube texture needs six files" << std::endl;
+                auto handle = std::make_shared<texture_handle>();
+                handle->texture = cube_placeholder();
+                handle->texture_unit = environment_unit;
+                handle->status = texture_status::failed;
+                handle->error = "a cube texture needs six files";
+                glBindTextureUnit(environment_unit, handle->texture);
+                return handle;
+            }
+            return start(GL_TEXTURE_CUBE_MAP, paths, environment_unit);
+        }
+
+        /**
+         * \brief Start loading a cube texture from the files posx.*, negx.*, posy.*, ... in the directory
+         * `base_path`, see `init_cube_texture_from_path`.
+         */
+        std::shared_ptr<const texture_handle> load_cube_texture_from_path(const char *base_path, int environment_unit,
+                                                                          const char *ext = "png")
+        {
+            const char *faces[] = {"posx", "negx", "posy", "negy", "posz", "negz"};
+            auto paths = std::vector<std::string>();
+            for (auto *face: faces) {
+                paths.push_back(std::string(base_path) + "/" + face + "." + ext);
+            }
+            return start(GL_TEXTURE_CUBE_MAP, paths, environment_unit);
+        }
+
+        /**
+         * \brief Upload the images decoded since the last call and bind the textures that are complete.
+         *
+         * Call once a frame, on the thread with the OpenGL context.
+         */
+        void update()
+        {
+            auto region = next_region;
+            auto copied = size_t(0);
+            auto *target = next_upload();
+            while (target) {
+                auto &image = target->images[target->uploaded];
+                auto bytes = image.texels.size();
+                if (copied > 0 && copied + bytes > region_bytes) {
+                    break;
+                }
+                if (copied == 0) {
+                    prepare_region(region, bytes);
+                }
+                upload(*target, region_bytes * region + copied);
+                copied += bytes;
+                if (copied >= upload_bytes_per_frame) {
+                    break;
+                }
+                target = next_upload();
+            }
+            if (copied > 0) {
+                fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                next_region = 1 - region;
+            }
+        }
+
+        /**
+         * \brief Wait for all the textures requested so far and upload them.
+         */
+        void finish()
+        {
+            while (pending() > 0) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    image_decoded.wait(lock, [this]() { return !decoded.empty() || !uploading.empty(); });
+                }
+                update();
+            }
+        }
+
+        /**
+         * \brief Number of textures requested and not yet ready or failed.
+         */
+        int pending() const
+        {
+            return static_cast<int>(requests.size());
+        }
+
+        /**
+         * \brief Images decoded and not yet uploaded, which is the memory held by the loader.
+         */
+        size_t decoded_bytes() const
+        {
+            return waiting_bytes;
+        }
+
+        size_t upload_bytes_per_frame;
+
+    private:
+
+        struct image {
+            std::string path;
+            int width = 0;
+            int height = 0;
+            std::vector<GLubyte> texels;
+        };
+
+        struct request {
+            std::shared_ptr<texture_handle> handle;
+            GLenum target;
+            std::vector<image> images;
+            std::atomic<int> remaining{0};
+            GLuint texture = 0;
+            int uploaded = 0;
+            std::chrono::steady_clock::time_point started;
+        };
+
+        struct job {
+            std::shared_ptr<request> from;
+            int index;
+        };
+
+
+        std::shared_ptr<const texture_handle> start(GLenum target, const std::vector<std::string> &paths,
+                                                    GLuint texture_unit)
+        {
+            auto handle = std::make_shared<texture_handle>();
+            handle->texture = target == GL_TEXTURE_CUBE_MAP ? cube_placeholder() : placeholder_texture();
+            handle->texture_unit = texture_unit;
+            glBindTextureUnit(texture_unit, handle->texture);
+
+            auto r = std::make_shared<request>();
+            r->handle = handle;
+            r->target = target;
+            r->images.resize(paths.size());
+            r->remaining = static_cast<int>(paths.size());
+            r->started = std::chrono::steady_clock::now();
+            requests.push_back(r);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (size_t i = 0; i < paths.size(); ++i) {
+                    r->images[i].path = paths[i];
+                    jobs.push_back({r, static_cast<int>(i)});
+                }
+            }
+            work_available.notify_all();
+            return handle;
+        }
+
+        /**
+         * What each worker runs: decode images until the loader is destroyed.
+         */
+        void decode_images()
+        {
+            while (true) {
+                job next;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    work_available.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                    if (stopping) {
+                        return;
+                    }
+                    next = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+                auto &image = next.from->images[next.index];
+                int channels;
+                auto *texels = stbi_load(image.path.c_str(), &image.width, &image.height, &channels, 4);
+                if (texels) {
+                    image.texels.assign(texels, texels + 4ull * image.width * image.height);
+                    stbi_image_free(texels);
+                    waiting_bytes += image.texels.size();
+                }
+                if (--next.from->remaining == 0) {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        decoded.push_back(next.from);
+                    }
+                    image_decoded.notify_all();
+                }
+            }
+        }
+
+        /**
+         * The request with the next image to upload, taking in the requests decoded since the last call.
+         * A request is checked, and its texture made, before its first image is uploaded.
+         */
+        request *next_upload()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                while (!decoded.empty()) {
+                    uploading.push_back(decoded.front());
+                    decoded.pop_front();
+                }
+            }
+            while (!uploading.empty()) {
+                auto &r = *uploading.front();
+                if (r.texture == 0 && !create_texture(r)) {
+                    uploading.pop_front();
+                    continue;
+                }
+                return &r;
+            }
+            return nullptr;
+        }
+
+        bool create_texture(request &r)
+        {
+            auto &first = r.images.front();
+            for (auto &image: r.images) {
+                if (image.texels.empty()) {
+                    fail(r, "could not read " + image.path);
+                    return false;
+                }
+                if (r.target == GL_TEXTURE_CUBE_MAP
+                    && (image.width != image.height || image.width != first.width)) {
+                    fail(r, "cube faces must be squares of one size, " + image.path);
+                    return false;
+                }
+            }
+            auto levels = 1;
+            while ((std::max(first.width, first.height) >> levels) > 0) {
+                ++levels;
+            }
+            glCreateTextures(r.target, 1, &r.texture);
+            glTextureStorage2D(r.texture, levels, GL_RGBA8, first.width, first.height);
+            return true;
+        }
+
+        /**
+         * Make sure a region holds at least `bytes` and that the transfers from it are done.
+         */
+        void prepare_region(int region, size_t bytes)
+        {
+            auto wanted = std::max(upload_bytes_per_frame, bytes);
+            if (wanted > region_bytes) {
+                for (auto r = 0; r < 2; ++r) {
+                    wait_for(r);
+                }
+                if (staging) {
+                    glUnmapNamedBuffer(staging);
+                    glDeleteBuffers(1, &staging);
+                }
+                region_bytes = wanted;
+                auto flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                glCreateBuffers(1, &staging);
+                glNamedBufferStorage(staging, static_cast<GLsizeiptr>(2 * region_bytes), nullptr, flags);
+                mapped = static_cast<GLubyte *>(glMapNamedBufferRange(
+                        staging, 0, static_cast<GLsizeiptr>(2 * region_bytes), flags));
+            }
+            wait_for(region);
+        }
+
+        void wait_for(int region)
+        {
+            auto &fence = fences[region];
+            if (!fence) {
+                return;
+            }
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+            }
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+
+        /**
+         * Copy the next image of `r` to the staging buffer at `offset` and start its transfer.
+         */
+        void upload(request &r, size_t offset)
+        {
+            auto &image = r.images[r.uploaded];
+            std::memcpy(mapped + offset, image.texels.data(), image.texels.size());
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging);
+            auto *from = reinterpret_cast<const void *>(offset);
+            if (r.target == GL_TEXTURE_CUBE_MAP) {
+                glTextureSubImage3D(r.texture, 0, 0, 0, r.uploaded, image.width, image.height, 1,
+                                    GL_RGBA, GL_UNSIGNED_BYTE, from);
+            } else {
+                glTextureSubImage2D(r.texture, 0, 0, 0, image.width, image.height,
+                                    GL_RGBA, GL_UNSIGNED_BYTE, from);
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            waiting_bytes -= image.texels.size();
+            image.texels = std::vector<GLubyte>();
+            if (++r.uploaded < static_cast<int>(r.images.size())) {
+                return;
+            }
+
+            glGenerateTextureMipmap(r.texture);
+            glTextureParameteri(r.texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTextureParameteri(r.texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            if (r.target == GL_TEXTURE_CUBE_MAP) {
+                glTextureParameteri(r.texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTextureParameteri(r.texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                glTextureParameteri(r.texture, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+            }
+            auto &handle = *r.handle;
+            handle.texture = r.texture;
+            handle.status = texture_status::ready;
+            handle.milliseconds = milliseconds_since(r.started);
+            glBindTextureUnit(handle.texture_unit, handle.texture);
+            uploading.pop_front();
+            forget(r);
+        }
+
+        void fail(request &r, const std::string &message)
+        {
+            std::cerr << message << std::endl;
+            r.handle->status = texture_status::failed;
+            r.handle->error = message;
+            r.handle->milliseconds = milliseconds_since(r.started);
+            for (auto &image: r.images) {
+                waiting_bytes -= image.texels.size();
+                image.texels = std::vector<GLubyte>();
+            }
+            forget(r);
+        }
+
+        void forget(request &r)
+        {
+            std::erase_if(requests, [&](const std::shared_ptr<request> &p) { return p.get() == &r; });
+        }
+
+        static double milliseconds_since(std::chrono::steady_clock::time_point start)
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        GLuint placeholder_texture()
+        {
+            if (!placeholder_2d) {
+                glCreateTextures(GL_TEXTURE_2D, 1, &placeholder_2d);
+                glTextureStorage2D(placeholder_2d, 1, GL_RGBA8, 1, 1);
+                glTextureSubImage2D(placeholder_2d, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &placeholder);
+            }
+            return placeholder_2d;
+        }
+
+        GLuint cube_placeholder()
+        {
+            if (!placeholder_cube) {
+                glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &placeholder_cube);
+                glTextureStorage2D(placeholder_cube, 1, GL_RGBA8, 1, 1);
+                for (auto face = 0; face < 6; ++face) {
+                    glTextureSubImage3D(placeholder_cube, 0, 0, 0, face, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                                        &placeholder);
+                }
+            }
+            return placeholder_cube;
+        }
+
+        cs4722::color placeholder;
+        GLuint placeholder_2d = 0;
+        GLuint placeholder_cube = 0;
+
+        // requests not yet ready or failed, only used on the OpenGL thread, as is uploading
+        std::vector<std::shared_ptr<request>> requests;
+        std::deque<std::shared_ptr<request>> uploading;
+
+        // shared with the workers
+        std::mutex mutex;
+        std::condition_variable work_available;
+        std::condition_variable image_decoded;
+        std::deque<job> jobs;
+        std::deque<std::shared_ptr<request>> decoded;
+        bool stopping = false;
+        std::atomic<size_t> waiting_bytes{0};
+        std::vector<std::thread> workers;
+
+        GLuint staging = 0;
+        GLubyte *mapped = nullptr;
+        size_t region_bytes = 0;
+        GLsync fences[2] = {nullptr, nullptr};
+        int next_region = 0;
+    };
+
+}
@@ -0,0 +1,918 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "STB/stb_image.h"
+
+#include "cs4722/parallel_for.h"
+
+/**
+ * \file
+ *
+ * Block compression of RGBA8 images on the CPU, for textures that would otherwise be uploaded uncompressed.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief Block compressed texture formats.
+     *
+     * Each compresses a 4 by 4 block of texels into a fixed number of bytes.
+     *
+     *  Format | Bytes per block | Channels | Use
+     *  ------ | --------------- | -------- | ---
+     *  `bc1` | 8 | RGB | opaque color, smallest
+     *  `bc4` | 8 | R | a single channel, such as one octave of noise
+     *  `bc5` | 16 | RG | two channels, such as the x and y of a normal map
+     *  `bc7` | 16 | RGBA | photos, the best quality of the four
+     */
+    enum class block_format {
+        bc1, bc4, bc5, bc7
+    };
+
+    /**
+     * \brief How much effort the encoder spends on each block.
+     *
+     * `fast` takes the endpoints from the extent of the block, `normal` from its principal axis followed by
+     * one least squares refinement, `best` refines further and tries more endpoint candidates.
+     */
+    enum class compression_quality {
+        fast, normal, best
+    };
+
+
+    /**
+     * \brief Encodes RGBA8 images into BC1, BC4, BC5 or BC7 blocks.
+     *
+     * The image is split into rows of blocks and worker threads repeatedly claim the next unfinished row
+     * until none remain, so the output does not depend on the number of threads.
+     * Images whose sizes are not multiples of 4 are padded by repeating the last row and column.
+     *
+     * Within a block, the work is done on arrays of the 16 texels with loops that have no dependencies
+     * between iterations, so the compiler can vectorize the distance and projection computations.
+     *
+     * BC4 takes the red channel of the image and BC5 the red and green channels.
+     * The BC7 encoder only writes mode 6, a single pair of RGBA endpoints with 4 bit indices,
+     * which suits photos well but loses more on blocks that mix two very different colors.
+     */
+    class block_encoder {
+    public:
+
+        /**
+         * @param format  Format to encode to
+         * @param quality  Effort spent on each block
+         * @param number_of_threads  Number of worker threads, 0 means use the hardware concurrency
+         */
+        explicit block_encoder(block_format format, compression_quality quality = compression_quality::normal,
+                               int number_of_threads = 0)
+                : format(format), quality(quality), number_of_threads(number_of_threads)
+        {}
+
+        /**
+         * \brief Number of bytes in one block of `format`.
+         */
+        static int block_bytes(block_format format)
+        {
+            return format == block_format::bc1 || format == block_format::bc4 ? 8 : 16;
+        }
+
+        /**
+         * \brief Number of bytes an image of the given size takes in `format`.
+         */
+        static size_t compressed_size(block_format format, int width, int height)
+        {
+            return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * block_bytes(format);
+        }
+
+        /**
+         * \brief The OpenGL internal format for `format`.
+         */
+        static GLenum internal_format(block_format format)
+        {
+            switch (format) {
+                case block_format::bc1:
+                    return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+                case block_format::bc4:
+                    return GL_COMPRESSED_RED_RGTC1;
+                case block_format::bc5:
+                    return GL_COMPRESSED_RG_RGTC2;
+                default:
+                    return GL_COMPRESSED_RGBA_BPTC_UNORM;
+            }
+        }
+
+        /**
+         * \brief Encode `width` by `height` RGBA8 texels, rows in the order OpenGL expects.
+         */
+        std::vector<GLubyte> encode(const GLubyte *rgba, int width, int height) const
+        {
+            auto blocks_x = (width + 3) / 4;
+            auto blocks_y = (height + 3) / 4;
+            auto bytes = block_bytes(format);
+            auto output = std::vector<GLubyte>(compressed_size(format, width, height));
+
+            parallel_for(blocks_y, number_of_threads, [&](int by) {
+                GLubyte texels[16][4];
+                auto *out = output.data() + static_cast<size_t>(by) * blocks_x * bytes;
+                for (auto bx = 0; bx < blocks_x; ++bx, out += bytes) {
+                    load_block(rgba, width, height, bx, by, texels);
+                    encode_block(texels, out);
+                }
+            });
+            return output;
+        }
+
+        /**
+         * \brief Decode blocks back to RGBA8, to measure the error of the encoding.
+         *
+         * Channels a format does not store are set as OpenGL returns them, 0 for green and blue and 255 for
+         * alpha.
+         * BC7 blocks are only decoded if they are mode 6, the mode `encode` writes, others decode to magenta.
+         */
+        static std::vector<GLubyte> decode(block_format format, const GLubyte *blocks, int width, int height)
+        {
+            auto blocks_x = (width + 3) / 4;
+            auto bytes = block_bytes(format);
+            auto rgba = std::vector<GLubyte>(4ull * width * height);
+            GLubyte texels[16][4];
+            for (auto by = 0; by < (height + 3) / 4; ++by) {
+                for (auto bx = 0; bx < blocks_x; ++bx) {
+                    decode_block(format, blocks + (static_cast<size_t>(by) * blocks_x + bx) * bytes, texels);
+                    for (auto y = 0; y < 4 && by * 4 + y < height; ++y) {
+                        for (auto x = 0; x < 4 && bx * 4 + x < width; ++x) {
+                            std::memcpy(&rgba[4 * (static_cast<size_t>(by * 4 + y) * width + bx * 4 + x)],
+                                        texels[4 * y + x], 4);
+                        }
+                    }
+                }
+            }
+            return rgba;
+        }
+
+        block_format format;
+        compression_quality quality;
+        int number_of_threads;
+
+    private:
+
+        static void load_block(const GLubyte *rgba, int width, int height, int bx, int by, GLubyte texels[16][4])
+        {
+            for (auto y = 0; y < 4; ++y) {
+                auto sy = std::min(by * 4 + y, height - 1);
+                for (auto x = 0; x < 4; ++x) {
+                    auto sx = std::min(bx * 4 + x, width - 1);
+                    std::memcpy(texels[4 * y + x], rgba + 4 * (static_cast<size_t>(sy) * width + sx), 4);
+                }
+            }
+        }
+
+        void encode_block(const GLubyte texels[16][4], GLubyte *out) const
+        {
+            GLubyte channel[16];
+            switch (format) {
+                case block_format::bc1:
+                    encode_bc1(texels, out);
+                    break;
+                case block_format::bc4:
+                    for (auto i = 0; i < 16; ++i) channel[i] = texels[i][0];
+                    encode_bc4(channel, out);
+                    break;
+                case block_format::bc5:
+                    for (auto i = 0; i < 16; ++i) channel[i] = texels[i][0];
+                    encode_bc4(channel, out);
+                    for (auto i = 0; i < 16; ++i) channel[i] = texels[i][1];
+                    encode_bc4(channel, out + 8);
+                    break;
+                case block_format::bc7:
+                    encode_bc7(texels, out);
+                    break;
+            }
+        }
+
+        static void decode_block(block_format format, const GLubyte *block, GLubyte texels[16][4])
+        {
+            GLubyte channel[16];
+            switch (format) {
+                case block_format::bc1:
+                    decode_bc1(block, texels);
+                    break;
+                case block_format::bc4:
+                case block_format::bc5:
+                    decode_bc4(block, channel);
+                    for (auto i = 0; i < 16; ++i) {
+                        texels[i][0] = channel[i];
+                        texels[i][1] = 0;
+                        texels[i][2] = 0;
+                        texels[i][3] = 255;
+                    }
+                    if (format == block_format::bc5) {
+                        decode_bc4(block + 8, channel);
+                        for (auto i = 0; i < 16; ++i) texels[i][1] = channel[i];
+                    }
+                    break;
+                case block_format::bc7:
+                    decode_bc7(block, texels);
+                    break;
+            }
+        }
+
+        /*
+         * Shared by the formats: the principal axis of a block, the direction along which its texels
+         * vary the most, found by power iteration on the covariance matrix.
+         * Only the first `channels` channels are used.
+         */
+        static void principal_axis(const float texels[16][4], int channels, float mean[4], float axis[4])
+        {
+            for (auto c = 0; c < 4; ++c) {
+                auto sum = 0.0f;
+                for (auto i = 0; i < 16; ++i) sum += texels[i][c];
+                mean[c] = c < channels ? sum / 16 : 0.0f;
+            }
+            float covariance[4][4] = {};
+            for (auto a = 0; a < channels; ++a) {
+                for (auto b = a; b < channels; ++b) {
+                    auto sum = 0.0f;
+                    for (auto i = 0; i < 16; ++i) sum += (texels[i][a] - mean[a]) * (texels[i][b] - mean[b]);
+                    covariance[a][b] = covariance[b][a] = sum;
+                }
+            }
+            // start from the diagonal of the extent, which is usually close to the answer
+            for (auto c = 0; c < 4; ++c) {
+                auto low = texels[0][c], high = texels[0][c];
+                for (auto i = 1; i < 16; ++i) {
+                    low = std::min(low, texels[i][c]);
+                    high = std::max(high, texels[i][c]);
+                }
+                axis[c] = c < channels ? high - low + 1e-3f : 0.0f;
+            }
+            for (auto iteration = 0; iteration < 8; ++iteration) {
+                float next[4] = {};
+                for (auto a = 0; a < channels; ++a) {
+                    for (auto b = 0; b < channels; ++b) next[a] += covariance[a][b] * axis[b];
+                }
+                auto length = 0.0f;
+                for (auto c = 0; c < channels; ++c) length = std::max(length, std::abs(next[c]));
+                if (length < 1e-6f) {
+                    break;
+                }
+                for (auto c = 0; c < channels; ++c) axis[c] = next[c] / length;
+            }
+            auto norm = 0.0f;
+            for (auto c = 0; c < channels; ++c) norm += axis[c] * axis[c];
+            norm = norm > 0 ? 1.0f / std::sqrt(norm) : 0.0f;
+            for (auto c = 0; c < channels; ++c) axis[c] *= norm;
+        }
+
+        /*
+         * Endpoints at the ends of the projection of the texels on the principal axis.
+         */
+        static void axis_endpoints(const float texels[16][4], int channels, float low[4], float high[4])
+        {
+            float mean[4], axis[4];
+            principal_axis(texels, channels, mean, axis);
+            auto t_low = 0.0f, t_high = 0.0f;
+            for (auto i = 0; i < 16; ++i) {
+                auto t = 0.0f;
+                for (auto c = 0; c < channels; ++c) t += (texels[i][c] - mean[c]) * axis[c];
+                t_low = std::min(t_low, t);
+                t_high = std::max(t_high, t);
+            }
+            for (auto c = 0; c < 4; ++c) {
+                low[c] = std::clamp(mean[c] + t_low * axis[c], 0.0f, 255.0f);
+                high[c] = std::clamp(mean[c] + t_high * axis[c], 0.0f, 255.0f);
+            }
+        }
+
+        /*
+         * Least squares endpoints for fixed indices: texel i is approximated by
+         * weight[i] * first + (1 - weight[i]) * second.
+         * Returns false, leaving the endpoints alone, when all the texels use the same weight.
+         */
+        static bool least_squares_endpoints(const float texels[16][4], const float weight[16], int channels,
+                                            float first[4], float second[4])
+        {
+            auto aa = 0.0f, ab = 0.0f, bb = 0.0f;
+            float ax[4] = {}, bx[4] = {};
+            for (auto i = 0; i < 16; ++i) {
+                auto a = weight[i], b = 1.0f - weight[i];
+                aa += a * a;
+                ab += a * b;
+                bb += b * b;
+                for (auto c = 0; c < channels; ++c) {
+                    ax[c] += a * texels[i][c];
+                    bx[c] += b * texels[i][c];
+                }
+            }
+            auto determinant = aa * bb - ab * ab;
+            if (std::abs(determinant) < 1e-6f) {
+                return false;
+            }
+            for (auto c = 0; c < channels; ++c) {
+                first[c] = std::clamp((bb * ax[c] - ab * bx[c]) / determinant, 0.0f, 255.0f);
+                second[c] = std::clamp((aa * bx[c] - ab * ax[c]) / determinant, 0.0f, 255.0f);
+            }
+            return true;
+        }
+
+        static void to_float(const GLubyte texels[16][4], float result[16][4])
+        {
+            for (auto i = 0; i < 16; ++i) {
+                for (auto c = 0; c < 4; ++c) result[i][c] = texels[i][c];
+            }
+        }
+
+        /*
+         * Index of the closest palette entry for each texel, returning the total squared error.
+         */
+        template<int entries>
+        static int closest_indices(const GLubyte texels[16][4], const int palette[entries][4], int channels,
+                                   int indices[16])
+        {
+            auto total = 0;
+            for (auto i = 0; i < 16; ++i) {
+                auto best = 1 << 30, best_index = 0;
+                for (auto e = 0; e < entries; ++e) {
+                    auto error = 0;
+                    for (auto c = 0; c < channels; ++c) {
+                        auto d = texels[i][c] - palette[e][c];
+                        error += d * d;
+                    }
+                    if (error < best) {
+                        best = error;
+                        best_index = e;
+                    }
+                }
+                indices[i] = best_index;
+                total += best;
+            }
+            return total;
+        }
+
+        // ---- BC1 ----
+
+        static int pack565(const float color[4])
+        {
+            auto r = static_cast<int>(std::lround(color[0] * 31 / 255));
+            auto g = static_cast<int>(std::lround(color[1] * 63 / 255));
+            auto b = static_cast<int>(std::lround(color[2] * 31 / 255));
+            return (r << 11) | (g << 5) | b;
+        }
+
+        static void unpack565(int packed, int color[4])
+        {
+            auto r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+            color[0] = (r << 3) | (r >> 2);
+            color[1] = (g << 2) | (g >> 4);
+            color[2] = (b << 3) | (b >> 2);
+            color[3] = 255;
+        }
+
+        static void bc1_palette(int color0, int color1, int palette[4][4])
+        {
+            unpack565(color0, palette[0]);
+            unpack565(color1, palette[1]);
+            for (auto c = 0; c < 4; ++c) {
+                if (color0 > color1) {
+                    palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                    palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+                } else {
+                    palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                    palette[3][c] = 0;
+                }
+            }
+            palette[3][3] = color0 > color1 ? 255 : 0;
+        }
+
+        /*
+         * Quantize the endpoints and choose indices, keeping the result if it beats `best_error`.
+         */
+        static void try_bc1(const GLubyte texels[16][4], const float first[4], const float second[4],
+                            int &best_error, int &best_color0, int &best_color1, int best_indices[16])
+        {
+            auto color0 = pack565(first);
+            auto color1 = pack565(second);
+            // the four color mode needs color0 > color1
+            if (color0 < color1) {
+                std::swap(color0, color1);
+            }
+            int palette[4][4];
+            bc1_palette(color0, color1, palette);
+            int indices[16];
+            // equal endpoints are in the three color mode, where entry 3 is black, so only entry 0 is used
+            auto error = color0 == color1 ? closest_indices<1>(texels, palette, 3, indices)
+                                          : closest_indices<4>(texels, palette, 3, indices);
+            if (error < best_error) {
+                best_error = error;
+                best_color0 = color0;
+                best_color1 = color1;
+                std::copy(indices, indices + 16, best_indices);
+            }
+        }
+
+        void encode_bc1(const GLubyte texels[16][4], GLubyte *out) const
+        {
+            float values[16][4];
+            to_float(texels, values);
+            float first[4], second[4];
+            auto best_error = 1 << 30, color0 = 0, color1 = 0;
+            int indices[16];
+
+            if (quality == compression_quality::fast) {
+                // the extent of the block, inset by 1/16 since the extremes are rarely all on one axis
+                for (auto c = 0; c < 3; ++c) {
+                    auto low = values[0][c], high = values[0][c];
+                    for (auto i = 1; i < 16; ++i) {
+                        low = std::min(low, values[i][c]);
+                        high = std::max(high, values[i][c]);
+                    }
+                    auto inset = (high - low) / 16;
+                    first[c] = high - inset;
+                    second[c] = low + inset;
+                }
+                try_bc1(texels, first, second, best_error, color0, color1, indices);
+            } else {
+                axis_endpoints(values, 3, second, first);
+                try_bc1(texels, first, second, best_error, color0, color1, indices);
+                auto iterations = quality == compression_quality::best ? 3 : 1;
+                for (auto iteration = 0; iteration < iterations && color0 != color1; ++iteration) {
+                    static constexpr float index_weight[4] = {1.0f, 0.0f, 2.0f / 3, 1.0f / 3};
+                    float weight[16];
+                    for (auto i = 0; i < 16; ++i) weight[i] = index_weight[indices[i]];
+                    if (!least_squares_endpoints(values, weight, 3, first, second)) {
+                        break;
+                    }
+                    try_bc1(texels, first, second, best_error, color0, color1, indices);
+                }
+            }
+
+            out[0] = static_cast<GLubyte>(color0 & 255);
+            out[1] = static_cast<GLubyte>(color0 >> 8);
+            out[2] = static_cast<GLubyte>(color1 & 255);
+            out[3] = static_cast<GLubyte>(color1 >> 8);
+            auto bits = 0u;
+            for (auto i = 0; i < 16; ++i) {
+                bits |= static_cast<unsigned>(indices[i]) << (2 * i);
+            }
+            for (auto b = 0; b < 4; ++b) {
+                out[4 + b] = static_cast<GLubyte>(bits >> (8 * b));
+            }
+        }
+
+        static void decode_bc1(const GLubyte *block, GLubyte texels[16][4])
+        {
+            int palette[4][4];
+            bc1_palette(block[0] | (block[1] << 8), block[2] | (block[3] << 8), palette);
+            for (auto i = 0; i < 16; ++i) {
+                auto index = (block[4 + i / 4] >> (2 * (i % 4))) & 3;
+                for (auto c = 0; c < 4; ++c) texels[i][c] = static_cast<GLubyte>(palette[index][c]);
+            }
+        }
+
+        // ---- BC4, and BC5 as two BC4 blocks ----
+
+        static void bc4_palette(int value0, int value1, int palette[8][4])
+        {
+            int values[8];
+            values[0] = value0;
+            values[1] = value1;
+            if (value0 > value1) {
+                for (auto i = 2; i < 8; ++i) values[i] = ((8 - i) * value0 + (i - 1) * value1 + 3) / 7;
+            } else {
+                for (auto i = 2; i < 6; ++i) values[i] = ((6 - i) * value0 + (i - 1) * value1 + 2) / 5;
+                values[6] = 0;
+                values[7] = 255;
+            }
+            for (auto i = 0; i < 8; ++i) palette[i][0] = values[i];
+        }
+
+        static void try_bc4(const GLubyte texels[16][4], int value0, int value1,
+                            int &best_error, int &best0, int &best1, int best_indices[16])
+        {
+            int palette[8][4];
+            bc4_palette(value0, value1, palette);
+            int indices[16];
+            auto error = closest_indices<8>(texels, palette, 1, indices);
+            if (error < best_error) {
+                best_error = error;
+                best0 = value0;
+                best1 = value1;
+                std::copy(indices, indices + 16, best_indices);
+            }
+        }
+
+        void encode_bc4(const GLubyte channel[16], GLubyte *out) const
+        {
+            GLubyte texels[16][4] = {};
+            auto low = 255, high = 0;
+            // the lowest and highest values other than 0 and 255, which the six value mode has for free
+            auto inner_low = 255, inner_high = 0;
+            for (auto i = 0; i < 16; ++i) {
+                texels[i][0] = channel[i];
+                low = std::min(low, static_cast<int>(channel[i]));
+                high = std::max(high, static_cast<int>(channel[i]));
+                if (channel[i] != 0 && channel[i] != 255) {
+                    inner_low = std::min(inner_low, static_cast<int>(channel[i]));
+                    inner_high = std::max(inner_high, static_cast<int>(channel[i]));
+                }
+            }
+
+            auto best_error = 1 << 30, value0 = 0, value1 = 0;
+            int indices[16];
+            try_bc4(texels, high, low, best_error, value0, value1, indices);
+            if (quality != compression_quality::fast && best_error > 0) {
+                if (inner_low <= inner_high) {
+                    try_bc4(texels, inner_low, inner_high, best_error, value0, value1, indices);
+                }
+                if (quality == compression_quality::best) {
+                    // endpoints slightly inside the range can fit the texels between them better
+                    for (auto d0 = 0; d0 <= 3; ++d0) {
+                        for (auto d1 = 0; d1 <= 3; ++d1) {
+                            if (high - d0 > low + d1) {
+                                try_bc4(texels, high - d0, low + d1, best_error, value0, value1, indices);
+                            }
+                        }
+                    }
+                }
+            }
+
+            out[0] = static_cast<GLubyte>(value0);
+            out[1] = static_cast<GLubyte>(value1);
+            auto bits = 0ull;
+            for (auto i = 0; i < 16; ++i) {
+                bits |= static_cast<unsigned long long>(indices[i]) << (3 * i);
+            }
+            for (auto b = 0; b < 6; ++b) {
+                out[2 + b] = static_cast<GLubyte>(bits >> (8 * b));
+            }
+        }
+
+        static void decode_bc4(const GLubyte *block, GLubyte channel[16])
+        {
+            int palette[8][4];
+            bc4_palette(block[0], block[1], palette);
+            auto bits = 0ull;
+            for (auto b = 0; b < 6; ++b) {
+                bits |= static_cast<unsigned long long>(block[2 + b]) << (8 * b);
+            }
+            for (auto i = 0; i < 16; ++i) {
+                channel[i] = static_cast<GLubyte>(palette[(bits >> (3 * i)) & 7][0]);
+            }
+        }
+
+        // ---- BC7 mode 6 ----
+
+        static constexpr int bc7_weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+        /*
+         * Quantize an endpoint to 7 bits per channel plus a shared low bit.
+         */
+        static void quantize_bc7(const float endpoint[4], int p_bit, int quantized[4])
+        {
+            for (auto c = 0; c < 4; ++c) {
+                quantized[c] = std::clamp(static_cast<int>(std::lround((endpoint[c] - p_bit) / 2)), 0, 127);
+            }
+        }
+
+        static int quantization_error(const float endpoint[4], const int quantized[4], int p_bit)
+        {
+            auto error = 0.0f;
+            for (auto c = 0; c < 4; ++c) {
+                auto d = endpoint[c] - static_cast<float>(quantized[c] * 2 + p_bit);
+                error += d * d;
+            }
+            return static_cast<int>(error);
+        }
+
+        static void bc7_palette(const int first[4], const int second[4], int p0, int p1, int palette[16][4])
+        {
+            for (auto c = 0; c < 4; ++c) {
+                auto e0 = first[c] * 2 + p0, e1 = second[c] * 2 + p1;
+                for (auto i = 0; i < 16; ++i) {
+                    palette[i][c] = ((64 - bc7_weights[i]) * e0 + bc7_weights[i] * e1 + 32) >> 6;
+                }
+            }
+        }
+
+        /*
+         * Indices for a BC7 palette, which lies along a line: each texel is projected onto the line and only
+         * the entries next to the projection are compared, rather than all 16.
+         */
+        static int line_indices(const GLubyte texels[16][4], const int palette[16][4], int indices[16])
+        {
+            float direction[4];
+            auto length = 0.0f;
+            for (auto c = 0; c < 4; ++c) {
+                direction[c] = static_cast<float>(palette[15][c] - palette[0][c]);
+                length += direction[c] * direction[c];
+            }
+            auto scale = length > 0 ? 15.0f / length : 0.0f;
+            auto total = 0;
+            for (auto i = 0; i < 16; ++i) {
+                auto t = 0.0f;
+                for (auto c = 0; c < 4; ++c) t += (texels[i][c] - palette[0][c]) * direction[c];
+                auto guess = std::clamp(static_cast<int>(std::lround(t * scale)), 0, 15);
+                auto best = 1 << 30, best_index = guess;
+                for (auto e = std::max(guess - 1, 0); e <= std::min(guess + 1, 15); ++e) {
+                    auto error = 0;
+                    for (auto c = 0; c < 4; ++c) {
+                        auto d = texels[i][c] - palette[e][c];
+                        error += d * d;
+                    }
+                    if (error < best) {
+                        best = error;
+                        best_index = e;
+                    }
+                }
+                indices[i] = best_index;
+                total += best;
+            }
+            return total;
+        }
+
+        struct bc7_result {
+            int error = 1 << 30;
+            int first[4], second[4];
+            int p0, p1;
+            int indices[16];
+        };
+
+        void try_bc7(const GLubyte texels[16][4], const float first[4], const float second[4],
+                     bc7_result &best) const
+        {
+            // each endpoint has its own low bit, chosen for it alone or, at best quality, by trying all four
+            int candidates[2][2][4];
+            for (auto p = 0; p < 2; ++p) {
+                quantize_bc7(first, p, candidates[0][p]);
+                quantize_bc7(second, p, candidates[1][p]);
+            }
+            int palette[16][4], indices[16];
+            if (quality == compression_quality::best) {
+                for (auto p0 = 0; p0 < 2; ++p0) {
+                    for (auto p1 = 0; p1 < 2; ++p1) {
+                        bc7_palette(candidates[0][p0], candidates[1][p1], p0, p1, palette);
+                        auto error = closest_indices<16>(texels, palette, 4, indices);
+                        keep_bc7(error, candidates[0][p0], candidates[1][p1], p0, p1, indices, best);
+                    }
+                }
+                return;
+            }
+            auto p0 = quantization_error(first, candidates[0][0], 0)
+                      <= quantization_error(first, candidates[0][1], 1) ? 0 : 1;
+            auto p1 = quantization_error(second, candidates[1][0], 0)
+                      <= quantization_error(second, candidates[1][1], 1) ? 0 : 1;
+            bc7_palette(candidates[0][p0], candidates[1][p1], p0, p1, palette);
+            auto error = line_indices(texels, palette, indices);
+            keep_bc7(error, candidates[0][p0], candidates[1][p1], p0, p1, indices, best);
+        }
+
+        static void keep_bc7(int error, const int first[4], const int second[4], int p0, int p1,
+                             const int indices[16], bc7_result &best)
+        {
+            if (error >= best.error) {
+                return;
+            }
+            best.error = error;
+            std::copy(first, first + 4, best.first);
+            std::copy(second, second + 4, best.second);
+            best.p0 = p0;
+            best.p1 = p1;
+            std::copy(indices, indices + 16, best.indices);
+        }
+
+        void encode_bc7(const GLubyte texels[16][4], GLubyte *out) const
+        {
+            float values[16][4];
+            to_float(texels, values);
+            float first[4], second[4];
+            axis_endpoints(values, 4, first, second);
+            auto best = bc7_result();
+            try_bc7(texels, first, second, best);
+
+            auto iterations = quality == compression_quality::fast ? 0
+                    : quality == compression_quality::normal ? 1 : 3;
+            for (auto iteration = 0; iteration < iterations && best.error > 0; ++iteration) {
+                float weight[16];
+                for (auto i = 0; i < 16; ++i) weight[i] = (64 - bc7_weights[best.indices[i]]) / 64.0f;
+                if (!least_squares_endpoints(values, weight, 4, first, second)) {
+                    break;
+                }
+                try_bc7(texels, first, second, best);
+            }
+
+            // the first texel's index is stored with 3 bits, so it must be below 8, swap the endpoints if not
+            if (best.indices[0] >= 8) {
+                std::swap(best.first, best.second);
+                std::swap(best.p0, best.p1);
+                for (auto &index: best.indices) index = 15 - index;
+            }
+
+            std::memset(out, 0, 16);
+            auto position = 0;
+            auto put = [&](unsigned value, int bits) {
+                for (auto b = 0; b < bits; ++b, ++position) {
+                    out[position / 8] |= static_cast<GLubyte>(((value >> b) & 1) << (position % 8));
+                }
+            };
+            put(1u << 6, 7);
+            for (auto c = 0; c < 4; ++c) {
+                put(best.first[c], 7);
+                put(best.second[c], 7);
+            }
+            put(best.p0, 1);
+            put(best.p1, 1);
+            put(best.indices[0], 3);
+            for (auto i = 1; i < 16; ++i) {
+                put(best.indices[i], 4);
+            }
+        }
+
+        static void decode_bc7(const GLubyte *block, GLubyte texels[16][4])
+        {
+            auto position = 0;
+            auto get = [&](int bits) {
+                auto value = 0u;
+                for (auto b = 0; b < bits; ++b, ++position) {
+                    value |= ((block[position / 8] >> (position % 8)) & 1u) << b;
+                }
+                return static_cast<int>(value);
+            };
+            if (get(7) != 1 << 6) {
+                for (auto i = 0; i < 16; ++i) {
+                    texels[i][0] = 255;
+                    texels[i][1] = 0;
+                    texels[i][2] = 255;
+                    texels[i][3] = 255;
+                }
+                return;
+            }
+            int first[4], second[4];
+            for (auto c = 0; c < 4; ++c) {
+                first[c] = get(7);
+                second[c] = get(7);
+            }
+            auto p0 = get(1);
+            auto p1 = get(1);
+            int palette[16][4];
+            bc7_palette(first, second, p0, p1, palette);
+            for (auto i = 0; i < 16; ++i) {
+                auto index = get(i == 0 ? 3 : 4);
+                for (auto c = 0; c < 4; ++c) texels[i][c] = static_cast<GLubyte>(palette[index][c]);
+            }
+        }
+    };
+
+    /**
+     * \brief Halve each dimension of an RGBA8 image that is larger than 1, averaging the texels each new
+     * texel covers, as OpenGL sizes the next mip level.
+     */
+    inline std::vector<GLubyte> halve_image(const GLubyte *rgba, int width, int height,
+                                            int &half_width, int &half_height)
+    {
+        half_width = std::max(1, width / 2);
+        half_height = std::max(1, height / 2);
+        auto step_x = width > 1 ? 1 : 0, step_y = height > 1 ? 1 : 0;
+        auto half = std::vector<GLubyte>(4ull * half_width * half_height);
+        for (auto y = 0; y < half_height; ++y) {
+            const auto *row0 = rgba + 4ull * width * (2 * y);
+            const auto *row1 = rgba + 4ull * width * (2 * y + step_y);
+            auto *out = half.data() + 4ull * half_width * y;
+            for (auto x = 0; x < half_width * 4; ++x) {
+                auto c = x % 4, sx = 2 * (x / 4);
+                auto sum = row0[4 * sx + c] + row0[4 * (sx + step_x) + c]
+                           + row1[4 * sx + c] + row1[4 * (sx + step_x) + c];
+                out[x] = static_cast<GLubyte>((sum + 2) / 4);
+            }
+        }
+        return half;
+    }
+
+    /**
+     * \brief Encode an RGBA8 image and each of its mip levels and upload them to `texture`.
+     *
+     * The texture must have storage for every level in the encoder's format.
+     * For a cube map `face` is the face, 0 for X+ up to 5 for Z-, as the layer of the texture.
+     */
+    inline void upload_compressed_levels(GLuint texture, bool cube, int face, const GLubyte *rgba,
+                                         int width, int height, const block_encoder &encoder)
+    {
+        auto format = block_encoder::internal_format(encoder.format);
+        auto level_texels = std::vector<GLubyte>(rgba, rgba + 4ull * width * height);
+        for (auto level = 0; ; ++level) {
+            auto blocks = encoder.encode(level_texels.data(), width, height);
+            auto size = static_cast<GLsizei>(blocks.size());
+            if (cube) {
+                glCompressedTextureSubImage3D(texture, level, 0, 0, face, width, height, 1, format, size,
+                                              blocks.data());
+            } else {
+                glCompressedTextureSubImage2D(texture, level, 0, 0, width, height, format, size, blocks.data());
+            }
+            if (width == 1 && height == 1) {
+                break;
+            }
+            level_texels = halve_image(level_texels.data(), width, height, width, height);
+        }
+    }
+
+    inline int texture_level_count(int width, int height)
+    {
+        auto levels = 1;
+        for (auto largest = std::max(width, height); largest > 1; largest /= 2) {
+            ++levels;
+        }
+        return levels;
+    }
+
+    /**
+     * \brief Create a block compressed texture, with all its mip levels, from an image file and assign it
+     * to a texture unit.
+     *
+     * This is `init_texture_from_file` for compressed textures.
+     * BC7 suits photos, BC1 takes half the memory at a lower quality.
+     * The rows are uploaded in the order stb_image reads them, as in the cube map example.
+     *
+     * @param path  Path to the image file
+     * @param texture_unit  Texture unit to use for this texture
+     * @param format  Compressed format
+     * @param quality  Effort spent on each block
+     * @returns  The texture identifier, or 0 if the file could not be read
+     */
+    inline GLuint init_compressed_texture_from_file(const char *path, GLuint texture_unit,
+                                                    block_format format = block_format::bc7,
+                                                    compression_quality quality = compression_quality::normal)
+    {
+        int width, height, channels;
+        auto *texels = stbi_load(path, &width, &height, &channels, 4);
+        if (!texels) {
+            std::cerr << "could not read " << path << std::endl;
+            return 0;
+        }
+        GLuint texture;
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+        glTextureStorage2D(texture, texture_level_count(width, height), block_encoder::internal_format(format),
+                           width, height);
+        upload_compressed_levels(texture, false, 0, texels, width, height, block_encoder(format, quality));
+        stbi_image_free(texels);
+
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTextureUnit(texture_unit, texture);
+        return texture;
+    }
+
+    /**
+     * \brief Create a block compressed cube texture from the files posx.*, negx.*, posy.*, ... in the
+     * directory `base_path`.
+     *
+     * This is `init_cube_texture_from_path` for compressed textures, the arguments are the same with
+     * the format and quality added.
+     *
+     * @returns  The texture identifier, or 0 if a face could not be read or the faces differ in size
+     */
+    inline GLuint init_compressed_cube_texture_from_path(const char *base_path, int environment_unit,
+                                                         const char *ext = "png",
+                                                         block_format format = block_format::bc7,
+                                                         compression_quality quality = compression_quality::normal)
+    {
+        const char *faces[] = {"posx", "negx", "posy", "negy", "posz", "negz"};
+        auto encoder = block_encoder(format, quality);
+        GLuint texture = 0;
+        auto size = 0;
+        for (auto face = 0; face < 6; ++face) {
+            auto path = std::string(base_path) + "/" + faces[face] + "." + ext;
+            int width, height, channels;
+            auto *texels = stbi_load(path.c_str(), &width, &height, &channels, 4);
+            if (!texels || width != height || (texture && width != size)) {
+                std::cerr << (texels ? "cube faces must be squares of one size, " : "could not read ")
+                          << path << std::endl;
+                stbi_image_free(texels);
+                if (texture) glDeleteTextures(1, &texture);
+                return 0;
+            }
+            if (!texture) {
+                size = width;
+                glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &texture);
+                glTextureStorage2D(texture, texture_level_count(size, size), block_encoder::internal_format(format),
+                                   size, size);
+            }
+            upload_compressed_levels(texture, true, face, texels, width, height, encoder);
+            stbi_image_free(texels);
+        }
+
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glBindTextureUnit(environment_unit, texture);
+        return texture;
+    }
+
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstdlib>
+#include <iterator>
+#include <string>
+
+#include <GLM/glm.hpp>
+
+/**
+ * \file
+ *
+ * The color filters of fragment_shader05A.glsl, and a few with an amount to adjust, on the CPU and in GLSL,
+ * shared by `postfx_graph` and `color_lut`.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief The color filters of fragment_shader05A.glsl, and a few with an amount to adjust.
+     *
+     * The numbers are those `color_filter_glsl` uses for them.
+     * The first eight take no amount.
+     */
+    enum class color_filter {
+        /// keep only red
+        red = 0,
+        /// blue shown as green
+        blue_as_green = 1,
+        /// gray with the luminance of the color
+        luminance = 2,
+        /// blue, red or green for low, medium or high luminance
+        coded_luminance = 3,
+        /// blue mixed with green in proportion to the luminance
+        luminance_blue_green = 4,
+        /// gray with the average of red, green and blue
+        average_gray = 5,
+        /// gray with the red of the color
+        red_gray = 6,
+        /// one minus each component, as a film negative
+        negative = 7,
+        /// mixed with the brown tones of an old photograph by the amount, 1 for all sepia
+        sepia = 8,
+        /// colors moved away from or toward gray by the amount, 1 for no change, 0 for gray
+        saturation = 9,
+        /// colors moved away from or toward middle gray by the amount, 1 for no change
+        contrast = 10,
+        /// the amount added to each component
+        brightness = 11,
+        /// each component raised to one over the amount
+        gamma = 12
+    };
+
+    /**
+     * \brief The filter named, written as the enumerator with - for _, as in coded-luminance.
+     *
+     * False if the name is not known.
+     */
+    inline bool color_filter_from_name(const std::string &name, color_filter &filter)
+    {
+        static const char *const names[] = {
+                "red", "blue-as-green", "luminance", "coded-luminance", "luminance-blue-green", "average-gray",
+                "red-gray", "negative", "sepia", "saturation", "contrast", "brightness", "gamma",
+        };
+        for (auto i = 0; i < static_cast<int>(std::size(names)); ++i) {
+            if (name == names[i]) {
+                filter = static_cast<color_filter>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * \brief The filter named and its amount, written name:amount, as in saturation:0.5, or only the name
+     * for the default amount, 1, or 0 for brightness.
+     *
+     * False if the name is not known.
+     */
+    inline bool color_filter_from_name(const std::string &text, color_filter &filter, float &amount)
+    {
+        auto colon = text.find(':');
+        if (!color_filter_from_name(text.substr(0, colon), filter)) {
+            return false;
+        }
+        amount = filter == color_filter::brightness ? 0.0f : 1.0f;
+        if (colon != std::string::npos) {
+            amount = static_cast<float>(std::atof(text.c_str() + colon + 1));
+        }
+        return true;
+    }
+
+    /**
+     * \brief The color `c` after `filter` with `amount`, as `color_filter_glsl` works it out.
+     */
+    inline glm::vec3 apply_color_filter(color_filter filter, float amount, glm::vec3 c)
+    {
+        auto g = 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;
+        switch (filter) {
+            case color_filter::red:
+                return {c.r, 0.0f, 0.0f};
+            case color_filter::blue_as_green:
+                return {0.0f, c.b, 0.0f};
+            case color_filter::luminance:
+                return glm::vec3(g);
+            case color_filter::coded_luminance:
+                return g < 0.3f ? glm::vec3(0, 0, 1) : g < 0.6f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+            case color_filter::luminance_blue_green:
+                return glm::mix(glm::vec3(0, 0, 1), glm::vec3(0, 1, 0), g);
+            case color_filter::average_gray:
+                return glm::vec3((c.r + c.g + c.b) / 3.0f);
+            case color_filter::red_gray:
+                return glm::vec3(c.r);
+            case color_filter::negative:
+                return glm::vec3(1.0f) - c;
+            case color_filter::sepia: {
+                auto tone = glm::vec3(0.393f * c.r + 0.769f * c.g + 0.189f * c.b,
+                                      0.349f * c.r + 0.686f * c.g + 0.168f * c.b,
+                                      0.272f * c.r + 0.534f * c.g + 0.131f * c.b);
+                return glm::mix(c, tone, amount);
+            }
+            case color_filter::saturation:
+                return glm::mix(glm::vec3(g), c, amount);
+            case color_filter::contrast:
+                return (c - 0.5f) * amount + 0.5f;
+            case color_filter::brightness:
+                return c + amount;
+            case color_filter::gamma:
+                return glm::pow(glm::max(c, glm::vec3(0.0f)), glm::vec3(1.0f / amount));
+        }
+        return c;
+    }
+
+    /**
+     * \brief GLSL for `vec3 apply_color_filter(int number, float amount, vec3 c)`, the same as the C++
+     * function, with `number` that of a `color_filter`, since filter is a reserved word in GLSL.
+     *
+     * Goes after the `#version` line of a shader, or in a source of its own given after one that declares
+     * the function.
+     */
+    inline const char *const color_filter_glsl =
+            "vec3 apply_color_filter(int number, float amount, vec3 c)\n"
+            "{\n"
+            "    float g = 0.2126 * c.r + 0.7152 * c.g + 0.0722 * c.b;\n"
+            "    switch (number) {\n"
+            "        case 0:     // red\n"
+            "            return vec3(c.r, 0.0, 0.0);\n"
+            "        case 1:     // blue as green\n"
+            "            return vec3(0.0, c.b, 0.0);\n"
+            "        case 2:     // luminance\n"
+            "            return vec3(g);\n"
+            "        case 3:     // coded luminance\n"
+            "            return g < 0.3 ? vec3(0, 0, 1) : g < 0.6 ? vec3(1, 0, 0) : vec3(0, 1, 0);\n"
+            "        case 4:     // luminance blue green\n"
+            "            return mix(vec3(0, 0, 1), vec3(0, 1, 0), g);\n"
+            "        case 5:     // average gray\n"
+            "            return vec3((c.r + c.g + c.b) / 3.0);\n"
+            "        case 6:     // red gray\n"
+            "            return vec3(c.r);\n"
+            "        case 7:     // negative\n"
+            "            return 1.0 - c;\n"
+            "        case 8:     // sepia\n"
+            "            return mix(c, vec3(dot(c, vec3(0.393, 0.769, 0.189)),\n"
+            "                               dot(c, vec3(0.349, 0.686, 0.168)),\n"
+            "                               dot(c, vec3(0.272, 0.534, 0.131))), amount);\n"
+            "        case 9:     // saturation\n"
+            "            return mix(vec3(g), c, amount);\n"
+            "        case 10:    // contrast\n"
+            "            return (c - 0.5) * amount + 0.5;\n"
+            "        case 11:    // brightness\n"
+            "            return c + amount;\n"
+            "        case 12:    // gamma\n"
+            "            return pow(max(c, vec3(0.0)), vec3(1.0 / amount));\n"
+            "    }\n"
+            "    return c;\n"
+            "}\n";
+
+}
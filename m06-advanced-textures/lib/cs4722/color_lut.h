@@ -0,0 +1,220 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glad/gl.h>
+#include <GLM/glm.hpp>
+
+#include "cs4722/color_filter.h"
+#include "cs4722/parallel_for.h"
+
+/**
+ * \file
+ *
+ * Color grading with a 3D texture that holds the result of a chain of color functions for every color.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief One filter of a `color_lut` and its amount, which is not used by the filters of 05A.
+     */
+    struct color_step {
+        color_filter filter;
+        float amount = 1.0f;
+    };
+
+    /**
+     * \brief A chain of color filters, any number of them, applied to every color of a size^3 grid
+     * and kept in a 3D texture.
+     *
+     * Applying the chain in a fragment shader costs a branch and the function for each step.
+     * Since every step only depends on the color it is given, the whole chain is a function from colors to
+     * colors, which the texture holds at size^3 colors evenly spread from black to white.
+     * A fragment shader then applies the whole chain with one fetch, filtered linearly between the eight
+     * nearest colors of the grid, whatever the length of the chain.
+     * Functions that jump from one color to another, such as `coded_luminance`, are blurred across a
+     * grid cell at the jump, so the grid should be 64 for them; 32 is plenty for smooth ones.
+     *
+     * The result of each step for each color of the grid is kept, so when the amount of a step changes
+     * `update` starts from the results of the step before it.
+     * Changing the last step of a long chain only works out that step again.
+     * The grid is split into slices of one blue value that the threads claim in turn, as the bands
+     * of `separable_filter`.
+     *
+     * The texture is `GL_RGBA16F` so the colors of the grid are not rounded to 8 bits before being
+     * filtered; it is made by `upload`, which needs a current OpenGL context, and deleted with the `color_lut`.
+     */
+    class color_lut {
+    public:
+
+        /**
+         * @param size  Colors along each side of the grid, 32 or 64 usually
+         * @param number_of_threads  0 for one per hardware thread
+         */
+        explicit color_lut(int size = 32, int number_of_threads = 0)
+                : size(size), number_of_threads(number_of_threads)
+        {}
+
+        color_lut(const color_lut &) = delete;
+        color_lut &operator=(const color_lut &) = delete;
+
+        ~color_lut()
+        {
+            if (texture) glDeleteTextures(1, &texture);
+        }
+
+        void add(color_filter filter, float amount = 1.0f)
+        {
+            chain.push_back({filter, amount});
+            results.emplace_back();
+            first_changed = std::min(first_changed, static_cast<int>(chain.size()) - 1);
+        }
+
+        void set_amount(int step, float amount)
+        {
+            chain[step].amount = amount;
+            first_changed = std::min(first_changed, step);
+        }
+
+        const std::vector<color_step> &steps() const
+        {
+            return chain;
+        }
+
+        /**
+         * \brief Work out again the steps from the first one changed since the last update.
+         *
+         * @return  Number of steps worked out, 0 if nothing changed
+         */
+        int update()
+        {
+            auto count = static_cast<int>(chain.size());
+            auto first = std::min(first_changed, count);
+            if (first == count && !grid.empty()) {
+                return 0;
+            }
+            auto entries = static_cast<size_t>(size) * size * size;
+            if (grid.size() != 3 * entries) {
+                make_grid();
+                first = 0;
+            }
+            for (auto s = first; s < count; ++s) {
+                results[s].resize(3 * entries);
+            }
+
+            auto slice_entries = static_cast<size_t>(size) * size;
+            parallel_for(size, number_of_threads, [&](int slice) {
+                auto begin = slice_entries * slice;
+                for (auto s = first; s < count; ++s) {
+                    const auto *in = (s == 0 ? grid : results[s - 1]).data();
+                    auto *out = results[s].data();
+                    for (auto e = begin; e < begin + slice_entries; ++e) {
+                        auto c = apply_color_filter(chain[s].filter, chain[s].amount,
+                                                    glm::vec3(in[3 * e], in[3 * e + 1], in[3 * e + 2]));
+                        out[3 * e] = c.r;
+                        out[3 * e + 1] = c.g;
+                        out[3 * e + 2] = c.b;
+                    }
+                }
+            });
+
+            first_changed = count;
+            changed_since_upload = true;
+            return count - first;
+        }
+
+        /**
+         * \brief Update if needed and copy the colors into the texture on `texture_unit`, making the
+         * texture the first time.
+         *
+         * @return  The texture
+         */
+        GLuint upload(GLuint texture_unit)
+        {
+            update();
+            if (!texture) {
+                glCreateTextures(GL_TEXTURE_3D, 1, &texture);
+                glTextureStorage3D(texture, 1, GL_RGBA16F, size, size, size);
+                glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                glTextureParameteri(texture, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+                changed_since_upload = true;
+            }
+            if (changed_since_upload) {
+                const auto &last = chain.empty() ? grid : results.back();
+                glTextureSubImage3D(texture, 0, 0, 0, 0, size, size, size, GL_RGB, GL_FLOAT, last.data());
+                changed_since_upload = false;
+            }
+            glBindTextureUnit(texture_unit, texture);
+            return texture;
+        }
+
+        /**
+         * \brief The color the chain gives `c`, worked out step by step.
+         */
+        glm::vec3 exact(glm::vec3 c) const
+        {
+            for (auto &step: chain) {
+                c = apply_color_filter(step.filter, step.amount, c);
+            }
+            return c;
+        }
+
+        /**
+         * \brief The color the texture gives `c`, filtered between the colors of the grid as the GPU does it.
+         *
+         * Call after `update`.
+         */
+        glm::vec3 lookup(glm::vec3 c) const
+        {
+            const auto &last = chain.empty() ? grid : results.back();
+            // texture coordinates of c put the centers of the first and last texels at 0 and 1
+            auto position = glm::clamp(c, 0.0f, 1.0f) * static_cast<float>(size - 1);
+            auto low = glm::min(glm::ivec3(position), glm::ivec3(size - 2));
+            auto f = position - glm::vec3(low);
+            auto result = glm::vec3(0.0f);
+            for (auto corner = 0; corner < 8; ++corner) {
+                auto offset = glm::ivec3(corner & 1, (corner >> 1) & 1, corner >> 2);
+                auto at = low + offset;
+                auto weight = (offset.x ? f.x : 1 - f.x) * (offset.y ? f.y : 1 - f.y) * (offset.z ? f.z : 1 - f.z);
+                const auto *texel = &last[3 * ((static_cast<size_t>(at.z) * size + at.y) * size + at.x)];
+                result += weight * glm::vec3(texel[0], texel[1], texel[2]);
+            }
+            return result;
+        }
+
+        const int size;
+        int number_of_threads;
+
+    private:
+
+        void make_grid()
+        {
+            grid.resize(3ull * size * size * size);
+            auto *out = grid.data();
+            for (auto b = 0; b < size; ++b) {
+                for (auto g = 0; g < size; ++g) {
+                    for (auto r = 0; r < size; ++r) {
+                        *out++ = static_cast<float>(r) / static_cast<float>(size - 1);
+                        *out++ = static_cast<float>(g) / static_cast<float>(size - 1);
+                        *out++ = static_cast<float>(b) / static_cast<float>(size - 1);
+                    }
+                }
+            }
+        }
+
+        std::vector<color_step> chain;
+        // the colors of the grid, then the colors after each step, three floats for each color
+        std::vector<float> grid;
+        std::vector<std::vector<float>> results;
+        int first_changed = 0;
+        bool changed_since_upload = false;
+        GLuint texture = 0;
+    };
+
+}
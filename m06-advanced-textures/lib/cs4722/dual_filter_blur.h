@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glad/gl.h>
+
+/**
+ * \file
+ *
+ * Blurring with a pyramid of images, each half the size of the one before, for radii of hundreds of texels.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief The dual filter blur, Marius Bjørge's variant of the Kawase blur: the image is filtered
+     * down a chain of images each half the size of the last, then back up the chain.
+     *
+     * Each step down takes five bilinear samples of the larger image: one between the four texels under
+     * the smaller texel and four at its corners, moved out by `offset`.
+     * Each step up takes eight samples of the smaller image around the larger texel.
+     * A step covers a few texels of the image it reads, but the texels of level k are 2^k texels of the
+     * original, so the spread of the blur doubles with each level.
+     * The cost does not grow with it: the steps at level k draw a quarter of the texels of those at k - 1,
+     * so all the levels take less than twice the time of the first step down and the last step up.
+     *
+     * The levels, and the offset within a level, are chosen by `for_radius` so the blur spreads the
+     * colors as much as the average over a square of radius texels does, the loop of
+     * image_processing_fragment_shader.glsl with lim = radius.
+     * Both are compared by their standard deviation, which for the square is sqrt(r (r + 1) / 3).
+     *
+     * Level k is max(1, width >> k) by max(1, height >> k), the sizes of the mip levels of the image,
+     * and samples are taken as a `GL_LINEAR` sampler with `GL_CLAMP_TO_EDGE` takes them.
+     * `apply` does the same steps on the CPU in floats, as a reference for the shader that does them,
+     * dual_filter_fragment_shader.glsl in 05B-image-processing, whose levels are half floats.
+     */
+    class dual_filter_blur {
+    public:
+
+        dual_filter_blur(int levels = 0, float offset = 1.0f)
+                : levels(levels), offset(offset)
+        {}
+
+        /**
+         * \brief The blur that spreads colors as much as averaging a square of the given radius.
+         *
+         * Uses the fewest levels that reach that spread with an offset of at most `max_offset`,
+         * up to `max_levels`, where the offset is as large as it may be.
+         * A radius of 0 gives no blur.
+         */
+        static dual_filter_blur for_radius(float radius, int max_levels = 8)
+        {
+            if (radius <= 0.0f || max_levels <= 0) {
+                return dual_filter_blur(0);
+            }
+            auto target = box_sigma(radius);
+            auto levels = 1;
+            while (levels < max_levels && sigma(levels, max_offset) < target) {
+                ++levels;
+            }
+            // the spread grows with the offset, closely enough to bisect on it
+            auto low = 0.0f, high = max_offset;
+            for (auto step = 0; step < 24; ++step) {
+                auto middle = (low + high) / 2.0f;
+                (sigma(levels, middle) < target ? low : high) = middle;
+            }
+            return dual_filter_blur(levels, (low + high) / 2.0f);
+        }
+
+        /**
+         * \brief Number of levels below the full size image, down to a level of at least 2 by 2.
+         */
+        static int max_levels(int width, int height)
+        {
+            auto levels = 0;
+            while ((std::min(width, height) >> (levels + 1)) >= 2) {
+                ++levels;
+            }
+            return levels;
+        }
+
+        /**
+         * \brief Standard deviation of the average over a square of the given radius, along x or y.
+         */
+        static double box_sigma(double radius)
+        {
+            return std::sqrt(radius * (radius + 1.0) / 3.0);
+        }
+
+        /**
+         * \brief Standard deviation, in texels of the full size image along x or y, of the spread of a
+         * single texel by the blur, averaged over where the texel falls among the texels of the smaller levels.
+         *
+         * The variances of the steps add, each that of its samples' offsets and of the bilinear filtering
+         * of each sample, in texels of the level read times 2^level.
+         * Texels of a smaller level sit between four of the larger, and texels of a larger level a quarter
+         * of a texel from one of the smaller, which fixes where the samples fall between texels.
+         */
+        static double sigma(int levels, double offset)
+        {
+            // variance of bilinear filtering at a fraction f of the way between texels
+            auto bilinear = [](double position) {
+                auto f = position - std::floor(position);
+                return f * (1.0 - f);
+            };
+            auto variance = 0.0;
+            for (auto k = 0; k < levels; ++k) {
+                auto texel = std::ldexp(1.0, k);
+                auto down = offset * offset / 8.0 + bilinear(0.5) / 2.0 + bilinear(0.5 + offset / 2.0) / 2.0;
+                variance += texel * texel * down;
+                auto up = offset * offset / 3.0
+                          + (2.0 * bilinear(0.25)
+                             + bilinear(0.25 + offset) + bilinear(0.25 - offset)
+                             + 4.0 * (bilinear(0.25 + offset / 2.0) + bilinear(0.25 - offset / 2.0))) / 12.0;
+                variance += 4.0 * texel * texel * up;
+            }
+            return std::sqrt(variance);
+        }
+
+        double sigma() const
+        {
+            return sigma(levels, offset);
+        }
+
+        /**
+         * \brief Blur `width` by `height` RGBA8 texels into `result` on the CPU, which may be the same as `rgba`.
+         *
+         * Fewer levels are used if the image is too small for all of them.
+         */
+        void apply(const GLubyte *rgba, GLubyte *result, int width, int height) const
+        {
+            auto count = std::min(levels, max_levels(width, height));
+            auto chain = std::vector<image>(count + 1);
+            chain[0] = {width, height, std::vector<float>(rgba, rgba + 4ull * width * height)};
+            for (auto k = 1; k <= count; ++k) {
+                chain[k] = step(chain[k - 1], std::max(1, width >> k), std::max(1, height >> k), false);
+            }
+            for (auto k = count; k >= 1; --k) {
+                chain[k - 1] = step(chain[k], chain[k - 1].width, chain[k - 1].height, true);
+            }
+            auto &out = chain[0].texels;
+            for (size_t i = 0; i < out.size(); ++i) {
+                result[i] = static_cast<GLubyte>(std::min(255.0f, std::max(0.0f, out[i] + 0.5f)));
+            }
+        }
+
+        /// Levels below the full size image, 0 for no blur
+        int levels;
+        /// How far the samples are moved out, in half texels of the level read
+        float offset;
+
+        /// The largest offset `for_radius` uses before adding a level
+        static constexpr float max_offset = 2.0f;
+
+    private:
+
+        struct image {
+            int width = 0;
+            int height = 0;
+            std::vector<float> texels;
+        };
+
+        /**
+         * A step down, or up, from `in` to an image of the given size.
+         */
+        image step(const image &in, int width, int height, bool up) const
+        {
+            auto out = image{width, height, std::vector<float>(4ull * width * height)};
+            // half a texel of the image read, moved out by the offset, in texture coordinates
+            auto dx = 0.5f / static_cast<float>(in.width) * offset;
+            auto dy = 0.5f / static_cast<float>(in.height) * offset;
+            for (auto y = 0; y < height; ++y) {
+                auto v = (static_cast<float>(y) + 0.5f) / static_cast<float>(height);
+                for (auto x = 0; x < width; ++x) {
+                    auto u = (static_cast<float>(x) + 0.5f) / static_cast<float>(width);
+                    float sum[4] = {0, 0, 0, 0};
+                    auto add = [&](float su, float sv, float weight) {
+                        sample(in, su, sv, weight, sum);
+                    };
+                    if (up) {
+                        add(u - 2 * dx, v, 1);
+                        add(u - dx, v + dy, 2);
+                        add(u, v + 2 * dy, 1);
+                        add(u + dx, v + dy, 2);
+                        add(u + 2 * dx, v, 1);
+                        add(u + dx, v - dy, 2);
+                        add(u, v - 2 * dy, 1);
+                        add(u - dx, v - dy, 2);
+                    } else {
+                        add(u, v, 4);
+                        add(u - dx, v - dy, 1);
+                        add(u + dx, v + dy, 1);
+                        add(u + dx, v - dy, 1);
+                        add(u - dx, v + dy, 1);
+                    }
+                    auto *texel = &out.texels[4 * (static_cast<size_t>(y) * width + x)];
+                    for (auto c = 0; c < 4; ++c) {
+                        texel[c] = sum[c] / (up ? 12.0f : 8.0f);
+                    }
+                }
+            }
+            return out;
+        }
+
+        /**
+         * Add the bilinear sample of `in` at texture coordinates (u, v), times weight, to sum.
+         */
+        static void sample(const image &in, float u, float v, float weight, float *sum)
+        {
+            auto x = u * static_cast<float>(in.width) - 0.5f;
+            auto y = v * static_cast<float>(in.height) - 0.5f;
+            auto x0 = std::floor(x), y0 = std::floor(y);
+            auto fx = x - x0, fy = y - y0;
+            auto column = [&](float i) { return std::clamp(static_cast<int>(i), 0, in.width - 1); };
+            auto row = [&](float j) { return std::clamp(static_cast<int>(j), 0, in.height - 1); };
+            const float *corners[4] = {
+                    &in.texels[4 * (static_cast<size_t>(row(y0)) * in.width + column(x0))],
+                    &in.texels[4 * (static_cast<size_t>(row(y0)) * in.width + column(x0 + 1))],
+                    &in.texels[4 * (static_cast<size_t>(row(y0 + 1)) * in.width + column(x0))],
+                    &in.texels[4 * (static_cast<size_t>(row(y0 + 1)) * in.width + column(x0 + 1))],
+            };
+            const float weights[4] = {(1 - fx) * (1 - fy), fx * (1 - fy), (1 - fx) * fy, fx * fy};
+            for (auto i = 0; i < 4; ++i) {
+                for (auto c = 0; c < 4; ++c) {
+                    sum[c] += weight * weights[i] * corners[i][c];
+                }
+            }
+        }
+    };
+
+}
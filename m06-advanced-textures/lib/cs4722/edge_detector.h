@@ -0,0 +1,365 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "cs4722/parallel_for.h"
+#include "cs4722/separable_filter.h"
+
+/**
+ * \file
+ *
+ * Finding the edges in RGBA8 images on the CPU with the Canny edge detector.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief What `edge_detector::detect` did.
+     */
+    struct edge_statistics {
+        int tiles = 0;
+        /// Times the edges were followed across the borders of the tiles, after following them within each
+        int hysteresis_rounds = 0;
+        size_t edge_texels = 0;
+    };
+
+    /**
+     * \brief The Canny edge detector: edges one texel wide where the luminance changes fastest.
+     *
+     * The raw Sobel derivative of image_processing_fragment_shader.glsl is large wherever the image is noisy
+     * and is several texels wide along each edge.
+     * This detector
+     *      - smooths the luminance with a Gaussian of `smoothing_radius`, the weights of
+     *          `separable_filter::gaussian`, one direction at a time
+     *      - takes the Sobel derivative, its magnitude, and its direction rounded to a multiple of 45 degrees
+     *      - keeps only texels whose magnitude is the largest of their neighbors across the edge,
+     *          that is in the direction of the derivative, which thins the edges to one texel
+     *      - keeps those over `high` and those over `low` that are joined to them by a chain of texels
+     *          over `low`, so edges fade out less in the middle while noise stays out
+     *
+     * The luminance is 0 to 1 and the derivative is scaled so a step from black to white has magnitude 1,
+     * so the thresholds are fractions of that step.
+     * Beyond the edges of the image every stage sees copies of the nearest edge texel, as with
+     * `GL_CLAMP_TO_EDGE`, so the result is the same as the shaders in 05B-image-processing give.
+     *
+     * The image is cut into tiles of `tile_size` squared texels, which the threads claim in turn.
+     * A tile is worked on together with a halo of the texels around it that its stages read, the smoothing
+     * radius plus one for the derivative and one for the comparison with neighbors, so every tile has
+     * what it needs without waiting for others, in buffers small enough for the L2 cache.
+     * The stages loop along rows of floats with no dependencies between iterations, and choose between
+     * neighbors with conditional expressions and arithmetic rather than branches, so the compiler
+     * vectorizes them.
+     *
+     * Following edges from strong texels to weak ones is done first within each tile.
+     * Then, in rounds, each tile takes the texels just outside it from a copy made at the start of the
+     * round, and follows edges entering it from its neighbors, until a round finds no new edges.
+     */
+    class edge_detector {
+    public:
+
+        /**
+         * @param low  Magnitude a texel must have to be on an edge that reaches a strong texel
+         * @param high  Magnitude of a strong texel
+         * @param smoothing_radius  Radius of the Gaussian applied first, 0 for none
+         * @param number_of_threads  0 for one per hardware thread
+         */
+        explicit edge_detector(float low = 0.1f, float high = 0.25f, int smoothing_radius = 2,
+                               int number_of_threads = 0)
+                : low(low), high(high), smoothing_radius(smoothing_radius), number_of_threads(number_of_threads)
+        {}
+
+        /**
+         * \brief Find the edges of `width` by `height` RGBA8 texels.
+         *
+         * @param edges  `width * height` bytes, 255 on an edge and 0 elsewhere
+         */
+        edge_statistics detect(const GLubyte *rgba, GLubyte *edges, int width, int height) const
+        {
+            auto weights = smoothing_weights();
+            auto columns = (width + tile_size - 1) / tile_size;
+            auto rows = (height + tile_size - 1) / tile_size;
+            auto statistics = edge_statistics();
+            statistics.tiles = columns * rows;
+
+            // 0, 1 for weak and 2 for strong
+            for_each_tile(width, height, [&](int x0, int y0, int x1, int y1, tile_buffers &buffers) {
+                classify_tile(rgba, edges, width, height, weights, x0, y0, x1, y1, buffers);
+            });
+
+            // edges within each tile, from its strong texels
+            for_each_tile(width, height, [&](int x0, int y0, int x1, int y1, tile_buffers &buffers) {
+                for (auto y = y0; y < y1; ++y) {
+                    for (auto x = x0; x < x1; ++x) {
+                        if (edges[static_cast<size_t>(y) * width + x] == strong) {
+                            follow(edges, width, x, y, x0, y0, x1, y1, buffers.stack);
+                        }
+                    }
+                }
+            });
+
+            // edges across the borders of the tiles, until none are found
+            auto before = std::vector<GLubyte>();
+            for (auto found = statistics.tiles > 1; found;) {
+                ++statistics.hysteresis_rounds;
+                before.assign(edges, edges + static_cast<size_t>(width) * height);
+                std::atomic<bool> any(false);
+                for_each_tile(width, height, [&](int x0, int y0, int x1, int y1, tile_buffers &buffers) {
+                    auto entering = [&](int x, int y) {
+                        for (auto dy = -1; dy <= 1; ++dy) {
+                            for (auto dx = -1; dx <= 1; ++dx) {
+                                auto nx = x + dx, ny = y + dy;
+                                auto outside = nx < x0 || nx >= x1 || ny < y0 || ny >= y1;
+                                if (outside && nx >= 0 && nx < width && ny >= 0 && ny < height
+                                    && before[static_cast<size_t>(ny) * width + nx] == edge) {
+                                    return true;
+                                }
+                            }
+                        }
+                        return false;
+                    };
+                    auto visit = [&](int x, int y) {
+                        if (edges[static_cast<size_t>(y) * width + x] == weak && entering(x, y)) {
+                            follow(edges, width, x, y, x0, y0, x1, y1, buffers.stack);
+                            any = true;
+                        }
+                    };
+                    for (auto x = x0; x < x1; ++x) {
+                        visit(x, y0);
+                        visit(x, y1 - 1);
+                    }
+                    for (auto y = y0 + 1; y < y1 - 1; ++y) {
+                        visit(x0, y);
+                        visit(x1 - 1, y);
+                    }
+                });
+                found = any;
+            }
+
+            // weak texels not joined to a strong one are not edges
+            auto count = size_t(0);
+            for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i) {
+                edges[i] = edges[i] == edge ? edge : 0;
+                count += edges[i] == edge;
+            }
+            statistics.edge_texels = count;
+            return statistics;
+        }
+
+        /**
+         * \brief Weights of the Gaussian smoothing, from -smoothing_radius to smoothing_radius.
+         */
+        std::vector<float> smoothing_weights() const
+        {
+            return smoothing_radius > 0 ? separable_filter::gaussian(smoothing_radius).weights
+                                        : std::vector<float>{1.0f};
+        }
+
+        float low;
+        float high;
+        int smoothing_radius;
+        int number_of_threads;
+        int tile_size = 128;
+
+    private:
+
+        static constexpr GLubyte weak = 1;
+        static constexpr GLubyte strong = 2;
+        static constexpr GLubyte edge = 255;
+
+        /**
+         * The buffers of a tile and its halo, kept by each thread from one tile to the next.
+         */
+        struct tile_buffers {
+            std::vector<float> luminance, rows, smooth, magnitude;
+            std::vector<GLubyte> sector;
+            std::vector<int> stack;
+        };
+
+        template<typename F>
+        void for_each_tile(int width, int height, F work) const
+        {
+            auto columns = (width + tile_size - 1) / tile_size;
+            auto tiles = columns * ((height + tile_size - 1) / tile_size);
+            auto make_buffers = [] { return tile_buffers(); };
+            parallel_for(tiles, number_of_threads, make_buffers, [&](int tile, tile_buffers &buffers) {
+                auto x0 = tile % columns * tile_size;
+                auto y0 = tile / columns * tile_size;
+                work(x0, y0, std::min(width, x0 + tile_size), std::min(height, y0 + tile_size), buffers);
+            });
+        }
+
+        /**
+         * Smooth, differentiate and thin the tile from (x0, y0) to (x1, y1), writing 0, weak or strong
+         * for each of its texels into `classes`.
+         */
+        void classify_tile(const GLubyte *rgba, GLubyte *classes, int width, int height,
+                           const std::vector<float> &weights, int x0, int y0, int x1, int y1,
+                           tile_buffers &b) const
+        {
+            auto r = smoothing_radius > 0 ? smoothing_radius : 0;
+            auto halo = r + 2;
+            // the region read, the tile and its halo, and where texel (x, y) of the image is in it
+            auto left = x0 - halo, top = y0 - halo;
+            auto region_width = x1 - x0 + 2 * halo;
+            auto region_height = y1 - y0 + 2 * halo;
+            auto size = static_cast<size_t>(region_width) * region_height;
+            b.luminance.resize(size);
+            b.rows.resize(size);
+            b.smooth.resize(size);
+            b.magnitude.resize(size);
+            b.sector.resize(size);
+            auto at = [&](int x, int y) {
+                return static_cast<size_t>(y - top) * region_width + (x - left);
+            };
+
+            for (auto y = top; y < top + region_height; ++y) {
+                const auto *row = rgba + 4ull * width * std::clamp(y, 0, height - 1);
+                auto *out = &b.luminance[at(left, y)];
+                for (auto i = 0; i < region_width; ++i) {
+                    const auto *texel = row + 4 * std::clamp(left + i, 0, width - 1);
+                    out[i] = (0.2126f * texel[0] + 0.7152f * texel[1] + 0.0722f * texel[2]) / 255.0f;
+                }
+            }
+
+            // the smoothed luminance covers the tile and two texels around it
+            for (auto y = top; y < top + region_height; ++y) {
+                smooth_along(&b.luminance[at(left, y)], &b.rows[at(left, y)], weights, r, 1, r,
+                             region_width - r);
+            }
+            for (auto y = top + r; y < top + region_height - r; ++y) {
+                smooth_along(&b.rows[at(left, y)], &b.smooth[at(left, y)], weights, r, region_width, r,
+                             region_width - r);
+            }
+            clamp_outside(b.smooth, at, x0 - 2, y0 - 2, x1 + 2, y1 + 2, width, height);
+
+            // the derivative covers the tile and one texel around it
+            for (auto y = y0 - 1; y < y1 + 1; ++y) {
+                gradient_row(&b.smooth[at(x0 - 1, y)], region_width, x1 - x0 + 2,
+                             &b.magnitude[at(x0 - 1, y)], &b.sector[at(x0 - 1, y)]);
+            }
+            clamp_outside(b.magnitude, at, x0 - 1, y0 - 1, x1 + 1, y1 + 1, width, height);
+
+            for (auto y = y0; y < y1; ++y) {
+                suppress_row(&b.magnitude[at(x0, y)], &b.sector[at(x0, y)], region_width, x1 - x0,
+                             classes + static_cast<size_t>(y) * width + x0);
+            }
+        }
+
+        /**
+         * Weighted sums of the taps `step` apart around each of in[start] to in[end - 1], into out.
+         */
+        static void smooth_along(const float *in, float *out, const std::vector<float> &weights, int radius,
+                                 int step, int start, int end)
+        {
+            for (auto i = start; i < end; ++i) {
+                out[i] = 0.0f;
+            }
+            for (auto k = -radius; k <= radius; ++k) {
+                auto weight = weights[k + radius];
+                const auto *tap = in + k * step;
+                for (auto i = start; i < end; ++i) {
+                    out[i] += weight * tap[i];
+                }
+            }
+        }
+
+        /**
+         * Give the texels of the area from (x0, y0) to (x1, y1) that are outside the image the values of the
+         * nearest texels inside it.
+         */
+        template<typename A>
+        static void clamp_outside(std::vector<float> &values, A at, int x0, int y0, int x1, int y1,
+                                  int width, int height)
+        {
+            for (auto y = y0; y < y1; ++y) {
+                auto inside_row = y >= 0 && y < height;
+                for (auto x = x0; x < x1; ++x) {
+                    if (!inside_row || x < 0 || x >= width) {
+                        values[at(x, y)] = values[at(std::clamp(x, 0, width - 1), std::clamp(y, 0, height - 1))];
+                    }
+                }
+            }
+        }
+
+        /**
+         * The Sobel derivative of `count` texels from `smooth`, a row of a region `stride` wide,
+         * into its magnitude and its direction:
+         * 0 along x, 2 along y, 1 along the diagonal where x and y grow together, and 3 along the other.
+         */
+        static void gradient_row(const float *smooth, int stride, int count, float *magnitude, GLubyte *sector)
+        {
+            // tan(22.5 degrees) and tan(67.5 degrees)
+            const auto tan_22 = 0.41421356f, tan_67 = 2.41421356f;
+            const auto *above = smooth - stride;
+            const auto *below = smooth + stride;
+            for (auto i = 0; i < count; ++i) {
+                auto gx = (above[i + 1] + 2.0f * smooth[i + 1] + below[i + 1]
+                           - above[i - 1] - 2.0f * smooth[i - 1] - below[i - 1]) / 4.0f;
+                auto gy = (below[i - 1] + 2.0f * below[i] + below[i + 1]
+                           - above[i - 1] - 2.0f * above[i] - above[i + 1]) / 4.0f;
+                magnitude[i] = std::sqrt(gx * gx + gy * gy);
+                auto ax = std::fabs(gx), ay = std::fabs(gy);
+                // worked out with arithmetic rather than branches
+                auto along_y = static_cast<int>(ay >= tan_67 * ax);
+                auto diagonal = static_cast<int>(ay > tan_22 * ax) & (1 - along_y);
+                auto rising = static_cast<int>(gx * gy > 0.0f);
+                sector[i] = static_cast<GLubyte>(2 * along_y + diagonal * (3 - 2 * rising));
+            }
+        }
+
+        /**
+         * Classify `count` texels of a row: kept if no smaller than the neighbor behind them in the
+         * direction of the derivative and larger than the one ahead, then weak or strong by magnitude.
+         */
+        void suppress_row(const float *magnitude, const GLubyte *sector, int stride, int count,
+                          GLubyte *classes) const
+        {
+            const auto *above = magnitude - stride;
+            const auto *below = magnitude + stride;
+            for (auto i = 0; i < count; ++i) {
+                // all the neighbors are loaded and then chosen between, so the choice needs no branches
+                auto left = magnitude[i - 1], right = magnitude[i + 1];
+                auto up = above[i], up_left = above[i - 1], up_right = above[i + 1];
+                auto down = below[i], down_left = below[i - 1], down_right = below[i + 1];
+                auto s = sector[i];
+                auto behind = s == 0 ? left : s == 2 ? up : s == 1 ? up_left : up_right;
+                auto ahead = s == 0 ? right : s == 2 ? down : s == 1 ? down_right : down_left;
+                auto m = magnitude[i];
+                auto kept = static_cast<int>(m >= behind) & static_cast<int>(m > ahead);
+                // weak is 1 and strong 2
+                classes[i] = static_cast<GLubyte>(kept * (static_cast<int>(m >= low) + static_cast<int>(m >= high)));
+            }
+        }
+
+        /**
+         * Mark the texel at (x, y) and every weak or strong texel joined to it within the tile as edges.
+         */
+        static void follow(GLubyte *edges, int width, int x, int y, int x0, int y0, int x1, int y1,
+                           std::vector<int> &stack)
+        {
+            edges[static_cast<size_t>(y) * width + x] = edge;
+            stack.assign(1, y * width + x);
+            while (!stack.empty()) {
+                auto index = stack.back();
+                stack.pop_back();
+                auto cx = index % width, cy = index / width;
+                for (auto ny = std::max(y0, cy - 1); ny <= std::min(y1 - 1, cy + 1); ++ny) {
+                    for (auto nx = std::max(x0, cx - 1); nx <= std::min(x1 - 1, cx + 1); ++nx) {
+                        auto &value = edges[static_cast<size_t>(ny) * width + nx];
+                        if (value == weak || value == strong) {
+                            value = edge;
+                            stack.push_back(ny * width + nx);
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+}
@@ -0,0 +1,665 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "cs4722/color_filter.h"
+#include "cs4722/separable_filter.h"
+
+/**
+ * \file
+ *
+ * Chaining image filters, such as those of 05A-pixel-filters and 05B-image-processing, without writing
+ * the shaders that run them by hand.
+ */
+
+namespace cs4722 {
+
+    enum class tone_map_operator {
+        /// c / (1 + c)
+        reinhard,
+        /// the curve fitted to the ACES filmic tone mapping by Krzysztof Narkowicz
+        aces
+    };
+
+    /**
+     * \brief A graph of post processing filters, each a node, run on a texture once a frame.
+     *
+     * Nodes are made by the functions named for them, each taking the node or nodes it filters,
+     * starting from `source()`, the texture given to `run`.
+     * A node can be the input of any number of later nodes, so results can be combined with `mix`,
+     * for instance to add a blurred copy of an image to it.
+     * `output` chooses the node drawn to the framebuffer that is bound when `run` is called.
+     *
+     * `compile` turns the graph into passes, each drawing a triangle that covers its target with a shader
+     * generated for it.
+     * A pass starts with a node that samples its inputs: a blur direction, Sobel, mix, or a plain fetch.
+     * Color filters and tone mapping only look at the texel they are given, so a run of them is fused
+     * into the pass before it, as a function applied to each fragment's color, unless the value before
+     * one of them is also used by another node.
+     * A Gaussian or box blur is two passes, along the rows and then down the columns, with the weights
+     * of a `separable_filter`.
+     *
+     * The results passed between passes go in `GL_RGBA16F` textures, so tone mapping sees values over 1.
+     * The textures come from a pool: a pass takes a texture of the size it needs that no later pass will
+     * read again, and only if there is none is a new one made.
+     * `report` tells the number of passes, the textures made, and the memory they take beside the memory
+     * one texture per pass would take.
+     *
+     * Needs a current OpenGL context for `compile` and `run`.
+     */
+    class postfx_graph {
+    public:
+
+        using node = int;
+
+        postfx_graph()
+        {
+            nodes.push_back({kind::source});
+        }
+
+        postfx_graph(const postfx_graph &) = delete;
+        postfx_graph &operator=(const postfx_graph &) = delete;
+
+        ~postfx_graph()
+        {
+            release_targets();
+            for (auto &p: passes) {
+                if (p.program) glDeleteProgram(p.program);
+            }
+            if (vao) glDeleteVertexArrays(1, &vao);
+        }
+
+        /**
+         * \brief The texture given to `run`.
+         */
+        node source() const
+        {
+            return 0;
+        }
+
+        /**
+         * \brief `input` blurred with `filter`, a Gaussian or box filter of radius up to 64.
+         */
+        node blur(node input, const separable_filter &filter)
+        {
+            auto along_rows = add({kind::blur_rows, {input}});
+            nodes[along_rows].weights = filter.weights;
+            auto along_columns = add({kind::blur_columns, {along_rows}});
+            nodes[along_columns].weights = filter.weights;
+            return along_columns;
+        }
+
+        /**
+         * \brief How fast the color of `input` changes at each texel, as gray, the Sobel derivative of
+         * image_processing_fragment_shader.glsl.
+         */
+        node sobel(node input)
+        {
+            return add({kind::sobel, {input}});
+        }
+
+        /**
+         * \brief `input` through `filter`, with `amount` for the filters that take one.
+         */
+        node color(node input, color_filter filter, float amount = 1.0f)
+        {
+            auto n = add({kind::color, {input}});
+            nodes[n].filter = filter;
+            nodes[n].values[0] = amount;
+            return n;
+        }
+
+        /**
+         * \brief Map the colors of `input`, after multiplying them by `exposure`, into [0, 1].
+         */
+        node tone_map(node input, float exposure = 1.0f, tone_map_operator op = tone_map_operator::reinhard)
+        {
+            auto n = add({kind::tone_map, {input}});
+            nodes[n].op = op;
+            nodes[n].values[0] = exposure;
+            return n;
+        }
+
+        /**
+         * \brief `weight_a` times `a` plus `weight_b` times `b`.
+         */
+        node mix(node a, node b, float weight_a, float weight_b)
+        {
+            auto n = add({kind::mix, {a, b}});
+            nodes[n].values[0] = weight_a;
+            nodes[n].values[1] = weight_b;
+            return n;
+        }
+
+        void output(node n)
+        {
+            result = n;
+            compiled = false;
+        }
+
+        /**
+         * \brief Change the amount of a color node, the exposure of a tone map node or the weights of a mix node,
+         * which takes effect at the next `run` without compiling again.
+         */
+        void set_values(node n, float first, float second = 0.0f)
+        {
+            nodes[n].values[0] = first;
+            nodes[n].values[1] = second;
+        }
+
+        /**
+         * \brief Plan the passes and compile their shaders.
+         *
+         * Called by `run` if the graph has changed since it was last compiled.
+         */
+        void compile()
+        {
+            release_targets();
+            for (auto &p: passes) {
+                if (p.program) glDeleteProgram(p.program);
+            }
+            passes.clear();
+            plan_passes();
+            for (auto &p: passes) {
+                p.program = compile_program(fragment_source(p));
+                p.input_locations[0] = glGetUniformLocation(p.program, "input0");
+                p.input_locations[1] = glGetUniformLocation(p.program, "input1");
+                p.viewport_location = glGetUniformLocation(p.program, "viewport");
+                for (auto n: p.nodes) {
+                    auto name = "n" + std::to_string(n) + "_";
+                    nodes[n].locations[0] = glGetUniformLocation(p.program, (name + "values").c_str());
+                    nodes[n].locations[1] = glGetUniformLocation(p.program, (name + "weights").c_str());
+                }
+            }
+            if (!vao) {
+                glCreateVertexArrays(1, &vao);
+            }
+            compiled = true;
+        }
+
+        /**
+         * \brief Run the passes on `source_texture`, `width` by `height`, drawing the output into the
+         * framebuffer and viewport that are current.
+         *
+         * The framebuffer, viewport, program and vertex array are as they were when this returns;
+         * depth testing and blending are off while the passes run.
+         */
+        void run(GLuint source_texture, int width, int height)
+        {
+            if (!compiled) {
+                compile();
+            }
+            if (width != target_width || height != target_height) {
+                allocate_targets(width, height);
+            }
+
+            GLint frame_buffer, viewport[4], program, vertex_array;
+            glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &frame_buffer);
+            glGetIntegerv(GL_VIEWPORT, viewport);
+            glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+            glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vertex_array);
+            auto depth_test = glIsEnabled(GL_DEPTH_TEST);
+            auto blend = glIsEnabled(GL_BLEND);
+            glDisable(GL_DEPTH_TEST);
+            glDisable(GL_BLEND);
+            glBindVertexArray(vao);
+
+            for (auto &p: passes) {
+                glUseProgram(p.program);
+                for (auto i = 0; i < static_cast<int>(p.inputs.size()); ++i) {
+                    auto from = p.inputs[i];
+                    auto texture = from == source() ? source_texture : targets[passes[pass_of[from]].target].texture;
+                    glBindTextureUnit(first_texture_unit + i, texture);
+                    glUniform1i(p.input_locations[i], first_texture_unit + i);
+                }
+                for (auto n: p.nodes) {
+                    auto &nd = nodes[n];
+                    if (nd.locations[0] >= 0) glUniform2fv(nd.locations[0], 1, nd.values);
+                    if (nd.locations[1] >= 0) {
+                        glUniform1fv(nd.locations[1], static_cast<GLsizei>(nd.weights.size()), nd.weights.data());
+                    }
+                }
+                if (p.target < 0) {
+                    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frame_buffer);
+                    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+                    glUniform4f(p.viewport_location, static_cast<GLfloat>(viewport[0]),
+                                static_cast<GLfloat>(viewport[1]), static_cast<GLfloat>(viewport[2]),
+                                static_cast<GLfloat>(viewport[3]));
+                } else {
+                    auto &t = targets[p.target];
+                    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, t.frame_buffer);
+                    glViewport(0, 0, t.width, t.height);
+                    glUniform4f(p.viewport_location, 0.0f, 0.0f, static_cast<GLfloat>(t.width),
+                                static_cast<GLfloat>(t.height));
+                }
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            }
+
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frame_buffer);
+            glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+            glUseProgram(program);
+            glBindVertexArray(vertex_array);
+            if (depth_test) glEnable(GL_DEPTH_TEST);
+            if (blend) glEnable(GL_BLEND);
+        }
+
+        /**
+         * \brief Number of passes, that is draws, in each run.
+         */
+        int pass_count() const
+        {
+            return static_cast<int>(passes.size());
+        }
+
+        /**
+         * \brief Bytes of the textures holding results between passes, for the size last run.
+         */
+        size_t target_bytes() const
+        {
+            auto bytes = size_t(0);
+            for (auto &t: targets) {
+                bytes += t.bytes();
+            }
+            return bytes;
+        }
+
+        /**
+         * \brief Bytes the results would take with a texture for each pass, for the size last run.
+         */
+        size_t unshared_target_bytes() const
+        {
+            auto bytes = size_t(0);
+            for (auto &p: passes) {
+                if (p.target >= 0) {
+                    bytes += targets[p.target].bytes();
+                }
+            }
+            return bytes;
+        }
+
+        /**
+         * \brief The passes, what each does, and the memory taken by the results between them.
+         */
+        std::string report() const
+        {
+            std::ostringstream out;
+            auto node_count = 0;
+            for (auto &p: passes) {
+                node_count += static_cast<int>(p.nodes.size());
+            }
+            out << node_count << " nodes in " << passes.size() << " passes, " << targets.size()
+                << " textures between passes\n";
+            for (size_t i = 0; i < passes.size(); ++i) {
+                auto &p = passes[i];
+                out << "    pass " << i << ":";
+                for (auto n: p.nodes) {
+                    out << " " << kind_name(nodes[n]);
+                }
+                out << " -> " << (p.target < 0 ? std::string("output") : "texture " + std::to_string(p.target))
+                    << "\n";
+            }
+            out << "    " << target_bytes() / 1024 << " KiB in textures, " << unshared_target_bytes() / 1024
+                << " KiB with one for each pass";
+            return out.str();
+        }
+
+        /// The first of the two texture units the passes bind their inputs to
+        GLint first_texture_unit = 40;
+
+    private:
+
+        enum class kind {
+            source, blur_rows, blur_columns, sobel, mix, color, tone_map
+        };
+
+        struct node_data {
+            node_data(kind type, std::vector<node> inputs = {})
+                    : type(type), inputs(std::move(inputs))
+            {}
+
+            kind type;
+            std::vector<node> inputs;
+            std::vector<float> weights;
+            color_filter filter = color_filter::red;
+            tone_map_operator op = tone_map_operator::reinhard;
+            float values[2] = {0.0f, 0.0f};
+            GLint locations[2] = {-1, -1};
+        };
+
+        struct pass {
+            // the node that samples the inputs, or -1 for a plain fetch, then the per texel nodes after it
+            node sampler = -1;
+            std::vector<node> nodes;
+            std::vector<node> inputs;
+            node last = 0;
+            int target = -1;
+            int last_reader = -1;
+            GLuint program = 0;
+            GLint input_locations[2] = {-1, -1};
+            GLint viewport_location = -1;
+        };
+
+        struct target {
+            int width;
+            int height;
+            GLuint texture = 0;
+            GLuint frame_buffer = 0;
+
+            size_t bytes() const
+            {
+                // GL_RGBA16F
+                return 8ull * width * height;
+            }
+        };
+
+        node add(node_data data)
+        {
+            nodes.push_back(std::move(data));
+            compiled = false;
+            return static_cast<node>(nodes.size() - 1);
+        }
+
+        static bool per_texel(kind k)
+        {
+            return k == kind::color || k == kind::tone_map;
+        }
+
+        /**
+         * Group the nodes the output depends on into passes, in the order they were made, which is an order
+         * in which every node comes after its inputs.
+         */
+        void plan_passes()
+        {
+            auto needed = std::vector<bool>(nodes.size(), false);
+            needed[result] = true;
+            for (auto n = result; n > 0; --n) {
+                if (needed[n]) {
+                    for (auto i: nodes[n].inputs) needed[i] = true;
+                }
+            }
+            auto readers = std::vector<int>(nodes.size(), 0);
+            for (size_t n = 1; n < nodes.size(); ++n) {
+                if (needed[n]) {
+                    for (auto i: nodes[n].inputs) ++readers[i];
+                }
+            }
+
+            pass_of.assign(nodes.size(), -1);
+            for (node n = 1; n < static_cast<node>(nodes.size()); ++n) {
+                if (!needed[n]) {
+                    continue;
+                }
+                auto &nd = nodes[n];
+                auto input = nd.inputs.front();
+                if (per_texel(nd.type) && input != source() && readers[input] == 1
+                    && passes[pass_of[input]].last == input) {
+                    // fused into the pass that makes its input
+                    auto &p = passes[pass_of[input]];
+                    p.nodes.push_back(n);
+                    p.last = n;
+                    pass_of[n] = pass_of[input];
+                    continue;
+                }
+                pass p;
+                p.sampler = per_texel(nd.type) ? -1 : n;
+                p.nodes.push_back(n);
+                p.inputs = nd.inputs;
+                p.last = n;
+                pass_of[n] = static_cast<int>(passes.size());
+                passes.push_back(p);
+            }
+            if (result == source() || passes.empty() || passes.back().last != result) {
+                // the output is the source, or a result also used by other nodes: copy it out
+                pass p;
+                p.inputs = {result};
+                p.last = result;
+                passes.push_back(p);
+            }
+
+            // which pass reads the result of each pass last, so its texture can be used again after that
+            for (size_t i = 0; i < passes.size(); ++i) {
+                for (auto from: passes[i].inputs) {
+                    if (from != source()) {
+                        passes[pass_of[from]].last_reader = static_cast<int>(i);
+                    }
+                }
+            }
+        }
+
+        /**
+         * Give each pass but the last a texture, one that is free when the pass is drawn.
+         */
+        void allocate_targets(int width, int height)
+        {
+            release_targets();
+            target_width = width;
+            target_height = height;
+            auto free_after = std::vector<int>();
+            for (size_t i = 0; i + 1 < passes.size(); ++i) {
+                auto &p = passes[i];
+                p.target = -1;
+                for (size_t t = 0; t < targets.size(); ++t) {
+                    // the texture's last reader has been drawn before this pass
+                    if (free_after[t] < static_cast<int>(i)) {
+                        p.target = static_cast<int>(t);
+                        break;
+                    }
+                }
+                if (p.target < 0) {
+                    target t{width, height};
+                    glCreateTextures(GL_TEXTURE_2D, 1, &t.texture);
+                    glTextureStorage2D(t.texture, 1, GL_RGBA16F, width, height);
+                    glTextureParameteri(t.texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                    glTextureParameteri(t.texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                    glTextureParameteri(t.texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                    glTextureParameteri(t.texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                    glCreateFramebuffers(1, &t.frame_buffer);
+                    glNamedFramebufferTexture(t.frame_buffer, GL_COLOR_ATTACHMENT0, t.texture, 0);
+                    p.target = static_cast<int>(targets.size());
+                    targets.push_back(t);
+                    free_after.push_back(0);
+                }
+                free_after[p.target] = p.last_reader;
+            }
+            passes.back().target = -1;
+        }
+
+        void release_targets()
+        {
+            for (auto &t: targets) {
+                glDeleteFramebuffers(1, &t.frame_buffer);
+                glDeleteTextures(1, &t.texture);
+            }
+            targets.clear();
+            target_width = target_height = 0;
+        }
+
+        static const char *kind_name(const node_data &nd)
+        {
+            switch (nd.type) {
+                case kind::blur_rows:
+                    return "blur-rows";
+                case kind::blur_columns:
+                    return "blur-columns";
+                case kind::sobel:
+                    return "sobel";
+                case kind::mix:
+                    return "mix";
+                case kind::tone_map:
+                    return "tone-map";
+                case kind::color:
+                    return "color";
+                default:
+                    return "source";
+            }
+        }
+
+        /**
+         * The fragment shader of a pass: the sampling node, or a fetch, then a function for each per texel node.
+         */
+        std::string fragment_source(const pass &p) const
+        {
+            std::ostringstream s;
+            s << "#version 430 core\n\n"
+                 "// generated by cs4722::postfx_graph\n\n"
+                 "out vec4 fColor;\n\n"
+                 "// x, y, width and height of the viewport, which for the last pass is the caller's\n"
+                 "uniform vec4 viewport;\n"
+                 "uniform sampler2D input0;\n";
+            if (p.inputs.size() > 1) {
+                s << "uniform sampler2D input1;\n";
+            }
+            for (auto n: p.nodes) {
+                s << "uniform vec2 n" << n << "_values;\n";
+                if (!nodes[n].weights.empty()) {
+                    s << "uniform float n" << n << "_weights[" << nodes[n].weights.size() << "];\n";
+                }
+            }
+            s << "\n";
+            if (std::any_of(p.nodes.begin(), p.nodes.end(), [&](node n) { return nodes[n].type == kind::color; })) {
+                s << color_filter_glsl << "\n";
+            }
+            for (auto n: p.nodes) {
+                if (per_texel(nodes[n].type)) {
+                    s << "vec4 n" << n << "(vec4 c) {\n" << per_texel_body(n) << "}\n\n";
+                }
+            }
+
+            s << "void main() {\n"
+                 "    // texture coordinates of this fragment in a target the size of the viewport\n"
+                 "    vec2 uv = (gl_FragCoord.xy - viewport.xy) / viewport.zw;\n"
+                 "    vec4 c;\n";
+            if (p.sampler < 0) {
+                s << "    c = texture(input0, uv);\n";
+            } else {
+                s << sampler_body(p.sampler);
+            }
+            for (auto n: p.nodes) {
+                if (per_texel(nodes[n].type)) {
+                    s << "    c = n" << n << "(c);\n";
+                }
+            }
+            s << "    fColor = c;\n"
+                 "}\n";
+            return s.str();
+        }
+
+        std::string sampler_body(node n) const
+        {
+            auto &nd = nodes[n];
+            auto name = "n" + std::to_string(n) + "_";
+            std::ostringstream s;
+            switch (nd.type) {
+                case kind::blur_rows:
+                case kind::blur_columns: {
+                    auto radius = (static_cast<int>(nd.weights.size()) - 1) / 2;
+                    auto direction = nd.type == kind::blur_rows ? "ivec2(1, 0)" : "ivec2(0, 1)";
+                    s << "    ivec2 size = textureSize(input0, 0);\n"
+                         "    ivec2 texel = min(ivec2(uv * vec2(size)), size - 1);\n"
+                         "    c = vec4(0);\n"
+                         "    for (int k = -" << radius << "; k <= " << radius << "; k++) {\n"
+                         "        ivec2 at = clamp(texel + k * " << direction << ", ivec2(0), size - 1);\n"
+                         "        c += " << name << "weights[k + " << radius << "] * texelFetch(input0, at, 0);\n"
+                         "    }\n";
+                    break;
+                }
+                case kind::sobel:
+                    s << "    vec2 delta = 1.0 / vec2(textureSize(input0, 0));\n"
+                         "    vec4 sobelX = (texture(input0, uv + vec2(-delta.x, -delta.y))\n"
+                         "            + 2 * texture(input0, uv + vec2(-delta.x, 0))\n"
+                         "            + texture(input0, uv + vec2(-delta.x, delta.y))\n"
+                         "            - texture(input0, uv + vec2(delta.x, -delta.y))\n"
+                         "            - 2 * texture(input0, uv + vec2(delta.x, 0))\n"
+                         "            - texture(input0, uv + vec2(delta.x, delta.y))) / 8.0;\n"
+                         "    vec4 sobelY = (texture(input0, uv + vec2(-delta.x, -delta.y))\n"
+                         "            + 2 * texture(input0, uv + vec2(0, -delta.y))\n"
+                         "            + texture(input0, uv + vec2(delta.x, -delta.y))\n"
+                         "            - texture(input0, uv + vec2(-delta.x, delta.y))\n"
+                         "            - 2 * texture(input0, uv + vec2(0, delta.y))\n"
+                         "            - texture(input0, uv + vec2(delta.x, delta.y))) / 8.0;\n"
+                         "    float d = length(vec2(length(sobelX.xyz), length(sobelY.xyz)));\n"
+                         "    c = vec4(d, d, d, 1);\n";
+                    break;
+                case kind::mix:
+                    s << "    c = " << name << "values.x * texture(input0, uv) + " << name
+                      << "values.y * texture(input1, uv);\n";
+                    break;
+                default:
+                    s << "    c = texture(input0, uv);\n";
+            }
+            return s.str();
+        }
+
+        std::string per_texel_body(node n) const
+        {
+            auto &nd = nodes[n];
+            auto name = "n" + std::to_string(n) + "_";
+            if (nd.type == kind::tone_map) {
+                auto body = "    vec3 x = c.rgb * " + name + "values.x;\n";
+                if (nd.op == tone_map_operator::aces) {
+                    return body + "    x = clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);\n"
+                                  "    return vec4(x, c.a);\n";
+                }
+                return body + "    return vec4(x / (1.0 + x), c.a);\n";
+            }
+            // the number of the filter is a constant, so the compiler drops the other cases
+            return "    return vec4(apply_color_filter(" + std::to_string(static_cast<int>(nd.filter)) + ", " + name
+                   + "values.x, c.rgb), 1.0);\n";
+        }
+
+        static GLuint compile_program(const std::string &fragment)
+        {
+            // a triangle that covers the viewport, made from the vertex number so no buffers are needed
+            const char *vertex =
+                    "#version 430 core\n"
+                    "void main() {\n"
+                    "    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+                    "    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);\n"
+                    "}\n";
+            auto program = glCreateProgram();
+            const char *sources[] = {vertex, fragment.c_str()};
+            GLenum types[] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+            for (auto i = 0; i < 2; ++i) {
+                auto shader = glCreateShader(types[i]);
+                glShaderSource(shader, 1, &sources[i], nullptr);
+                glCompileShader(shader);
+                GLint ok;
+                glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+                if (!ok) {
+                    char log[2048];
+                    glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+                    std::cerr << "postfx_graph shader did not compile:\n" << log << "\n" << sources[i] << std::endl;
+                }
+                glAttachShader(program, shader);
+                glDeleteShader(shader);
+            }
+            glLinkProgram(program);
+            GLint ok;
+            glGetProgramiv(program, GL_LINK_STATUS, &ok);
+            if (!ok) {
+                char log[2048];
+                glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+                std::cerr << "postfx_graph program did not link:\n" << log << "\n" << fragment << std::endl;
+            }
+            return program;
+        }
+
+        std::vector<node_data> nodes;
+        node result = 0;
+        bool compiled = false;
+        std::vector<pass> passes;
+        std::vector<int> pass_of;
+        std::vector<target> targets;
+        int target_width = 0;
+        int target_height = 0;
+        GLuint vao = 0;
+    };
+
+}
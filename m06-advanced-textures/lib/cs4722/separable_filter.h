@@ -0,0 +1,274 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "cs4722/parallel_for.h"
+
+/**
+ * \file
+ *
+ * Blurring RGBA8 images on the CPU with filters that are done one direction at a time.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief A blur whose weights are the product of a weight along x and the same weight along y,
+     * applied as a pass along each row followed by a pass down each column.
+     *
+     * A filter of radius r covers (2r + 1) by (2r + 1) texels, which takes (2r + 1)^2 samples done directly,
+     * as in image_processing_fragment_shader.glsl, but only 2 (2r + 1) done in two passes.
+     * The box filter goes further: each pass keeps a running sum, adding the texel entering the window and
+     * subtracting the one leaving it, so its cost does not depend on the radius at all.
+     *
+     * Texels beyond the edges of the image are taken to be copies of the nearest edge texel, as with
+     * `GL_CLAMP_TO_EDGE`.
+     *
+     * The image is split into bands of `band_rows` rows that the threads claim in turn, as the rows in
+     * `block_encoder`.
+     * A thread filters the rows of its band along x into a ring of 2r + 2 rows, as floats, and makes each
+     * output row from the rows of the ring as soon as they are in.
+     * So the rows being read stay in the L2 cache, and only the 2r rows above and below a band are filtered
+     * along x twice.
+     * The passes work through a row in pieces of `tile_floats`, which with the rows they are combined with
+     * fit in the L1 cache.
+     * The loops over a piece have no dependencies between iterations, so the compiler vectorizes them,
+     * eight floats at a time when building for AVX2.
+     */
+    class separable_filter {
+    public:
+
+        /**
+         * \brief The box filter of the given radius, the average of the (2r + 1)^2 texels around each one.
+         */
+        static separable_filter box(int radius, int number_of_threads = 0)
+        {
+            auto filter = separable_filter(radius, number_of_threads);
+            std::fill(filter.weights.begin(), filter.weights.end(), 1.0f / static_cast<float>(2 * radius + 1));
+            filter.running_sum = true;
+            return filter;
+        }
+
+        /**
+         * \brief The Gaussian filter of the given radius.
+         *
+         * @param sigma  Standard deviation in texels, 0 means a third of the radius, so the weights cut off
+         *          at three standard deviations
+         */
+        static separable_filter gaussian(int radius, float sigma = 0.0f, int number_of_threads = 0)
+        {
+            auto filter = separable_filter(radius, number_of_threads);
+            if (sigma <= 0.0f) {
+                sigma = std::max(0.5f, static_cast<float>(radius) / 3.0f);
+            }
+            auto total = 0.0f;
+            for (auto k = -radius; k <= radius; ++k) {
+                auto weight = std::exp(-static_cast<float>(k * k) / (2.0f * sigma * sigma));
+                filter.weights[k + radius] = weight;
+                total += weight;
+            }
+            for (auto &weight: filter.weights) {
+                weight /= total;
+            }
+            return filter;
+        }
+
+        /**
+         * \brief Filter `width` by `height` RGBA8 texels into `result`, which must not overlap them.
+         */
+        void apply(const GLubyte *rgba, GLubyte *result, int width, int height) const
+        {
+            auto bands = (height + band_rows - 1) / band_rows;
+            auto ring_rows = 2 * radius + 2;
+            auto row_floats = 4 * width;
+            struct buffers {
+                std::vector<float> ring;
+                std::vector<float> line;
+                std::vector<float> sums;
+            };
+            auto make_buffers = [&]() {
+                return buffers{std::vector<float>(static_cast<size_t>(ring_rows) * row_floats),
+                               std::vector<float>(4ull * (width + 2 * radius)),
+                               std::vector<float>(row_floats)};
+            };
+            parallel_for(bands, number_of_threads, make_buffers, [&](int band, buffers &b) {
+                auto &ring = b.ring;
+                auto &line = b.line;
+                auto &sums = b.sums;
+                auto ring_row = [&](int y) {
+                    return ring.data() + static_cast<size_t>((y + ring_rows) % ring_rows) * row_floats;
+                };
+                auto first = band * band_rows;
+                auto last = std::min(height, first + band_rows);
+                for (auto y = first - radius; y <= first + radius; ++y) {
+                    filter_row(rgba, width, height, y, line.data(), ring_row(y - first));
+                }
+                if (running_sum) {
+                    sum_rows(ring, ring_rows, row_floats, sums.data());
+                }
+                for (auto y = first; y < last; ++y) {
+                    auto *out = result + 4ull * width * y;
+                    if (running_sum) {
+                        if (y > first) {
+                            // the window moves down a row: filter the row entering it, then swap it for the
+                            // row leaving it
+                            auto *entering = ring_row(y - first + radius);
+                            filter_row(rgba, width, height, y + radius, line.data(), entering);
+                            slide(sums.data(), entering, ring_row(y - first - radius - 1), row_floats);
+                        }
+                        scale_row(sums.data(), weights[0], out, row_floats);
+                    } else {
+                        if (y > first) {
+                            filter_row(rgba, width, height, y + radius, line.data(),
+                                       ring_row(y - first + radius));
+                        }
+                        column_pass(ring_row, y - first, row_floats, sums.data(), out);
+                    }
+                }
+            });
+        }
+
+        /**
+         * \brief Weights of the taps from -radius to radius, the same along x and y, adding to 1.
+         */
+        std::vector<float> weights;
+        int radius;
+        /// Whether the passes keep running sums, which is only right when the weights are all equal
+        bool running_sum = false;
+        int number_of_threads;
+        int band_rows = 64;
+        int tile_floats = 1024;
+
+    private:
+
+        separable_filter(int radius, int number_of_threads)
+                : weights(2 * radius + 1), radius(radius), number_of_threads(number_of_threads)
+        {}
+
+        /**
+         * Row y of the image, clamped to the image, filtered along x into `out`, with `line` holding the
+         * row as floats and radius texels of the edge copied on each side.
+         */
+        void filter_row(const GLubyte *rgba, int width, int height, int y, float *line, float *out) const
+        {
+            y = std::clamp(y, 0, height - 1);
+            const auto *row = rgba + 4ull * width * y;
+            for (auto x = 0; x < radius; ++x) {
+                for (auto c = 0; c < 4; ++c) {
+                    line[4 * x + c] = row[c];
+                    line[4 * (width + radius + x) + c] = row[4 * (width - 1) + c];
+                }
+            }
+            auto *middle = line + 4 * radius;
+            for (auto i = 0; i < 4 * width; ++i) {
+                middle[i] = row[i];
+            }
+
+            if (running_sum) {
+                // the four channels are summed side by side and each texel depends on the one before
+                float sum[4] = {0, 0, 0, 0};
+                for (auto k = 0; k < 2 * radius + 1; ++k) {
+                    for (auto c = 0; c < 4; ++c) sum[c] += line[4 * k + c];
+                }
+                for (auto x = 0; x < width; ++x) {
+                    for (auto c = 0; c < 4; ++c) {
+                        out[4 * x + c] = sum[c];
+                        sum[c] += line[4 * (x + 2 * radius + 1) + c] - line[4 * x + c];
+                    }
+                }
+                // the sums are scaled once, after the column pass, by `scale_row`
+                return;
+            }
+
+            for (auto start = 0; start < 4 * width; start += tile_floats) {
+                auto end = std::min(4 * width, start + tile_floats);
+                for (auto i = start; i < end; ++i) {
+                    out[i] = 0.0f;
+                }
+                for (auto k = 0; k < 2 * radius + 1; k += 4) {
+                    accumulate(out, start, end, k, [&](int tap) { return line + 4 * tap; });
+                }
+            }
+        }
+
+        /**
+         * Output row `y` (relative to the band) from the 2r + 1 ring rows around it, weighted, into `out`.
+         */
+        template<typename R>
+        void column_pass(R ring_row, int y, int row_floats, float *sums, GLubyte *out) const
+        {
+            for (auto start = 0; start < row_floats; start += tile_floats) {
+                auto end = std::min(row_floats, start + tile_floats);
+                for (auto i = start; i < end; ++i) {
+                    sums[i] = 0.0f;
+                }
+                for (auto k = 0; k < 2 * radius + 1; k += 4) {
+                    accumulate(sums, start, end, k, [&](int tap) { return ring_row(y - radius + tap); });
+                }
+                for (auto i = start; i < end; ++i) {
+                    out[i] = to_byte(sums[i]);
+                }
+            }
+        }
+
+        /**
+         * Add taps k to k + 3 to `sums` from start to end, the input of each tap given by `tap_input`.
+         * Taking four taps at once reads and writes the sums a quarter as often.
+         * Taps past the last are given a weight of 0 and the input of the last.
+         */
+        template<typename T>
+        void accumulate(float *sums, int start, int end, int k, T tap_input) const
+        {
+            auto last = 2 * radius;
+            float w[4];
+            const float *in[4];
+            for (auto t = 0; t < 4; ++t) {
+                w[t] = k + t <= last ? weights[k + t] : 0.0f;
+                in[t] = tap_input(std::min(k + t, last));
+            }
+            for (auto i = start; i < end; ++i) {
+                sums[i] += w[0] * in[0][i] + w[1] * in[1][i] + w[2] * in[2][i] + w[3] * in[3][i];
+            }
+        }
+
+        void sum_rows(const std::vector<float> &ring, int ring_rows, int row_floats, float *sums) const
+        {
+            // the first 2r + 1 rows of a band are in ring rows -r to r, which wrap to the end of the ring
+            for (auto i = 0; i < row_floats; ++i) {
+                sums[i] = 0.0f;
+            }
+            for (auto k = -radius; k <= radius; ++k) {
+                const auto *in = ring.data() + static_cast<size_t>((k + ring_rows) % ring_rows) * row_floats;
+                for (auto i = 0; i < row_floats; ++i) {
+                    sums[i] += in[i];
+                }
+            }
+        }
+
+        static void slide(float *sums, const float *entering, const float *leaving, int row_floats)
+        {
+            for (auto i = 0; i < row_floats; ++i) {
+                sums[i] += entering[i] - leaving[i];
+            }
+        }
+
+        void scale_row(const float *sums, float weight, GLubyte *out, int row_floats) const
+        {
+            // both passes summed, so the weight of each texel is the square of the weight of a tap
+            auto scale = weight * weight;
+            for (auto i = 0; i < row_floats; ++i) {
+                out[i] = to_byte(sums[i] * scale);
+            }
+        }
+
+        static GLubyte to_byte(float value)
+        {
+            return static_cast<GLubyte>(std::min(255.0f, std::max(0.0f, value + 0.5f)));
+        }
+    };
+
+}
@@ -0,0 +1,370 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <glad/gl.h>
+
+#include "cs4722/block_compression.h"
+
+/**
+ * \file
+ *
+ * A file format for textures that are ready to upload, so a program does not decode its images every time
+ * it starts.
+ *
+ * A container holds the texels of every mip level of a 2D texture or of every face of a cube texture,
+ * either as RGBA8 or block compressed, in the order OpenGL takes them.
+ * The file starts with a `texture_container_header`, followed by a `texture_container_image` for each
+ * level and face, level by level with the faces of a level in order.
+ * The texels of each image start at a multiple of `texture_container_alignment` bytes, a page on
+ * the usual systems, so once the file is mapped into memory they can be given to OpenGL where they are.
+ * All numbers are little endian.
+ *
+ * The 03-texture-converter program makes containers from image files; `init_texture_from_container`
+ * loads them.
+ */
+
+namespace cs4722 {
+
+    constexpr char texture_container_magic[8] = {'C', 'S', '4', '7', '2', '2', 'T', 'X'};
+    constexpr std::uint32_t texture_container_version = 1;
+    constexpr std::uint32_t texture_container_alignment = 4096;
+
+    struct texture_container_header {
+        char magic[8];
+        std::uint32_t version;
+        /// `GL_RGBA8` or one of the compressed formats of `block_encoder::internal_format`
+        std::uint32_t internal_format;
+        std::uint32_t width;
+        std::uint32_t height;
+        /// 1 for a 2D texture, 6 for a cube texture
+        std::uint32_t faces;
+        std::uint32_t levels;
+        std::uint32_t alignment;
+        std::uint32_t reserved[7];
+    };
+
+    struct texture_container_image {
+        std::uint64_t offset;
+        std::uint64_t size;
+    };
+
+    static_assert(sizeof(texture_container_header) == 64 && sizeof(texture_container_image) == 16);
+
+    /**
+     * \brief The compressed format stored as `internal_format`, or false for `GL_RGBA8`.
+     */
+    inline bool texture_container_format(GLenum internal_format, block_format &format)
+    {
+        for (auto f: {block_format::bc1, block_format::bc4, block_format::bc5, block_format::bc7}) {
+            if (block_encoder::internal_format(f) == internal_format) {
+                format = f;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * \brief Where each image of a container goes, given the sizes in its header.
+     *
+     * The writer lays the file out with this and the reader checks the file against it.
+     * Returns an empty list if the header describes a texture the container cannot hold.
+     */
+    inline std::vector<texture_container_image> texture_container_layout(const texture_container_header &header)
+    {
+        auto images = std::vector<texture_container_image>();
+        block_format format = block_format::bc1;
+        auto compressed = texture_container_format(header.internal_format, format);
+        if ((!compressed && header.internal_format != GL_RGBA8)
+            || (header.faces != 1 && header.faces != 6)
+            || header.width == 0 || header.height == 0
+            || (header.faces == 6 && header.width != header.height)
+            || header.levels == 0
+            || header.levels > static_cast<std::uint32_t>(texture_level_count(header.width, header.height))) {
+            return images;
+        }
+        auto align = [](std::uint64_t offset) {
+            return (offset + texture_container_alignment - 1) / texture_container_alignment
+                   * texture_container_alignment;
+        };
+        auto offset = align(sizeof(texture_container_header)
+                            + sizeof(texture_container_image) * header.levels * header.faces);
+        for (std::uint32_t level = 0; level < header.levels; ++level) {
+            auto width = std::max(1u, header.width >> level);
+            auto height = std::max(1u, header.height >> level);
+            std::uint64_t size = compressed ? block_encoder::compressed_size(format, width, height)
+                                            : 4ull * width * height;
+            for (std::uint32_t face = 0; face < header.faces; ++face) {
+                images.push_back({offset, size});
+                offset = align(offset + size);
+            }
+        }
+        return images;
+    }
+
+    /**
+     * \brief The texels of every mip level of an RGBA8 image, ready to write to a container.
+     *
+     * Each level is half the size of the one before, made with `halve_image`.
+     * With an encoder the levels are block compressed, as `upload_compressed_levels` uploads them.
+     */
+    inline std::vector<std::vector<GLubyte>> texture_container_levels(const GLubyte *rgba, int width, int height,
+                                                                      const block_encoder *encoder = nullptr)
+    {
+        auto levels = std::vector<std::vector<GLubyte>>();
+        auto level_texels = std::vector<GLubyte>(rgba, rgba + 4ull * width * height);
+        while (true) {
+            levels.push_back(encoder ? encoder->encode(level_texels.data(), width, height) : level_texels);
+            if (width == 1 && height == 1) {
+                break;
+            }
+            level_texels = halve_image(level_texels.data(), width, height, width, height);
+        }
+        return levels;
+    }
+
+    /**
+     * \brief Write a container.
+     *
+     * @param path  Path of the file to write
+     * @param internal_format  `GL_RGBA8` or a compressed format
+     * @param width  Width of level 0
+     * @param height  Height of level 0
+     * @param faces  The texels of each face, 1 for a 2D texture or 6 for a cube texture, each with its levels
+     *          from `texture_container_levels`
+     * @returns  False if the file could not be written or the texels do not fit the format and sizes
+     */
+    inline bool write_texture_container(const char *path, GLenum internal_format, int width, int height,
+                                        const std::vector<std::vector<std::vector<GLubyte>>> &faces)
+    {
+        auto header = texture_container_header{};
+        std::memcpy(header.magic, texture_container_magic, sizeof(header.magic));
+        header.version = texture_container_version;
+        header.internal_format = internal_format;
+        header.width = width;
+        header.height = height;
+        header.faces = static_cast<std::uint32_t>(faces.size());
+        header.levels = faces.empty() ? 0 : static_cast<std::uint32_t>(faces.front().size());
+        header.alignment = texture_container_alignment;
+        auto images = texture_container_layout(header);
+        if (images.empty()) {
+            std::cerr << "cannot make a container of this texture, " << path << std::endl;
+            return false;
+        }
+        for (std::uint32_t level = 0; level < header.levels; ++level) {
+            for (std::uint32_t face = 0; face < header.faces; ++face) {
+                if (faces[face].size() != header.levels
+                    || faces[face][level].size() != images[level * header.faces + face].size) {
+                    std::cerr << "the texels do not match the format and size, " << path << std::endl;
+                    return false;
+                }
+            }
+        }
+
+        auto *file = std::fopen(path, "wb");
+        if (!file) {
+            std::cerr << "could not write " << path << std::endl;
+            return false;
+        }
+        std::uint64_t written = 0;
+        auto put = [&](const void *data, std::uint64_t size) {
+            written += std::fwrite(data, 1, size, file);
+        };
+        put(&header, sizeof(header));
+        put(images.data(), sizeof(texture_container_image) * images.size());
+        auto padding = std::vector<GLubyte>(texture_container_alignment);
+        for (std::uint32_t level = 0; level < header.levels; ++level) {
+            for (std::uint32_t face = 0; face < header.faces; ++face) {
+                auto &image = images[level * header.faces + face];
+                put(padding.data(), image.offset - written);
+                put(faces[face][level].data(), image.size);
+            }
+        }
+        auto ok = std::fclose(file) == 0 && written == images.back().offset + images.back().size;
+        if (!ok) {
+            std::cerr << "could not write " << path << std::endl;
+        }
+        return ok;
+    }
+
+    /**
+     * \brief A file mapped read only into memory, for as long as the object lives.
+     */
+    class mapped_file {
+    public:
+
+        explicit mapped_file(const char *path)
+        {
+#ifdef _WIN32
+            file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                               FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                return;
+            }
+            LARGE_INTEGER file_size;
+            if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+                return;
+            }
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!mapping) {
+                return;
+            }
+            auto *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if (view) {
+                bytes = static_cast<const GLubyte *>(view);
+                length = static_cast<size_t>(file_size.QuadPart);
+            }
+#else
+            descriptor = open(path, O_RDONLY);
+            struct stat status{};
+            if (descriptor < 0 || fstat(descriptor, &status) != 0 || status.st_size == 0) {
+                return;
+            }
+            auto *view = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (view != MAP_FAILED) {
+                // the texels are read once from start to end
+                madvise(view, status.st_size, MADV_SEQUENTIAL);
+                madvise(view, status.st_size, MADV_WILLNEED);
+                bytes = static_cast<const GLubyte *>(view);
+                length = static_cast<size_t>(status.st_size);
+            }
+#endif
+        }
+
+        mapped_file(const mapped_file &) = delete;
+        mapped_file &operator=(const mapped_file &) = delete;
+
+        ~mapped_file()
+        {
+#ifdef _WIN32
+            if (bytes) UnmapViewOfFile(bytes);
+            if (mapping) CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+            if (bytes) munmap(const_cast<GLubyte *>(bytes), length);
+            if (descriptor >= 0) close(descriptor);
+#endif
+        }
+
+        /**
+         * \brief The contents of the file, or null if it could not be mapped.
+         */
+        const GLubyte *data() const
+        {
+            return bytes;
+        }
+
+        size_t size() const
+        {
+            return length;
+        }
+
+    private:
+
+        const GLubyte *bytes = nullptr;
+        size_t length = 0;
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#else
+        int descriptor = -1;
+#endif
+    };
+
+    /**
+     * \brief Create a texture from a container and assign it to a texture unit.
+     *
+     * The file is mapped into memory and each image is given to OpenGL straight from the mapping,
+     * so nothing is decoded or copied on the way, and loading takes about as long as reading the file.
+     * A container with six faces makes a cube texture, set to clamp to its edges as
+     * `init_cube_texture_from_path` does.
+     *
+     * @param path  Path to the container
+     * @param texture_unit  Texture unit to use for this texture
+     * @returns  The texture identifier, or 0 if the file could not be read or is not a container
+     */
+    inline GLuint init_texture_from_container(const char *path, GLuint texture_unit)
+    {
+        auto file = mapped_file(path);
+        if (!file.data()) {
+            std::cerr << "could not read " << path << std::endl;
+            return 0;
+        }
+        texture_container_header header;
+        auto images = std::vector<texture_container_image>();
+        if (file.size() >= sizeof(header)) {
+            std::memcpy(&header, file.data(), sizeof(header));
+            if (std::memcmp(header.magic, texture_container_magic, sizeof(header.magic)) == 0
+                && header.version == texture_container_version) {
+                images = texture_container_layout(header);
+            }
+        }
+        auto table_end = sizeof(header) + sizeof(texture_container_image) * images.size();
+        if (images.empty() || file.size() < images.back().offset + images.back().size
+            || std::memcmp(file.data() + sizeof(header), images.data(), table_end - sizeof(header)) != 0) {
+            std::cerr << "not a texture container, or one from another version, " << path << std::endl;
+            return 0;
+        }
+
+        block_format format = block_format::bc1;
+        auto compressed = texture_container_format(header.internal_format, format);
+        auto cube = header.faces == 6;
+        GLuint texture;
+        glCreateTextures(cube ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D, 1, &texture);
+        glTextureStorage2D(texture, static_cast<GLsizei>(header.levels), header.internal_format,
+                           static_cast<GLsizei>(header.width), static_cast<GLsizei>(header.height));
+        for (std::uint32_t level = 0; level < header.levels; ++level) {
+            auto width = static_cast<GLsizei>(std::max(1u, header.width >> level));
+            auto height = static_cast<GLsizei>(std::max(1u, header.height >> level));
+            for (std::uint32_t face = 0; face < header.faces; ++face) {
+                auto &image = images[level * header.faces + face];
+                const auto *texels = file.data() + image.offset;
+                auto size = static_cast<GLsizei>(image.size);
+                if (compressed && cube) {
+                    glCompressedTextureSubImage3D(texture, level, 0, 0, face, width, height, 1,
+                                                  header.internal_format, size, texels);
+                } else if (compressed) {
+                    glCompressedTextureSubImage2D(texture, level, 0, 0, width, height, header.internal_format,
+                                                  size, texels);
+                } else if (cube) {
+                    glTextureSubImage3D(texture, level, 0, 0, face, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                                        texels);
+                } else {
+                    glTextureSubImage2D(texture, level, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+                }
+            }
+        }
+
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        if (cube) {
+            glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTextureParameteri(texture, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        }
+        glBindTextureUnit(texture_unit, texture);
+        return texture;
+    }
+
+}
@@ -34,6 +34,7 @@
 #include "cs4722/window.h"
 #include "cs4722/callbacks.h"
 #include "cs4722/compile_shaders.h"
+#include "cs4722/render_context.h"
 
 static cs4722::view *the_view;
 static GLint program;
@@ -122,7 +123,7 @@ void display()
 
     static const float black[] = { 0.0f, 0.0f, 0.0f, 0.0f };
 
-	glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_float());
+	glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_array().data());
 	glClear(GL_DEPTH_BUFFER_BIT);
 
     glBindVertexArray(vao);
@@ -149,7 +150,7 @@ void display()
         /**
          * Send the ambient color to the fragment shader.
          */
-		glUniform4fv(ambient_color_loc, 1, artf->surface_material.ambient_color.as_float());
+		glUniform4fv(ambient_color_loc, 1, artf->surface_material.ambient_color.as_array().data());
 
 		
 		glDrawArrays(GL_TRIANGLES, artf->the_shape->buffer_start,
@@ -164,10 +165,8 @@ void display()
 int
 main(int argc, char** argv)
 {
-	glfwInit();
-
-	auto *window = cs4722::setup_window("Ambient Color", 0.9);
-    gladLoadGL(glfwGetProcAddress);
+	auto context = cs4722::render_context(argc, argv, "Ambient Color", 0.9);
+	auto *window = context.window;
 	cs4722::setup_debug_callbacks();
 
 	init();
@@ -176,14 +175,9 @@ main(int argc, char** argv)
 	cs4722::setup_user_callbacks(window);
 
 
-	while (!glfwWindowShouldClose(window))
+	while (context.running())
 	{
 		display();
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		context.end_frame();
 	}
-
-	glfwDestroyWindow(window);
-
-	glfwTerminate();
 }
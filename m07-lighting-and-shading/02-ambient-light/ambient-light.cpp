@@ -18,6 +18,7 @@
 #include "cs4722/callbacks.h"
 #include "cs4722/light.h"
 #include "cs4722/compile_shaders.h"
+#include "cs4722/render_context.h"
 
 static cs4722::view *the_view;
 static GLuint program;
@@ -127,7 +128,7 @@ void display()
      * The light belongs to the scene not to any particular artifact.
      * So, the ambient light value is sent to the fragment shader outside of the artifact loop.
      */
-    glUniform4fv(ambient_light_loc, 1, a_light.ambient_light.as_float());
+    glUniform4fv(ambient_light_loc, 1, a_light.ambient_light.as_array().data());
 
     auto time = glfwGetTime();
 	auto delta_time = time - last_time;
@@ -139,7 +140,7 @@ void display()
         auto transform = vp_transform * model_transform;
 
         glUniformMatrix4fv(transform_loc, 1, GL_FALSE, glm::value_ptr(transform));
-		glUniform4fv(ambient_color_loc, 1, artf->surface_material.ambient_color.as_float());
+		glUniform4fv(ambient_color_loc, 1, artf->surface_material.ambient_color.as_array().data());
 
 		glDrawArrays(GL_TRIANGLES, artf->the_shape->buffer_start,
 			artf->the_shape->buffer_size);
@@ -153,9 +154,8 @@ void display()
 int
 main(int argc, char** argv)
 {
-	glfwInit();
-	auto *window = cs4722::setup_window("Ambient Lighting", 0.9);
-    gladLoadGL(glfwGetProcAddress);
+	auto context = cs4722::render_context(argc, argv, "Ambient Lighting", 0.9);
+	auto *window = context.window;
 	cs4722::setup_debug_callbacks();
 
 	init();
@@ -163,17 +163,12 @@ main(int argc, char** argv)
 	glfwSetWindowUserPointer(window, the_view);
 	cs4722::setup_user_callbacks(window);
 
-	while (!glfwWindowShouldClose(window))
+	while (context.running())
 	{
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray25.as_float());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray25.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
 
         display();
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		context.end_frame();
 	}
-
-	glfwDestroyWindow(window);
-
-	glfwTerminate();
 }
@@ -36,6 +36,7 @@
 #include "cs4722/window.h"
 #include "cs4722/callbacks.h"
 #include "cs4722/compile_shaders.h"
+#include "cs4722/render_context.h"
 
 static cs4722::view *the_view;
 static GLuint program;
@@ -153,9 +154,8 @@ void display()
 int
 main(int argc, char** argv)
 {
-	glfwInit();
-	auto *window = cs4722::setup_window("Adjust Normals", 0.9);
-    gladLoadGL(glfwGetProcAddress);
+	auto context = cs4722::render_context(argc, argv, "Adjust Normals", 0.9);
+	auto *window = context.window;
 	cs4722::setup_debug_callbacks();
 
 	init();
@@ -163,17 +163,12 @@ main(int argc, char** argv)
 	glfwSetWindowUserPointer(window, the_view);
 	cs4722::setup_user_callbacks(window);
 
-	while (!glfwWindowShouldClose(window))
+	while (context.running())
 	{
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray25.as_float());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray25.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
 
         display();
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		context.end_frame();
 	}
-
-	glfwDestroyWindow(window);
-
-	glfwTerminate();
 }
@@ -0,0 +1,149 @@
+/*
+ * Count the heap allocations made by the per-frame work of the point lighting example.
+ *
+ * The global operator new is replaced by one that counts calls.
+ * The scene from point_lighting.cpp is built and then the CPU side of its display loop is run for a number
+ *      of frames: animation, transforms, frustum culling, and the color values sent to the shaders.
+ * One frame is run before counting starts, since the culler sizes its lists on first use.
+ * The OpenGL calls are left out since they need a window, they do not allocate in our code.
+ *
+ * The program also checks that asking for the attributes of a shape a second time, through
+ *      cs4722::attributes_of, does not allocate.
+ *
+ * The exit code is 0 if no allocations were counted and 1 otherwise.
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include <GLM/gtc/type_ptr.hpp>
+#include <GLM/gtc/matrix_inverse.hpp>
+#include <GLM/ext/scalar_constants.hpp>
+
+#include "cs4722/artifact.h"
+#include "cs4722/frustum.h"
+#include "cs4722/light.h"
+#include "cs4722/shape_attributes.h"
+
+static std::atomic<long> allocation_count(0);
+
+void *operator new(std::size_t size)
+{
+    ++allocation_count;
+    if (auto *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+
+int
+main()
+{
+    auto shape_list = std::vector<cs4722::shape *>({
+            new cs4722::sphere(), new cs4722::block(), new cs4722::torus(), new cs4722::cylinder()});
+    auto artifact_list = std::vector<cs4722::artifact_rotating *>();
+    auto number = 4;
+    auto d = 20.0f / (2 * number + 1);
+    auto radius = d / 4;
+    auto base = -number * d / 2 + radius;
+    for (auto x = 0; x < number; ++x) {
+        for (auto y = 0; y < number; ++y) {
+            for (auto z = 0; z < number; ++z) {
+                auto *artf = new cs4722::artifact_rotating();
+                artf->the_shape = shape_list[(x + y + z) % shape_list.size()];
+                artf->world_transform.translate = glm::vec3(base + x * d, base + y * d, base + z * d);
+                artf->world_transform.scale = glm::vec3(radius, radius, radius);
+                artf->animation_transform.rotation_axis = glm::vec3(x + 1, y + 1, z + 1);
+                artf->rotation_rate = (x + y + z) % 12 * glm::pi<float>() / 24;
+                artf->surface_material.ambient_color = cs4722::color(
+                        x * 255 / (number - 1), y * 255 / (number - 1), z * 255 / (number - 1), 255);
+                artifact_list.push_back(artf);
+            }
+        }
+    }
+    for (auto *the_shape: shape_list) {
+        cs4722::attributes_of(the_shape).positions();
+        cs4722::attributes_of(the_shape).normals();
+    }
+    cs4722::light a_light;
+    cs4722::view a_view;
+    cs4722::frustum_culler culler;
+    auto model_transforms = std::vector<glm::mat4>(artifact_list.size());
+    auto world_bounds = std::vector<cs4722::bounding_sphere>(artifact_list.size());
+
+    // values are accumulated so the compiler cannot drop the work
+    auto checksum = 0.0f;
+
+    const auto frames = 100;
+    for (auto frame = -1; frame < frames; ++frame) {
+        if (frame == 0) {
+            allocation_count = 0;
+        }
+        auto time = frame / 60.0;
+        for (size_t i = 0; i < artifact_list.size(); ++i) {
+            auto *artf = artifact_list[i];
+            artf->animate(time, 1 / 60.0);
+            model_transforms[i] = artf->animation_transform.matrix() * artf->world_transform.matrix();
+            world_bounds[i] = cs4722::transform_sphere(model_transforms[i],
+                                                       cs4722::local_bounding_sphere(artf->the_shape));
+        }
+        culler.cull(cs4722::frustum(a_view), world_bounds);
+        for (auto i: culler.visible) {
+            auto *artf = artifact_list[i];
+            auto &model_transform = model_transforms[i];
+            auto normal_transform = glm::inverseTranspose(model_transform);
+            checksum += glm::value_ptr(model_transform)[0] + glm::value_ptr(normal_transform)[5];
+
+            for (auto &c: {a_light.ambient_light, a_light.diffuse_light, a_light.specular_light,
+                           artf->surface_material.ambient_color, artf->surface_material.diffuse_color,
+                           artf->surface_material.specular_color}) {
+                checksum += c.as_array().data()[0];
+            }
+        }
+        checksum += cs4722::x11::gray25.as_array().data()[0];
+    }
+    auto display_allocations = allocation_count.load();
+
+    allocation_count = 0;
+    for (auto *the_shape: shape_list) {
+        checksum += cs4722::attributes_of(the_shape).positions()[0].x;
+        checksum += cs4722::attributes_of(the_shape).normals()[0].y;
+    }
+    auto attribute_allocations = allocation_count.load();
+
+    std::cout << "frames: " << frames << ", artifacts: " << artifact_list.size()
+              << " (checksum " << checksum << ")" << std::endl;
+    std::cout << "heap allocations in display work: " << display_allocations << std::endl;
+    std::cout << "heap allocations when reusing shape attributes: " << attribute_allocations << std::endl;
+
+    return display_allocations == 0 && attribute_allocations == 0 ? 0 : 1;
+}
@@ -16,15 +16,26 @@
  *   Indeed, most of the examples up to this point have a memory leak.  If a program uses .as_float() inside
  *      the display loop, then that will leak memory until the program crashes.
  *      This just didn't become noticeable until this example when .as_float() is used six times in the display loop.
- *   The code in this example uses one approach to solve the issue.
- *   See the code and comment around line 203 and following for a discussion.
+ *   The code in this example uses color::as_array, which does not allocate at all.
+ *   See the code and comment in the display function for a discussion.
+ *
+ *   Artifacts outside the camera's view are not drawn.
+ *   Each frame the bounding sphere of every artifact is tested against the view frustum and only the
+ *      artifacts that may be visible are sent to OpenGL.
+ *   The percentage culled and the time spent culling are printed every few seconds.
+ *
+ *   Each artifact here still costs several uniform calls and one draw call per frame, which is the point of
+ *      the example.
+ *   08-instanced-lighting draws the same grid with cs4722::artifact_batch, one instanced draw call per shape.
  */
 
 
 #include <GLM/gtc/type_ptr.hpp>
 #include <GLM/gtc/matrix_inverse.hpp>
 
+#include <chrono>
 #include <iostream>
+#include <numeric>
 
 
 #include <glad/gl.h>
@@ -39,11 +50,27 @@
 #include "cs4722/callbacks.h"
 #include "cs4722/light.h"
 #include "cs4722/compile_shaders.h"
+#include "cs4722/indexed_mesh.h"
+#include "cs4722/frustum.h"
+#include "cs4722/render_context.h"
 
 static cs4722::view *the_view;
 static GLuint program;
 static GLuint vao;
 
+/*
+ * When true the shapes are stored with welded vertices and an element array buffer and are drawn
+ *      with glDrawElements.
+ * Set to false to go back to glDrawArrays over the unindexed triangle lists.
+ */
+static bool use_indexed_buffers = true;
+
+/*
+ * When true only the artifacts whose bounding spheres intersect the view frustum are drawn.
+ */
+static bool use_culling = true;
+static cs4722::frustum_culler culler;
+
 // many uniform variable locations to deal with
 static GLint ambient_light_loc;  // three components of light
 static GLint specular_light_loc;
@@ -61,6 +88,8 @@ static GLint normal_transform_loc;
 
 
 static std::vector<cs4722::artifact*> artifact_list;
+static std::vector<glm::mat4> model_transforms;
+static std::vector<cs4722::bounding_sphere> world_bounds;
 
 static cs4722::light a_light;
 
@@ -151,7 +180,13 @@ void init()
 	}
 	
 
-    vao = cs4722::init_buffers(program, artifact_list, "bPosition","","","bNormal");
+    if (use_indexed_buffers) {
+        vao = cs4722::init_indexed_buffers(program, artifact_list, "bPosition", "", "", "bNormal");
+    } else {
+        vao = cs4722::init_buffers(program, artifact_list, "bPosition", "", "", "bNormal");
+    }
+    model_transforms.resize(artifact_list.size());
+    world_bounds.resize(artifact_list.size());
 }
 
 
@@ -179,10 +214,27 @@ void display()
     auto time = glfwGetTime();
 	auto delta_time = time - last_time;
 
-	for (auto artf: artifact_list) {
-
-		artf->animate(time, delta_time);
-        auto model_transform = artf->animation_transform.matrix() * artf->world_transform.matrix();
+    /*
+     * All of the artifacts are animated first so their bounding spheres are known before anything is drawn.
+     */
+    for (auto i = 0; i < static_cast<int>(artifact_list.size()); ++i) {
+        auto *artf = artifact_list[i];
+        artf->animate(time, delta_time);
+        model_transforms[i] = artf->animation_transform.matrix() * artf->world_transform.matrix();
+        world_bounds[i] = cs4722::transform_sphere(model_transforms[i],
+                                                   cs4722::local_bounding_sphere(artf->the_shape));
+    }
+
+    if (use_culling) {
+        culler.cull(cs4722::frustum(vp_transform), world_bounds);
+    } else {
+        culler.visible.resize(artifact_list.size());
+        std::iota(culler.visible.begin(), culler.visible.end(), 0);
+    }
+
+	for (auto i: culler.visible) {
+        auto *artf = artifact_list[i];
+        auto &model_transform = model_transforms[i];
 
         //
         /**
@@ -203,44 +255,33 @@ void display()
          * The as_float method in class color allocates an array and returns a pointer to that array.
          * Heretofore the code has simply discarded that pointer after using the data and, so, the
          *      storage is never reclaimed.
-         * One approach, not illustrated in these examples, is to assign the array pointer to a variable,
-         *      use the variable in a call to glUniform4fv and the call delete[] to deallocated the storage.
-         * In this example we illustrate an approach that lets us keep pretty much the same code at the expense
-         *      of allocating more storage on a temporary basis.
-         *
-         *  The unique_ptr class creates objects that manage pointers.
-         *  Create a new object or array and create a unique_ptr to hold that pointer.
-         *  When the unique_ptr object does away, it will first deallocated the contained data.
-         *
-         *  The function as_float_up() returns a unique_ptr.
-         *  This is not a pointer to something but the object itself.
-         *  That means that the object returned is allocated on the stack space of the display function.
-         *  As soon as the display function is finished, the unique_ptr will be deallocated which will
-         *      trigger deletion of the array it contains.
-         *
-         *   This works since we can return an object, which means the value obtained is a copy of the original
-         *      object and is allocated on the stack.
-         *  Trying to return an array from a function just returns a pointer to the first element of the array.
-         *      That only works properly if the array is allocated on the heap with 'new'.
-         *
-         *
-         *  Note that the get() method is applied to the return value in order to get the actual data
-         *      encapsulated in the unique_ptr.
+         * Wrapping the array in a unique_ptr (as_float_up) fixes the leak, but still allocates and frees
+         *      six arrays for every artifact on every frame.
          *
+         * The as_array method returns a std::array<GLfloat, 4> by value.
+         * The array lives on the stack of the display function, just like an int would, so nothing
+         *      is allocated at all.
+         * The data() method gives the pointer that glUniform4fv expects.
          *
+         * With this change the display loop does no heap allocation.
          */
-        glUniform4fv(ambient_light_loc, 1, a_light.ambient_light.as_float_up().get());
-        glUniform4fv(diffuse_light_loc, 1, a_light.diffuse_light.as_float_up().get());
-        glUniform4fv(specular_light_loc, 1, a_light.specular_light.as_float_up().get());
-        glUniform4fv(ambient_color_loc, 1, artf->surface_material.ambient_color.as_float_up().get());
-        glUniform4fv(diffuse_color_loc, 1,  artf->surface_material.diffuse_color.as_float_up().get());
-        glUniform4fv(specular_color_loc, 1, artf->surface_material.specular_color.as_float_up().get());
+        glUniform4fv(ambient_light_loc, 1, a_light.ambient_light.as_array().data());
+        glUniform4fv(diffuse_light_loc, 1, a_light.diffuse_light.as_array().data());
+        glUniform4fv(specular_light_loc, 1, a_light.specular_light.as_array().data());
+        glUniform4fv(ambient_color_loc, 1, artf->surface_material.ambient_color.as_array().data());
+        glUniform4fv(diffuse_color_loc, 1,  artf->surface_material.diffuse_color.as_array().data());
+        glUniform4fv(specular_color_loc, 1, artf->surface_material.specular_color.as_array().data());
         glUniform1f(specular_shininess_loc, artf->surface_material.shininess);
         glUniform1f(specular_strength_loc, artf->surface_material.specular_strength);
 
 
-        glDrawArrays(GL_TRIANGLES, artf->the_shape->buffer_start,
-			artf->the_shape->buffer_size);
+        if (use_indexed_buffers) {
+            glDrawElements(GL_TRIANGLES, artf->the_shape->buffer_size, GL_UNSIGNED_INT,
+                           reinterpret_cast<void *>(artf->the_shape->buffer_start * sizeof(GLuint)));
+        } else {
+            glDrawArrays(GL_TRIANGLES, artf->the_shape->buffer_start,
+                         artf->the_shape->buffer_size);
+        }
 		
 	}
 }
@@ -251,9 +292,8 @@ void display()
 int
 main(int argc, char** argv)
 {
-	glfwInit();
-	auto *window = cs4722::setup_window("Point Lighting", 0.9);
-    gladLoadGL(glfwGetProcAddress);
+	auto context = cs4722::render_context(argc, argv, "Point Lighting", 0.9);
+	auto *window = context.window;
 	cs4722::setup_debug_callbacks();
 
 	init();
@@ -261,17 +301,21 @@ main(int argc, char** argv)
 	glfwSetWindowUserPointer(window, the_view);
 	cs4722::setup_user_callbacks(window);
 
-	while (!glfwWindowShouldClose(window))
+    // steady_clock rather than glfwGetTime, which stays at 0 when headless
+    auto report_time = std::chrono::steady_clock::now();
+	while (context.running())
 	{
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray25.as_float_up().get());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray25.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
 
         display();
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		context.end_frame();
+
+        if (use_culling && std::chrono::steady_clock::now() - report_time > std::chrono::seconds(5)) {
+            std::cout << culler.culled_percentage() << "% of artifacts culled, "
+                      << culler.average_milliseconds() << " ms per frame culling" << std::endl;
+            culler.reset_counters();
+            report_time = std::chrono::steady_clock::now();
+        }
 	}
-
-	glfwDestroyWindow(window);
-
-	glfwTerminate();
 }
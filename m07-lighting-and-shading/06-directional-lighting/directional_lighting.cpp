@@ -14,13 +14,22 @@
  *   This example contains a different approach to the memory leak discussed in the last example.
  *   The approach is more efficient in terms of time and space, BUT it is dangerous.
  *   The discussion starts about on line 154.
+ *
+ *   Artifacts outside the camera's view are not drawn, as in the point lighting example.
+ *   The percentage culled and the time spent culling are printed every few seconds.
+ *
+ *   Each artifact here still costs several uniform calls and one draw call per frame, which is the point of
+ *      the example.
+ *   08-instanced-lighting draws the same grid with cs4722::artifact_batch, one instanced draw call per shape.
  */
 
 
 #include <GLM/gtc/type_ptr.hpp>
 #include <GLM/gtc/matrix_inverse.hpp>
 
+#include <chrono>
 #include <iostream>
+#include <numeric>
 
 
 #include <glad/gl.h>
@@ -35,11 +44,27 @@
 #include "cs4722/callbacks.h"
 #include "cs4722/light.h"
 #include "cs4722/compile_shaders.h"
+#include "cs4722/indexed_mesh.h"
+#include "cs4722/frustum.h"
+#include "cs4722/render_context.h"
 
 static cs4722::view *the_view;
 static GLuint program;
 static GLuint vao;
 
+/*
+ * When true the shapes are stored with welded vertices and an element array buffer and are drawn
+ *      with glDrawElements.
+ * Set to false to go back to glDrawArrays over the unindexed triangle lists.
+ */
+static bool use_indexed_buffers = true;
+
+/*
+ * When true only the artifacts whose bounding spheres intersect the view frustum are drawn.
+ */
+static bool use_culling = true;
+static cs4722::frustum_culler culler;
+
 // many uniform variable locations to deal with
 static GLint ambient_light_loc;  // three components of light
 static GLint specular_light_loc;
@@ -57,6 +82,8 @@ static GLint normal_transform_loc;
 
 
 static std::vector<cs4722::artifact*> artifact_list;
+static std::vector<glm::mat4> model_transforms;
+static std::vector<cs4722::bounding_sphere> world_bounds;
 
 static cs4722::light a_light;
 
@@ -147,7 +174,13 @@ void init()
 	}
 	
 
-    vao = cs4722::init_buffers(program, artifact_list, "bPosition","","","bNormal");
+    if (use_indexed_buffers) {
+        vao = cs4722::init_indexed_buffers(program, artifact_list, "bPosition", "", "", "bNormal");
+    } else {
+        vao = cs4722::init_buffers(program, artifact_list, "bPosition", "", "", "bNormal");
+    }
+    model_transforms.resize(artifact_list.size());
+    world_bounds.resize(artifact_list.size());
 }
 
 /**
@@ -194,10 +227,27 @@ void display()
     auto time = glfwGetTime();
 	auto delta_time = time - last_time;
 
-	for (auto artf: artifact_list) {
-
-		artf->animate(time, delta_time);
-        auto model_transform = artf->animation_transform.matrix() * artf->world_transform.matrix();
+    /*
+     * All of the artifacts are animated first so their bounding spheres are known before anything is drawn.
+     */
+    for (auto i = 0; i < static_cast<int>(artifact_list.size()); ++i) {
+        auto *artf = artifact_list[i];
+        artf->animate(time, delta_time);
+        model_transforms[i] = artf->animation_transform.matrix() * artf->world_transform.matrix();
+        world_bounds[i] = cs4722::transform_sphere(model_transforms[i],
+                                                   cs4722::local_bounding_sphere(artf->the_shape));
+    }
+
+    if (use_culling) {
+        culler.cull(cs4722::frustum(vp_transform), world_bounds);
+    } else {
+        culler.visible.resize(artifact_list.size());
+        std::iota(culler.visible.begin(), culler.visible.end(), 0);
+    }
+
+	for (auto i: culler.visible) {
+        auto *artf = artifact_list[i];
+        auto &model_transform = model_transforms[i];
 
         //
         /**
@@ -236,8 +286,13 @@ void display()
         glUniform1f(specular_shininess_loc, artf->surface_material.shininess);
         glUniform1f(specular_strength_loc, artf->surface_material.specular_strength);
 
-        glDrawArrays(GL_TRIANGLES, artf->the_shape->buffer_start,
-			artf->the_shape->buffer_size);
+        if (use_indexed_buffers) {
+            glDrawElements(GL_TRIANGLES, artf->the_shape->buffer_size, GL_UNSIGNED_INT,
+                           reinterpret_cast<void *>(artf->the_shape->buffer_start * sizeof(GLuint)));
+        } else {
+            glDrawArrays(GL_TRIANGLES, artf->the_shape->buffer_start,
+                         artf->the_shape->buffer_size);
+        }
 		
 	}
 }
@@ -248,9 +303,8 @@ void display()
 int
 main(int argc, char** argv)
 {
-	glfwInit();
-	auto *window = cs4722::setup_window("No Lighting", 0.9);
-    gladLoadGL(glfwGetProcAddress);
+	auto context = cs4722::render_context(argc, argv, "No Lighting", 0.9);
+	auto *window = context.window;
 	cs4722::setup_debug_callbacks();
 
 	init();
@@ -258,19 +312,24 @@ main(int argc, char** argv)
 	glfwSetWindowUserPointer(window, the_view);
 	cs4722::setup_user_callbacks(window);
 
-    float *clear_color = cs4722::x11::gray25.as_float();
+    auto clear_color = cs4722::x11::gray25.as_array();
+
+    // steady_clock rather than glfwGetTime, which stays at 0 when headless
+    auto report_time = std::chrono::steady_clock::now();
 
-	while (!glfwWindowShouldClose(window))
+	while (context.running())
 	{
-        glClearBufferfv(GL_COLOR, 0, clear_color);
+        glClearBufferfv(GL_COLOR, 0, clear_color.data());
         glClear(GL_DEPTH_BUFFER_BIT);
 
         display();
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		context.end_frame();
+
+        if (use_culling && std::chrono::steady_clock::now() - report_time > std::chrono::seconds(5)) {
+            std::cout << culler.culled_percentage() << "% of artifacts culled, "
+                      << culler.average_milliseconds() << " ms per frame culling" << std::endl;
+            culler.reset_counters();
+            report_time = std::chrono::steady_clock::now();
+        }
 	}
-
-	glfwDestroyWindow(window);
-
-	glfwTerminate();
 }
@@ -0,0 +1,132 @@
+/*
+ * Compare the separate buffer layout used by init_buffers with the interleaved layout of
+ *      init_interleaved_buffers, for the attribute sets used by the examples in this module.
+ *
+ * For each scene the bytes per vertex and the time taken to gather the vertex data on the CPU are reported.
+ * The shape data is generated once, through cs4722::attributes_of, so only the packing is timed.
+ * Every scene uses the four shapes shared by the grid of artifacts in the examples.
+ *
+ * No window is opened, this program only does CPU work.
+ */
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cs4722/interleaved_buffers.h"
+
+
+struct scene {
+    std::string name;
+    const char *position_var, *color_var, *texture_var, *normal_var, *tangent_var;
+};
+
+/*
+ * Bytes per vertex and the copy done by init_buffers: one tightly packed array per attribute.
+ */
+static int separate_bytes_per_vertex(const scene &s)
+{
+    auto bytes = 16;
+    if (*s.color_var) bytes += 4;
+    if (*s.texture_var) bytes += 8;
+    if (*s.normal_var) bytes += 16;
+    if (*s.tangent_var) bytes += 16;
+    return bytes;
+}
+
+static size_t pack_separate(std::vector<cs4722::artifact *> &parts, const scene &s)
+{
+    auto positions = std::vector<glm::vec4>();
+    auto colors = std::vector<cs4722::color>();
+    auto texture_coordinates = std::vector<glm::vec2>();
+    auto normals = std::vector<glm::vec4>();
+    auto tangents = std::vector<glm::vec4>();
+    auto shapes = std::vector<cs4722::shape *>();
+    for (auto *part: parts) {
+        if (std::find(shapes.begin(), shapes.end(), part->the_shape) != shapes.end()) {
+            continue;
+        }
+        auto *the_shape = part->the_shape;
+        shapes.push_back(the_shape);
+        auto &attributes = cs4722::attributes_of(the_shape);
+        auto append = [](auto &to, auto from) { to.insert(to.end(), from.begin(), from.end()); };
+        append(positions, attributes.positions());
+        if (*s.color_var) append(colors, attributes.colors());
+        if (*s.texture_var) append(texture_coordinates, attributes.texture_coordinates());
+        if (*s.normal_var) append(normals, attributes.normals());
+        if (*s.tangent_var) append(tangents, attributes.tangents());
+    }
+    return positions.size();
+}
+
+template<typename F>
+static double milliseconds_for(int repeat, F &&work)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (auto r = 0; r < repeat; ++r) {
+        work();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / repeat;
+}
+
+int
+main()
+{
+    auto shapes = std::vector<cs4722::shape *>({
+            new cs4722::sphere(), new cs4722::block(), new cs4722::torus(), new cs4722::cylinder()});
+    auto parts = std::vector<cs4722::artifact *>();
+    for (auto i = 0; i < 4 * 4 * 4; ++i) {
+        auto *part = new cs4722::artifact();
+        part->the_shape = shapes[i % shapes.size()];
+        parts.push_back(part);
+    }
+
+    auto scenes = std::vector<scene>({
+            {"ambient color", "bPosition", "", "", "", ""},
+            {"ambient color, vertex colors", "bPosition", "bColor", "", "", ""},
+            {"point lighting", "bPosition", "", "", "bNormal", ""},
+            {"shading textures", "bPosition", "", "bTextureCoord", "bNormal", ""},
+    });
+
+    auto compact = cs4722::interleave_options();
+    compact.half_float_normals = true;
+    compact.unorm16_texture_coordinates = true;
+
+    const auto repeat = 50;
+
+    std::cout << std::left << std::setw(32) << "scene" << std::right
+              << std::setw(10) << "separate"
+              << std::setw(13) << "interleaved"
+              << std::setw(10) << "compact"
+              << std::setw(16) << "separate ms"
+              << std::setw(16) << "interleave ms"
+              << std::setw(13) << "compact ms" << std::endl;
+    std::cout << std::left << std::setw(32) << "" << std::right
+              << std::setw(33) << "(bytes per vertex)" << std::endl;
+
+    for (auto &s: scenes) {
+        auto layout = cs4722::vertex_layout(s.position_var, s.color_var, s.texture_var,
+                                            s.normal_var, s.tangent_var);
+        auto compact_layout = cs4722::vertex_layout(s.position_var, s.color_var, s.texture_var,
+                                                    s.normal_var, s.tangent_var, compact);
+
+        auto separate_time = milliseconds_for(repeat, [&]() { pack_separate(parts, s); });
+        auto interleaved_time = milliseconds_for(repeat, [&]() { cs4722::pack_interleaved(parts, layout); });
+        auto compact_time = milliseconds_for(repeat, [&]() {
+            cs4722::pack_interleaved(parts, compact_layout);
+        });
+
+        std::cout << std::left << std::setw(32) << s.name << std::right
+                  << std::setw(10) << separate_bytes_per_vertex(s)
+                  << std::setw(13) << layout.stride
+                  << std::setw(10) << compact_layout.stride
+                  << std::setw(16) << std::fixed << std::setprecision(3) << separate_time
+                  << std::setw(16) << interleaved_time
+                  << std::setw(13) << compact_time << std::endl;
+    }
+
+    return 0;
+}
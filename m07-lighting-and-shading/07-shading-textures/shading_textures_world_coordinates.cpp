@@ -10,13 +10,18 @@
  *          transform must be sent to the vertex shader
  *
  *   Changes are needed in the shaders.  See those for comments
+ *
+ *   Artifacts outside the camera's view are not drawn, as in the point lighting example.
+ *   The percentage culled and the time spent culling are printed every few seconds.
  */
 
 
 #include <GLM/gtc/type_ptr.hpp>
 #include <GLM/gtc/matrix_inverse.hpp>
 
+#include <chrono>
 #include <iostream>
+#include <numeric>
 
 
 #include <glad/gl.h>
@@ -32,11 +37,27 @@
 #include "cs4722/light.h"
 #include "cs4722/compile_shaders.h"
 #include "cs4722/texture_utilities.h"
+#include "cs4722/interleaved_buffers.h"
+#include "cs4722/frustum.h"
+#include "cs4722/render_context.h"
 
 static cs4722::view *the_view;
 static GLuint program;
 static GLuint vao;
 
+/*
+ * When true all of the vertex attributes are stored together in one interleaved buffer,
+ *      with the normals as half floats.
+ * Set to false to use one buffer per attribute as created by init_buffers.
+ */
+static bool use_interleaved_buffers = true;
+
+/*
+ * When true only the artifacts whose bounding spheres intersect the view frustum are drawn.
+ */
+static bool use_culling = true;
+static cs4722::frustum_culler culler;
+
 // many uniform variable locations to deal with
 static GLint ambient_light_loc;  // three components of light
 static GLint specular_light_loc;
@@ -55,6 +76,8 @@ static GLint sampler_loc;
 
 
 static std::vector<cs4722::artifact*> artifact_list;
+static std::vector<glm::mat4> model_transforms;
+static std::vector<cs4722::bounding_sphere> world_bounds;
 
 static cs4722::light a_light;
 
@@ -156,9 +179,18 @@ void init()
 	
 
 //    std::cerr << "before init buffers" << std::endl;
-    vao = cs4722::init_buffers(program, artifact_list, "bPosition","",
-                               "bTextureCoord","bNormal");
+    if (use_interleaved_buffers) {
+        auto options = cs4722::interleave_options();
+        options.half_float_normals = true;
+        vao = cs4722::init_interleaved_buffers(program, artifact_list, "bPosition", "",
+                                               "bTextureCoord", "bNormal", "", options);
+    } else {
+        vao = cs4722::init_buffers(program, artifact_list, "bPosition","",
+                                   "bTextureCoord","bNormal");
+    }
 //    std::cerr << "after init buffers" << std::endl;
+    model_transforms.resize(artifact_list.size());
+    world_bounds.resize(artifact_list.size());
 }
 
 
@@ -193,10 +225,27 @@ void display()
     auto time = glfwGetTime();
 	auto delta_time = time - last_time;
 
-	for (auto artf: artifact_list) {
-
-		artf->animate(time, delta_time);
-        auto model_transform = artf->animation_transform.matrix() * artf->world_transform.matrix();
+    /*
+     * All of the artifacts are animated first so their bounding spheres are known before anything is drawn.
+     */
+    for (auto i = 0; i < static_cast<int>(artifact_list.size()); ++i) {
+        auto *artf = artifact_list[i];
+        artf->animate(time, delta_time);
+        model_transforms[i] = artf->animation_transform.matrix() * artf->world_transform.matrix();
+        world_bounds[i] = cs4722::transform_sphere(model_transforms[i],
+                                                   cs4722::local_bounding_sphere(artf->the_shape));
+    }
+
+    if (use_culling) {
+        culler.cull(cs4722::frustum(vp_transform), world_bounds);
+    } else {
+        culler.visible.resize(artifact_list.size());
+        std::iota(culler.visible.begin(), culler.visible.end(), 0);
+    }
+
+	for (auto i: culler.visible) {
+        auto *artf = artifact_list[i];
+        auto &model_transform = model_transforms[i];
 
         //
         /**
@@ -242,9 +291,8 @@ void display()
 int
 main(int argc, char** argv)
 {
-	glfwInit();
-	auto *window = cs4722::setup_window("No Lighting", 0.9);
-    gladLoadGL(glfwGetProcAddress);
+	auto context = cs4722::render_context(argc, argv, "No Lighting", 0.9);
+	auto *window = context.window;
 	cs4722::setup_debug_callbacks();
 
 	init();
@@ -252,17 +300,21 @@ main(int argc, char** argv)
 	glfwSetWindowUserPointer(window, the_view);
 	cs4722::setup_user_callbacks(window);
 
-	while (!glfwWindowShouldClose(window))
+    // steady_clock rather than glfwGetTime, which stays at 0 when headless
+    auto report_time = std::chrono::steady_clock::now();
+	while (context.running())
 	{
         glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray25.as_float_up().get());
         glClear(GL_DEPTH_BUFFER_BIT);
 
         display();
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		context.end_frame();
+
+        if (use_culling && std::chrono::steady_clock::now() - report_time > std::chrono::seconds(5)) {
+            std::cout << culler.culled_percentage() << "% of artifacts culled, "
+                      << culler.average_milliseconds() << " ms per frame culling" << std::endl;
+            culler.reset_counters();
+            report_time = std::chrono::steady_clock::now();
+        }
 	}
-
-	glfwDestroyWindow(window);
-
-	glfwTerminate();
 }
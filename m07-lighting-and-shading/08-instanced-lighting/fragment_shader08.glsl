@@ -0,0 +1,50 @@
+#version 430 core
+
+/**
+The same point lighting calculation as fragment_shader05.glsl.
+The material comes from the vertex shader, which reads it from the instance data,
+    rather than from uniform variables.
+*/
+
+
+out vec4 fColor;
+
+
+in vec4 wNormal;
+in vec4 wPosition;
+
+flat in vec4 ambient_color;
+flat in vec4 diffuse_color;
+flat in vec4 specular_color;
+flat in float specular_shininess;
+flat in float specular_strength;
+
+// light
+uniform vec4 ambient_light;
+uniform vec4 specular_light;
+uniform vec4 diffuse_light;
+uniform vec4 light_position; // position of the light
+uniform vec4 camera_position;
+
+
+void main()
+{
+    vec3 light_direction = wPosition.xyz - light_position.xyz;
+    vec3 vnn = normalize(wNormal.xyz);
+
+    float diffuse_factor = max(0.0, dot(vnn, -normalize(light_direction)));
+
+    vec3 half_vector = normalize(normalize(-light_direction) - normalize(wPosition.xyz-camera_position.xyz));
+    float specular_factor = max(0.0, dot(vnn, half_vector));
+    if (diffuse_factor == 0.0)
+        specular_factor = 0.0;
+    else
+        specular_factor = pow(specular_factor, specular_shininess) * specular_strength;
+
+    vec4 ambient_component = ambient_color * ambient_light;
+    vec4 diffuse_component = diffuse_factor * diffuse_color * diffuse_light;
+    vec4 specular_component = specular_factor * specular_color * specular_light;
+
+    vec4 total = ambient_component + diffuse_component + specular_component;
+    fColor = vec4(total.rgb, 1.0);
+}
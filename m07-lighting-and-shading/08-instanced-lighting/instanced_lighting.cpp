@@ -0,0 +1,217 @@
+/**
+ * The point lighting example, drawn with instancing.
+ *
+ * point_lighting.cpp sends the transforms and material of each artifact as uniforms and then draws it,
+ *      so every artifact costs several uniform calls and one draw call each frame.
+ * Here the artifacts are grouped by shape with cs4722::artifact_batch.
+ * Each frame the batch writes the transforms and material of every artifact into a shader storage buffer
+ *      and then draws each shape once, with glDrawArraysInstanced, for all of the artifacts using it.
+ *
+ * The number of artifacts along each edge of the grid can be given on the command line, before or after the
+ *      options of cs4722::render_context.
+ * The default, 46, gives 97336 artifacts.
+ * The frame rate and the number of times the CPU had to wait for the GPU are printed every few seconds.
+ */
+
+
+#include <GLM/gtc/type_ptr.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+
+#include <glad/gl.h>
+
+#include <GLFW/glfw3.h>
+
+
+
+#include "cs4722/artifact.h"
+#include "cs4722/artifact_batch.h"
+#include "cs4722/buffer_utilities.h"
+#include "cs4722/window.h"
+#include "cs4722/callbacks.h"
+#include "cs4722/light.h"
+#include "cs4722/compile_shaders.h"
+#include "cs4722/render_context.h"
+
+static cs4722::view *the_view;
+static GLuint program;
+static GLuint vao;
+
+static GLint ambient_light_loc;
+static GLint specular_light_loc;
+static GLint diffuse_light_loc;
+static GLint light_position_loc;
+static GLint camera_position_loc;
+static GLint vp_transform_loc;
+
+
+static std::vector<cs4722::artifact*> artifact_list;
+static cs4722::artifact_batch *batch;
+
+static cs4722::light a_light;
+
+void init(int number)
+{
+    the_view = new cs4722::view();
+    the_view->enable_logging = false;
+    a_light.ambient_light = cs4722::x11::gray25;
+    a_light.is_directional = false;
+    a_light.light_direction_position = glm::vec4(0,0,0,1);
+
+	program = cs4722::compile_shaders("vertex_shader08.glsl",
+                                   "fragment_shader08.glsl");
+	glUseProgram(program);
+
+    ambient_light_loc = glGetUniformLocation(program, "ambient_light");
+    specular_light_loc = glGetUniformLocation(program, "specular_light");
+    diffuse_light_loc = glGetUniformLocation(program, "diffuse_light");
+    light_position_loc = glGetUniformLocation(program, "light_position");
+    camera_position_loc = glGetUniformLocation(program, "camera_position");
+    vp_transform_loc = glGetUniformLocation(program, "vp_transform");
+
+
+	glEnable(GL_DEPTH_TEST);
+
+
+	auto* shape_list = new std::vector<cs4722::shape*>();
+	shape_list->push_back(new cs4722::sphere());
+	shape_list->push_back(new cs4722::block());
+	shape_list->push_back(new cs4722::torus());
+	shape_list->push_back(new cs4722::cylinder());
+	auto numshp = shape_list->size();
+
+
+	auto d = 20.0f / (2 * number + 1);
+	auto radius = d / 4;
+	auto base = -number * d / 2 + radius;
+
+	for (auto x = 0; x < number; ++x)
+	{
+		for (auto y = 0; y < number; ++y)
+		{
+			for (auto z = 0; z < number; ++z)
+			{
+				auto* artf = new cs4722::artifact_rotating();
+				artf->the_shape = (shape_list->at((x + y + z) % numshp));
+				artf->world_transform.translate = (glm::vec3(base + x * d, base + y * d, base + z * d));
+				artf->world_transform.scale = (glm::vec3(radius, radius, radius));
+                artf->animation_transform.rotation_axis = (glm::vec3(x + 1, y + 1, z + 1));
+                artf->animation_transform.rotation_center =
+                        artf->world_transform.matrix() * glm::vec4(0,3,0,1);
+                artf->rotation_rate = ((x + y + z) % 12 * M_PI / 24);
+				artf->surface_material.ambient_color = (cs4722::color(
+					x * 255 / (number-1), y * 255 / (number - 1),
+					z * 255 / (number - 1), 255));
+				artf->surface_material.specular_color = cs4722::x11::white;
+				artf->surface_material.diffuse_color = artf->surface_material.ambient_color;
+				artf->surface_material.specular_strength = .75;
+				artf->surface_material.shininess = 30.0;
+				artifact_list.push_back(artf);
+			}
+		}
+	}
+
+
+    vao = cs4722::init_buffers(program, artifact_list, "bPosition","","","bNormal");
+
+    /*
+     * The batch must be created after init_buffers, which sets the part of the buffers used by each shape.
+     */
+    batch = new cs4722::artifact_batch(artifact_list);
+    batch->init(program);
+}
+
+
+
+void display()
+{
+
+    glBindVertexArray(vao);
+    glUseProgram(program);
+
+    auto view_transform = glm::lookAt(the_view->camera_position,
+                                      the_view->camera_position + the_view->camera_forward,
+                                      the_view->camera_up);
+    auto projection_transform = glm::infinitePerspective(the_view->perspective_fovy,
+                                                         the_view->perspective_aspect,
+                                                         the_view->perspective_near);
+
+    auto vp_transform = projection_transform * view_transform;
+
+    /*
+     * Everything that is the same for all of the artifacts is sent once per frame.
+     */
+    glUniformMatrix4fv(vp_transform_loc, 1, GL_FALSE, glm::value_ptr(vp_transform));
+    glUniform4fv(light_position_loc, 1, glm::value_ptr(a_light.light_direction_position));
+    glUniform4fv(camera_position_loc, 1, glm::value_ptr(the_view->camera_position));
+    glUniform4fv(ambient_light_loc, 1, a_light.ambient_light.as_array().data());
+    glUniform4fv(diffuse_light_loc, 1, a_light.diffuse_light.as_array().data());
+    glUniform4fv(specular_light_loc, 1, a_light.specular_light.as_array().data());
+
+
+    static auto last_time = 0.0;
+    auto time = glfwGetTime();
+	auto delta_time = time - last_time;
+    last_time = time;
+
+    /*
+     * The batch animates each artifact and writes its data, then draws one call per shape.
+     */
+    batch->update(time, delta_time);
+    batch->draw();
+}
+
+
+
+
+int
+main(int argc, char** argv)
+{
+    // the first argument that is not a render_context option such as --headless or --frames=N
+    auto number = 46;
+    for (auto a = 1; a < argc; ++a) {
+        if (argv[a][0] != '-') {
+            number = std::atoi(argv[a]);
+            break;
+        }
+    }
+    if (number < 2) {
+        number = 2;
+    }
+
+	auto context = cs4722::render_context(argc, argv, "Instanced Lighting", 0.9);
+	auto *window = context.window;
+	cs4722::setup_debug_callbacks();
+
+	init(number);
+    std::cout << artifact_list.size() << " artifacts, " << batch->groups.size() << " draw calls per frame"
+              << std::endl;
+
+	glfwSetWindowUserPointer(window, the_view);
+	cs4722::setup_user_callbacks(window);
+
+    auto frames = 0;
+    // steady_clock rather than glfwGetTime, which stays at 0 when headless
+    auto report_time = std::chrono::steady_clock::now();
+	while (context.running())
+	{
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray25.as_array().data());
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        display();
+		context.end_frame();
+
+        ++frames;
+        auto now = std::chrono::steady_clock::now();
+        auto seconds = std::chrono::duration<double>(now - report_time).count();
+        if (seconds > 5.0) {
+            std::cout << frames / seconds << " frames per second, "
+                      << batch->stall_count << " stalls" << std::endl;
+            frames = 0;
+            report_time = now;
+        }
+	}
+}
@@ -0,0 +1,53 @@
+#version 430 core
+
+in vec4 bPosition;
+in vec4 bNormal;
+
+/**
+The transforms and material for each instance are read from a shader storage buffer.
+The layout must match cs4722::artifact_instance.
+*/
+struct instance {
+    mat4 m_transform;
+    mat4 normal_transform;
+    vec4 ambient_color;
+    vec4 diffuse_color;
+    vec4 specular_color;
+    vec4 shininess_strength;
+};
+
+layout(std430, binding = 0) readonly buffer instance_buffer {
+    instance instances[];
+};
+
+// index of the first instance of the shape being drawn
+uniform int first_instance;
+uniform mat4 vp_transform;
+
+
+out vec4 wNormal;
+out vec4 wPosition;
+
+// the material does not change over a primitive, so it is not interpolated
+flat out vec4 ambient_color;
+flat out vec4 diffuse_color;
+flat out vec4 specular_color;
+flat out float specular_shininess;
+flat out float specular_strength;
+
+
+void
+main()
+{
+    instance self = instances[first_instance + gl_InstanceID];
+
+    wNormal = self.normal_transform * bNormal;
+    wPosition = self.m_transform * bPosition;
+    gl_Position =  vp_transform * wPosition;
+
+    ambient_color = self.ambient_color;
+    diffuse_color = self.diffuse_color;
+    specular_color = self.specular_color;
+    specular_shininess = self.shininess_strength.x;
+    specular_strength = self.shininess_strength.y;
+}
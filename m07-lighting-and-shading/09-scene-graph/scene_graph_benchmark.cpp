@@ -0,0 +1,131 @@
+/*
+ * Compare two ways of computing world matrices for a hierarchy of orbiting artifacts.
+ *
+ * The scene is a number of solar systems: suns with planets, planets with moons, and moons with satellites,
+ *      each body orbiting its parent.
+ * Every other solar system is frozen, its bodies have no orbital or rotation rate, so its matrices
+ *      never change after the first frame.
+ *
+ * The per-node way animates every artifact and then computes the world matrix of each one by walking up to
+ *      its root and multiplying the model matrices along the way, so the cost grows with the depth.
+ * The scene graph way is cs4722::scene_graph, which computes each world matrix once from the world
+ *      matrix of its parent and skips the frozen solar systems.
+ *
+ * The number of children of each body can be given on the command line, the default is 10.
+ * The average time per frame of each way is printed, along with the number of world matrices the scene graph
+ *      recomputed in the last frame and the largest difference between the two sets of matrices.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <GLM/ext/scalar_constants.hpp>
+
+#include "cs4722/artifact.h"
+#include "cs4722/artifact_elliptical_orbit.h"
+#include "cs4722/scene_graph.h"
+
+static cs4722::sphere the_sphere;
+
+/*
+ * Add `count` bodies orbiting `parent`, and `count` bodies orbiting each of those, down to `depth` levels.
+ */
+static void add_orbiting(cs4722::artifact *parent, int count, int depth, float distance, bool frozen,
+                         std::vector<cs4722::artifact *> &all)
+{
+    if (depth == 0) {
+        return;
+    }
+    for (auto i = 0; i < count; ++i) {
+        auto *body = new cs4722::artifact_elliptical_orbit();
+        body->the_shape = &the_sphere;
+        body->aphelion_vector = glm::vec3(distance * (1 + i), 0, 0);
+        body->perihelion_vector = glm::vec3(0, 0, distance * (1 + i) * 0.8f);
+        body->orbital_rate = frozen ? 0.0 : glm::pi<double>() / (4 + i);
+        body->time_offset = i;
+        body->animation_transform.rotation_axis = glm::vec3(0, 1, 0);
+        body->rotation_rate = frozen ? 0.0f : glm::pi<float>() / (2 + i);
+        body->parent = parent;
+        parent->children.push_back(body);
+        all.push_back(body);
+        add_orbiting(body, count, depth - 1, distance / (2 * count), frozen, all);
+    }
+}
+
+static glm::mat4 world_matrix(cs4722::artifact *artf)
+{
+    auto model = artf->animation_transform.matrix() * artf->world_transform.matrix();
+    return artf->parent ? world_matrix(artf->parent) * model : model;
+}
+
+int
+main(int argc, char **argv)
+{
+    auto count = argc > 1 ? std::atoi(argv[1]) : 10;
+    if (count < 1) {
+        count = 1;
+    }
+
+    auto all = std::vector<cs4722::artifact *>();
+    auto roots = std::vector<cs4722::artifact *>();
+    for (auto s = 0; s < count; ++s) {
+        auto *sun = new cs4722::artifact_rotating();
+        sun->the_shape = &the_sphere;
+        sun->world_transform.translate = glm::vec3(s * 1000.0f, 0, 0);
+        sun->animation_transform.rotation_axis = glm::vec3(0, 1, 0);
+        sun->rotation_rate = s % 2 ? 0.0f : glm::pi<float>() / 10;
+        all.push_back(sun);
+        roots.push_back(sun);
+        add_orbiting(sun, count, 3, 400.0f / count, s % 2 == 1, all);
+    }
+
+    auto graph = cs4722::scene_graph(roots);
+    auto per_node_matrices = std::vector<glm::mat4>(graph.size());
+
+    const auto frames = 60;
+    auto per_node_time = 0.0;
+    auto graph_time = 0.0;
+    auto recomputed = 0;
+    auto max_difference = 0.0f;
+    for (auto frame = 0; frame <= frames; ++frame) {
+        auto time = frame / 60.0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (auto *artf: all) {
+            artf->animate(time, 1 / 60.0);
+        }
+        for (auto i = 0; i < graph.size(); ++i) {
+            per_node_matrices[i] = world_matrix(graph.nodes()[i]);
+        }
+        auto middle = std::chrono::steady_clock::now();
+        recomputed = graph.update(time, 1 / 60.0);
+        auto end = std::chrono::steady_clock::now();
+
+        // the first frame computes everything in both ways and is left out of the times
+        if (frame > 0) {
+            per_node_time += std::chrono::duration<double, std::milli>(middle - start).count();
+            graph_time += std::chrono::duration<double, std::milli>(end - middle).count();
+        }
+
+        for (auto i = 0; i < graph.size(); ++i) {
+            for (auto col = 0; col < 4; ++col) {
+                for (auto row = 0; row < 4; ++row) {
+                    auto scale = std::max(1.0f, std::abs(per_node_matrices[i][col][row]));
+                    max_difference = std::max(max_difference, std::abs(
+                            per_node_matrices[i][col][row] - graph.world_matrices[i][col][row]) / scale);
+                }
+            }
+        }
+    }
+
+    std::cout << graph.size() << " artifacts, " << recomputed << " world matrices recomputed per frame" << std::endl;
+    std::cout << "per node " << per_node_time / frames << " ms/frame, scene graph " << graph_time / frames
+              << " ms/frame, speedup " << per_node_time / graph_time << std::endl;
+    std::cout << "largest relative difference " << max_difference << std::endl;
+    std::cout << "bounding sphere of the first solar system: radius " << graph.subtree_bounds[0].radius
+              << std::endl;
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "GLM/mat4x4.hpp"
+#include "GLM/gtc/matrix_inverse.hpp"
+
+#include "cs4722/artifact.h"
+#include "cs4722/transform_store.h"
+
+/**
+ * \file
+ *
+ * Instanced drawing of many artifacts that share a few shapes.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief Per-instance data written for each artifact in a batch.
+     *
+     * The layout matches the `instance` struct in the instanced shaders, using std430 rules.
+     * The material is part of the instance data, so artifacts with different materials can still
+     * be drawn in one call.
+     */
+    struct artifact_instance {
+        glm::mat4 m_transform;
+        glm::mat4 normal_transform;
+        glm::vec4 ambient_color;
+        glm::vec4 diffuse_color;
+        glm::vec4 specular_color;
+        /**
+         * \brief x is the shininess, y is the specular strength.
+         */
+        glm::vec4 shininess_strength;
+    };
+
+
+    /**
+     * \brief Draws a list of artifacts with one instanced draw call per shape.
+     *
+     * The artifacts are grouped by shape.
+     * Each frame, `update` animates every artifact and writes its model and normal transforms and its
+     * material into a shader storage buffer.
+     * The model transforms come from a `model_transform_system`, so only the matrices whose parameters
+     * changed are recomputed.
+     * `draw` then issues one `glDrawArraysInstanced` per group.
+     *
+     * The storage buffer is persistently mapped and split into `frames_in_flight` regions.
+     * A region is written only after the GPU is done with the frame that last used it, which is checked
+     * with a fence, so the CPU writes directly into buffer memory without stalling the draw calls in flight.
+     *
+     * The vertex shader finds the data for an instance at index `first_instance + gl_InstanceID` in the
+     * storage buffer bound at `binding`, where `first_instance` is a uniform set for each group.
+     *
+     * Shapes must already be in the vertex buffers, set up by `init_buffers` or one of its variants
+     * that draw with `glDrawArrays`.
+     */
+    class artifact_batch {
+    public:
+
+        /**
+         * \brief A shape and the artifacts that use it.
+         */
+        struct group {
+            shape *the_shape;
+            std::vector<artifact *> members;
+            GLint first_instance;
+        };
+
+        /**
+         * \brief Group the artifacts in `artifact_list` by shape.
+         *
+         * Call `init_buffers` for the same list first, since it sets the buffer range of each shape.
+         */
+        explicit artifact_batch(std::vector<artifact *> &artifact_list, int frames_in_flight = 3)
+                : frames_in_flight(frames_in_flight)
+        {
+            for (auto *artf: artifact_list) {
+                auto found = std::find_if(groups.begin(), groups.end(),
+                                          [&](const group &g) { return g.the_shape == artf->the_shape; });
+                if (found == groups.end()) {
+                    groups.push_back({artf->the_shape, {}, 0});
+                    found = groups.end() - 1;
+                }
+                found->members.push_back(artf);
+            }
+            for (auto &g: groups) {
+                g.first_instance = instance_count;
+                instance_count += static_cast<GLint>(g.members.size());
+                for (auto *artf: g.members) {
+                    transforms.add(artf);
+                }
+            }
+        }
+
+        artifact_batch(const artifact_batch &) = delete;
+        artifact_batch &operator=(const artifact_batch &) = delete;
+
+        ~artifact_batch()
+        {
+            for (auto fence: fences) {
+                if (fence) glDeleteSync(fence);
+            }
+            if (buffer) {
+                glUnmapNamedBuffer(buffer);
+                glDeleteBuffers(1, &buffer);
+            }
+        }
+
+        /**
+         * \brief Create the persistently mapped storage buffer.
+         *
+         * @param program  Program using the instanced vertex shader
+         * @param storage_binding  Binding point of the instance storage buffer in the shader
+         */
+        void init(GLuint program, GLuint storage_binding = 0)
+        {
+            binding = storage_binding;
+            first_instance_loc = glGetUniformLocation(program, "first_instance");
+
+            GLint alignment = 256;
+            glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+            // a buffer may not be empty, so an empty batch still gets one aligned region per frame
+            auto bytes = std::max<size_t>(sizeof(artifact_instance) * instance_count, 1);
+            region_size = (bytes + alignment - 1) / alignment * alignment;
+
+            auto flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glCreateBuffers(1, &buffer);
+            glNamedBufferStorage(buffer, region_size * frames_in_flight, nullptr, flags);
+            mapped = static_cast<GLubyte *>(glMapNamedBufferRange(buffer, 0, region_size * frames_in_flight,
+                                                                   flags));
+            fences.assign(frames_in_flight, nullptr);
+        }
+
+        /**
+         * \brief Animate the artifacts and write their instance data for this frame.
+         */
+        void update(double time, double delta_time)
+        {
+            current = (current + 1) % frames_in_flight;
+            wait_for_region(current);
+
+            // artifacts were added to the transform system in instance order
+            transforms.update(time, delta_time);
+
+            auto *instance = reinterpret_cast<artifact_instance *>(mapped + region_size * current);
+            for (auto k = 0; k < instance_count; ++k) {
+                auto *artf = transforms.artifacts[k];
+                auto &model_transform = transforms.model_matrices[k];
+                auto &material = artf->surface_material;
+                auto ambient = material.ambient_color.as_array();
+                auto diffuse = material.diffuse_color.as_array();
+                auto specular = material.specular_color.as_array();
+
+                // written field by field so the mapped memory is only ever written, never read
+                instance->m_transform = model_transform;
+                instance->normal_transform = glm::inverseTranspose(model_transform);
+                instance->ambient_color = glm::vec4(ambient[0], ambient[1], ambient[2], ambient[3]);
+                instance->diffuse_color = glm::vec4(diffuse[0], diffuse[1], diffuse[2], diffuse[3]);
+                instance->specular_color = glm::vec4(specular[0], specular[1], specular[2], specular[3]);
+                instance->shininess_strength = glm::vec4(material.shininess, material.specular_strength,
+                                                         0, 0);
+                ++instance;
+            }
+        }
+
+        /**
+         * \brief Draw every group with one instanced draw call.
+         *
+         * The program and vertex array must already be bound, and the uniforms that are the same
+         * for every instance, such as the view-projection transform and the light, must be set.
+         * Nothing is drawn for an empty batch, since binding an empty range is an error.
+         */
+        void draw()
+        {
+            if (instance_count == 0) {
+                return;
+            }
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, buffer, region_size * current,
+                              sizeof(artifact_instance) * instance_count);
+            for (auto &g: groups) {
+                glUniform1i(first_instance_loc, g.first_instance);
+                glDrawArraysInstanced(g.the_shape->drawing_mode, g.the_shape->buffer_start,
+                                      g.the_shape->buffer_size, static_cast<GLsizei>(g.members.size()));
+            }
+            fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+
+        /**
+         * \brief Number of times `update` had to wait for the GPU to release a region.
+         */
+        long stall_count = 0;
+
+        std::vector<group> groups;
+        GLint instance_count = 0;
+
+        /**
+         * \brief Model transforms of the artifacts, in instance order.
+         */
+        model_transform_system transforms;
+
+    private:
+
+        void wait_for_region(int region)
+        {
+            auto fence = fences[region];
+            if (!fence) {
+                return;
+            }
+            auto status = glClientWaitSync(fence, 0, 0);
+            if (status == GL_TIMEOUT_EXPIRED) {
+                ++stall_count;
+                while (status == GL_TIMEOUT_EXPIRED) {
+                    status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+                }
+            }
+            glDeleteSync(fence);
+            fences[region] = nullptr;
+        }
+
+        int frames_in_flight;
+        int current = 0;
+        GLuint binding = 0;
+        GLint first_instance_loc = -1;
+        GLuint buffer = 0;
+        GLubyte *mapped = nullptr;
+        size_t region_size = 0;
+        std::vector<GLsync> fences;
+    };
+
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "GLM/vec3.hpp"
+#include "GLM/mat4x4.hpp"
+#include "GLM/geometric.hpp"
+
+#include "cs4722/shape.h"
+#include "cs4722/shape_attributes.h"
+
+/**
+ * \file
+ *
+ * Bounding volumes for shapes and artifacts.
+ * The volume types themselves are declared in shape_attributes.h, which caches them for each shape.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief The smallest sphere enclosing both `a` and `b`.
+     */
+    inline bounding_sphere merge(const bounding_sphere &a, const bounding_sphere &b)
+    {
+        if (a.empty()) return b;
+        if (b.empty()) return a;
+        auto offset = b.center - a.center;
+        auto distance = glm::length(offset);
+        if (distance + b.radius <= a.radius) return a;
+        if (distance + a.radius <= b.radius) return b;
+        auto radius = (distance + a.radius + b.radius) / 2;
+        return {a.center + offset * ((radius - a.radius) / distance), radius};
+    }
+
+
+    /**
+     * \brief The sphere `s` after applying the affine matrix `m`.
+     *
+     * The radius is scaled by the largest scale factor of `m`, so the result still encloses the
+     * transformed geometry when the scaling is not uniform.
+     */
+    inline bounding_sphere transform_sphere(const glm::mat4 &m, const bounding_sphere &s)
+    {
+        if (s.empty()) return s;
+        auto scale2 = std::max({glm::dot(glm::vec3(m[0]), glm::vec3(m[0])),
+                                glm::dot(glm::vec3(m[1]), glm::vec3(m[1])),
+                                glm::dot(glm::vec3(m[2]), glm::vec3(m[2]))});
+        return {glm::vec3(m * glm::vec4(s.center, 1)), s.radius * std::sqrt(scale2)};
+    }
+
+
+    /**
+     * \brief The axis aligned bounding box of a shape in its own coordinates.
+     *
+     * It is computed the first time it is asked for and kept with the rest of `attributes_of(the_shape)`,
+     * so `forget_attributes_of` drops it too.
+     */
+    inline const bounding_box &local_bounding_box(shape *the_shape)
+    {
+        return attributes_of(the_shape).box();
+    }
+
+
+    /**
+     * \brief The bounding sphere of a shape in its own coordinates.
+     *
+     * The sphere is centered on the middle of `local_bounding_box`.
+     * It is computed the first time it is asked for and kept with the rest of `attributes_of(the_shape)`.
+     */
+    inline const bounding_sphere &local_bounding_sphere(shape *the_shape)
+    {
+        return attributes_of(the_shape).sphere();
+    }
+
+}
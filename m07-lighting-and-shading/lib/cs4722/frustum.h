@@ -0,0 +1,171 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "GLM/vec4.hpp"
+#include "GLM/mat4x4.hpp"
+#include "GLM/geometric.hpp"
+#include "GLM/ext/matrix_clip_space.hpp"
+#include "GLM/ext/matrix_transform.hpp"
+
+#include "cs4722/bounds.h"
+#include "cs4722/view.h"
+
+/**
+ * \file
+ *
+ * The region of space seen by the camera, and culling of bounding spheres against it.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief The planes bounding the region of space a camera can see.
+     *
+     * The display loops use `glm::infinitePerspective`, which has no far plane, so a frustum is bounded by
+     * five planes: left, right, bottom, top, and near.
+     * Each plane is stored as (normal, offset) with the normal pointing inward and of length 1,
+     * so `dot(normal, p) + offset` is the signed distance of point `p` from the plane.
+     */
+    class frustum {
+    public:
+
+        static constexpr int plane_count = 5;
+
+        /**
+         * \brief The frustum of a view-projection transform, such as `projection * view`.
+         */
+        explicit frustum(const glm::mat4 &vp_transform)
+        {
+            auto row = [&](int r) {
+                return glm::vec4(vp_transform[0][r], vp_transform[1][r], vp_transform[2][r], vp_transform[3][r]);
+            };
+            auto w = row(3);
+            planes = {w + row(0), w - row(0), w + row(1), w - row(1), w + row(2)};
+            for (auto &plane: planes) {
+                plane /= glm::length(glm::vec3(plane));
+            }
+        }
+
+        /**
+         * \brief The frustum of the camera in `the_view`, using the same perspective as the display loops.
+         */
+        explicit frustum(const view &the_view)
+                : frustum(glm::infinitePerspective(the_view.perspective_fovy, the_view.perspective_aspect,
+                                                   the_view.perspective_near)
+                          * glm::lookAt(the_view.camera_position,
+                                        the_view.camera_position + the_view.camera_forward,
+                                        the_view.camera_up))
+        {}
+
+        /**
+         * \brief True if some part of `sphere` may be inside the frustum.
+         */
+        bool intersects(const bounding_sphere &sphere) const
+        {
+            for (auto &plane: planes) {
+                if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) {
+                    return false;
+                }
+            }
+            return !sphere.empty();
+        }
+
+        std::array<glm::vec4, plane_count> planes;
+    };
+
+
+    /**
+     * \brief Finds which of a list of bounding spheres can be seen, and keeps counts of the work.
+     *
+     * `cull` tests every sphere against all of the planes with no early exit, so the loop has no branches
+     * and the compiler can vectorize it over the spheres.
+     * The indices of the spheres that may be visible are then collected in `visible`.
+     * Empty spheres are never visible.
+     *
+     * The counters accumulate over calls until `reset_counters`.
+     */
+    class frustum_culler {
+    public:
+
+        /**
+         * \brief Fill `visible` with the indices of the spheres that intersect `the_frustum`.
+         */
+        void cull(const frustum &the_frustum, std::span<const bounding_sphere> spheres)
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            auto n = spheres.size();
+            inside.resize(n);
+            auto &p = the_frustum.planes;
+            for (size_t i = 0; i < n; ++i) {
+                auto &s = spheres[i];
+                // starting from the radius makes empty spheres, whose radius is negative, fail
+                auto distance = s.radius;
+                for (auto k = 0; k < frustum::plane_count; ++k) {
+                    distance = std::min(distance, p[k].x * s.center.x + p[k].y * s.center.y
+                                                  + p[k].z * s.center.z + p[k].w + s.radius);
+                }
+                inside[i] = distance >= 0;
+            }
+
+            visible.clear();
+            for (size_t i = 0; i < n; ++i) {
+                if (inside[i]) {
+                    visible.push_back(static_cast<int>(i));
+                }
+            }
+
+            last_milliseconds = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+            total_milliseconds += last_milliseconds;
+            ++calls;
+            tested += static_cast<long>(n);
+            culled += static_cast<long>(n - visible.size());
+        }
+
+        /**
+         * \brief Percentage of the spheres tested since the counters were reset that were culled.
+         */
+        double culled_percentage() const
+        {
+            return tested == 0 ? 0.0 : 100.0 * culled / tested;
+        }
+
+        /**
+         * \brief Average time of a call to `cull` since the counters were reset.
+         */
+        double average_milliseconds() const
+        {
+            return calls == 0 ? 0.0 : total_milliseconds / calls;
+        }
+
+        void reset_counters()
+        {
+            total_milliseconds = 0;
+            calls = 0;
+            tested = 0;
+            culled = 0;
+        }
+
+        /**
+         * \brief Indices of the spheres found visible by the last call of `cull`, in increasing order.
+         */
+        std::vector<int> visible;
+
+        double last_milliseconds = 0;
+        double total_milliseconds = 0;
+        long calls = 0;
+        long tested = 0;
+        long culled = 0;
+
+    private:
+        std::vector<std::uint8_t> inside;
+    };
+
+}
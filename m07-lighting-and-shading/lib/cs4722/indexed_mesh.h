@@ -0,0 +1,433 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "cs4722/artifact.h"
+#include "cs4722/shape_attributes.h"
+
+/**
+ * \file
+ *
+ * Indexed versions of the vertex data provided by `cs4722::shape`.
+ *
+ * The shapes describe their triangles as a list of vertices, three per triangle, so a vertex shared
+ * by several triangles is repeated for each of them.
+ * The functions here weld identical vertices into one, describe the triangles with a list of indices
+ * instead, and reorder the triangles so that recently transformed vertices are reused as often as possible.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief Vertex data for a shape where each distinct vertex appears once, plus a list of indices.
+     *
+     * Only the attributes requested when the mesh was built are filled in, the other lists are empty.
+     */
+    struct indexed_mesh {
+        std::vector<glm::vec4> positions;
+        std::vector<cs4722::color> colors;
+        std::vector<glm::vec2> texture_coordinates;
+        std::vector<glm::vec4> normals;
+        std::vector<glm::vec4> tangents;
+
+        /**
+         * \brief Indices into the attribute lists, three per triangle when the shape uses `GL_TRIANGLES`.
+         */
+        std::vector<GLuint> indices;
+
+        int vertex_count() const
+        {
+            return static_cast<int>(positions.size());
+        }
+    };
+
+
+    /**
+     * \brief Build an indexed mesh from a shape by welding vertices that have identical attributes.
+     *
+     * Two vertices are welded only if every requested attribute matches exactly.
+     * Attributes that will not be sent to the shader should not be requested, since they can
+     * keep vertices apart.
+     * For example, the `colors` of most shapes change from triangle to triangle, so asking for colors
+     * leaves almost nothing to weld.
+     *
+     * The shape's lists are read through `attributes_of`, so they are generated only once.
+     */
+    inline indexed_mesh weld_vertices(shape *the_shape, bool use_colors, bool use_texture_coordinates,
+                                      bool use_normals, bool use_tangents)
+    {
+        auto &attributes = attributes_of(the_shape);
+        auto positions = attributes.positions();
+        auto colors = use_colors ? attributes.colors() : std::span<const cs4722::color>();
+        auto texture_coordinates = use_texture_coordinates ? attributes.texture_coordinates()
+                : std::span<const glm::vec2>();
+        auto normals = use_normals ? attributes.normals() : std::span<const glm::vec4>();
+        auto tangents = use_tangents ? attributes.tangents() : std::span<const glm::vec4>();
+
+        // a list that is shorter than the position list (tangents are not provided by every shape)
+        //      is treated as not requested
+        auto count = positions.size();
+        if (colors.size() < count) colors = {};
+        if (texture_coordinates.size() < count) texture_coordinates = {};
+        if (normals.size() < count) normals = {};
+        if (tangents.size() < count) tangents = {};
+
+        // the key for a vertex is the bytes of all of its requested attributes
+        const auto key_size = sizeof(glm::vec4) * 3 + sizeof(glm::vec2) + sizeof(cs4722::color);
+        auto key_of = [&](size_t v) {
+            auto key = std::string(key_size, '\0');
+            auto *at = key.data();
+            std::memcpy(at, &positions[v], sizeof(glm::vec4));
+            at += sizeof(glm::vec4);
+            if (!normals.empty()) std::memcpy(at, &normals[v], sizeof(glm::vec4));
+            at += sizeof(glm::vec4);
+            if (!tangents.empty()) std::memcpy(at, &tangents[v], sizeof(glm::vec4));
+            at += sizeof(glm::vec4);
+            if (!texture_coordinates.empty()) std::memcpy(at, &texture_coordinates[v], sizeof(glm::vec2));
+            at += sizeof(glm::vec2);
+            if (!colors.empty()) std::memcpy(at, &colors[v], sizeof(cs4722::color));
+            return key;
+        };
+
+        auto mesh = indexed_mesh();
+        mesh.indices.reserve(count);
+        auto first_use = std::unordered_map<std::string, GLuint>();
+        first_use.reserve(count);
+        for (size_t v = 0; v < count; ++v) {
+            auto next_index = static_cast<GLuint>(mesh.positions.size());
+            auto [entry, is_new] = first_use.try_emplace(key_of(v), next_index);
+            if (is_new) {
+                mesh.positions.push_back(positions[v]);
+                if (!colors.empty()) mesh.colors.push_back(colors[v]);
+                if (!texture_coordinates.empty()) mesh.texture_coordinates.push_back(texture_coordinates[v]);
+                if (!normals.empty()) mesh.normals.push_back(normals[v]);
+                if (!tangents.empty()) mesh.tangents.push_back(tangents[v]);
+            }
+            mesh.indices.push_back(entry->second);
+        }
+        return mesh;
+    }
+
+
+    /**
+     * \brief Number of vertices in the post-transform vertex cache, as modelled by
+     * `average_cache_miss_ratio` and `optimize_vertex_cache`.
+     */
+    inline constexpr int vertex_cache_size = 32;
+
+
+    /**
+     * \brief Average cache miss ratio: the number of vertices transformed per triangle.
+     *
+     * The post-transform vertex cache is modelled as an LRU list holding `cache_size` vertices, updated
+     * one triangle at a time, the same model `optimize_vertex_cache` uses to choose the triangle order.
+     * A list where no vertex is used twice scores 3.0, the best possible score for a large mesh is about 0.5.
+     */
+    inline double average_cache_miss_ratio(const std::vector<GLuint> &indices,
+                                           int cache_size = vertex_cache_size)
+    {
+        if (indices.size() < 3) {
+            return 0.0;
+        }
+        auto cache = std::vector<GLuint>();
+        auto new_cache = std::vector<GLuint>();
+        auto misses = 0ll;
+        for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+            new_cache.assign(indices.begin() + t, indices.begin() + t + 3);
+            for (auto c = 0; c < 3; ++c) {
+                if (std::find(cache.begin(), cache.end(), indices[t + c]) == cache.end()) {
+                    ++misses;
+                }
+            }
+            for (auto v: cache) {
+                if (std::find(new_cache.begin(), new_cache.end(), v) == new_cache.end()) {
+                    new_cache.push_back(v);
+                }
+            }
+            if (new_cache.size() > static_cast<size_t>(cache_size)) {
+                new_cache.resize(cache_size);
+            }
+            std::swap(cache, new_cache);
+        }
+        return static_cast<double>(misses) / (indices.size() / 3);
+    }
+
+
+    /**
+     * \brief Reorder triangles to make good use of the post-transform vertex cache.
+     *
+     * This is Tom Forsyth's "linear-speed vertex cache optimisation".
+     * Each vertex gets a score from its position in a simulated LRU cache and from the number of
+     * triangles still using it.
+     * The next triangle drawn is always the one with the highest total score, which is found among the
+     * triangles of the vertices in the cache.
+     *
+     * After the triangles are reordered the vertices are renumbered in the order of first use, so
+     * vertex fetches also walk through the buffers in order.
+     * The attribute lists of `mesh` are permuted to match.
+     */
+    inline void optimize_vertex_cache(indexed_mesh &mesh)
+    {
+        const auto cache_size = vertex_cache_size;
+        const auto triangle_count = mesh.indices.size() / 3;
+        const auto vertex_count = mesh.positions.size();
+        if (triangle_count == 0) {
+            return;
+        }
+
+        auto vertex_score = [](int cache_position, int remaining) {
+            if (remaining == 0) {
+                return -1.0f;
+            }
+            auto score = 0.0f;
+            if (cache_position >= 0) {
+                // the three vertices of the triangle just drawn get a fixed score so that
+                //      strips are not favoured over fans
+                score = cache_position < 3 ? 0.75f
+                        : std::pow(1.0f - (cache_position - 3) / float(cache_size - 3), 1.5f);
+            }
+            return score + 2.0f / std::sqrt(static_cast<float>(remaining));
+        };
+
+        // triangles using each vertex, stored in one list with offsets
+        auto remaining = std::vector<int>(vertex_count, 0);
+        for (auto index: mesh.indices) {
+            ++remaining[index];
+        }
+        auto offset = std::vector<size_t>(vertex_count + 1, 0);
+        for (size_t v = 0; v < vertex_count; ++v) {
+            offset[v + 1] = offset[v] + remaining[v];
+        }
+        auto vertex_triangles = std::vector<GLuint>(offset.back());
+        auto fill = std::vector<size_t>(offset.begin(), offset.end() - 1);
+        for (size_t t = 0; t < triangle_count; ++t) {
+            for (auto c = 0; c < 3; ++c) {
+                vertex_triangles[fill[mesh.indices[3 * t + c]]++] = static_cast<GLuint>(t);
+            }
+        }
+
+        auto cache_position = std::vector<int>(vertex_count, -1);
+        auto score = std::vector<float>(vertex_count);
+        for (size_t v = 0; v < vertex_count; ++v) {
+            score[v] = vertex_score(-1, remaining[v]);
+        }
+        auto triangle_score = std::vector<float>(triangle_count);
+        auto drawn = std::vector<bool>(triangle_count, false);
+        for (size_t t = 0; t < triangle_count; ++t) {
+            triangle_score[t] = score[mesh.indices[3 * t]] + score[mesh.indices[3 * t + 1]]
+                    + score[mesh.indices[3 * t + 2]];
+        }
+
+        auto cache = std::vector<GLuint>();
+        auto new_cache = std::vector<GLuint>();
+        auto reordered = std::vector<GLuint>();
+        reordered.reserve(mesh.indices.size());
+
+        auto best = static_cast<long long>(std::max_element(triangle_score.begin(), triangle_score.end())
+                                           - triangle_score.begin());
+        size_t scan_from = 0;
+        for (size_t emitted = 0; emitted < triangle_count; ++emitted) {
+            if (best < 0) {
+                // nothing in the cache has triangles left, continue with the next undrawn triangle
+                while (drawn[scan_from]) {
+                    ++scan_from;
+                }
+                best = static_cast<long long>(scan_from);
+            }
+            drawn[best] = true;
+
+            new_cache.clear();
+            for (auto c = 0; c < 3; ++c) {
+                auto v = mesh.indices[3 * best + c];
+                reordered.push_back(v);
+                new_cache.push_back(v);
+
+                // remove the triangle from the vertex's list of remaining triangles
+                auto *first = &vertex_triangles[offset[v]];
+                auto *last = first + remaining[v];
+                std::iter_swap(std::find(first, last, static_cast<GLuint>(best)), last - 1);
+                --remaining[v];
+            }
+            for (auto v: cache) {
+                if (std::find(new_cache.begin(), new_cache.end(), v) == new_cache.end()) {
+                    new_cache.push_back(v);
+                }
+            }
+
+            // update cache positions and scores, vertices that fell out of the cache go back to -1
+            for (size_t p = 0; p < new_cache.size(); ++p) {
+                auto v = new_cache[p];
+                cache_position[v] = p < cache_size ? static_cast<int>(p) : -1;
+                score[v] = vertex_score(cache_position[v], remaining[v]);
+            }
+
+            best = -1;
+            auto best_score = -1.0f;
+            for (auto v: new_cache) {
+                for (auto i = offset[v]; i < offset[v] + remaining[v]; ++i) {
+                    auto t = vertex_triangles[i];
+                    triangle_score[t] = score[mesh.indices[3 * t]] + score[mesh.indices[3 * t + 1]]
+                            + score[mesh.indices[3 * t + 2]];
+                    if (triangle_score[t] > best_score) {
+                        best_score = triangle_score[t];
+                        best = t;
+                    }
+                }
+            }
+
+            if (new_cache.size() > cache_size) {
+                new_cache.resize(cache_size);
+            }
+            std::swap(cache, new_cache);
+        }
+
+        // renumber vertices in order of first use
+        auto new_index = std::vector<GLuint>(vertex_count, ~0u);
+        auto next_index = GLuint(0);
+        auto order = std::vector<GLuint>();
+        order.reserve(vertex_count);
+        for (auto &index: reordered) {
+            if (new_index[index] == ~0u) {
+                new_index[index] = next_index++;
+                order.push_back(index);
+            }
+            index = new_index[index];
+        }
+        mesh.indices = std::move(reordered);
+
+        auto permute = [&](auto &list) {
+            if (list.empty()) {
+                return;
+            }
+            auto permuted = std::remove_reference_t<decltype(list)>();
+            permuted.reserve(order.size());
+            for (auto v: order) {
+                permuted.push_back(list[v]);
+            }
+            list = std::move(permuted);
+        };
+        permute(mesh.positions);
+        permute(mesh.colors);
+        permute(mesh.texture_coordinates);
+        permute(mesh.normals);
+        permute(mesh.tangents);
+    }
+
+
+    /**
+     * \brief Weld the vertices of a shape and, for triangle shapes, optimize the triangle order.
+     */
+    inline indexed_mesh make_indexed_mesh(shape *the_shape, bool use_colors, bool use_texture_coordinates,
+                                          bool use_normals, bool use_tangents)
+    {
+        auto mesh = weld_vertices(the_shape, use_colors, use_texture_coordinates, use_normals, use_tangents);
+        if (the_shape->drawing_mode == GL_TRIANGLES) {
+            optimize_vertex_cache(mesh);
+        }
+        return mesh;
+    }
+
+
+    /**
+     *  \brief Initializes indexed buffers, the same way as `init_buffers`, plus an element array buffer.
+     *
+     * The parameters have the same meaning as for `init_buffers`.
+     * Each shape is welded and optimized with `make_indexed_mesh` and then stored once in the buffers.
+     *
+     * As with `pack_interleaved`, attributes that a shape does not provide are filled with zeros.
+     *
+     * For each shape, `buffer_start` and `buffer_size` describe the range of the element array buffer
+     * used by that shape, rather than a range of vertices.
+     * The indices already include the offset of the shape's vertices, so a shape is drawn with
+     *
+     * `glDrawElements(shape->drawing_mode, shape->buffer_size, GL_UNSIGNED_INT,
+     *      reinterpret_cast<void*>(shape->buffer_start * sizeof(GLuint)));`
+     *
+     * @return Return the VAO assigned to this buffer collection
+     */
+    inline GLuint init_indexed_buffers(GLuint program, std::vector<cs4722::artifact *> &part_list,
+                                       const char *position_var, const char *color_var = "",
+                                       const char *texture_var = "", const char *normal_var = "",
+                                       const char *tangent_var = "")
+    {
+        auto use_colors = std::strlen(color_var) > 0;
+        auto use_texture = std::strlen(texture_var) > 0;
+        auto use_normals = std::strlen(normal_var) > 0;
+        auto use_tangents = std::strlen(tangent_var) > 0;
+
+        auto all = indexed_mesh();
+        auto done = std::vector<cs4722::shape *>();
+        for (auto *part: part_list) {
+            auto *the_shape = part->the_shape;
+            if (std::find(done.begin(), done.end(), the_shape) != done.end()) {
+                continue;
+            }
+            done.push_back(the_shape);
+
+            auto mesh = make_indexed_mesh(the_shape, use_colors, use_texture, use_normals, use_tangents);
+            auto base = static_cast<GLuint>(all.positions.size());
+            the_shape->buffer_start = static_cast<int>(all.indices.size());
+            the_shape->buffer_size = static_cast<int>(mesh.indices.size());
+            for (auto index: mesh.indices) {
+                all.indices.push_back(base + index);
+            }
+            all.positions.insert(all.positions.end(), mesh.positions.begin(), mesh.positions.end());
+            all.colors.insert(all.colors.end(), mesh.colors.begin(), mesh.colors.end());
+            all.texture_coordinates.insert(all.texture_coordinates.end(),
+                                           mesh.texture_coordinates.begin(), mesh.texture_coordinates.end());
+            all.normals.insert(all.normals.end(), mesh.normals.begin(), mesh.normals.end());
+            all.tangents.insert(all.tangents.end(), mesh.tangents.begin(), mesh.tangents.end());
+
+            // a shape that does not provide a requested attribute (tangents for most shapes) gets zeros,
+            //      so every list stays as long as the position list and the indices of later shapes line up
+            auto vertex_count = all.positions.size();
+            if (use_colors) all.colors.resize(vertex_count, cs4722::color());
+            if (use_texture) all.texture_coordinates.resize(vertex_count, glm::vec2(0.0f));
+            if (use_normals) all.normals.resize(vertex_count, glm::vec4(0.0f));
+            if (use_tangents) all.tangents.resize(vertex_count, glm::vec4(0.0f));
+        }
+
+        GLuint vao;
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+
+        auto attribute = [&](const char *var, const void *data, size_t bytes, GLint components, GLenum type,
+                             GLboolean normalized) {
+            if (std::strlen(var) == 0 || bytes == 0) {
+                return;
+            }
+            GLuint buffer;
+            glCreateBuffers(1, &buffer);
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glBufferStorage(GL_ARRAY_BUFFER, bytes, data, 0);
+            auto location = glGetAttribLocation(program, var);
+            glVertexAttribPointer(location, components, type, normalized, 0, nullptr);
+            glEnableVertexAttribArray(location);
+        };
+        attribute(position_var, all.positions.data(), sizeof(glm::vec4) * all.positions.size(),
+                  4, GL_FLOAT, GL_FALSE);
+        attribute(color_var, all.colors.data(), sizeof(cs4722::color) * all.colors.size(),
+                  4, GL_UNSIGNED_BYTE, GL_TRUE);
+        attribute(texture_var, all.texture_coordinates.data(),
+                  sizeof(glm::vec2) * all.texture_coordinates.size(), 2, GL_FLOAT, GL_FALSE);
+        attribute(normal_var, all.normals.data(), sizeof(glm::vec4) * all.normals.size(),
+                  4, GL_FLOAT, GL_FALSE);
+        attribute(tangent_var, all.tangents.data(), sizeof(glm::vec4) * all.tangents.size(),
+                  4, GL_FLOAT, GL_FALSE);
+
+        GLuint element_buffer;
+        glCreateBuffers(1, &element_buffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer);
+        glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * all.indices.size(), all.indices.data(), 0);
+
+        return vao;
+    }
+
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "GLM/packing.hpp"
+#include "GLM/gtc/packing.hpp"
+
+#include "cs4722/artifact.h"
+#include "cs4722/shape_attributes.h"
+
+/**
+ * \file
+ *
+ * An alternative to `init_buffers` that stores all of the attributes of a vertex next to each other in
+ * a single buffer, rather than one buffer per attribute.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief Options for the interleaved vertex layout.
+     */
+    struct interleave_options {
+        /**
+         * \brief Store normals and tangents as four half floats (8 bytes) rather than four floats (16 bytes).
+         */
+        bool half_float_normals = false;
+
+        /**
+         * \brief Store texture coordinates as two 16 bit unsigned normalized integers.
+         *
+         * Only coordinates in the range 0 to 1 can be represented, other values are clamped.
+         * Do not use this with a `rectangle` whose texture scales are larger than 1.
+         */
+        bool unorm16_texture_coordinates = false;
+    };
+
+
+    /**
+     * \brief Position of one attribute within an interleaved vertex.
+     */
+    struct vertex_attribute_format {
+        const char *variable = "";
+        GLint components = 0;
+        GLenum type = GL_FLOAT;
+        GLboolean normalized = GL_FALSE;
+        GLuint offset = 0;
+        GLuint size = 0;
+
+        bool used() const
+        {
+            return size > 0;
+        }
+    };
+
+
+    /**
+     * \brief Stride and attribute offsets for an interleaved vertex.
+     *
+     * An attribute is part of the layout only if its variable name is not empty, the same rule
+     * `init_buffers` uses.
+     * Positions are stored as three floats, the shader receives 1 as the fourth coordinate.
+     * Every attribute starts on a four byte boundary.
+     */
+    struct vertex_layout {
+
+        vertex_layout(const char *position_var, const char *color_var, const char *texture_var,
+                      const char *normal_var, const char *tangent_var,
+                      interleave_options options = interleave_options())
+                : options(options)
+        {
+            auto next = [&](vertex_attribute_format &format, const char *var, GLint components, GLenum type,
+                            GLboolean normalized, GLuint size) {
+                if (std::strlen(var) == 0) {
+                    return;
+                }
+                format = {var, components, type, normalized, stride, size};
+                stride += (size + 3) & ~3u;
+            };
+            next(position, position_var, 3, GL_FLOAT, GL_FALSE, 12);
+            next(color, color_var, 4, GL_UNSIGNED_BYTE, GL_TRUE, 4);
+            if (options.unorm16_texture_coordinates) {
+                next(texture_coordinate, texture_var, 2, GL_UNSIGNED_SHORT, GL_TRUE, 4);
+            } else {
+                next(texture_coordinate, texture_var, 2, GL_FLOAT, GL_FALSE, 8);
+            }
+            if (options.half_float_normals) {
+                next(normal, normal_var, 4, GL_HALF_FLOAT, GL_FALSE, 8);
+                next(tangent, tangent_var, 4, GL_HALF_FLOAT, GL_FALSE, 8);
+            } else {
+                next(normal, normal_var, 4, GL_FLOAT, GL_FALSE, 16);
+                next(tangent, tangent_var, 4, GL_FLOAT, GL_FALSE, 16);
+            }
+        }
+
+        interleave_options options;
+        vertex_attribute_format position, color, texture_coordinate, normal, tangent;
+        GLuint stride = 0;
+    };
+
+
+    /**
+     * \brief Pack the vertex data for the shapes used by `part_list` into one interleaved array.
+     *
+     * As with `init_buffers`, a shape shared by several parts is stored once and its `buffer_start` and
+     * `buffer_size` are set to its range of vertices.
+     *
+     * Attribute lists that the shape does not provide (tangents for most shapes) are filled with zeros.
+     */
+    inline std::vector<GLubyte> pack_interleaved(std::vector<cs4722::artifact *> &part_list,
+                                                 const vertex_layout &layout)
+    {
+        auto shapes = std::vector<cs4722::shape *>();
+        auto vertex_count = size_t(0);
+        for (auto *part: part_list) {
+            if (std::find(shapes.begin(), shapes.end(), part->the_shape) == shapes.end()) {
+                shapes.push_back(part->the_shape);
+                vertex_count += part->the_shape->get_size();
+            }
+        }
+
+        auto data = std::vector<GLubyte>(vertex_count * layout.stride);
+        auto start = 0;
+        for (auto *the_shape: shapes) {
+            auto count = the_shape->get_size();
+            the_shape->buffer_start = start;
+            the_shape->buffer_size = count;
+            auto *base = data.data() + static_cast<size_t>(start) * layout.stride;
+            auto &attributes = attributes_of(the_shape);
+
+            if (layout.position.used()) {
+                auto list = attributes.positions();
+                for (auto v = 0; v < count && v < static_cast<int>(list.size()); ++v) {
+                    std::memcpy(base + v * layout.stride + layout.position.offset, &list[v], 12);
+                }
+            }
+            if (layout.color.used()) {
+                auto list = attributes.colors();
+                for (auto v = 0; v < count && v < static_cast<int>(list.size()); ++v) {
+                    std::memcpy(base + v * layout.stride + layout.color.offset, &list[v], 4);
+                }
+            }
+            if (layout.texture_coordinate.used()) {
+                auto list = attributes.texture_coordinates();
+                for (auto v = 0; v < count && v < static_cast<int>(list.size()); ++v) {
+                    auto *to = base + v * layout.stride + layout.texture_coordinate.offset;
+                    if (layout.options.unorm16_texture_coordinates) {
+                        auto packed = glm::packUnorm2x16(list[v]);
+                        std::memcpy(to, &packed, 4);
+                    } else {
+                        std::memcpy(to, &list[v], 8);
+                    }
+                }
+            }
+            auto pack_direction = [&](const vertex_attribute_format &format, std::span<const glm::vec4> list) {
+                for (auto v = 0; v < count && v < static_cast<int>(list.size()); ++v) {
+                    auto *to = base + v * layout.stride + format.offset;
+                    if (layout.options.half_float_normals) {
+                        auto packed = glm::packHalf4x16(list[v]);
+                        std::memcpy(to, &packed, 8);
+                    } else {
+                        std::memcpy(to, &list[v], 16);
+                    }
+                }
+            };
+            if (layout.normal.used()) {
+                pack_direction(layout.normal, attributes.normals());
+            }
+            if (layout.tangent.used()) {
+                pack_direction(layout.tangent, attributes.tangents());
+            }
+
+            start += count;
+        }
+        return data;
+    }
+
+
+    /**
+     *  \brief Initializes a single interleaved buffer holding all of the requested vertex attributes.
+     *
+     * The parameters have the same meaning as for `init_buffers` and shapes are drawn the same way,
+     * with `glDrawArrays(shape->drawing_mode, shape->buffer_start, shape->buffer_size)`.
+     * The stride and offsets are chosen by `vertex_layout` from the variable names that are not empty.
+     *
+     * @param options  Optional compact encodings for normals, tangents and texture coordinates
+     * @return Return the VAO assigned to this buffer
+     */
+    inline GLuint init_interleaved_buffers(GLuint program, std::vector<cs4722::artifact *> &part_list,
+                                           const char *position_var, const char *color_var = "",
+                                           const char *texture_var = "", const char *normal_var = "",
+                                           const char *tangent_var = "",
+                                           interleave_options options = interleave_options())
+    {
+        auto layout = vertex_layout(position_var, color_var, texture_var, normal_var, tangent_var, options);
+        auto data = pack_interleaved(part_list, layout);
+
+        GLuint vao;
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+
+        GLuint buffer;
+        glCreateBuffers(1, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferStorage(GL_ARRAY_BUFFER, data.size(), data.data(), 0);
+
+        for (auto *format: {&layout.position, &layout.color, &layout.texture_coordinate,
+                            &layout.normal, &layout.tangent}) {
+            if (!format->used()) {
+                continue;
+            }
+            auto location = glGetAttribLocation(program, format->variable);
+            glVertexAttribPointer(location, format->components, format->type, format->normalized,
+                                  static_cast<GLsizei>(layout.stride),
+                                  reinterpret_cast<void *>(static_cast<uintptr_t>(format->offset)));
+            glEnableVertexAttribArray(location);
+        }
+
+        return vao;
+    }
+
+}
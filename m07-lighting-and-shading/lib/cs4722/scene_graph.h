@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+#include "GLM/mat4x4.hpp"
+
+#include "cs4722/artifact.h"
+#include "cs4722/bounds.h"
+#include "cs4722/transform_store.h"
+
+/**
+ * \file
+ *
+ * Artifacts arranged in a hierarchy through their `parent` and `children` fields.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief Computes world matrices and bounding spheres for a hierarchy of artifacts.
+     *
+     * The model matrix of an artifact, `animation_transform.matrix() * world_transform.matrix()`, places it
+     * relative to its parent.
+     * The world matrix is the product of the model matrices along the path from the root, so a moon
+     * placed relative to its planet follows the planet around the sun.
+     *
+     * The artifacts are stored in depth first order, so a parent always comes before its children and
+     * every subtree is a contiguous range.
+     * `update` computes all of the world matrices in a single pass through that order, each one from the
+     * already computed world matrix of its parent, so no node walks up to its root.
+     * Only the subtrees that contain a changed model matrix are visited, the others are skipped in one step.
+     *
+     * Each node also has the bounding sphere of its own shape in world coordinates, `node_bounds`,
+     * and a sphere enclosing its whole subtree, `subtree_bounds`.
+     */
+    class scene_graph {
+    public:
+
+        /**
+         * \brief Build the hierarchy containing the artifacts in `artifact_list`.
+         *
+         * The trees are found through the `parent` and `children` fields, so it is enough to list the roots.
+         * Listing other artifacts of the same tree does not add them twice.
+         * The hierarchy must not change after this.
+         */
+        explicit scene_graph(const std::vector<artifact *> &artifact_list)
+        {
+            auto roots = std::unordered_set<artifact *>();
+            for (auto *artf: artifact_list) {
+                while (artf->parent) {
+                    artf = artf->parent;
+                }
+                if (roots.insert(artf).second) {
+                    add_tree(artf);
+                }
+            }
+            world_matrices.assign(size(), glm::mat4(1.0f));
+            node_bounds.assign(size(), bounding_sphere());
+            subtree_bounds.assign(size(), bounding_sphere());
+            world_changed.assign(size(), 0);
+            subtree_changed.assign(size(), 0);
+        }
+
+        int size() const
+        {
+            return static_cast<int>(parents.size());
+        }
+
+        /**
+         * \brief The artifacts in depth first order, matching the indices of the other lists.
+         */
+        const std::vector<artifact *> &nodes() const
+        {
+            return local.artifacts;
+        }
+
+        /**
+         * \brief Animate every artifact and bring the world matrices and bounds up to date.
+         *
+         * @return The number of world matrices recomputed
+         */
+        int update(double time, double delta_time)
+        {
+            local.update(time, delta_time);
+
+            // mark each node with a changed model matrix and its ancestors, stopping at the first
+            //      ancestor already marked
+            for (auto i: local.last_changed()) {
+                world_changed[i] = 1;
+                for (auto j = i; j >= 0 && !subtree_changed[j]; j = parents[j]) {
+                    subtree_changed[j] = 1;
+                }
+            }
+
+            updated.clear();
+            for (auto i = 0; i < size();) {
+                auto p = parents[i];
+                auto parent_changed = p >= 0 && world_changed[p];
+                if (!parent_changed && !subtree_changed[i]) {
+                    i = subtree_ends[i];
+                    continue;
+                }
+                if (parent_changed || world_changed[i]) {
+                    world_changed[i] = 1;
+                    world_matrices[i] = p < 0 ? local.model_matrices[i]
+                                              : affine_multiply(world_matrices[p], local.model_matrices[i]);
+                    auto *the_shape = local.artifacts[i]->the_shape;
+                    node_bounds[i] = the_shape ? transform_sphere(world_matrices[i], local_bounding_sphere(the_shape))
+                                               : bounding_sphere();
+                    updated.push_back(i);
+                }
+                ++i;
+            }
+
+            // subtree spheres, children before parents
+            for (auto i = size() - 1; i >= 0; --i) {
+                if (world_changed[i] || subtree_changed[i]) {
+                    auto sphere = node_bounds[i];
+                    for (auto child = i + 1; child < subtree_ends[i]; child = subtree_ends[child]) {
+                        sphere = merge(sphere, subtree_bounds[child]);
+                    }
+                    subtree_bounds[i] = sphere;
+                }
+            }
+
+            for (auto i: updated) {
+                world_changed[i] = 0;
+            }
+            for (auto i: local.last_changed()) {
+                world_changed[i] = 0;
+                for (auto j = i; j >= 0 && subtree_changed[j]; j = parents[j]) {
+                    subtree_changed[j] = 0;
+                }
+            }
+            return static_cast<int>(updated.size());
+        }
+
+        /**
+         * \brief Index of the parent of each node, -1 for a root.
+         */
+        std::vector<int> parents;
+
+        /**
+         * \brief One past the last index of the subtree rooted at each node.
+         */
+        std::vector<int> subtree_ends;
+
+        std::vector<glm::mat4> world_matrices;
+        std::vector<bounding_sphere> node_bounds;
+        std::vector<bounding_sphere> subtree_bounds;
+
+    private:
+
+        void add_tree(artifact *root)
+        {
+            // (artifact, parent index), an explicit stack so deep hierarchies do not overflow
+            auto stack = std::vector<std::pair<artifact *, int>>({{root, -1}});
+            auto open = std::vector<int>();
+            while (!stack.empty()) {
+                auto [artf, parent] = stack.back();
+                stack.pop_back();
+
+                // close the subtrees that ended before this node
+                while (!open.empty() && open.back() != parent) {
+                    subtree_ends[open.back()] = size();
+                    open.pop_back();
+                }
+
+                auto index = size();
+                parents.push_back(parent);
+                subtree_ends.push_back(index + 1);
+                local.add(artf);
+                open.push_back(index);
+                for (auto child = artf->children.rbegin(); child != artf->children.rend(); ++child) {
+                    stack.emplace_back(*child, index);
+                }
+            }
+            while (!open.empty()) {
+                subtree_ends[open.back()] = size();
+                open.pop_back();
+            }
+        }
+
+        model_transform_system local;
+        std::vector<int> updated;
+        std::vector<std::uint8_t> world_changed;
+        std::vector<std::uint8_t> subtree_changed;
+    };
+
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "GLM/vec3.hpp"
+#include "GLM/geometric.hpp"
+
+#include "cs4722/shape.h"
+
+/**
+ * \file
+ *
+ * Read-only views of the vertex data of a shape, and its bounds, that are generated once and then reused.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief A sphere enclosing some geometry.
+     *
+     * A negative radius means the sphere is empty, for instance for an artifact with no shape.
+     */
+    struct bounding_sphere {
+        glm::vec3 center = glm::vec3(0, 0, 0);
+        float radius = -1.0f;
+
+        bool empty() const
+        {
+            return radius < 0;
+        }
+    };
+
+
+    /**
+     * \brief An axis aligned box enclosing some geometry, given by its lowest and highest corners.
+     */
+    struct bounding_box {
+        glm::vec3 low = glm::vec3(0, 0, 0);
+        glm::vec3 high = glm::vec3(0, 0, 0);
+    };
+
+
+    /**
+     * \brief The vertex attribute lists of one shape, generated on first use.
+     *
+     * The `shape` getters build a new list on every call.
+     * This class calls each getter at most once and hands out `std::span` views of the result, so asking
+     * again for the same data does not allocate.
+     *
+     * The lists are never deleted, matching `init_buffers`: some shapes return lists they still own.
+     */
+    class shape_attributes {
+    public:
+
+        explicit shape_attributes(shape *the_shape)
+                : the_shape(the_shape)
+        {}
+
+        std::span<const glm::vec4> positions()
+        {
+            if (!positions_) positions_ = the_shape->positions();
+            return *positions_;
+        }
+
+        std::span<const cs4722::color> colors()
+        {
+            if (!colors_) colors_ = the_shape->colors();
+            return *colors_;
+        }
+
+        std::span<const glm::vec2> texture_coordinates()
+        {
+            if (!texture_coordinates_) texture_coordinates_ = the_shape->texture_coordinates();
+            return *texture_coordinates_;
+        }
+
+        std::span<const glm::vec4> normals()
+        {
+            if (!normals_) normals_ = the_shape->normals();
+            return *normals_;
+        }
+
+        std::span<const glm::vec4> tangents()
+        {
+            if (!tangents_) tangents_ = the_shape->tangents();
+            return *tangents_;
+        }
+
+        /**
+         * \brief The axis aligned bounding box of the positions, see `local_bounding_box`.
+         */
+        const bounding_box &box()
+        {
+            if (!has_box_) {
+                auto list = positions();
+                if (!list.empty()) {
+                    box_.low = box_.high = glm::vec3(list[0]);
+                    for (auto &p: list) {
+                        box_.low = glm::min(box_.low, glm::vec3(p));
+                        box_.high = glm::max(box_.high, glm::vec3(p));
+                    }
+                }
+                has_box_ = true;
+            }
+            return box_;
+        }
+
+        /**
+         * \brief The bounding sphere of the positions, see `local_bounding_sphere`.
+         */
+        const bounding_sphere &sphere()
+        {
+            if (!has_sphere_) {
+                auto list = positions();
+                if (!list.empty()) {
+                    sphere_.center = (box().low + box().high) / 2.0f;
+                    auto radius2 = 0.0f;
+                    for (auto &p: list) {
+                        auto d = glm::vec3(p) - sphere_.center;
+                        radius2 = std::max(radius2, glm::dot(d, d));
+                    }
+                    sphere_.radius = std::sqrt(radius2);
+                }
+                has_sphere_ = true;
+            }
+            return sphere_;
+        }
+
+    private:
+        shape *the_shape;
+        std::vector<glm::vec4> *positions_ = nullptr;
+        std::vector<cs4722::color> *colors_ = nullptr;
+        std::vector<glm::vec2> *texture_coordinates_ = nullptr;
+        std::vector<glm::vec4> *normals_ = nullptr;
+        std::vector<glm::vec4> *tangents_ = nullptr;
+        bounding_box box_;
+        bool has_box_ = false;
+        bounding_sphere sphere_;
+        bool has_sphere_ = false;
+    };
+
+
+    /**
+     * \brief The cache behind `attributes_of` and `forget_attributes_of`.
+     */
+    inline std::unordered_map<shape *, std::unique_ptr<shape_attributes>> &shape_attribute_cache()
+    {
+        static auto cache = std::unordered_map<shape *, std::unique_ptr<shape_attributes>>();
+        return cache;
+    }
+
+    /**
+     * \brief The cached attributes of `the_shape`, created the first time a shape is seen.
+     *
+     * The cache assumes a shape does not change after its data has been requested, which is true for all
+     * of the library shapes.
+     * It is keyed by address, so a shape whose attributes were requested must be passed to
+     * `forget_attributes_of` before it is deleted; otherwise a new shape allocated at the same address would
+     * be given the old lists.
+     * It is meant to be used from the thread that sets up the scene.
+     */
+    inline shape_attributes &attributes_of(shape *the_shape)
+    {
+        auto &entry = shape_attribute_cache()[the_shape];
+        if (!entry) {
+            entry = std::make_unique<shape_attributes>(the_shape);
+        }
+        return *entry;
+    }
+
+    /**
+     * \brief Drop the cached attributes and bounds of `the_shape`, if any, for a shape about to be deleted.
+     */
+    inline void forget_attributes_of(shape *the_shape)
+    {
+        shape_attribute_cache().erase(the_shape);
+    }
+
+}
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "GLM/mat4x4.hpp"
+
+#include "cs4722/artifact.h"
+#include "cs4722/transform.h"
+
+/**
+ * \file
+ *
+ * Many transforms stored together, with their matrices computed in batches.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief A collection of transforms stored as a structure of arrays.
+     *
+     * Each parameter of `cs4722::transform` is kept in its own contiguous array, one entry per transform.
+     * `compute_matrices` rebuilds the matrices of the transforms that changed since the last call and
+     * leaves the others alone, so transforms that never change are computed once.
+     *
+     * The matrix for an entry is the same as `transform::matrix()`:
+     * scale, move the rotation center to the origin, rotate, move it back, translate.
+     * It is computed directly from the parameters with the axis-angle rotation formula, rather than
+     * as a product of four matrices.
+     * Sines and cosines are computed in a separate pass, the element pass after it has no branches.
+     */
+    class transform_store {
+    public:
+
+        /**
+         * \brief Add a transform, returning its index.
+         */
+        int add(const transform &t)
+        {
+            auto i = size();
+            center.push_back(t.rotation_center);
+            axis.push_back(t.rotation_axis);
+            angle.push_back(t.rotation_angle);
+            translate.push_back(t.translate);
+            scale.push_back(t.scale);
+            dirty.push_back(1);
+            matrices.emplace_back(1.0f);
+            return i;
+        }
+
+        /**
+         * \brief Replace the transform at index `i`.
+         *
+         * The entry is marked for recomputation only if some parameter is different.
+         */
+        void set(int i, const transform &t)
+        {
+            if (angle[i] != t.rotation_angle || center[i] != t.rotation_center || axis[i] != t.rotation_axis
+                || translate[i] != t.translate || scale[i] != t.scale) {
+                center[i] = t.rotation_center;
+                axis[i] = t.rotation_axis;
+                angle[i] = t.rotation_angle;
+                translate[i] = t.translate;
+                scale[i] = t.scale;
+                dirty[i] = 1;
+            }
+        }
+
+        /**
+         * \brief Change only the rotation angle of the transform at index `i`.
+         */
+        void set_rotation_angle(int i, float rotation_angle)
+        {
+            if (angle[i] != rotation_angle) {
+                angle[i] = rotation_angle;
+                dirty[i] = 1;
+            }
+        }
+
+        int size() const
+        {
+            return static_cast<int>(angle.size());
+        }
+
+        /**
+         * \brief Recompute the matrices of the entries that changed.
+         *
+         * @return The number of matrices recomputed
+         */
+        int compute_matrices()
+        {
+            changed.clear();
+            for (auto i = 0; i < size(); ++i) {
+                if (dirty[i]) {
+                    changed.push_back(i);
+                    dirty[i] = 0;
+                }
+            }
+            auto n = static_cast<int>(changed.size());
+            if (n == 0) {
+                return 0;
+            }
+            sines.resize(n);
+            cosines.resize(n);
+
+            // sines and cosines, the only calls that are not simple arithmetic
+            for (auto k = 0; k < n; ++k) {
+                auto a = angle[changed[k]];
+                sines[k] = std::sin(a);
+                cosines[k] = std::cos(a);
+            }
+
+            // matrix elements, written straight into the matrix, which is column major like glm
+            for (auto k = 0; k < n; ++k) {
+                auto i = changed[k];
+                auto &a = axis[i];
+                auto length = std::sqrt(a.x * a.x + a.y * a.y + a.z * a.z);
+                auto x = a.x / length, y = a.y / length, z = a.z / length;
+                auto s = sines[k], c = cosines[k];
+                auto one_c = 1.0f - c;
+
+                auto m00 = c + one_c * x * x, m01 = one_c * x * y + s * z, m02 = one_c * x * z - s * y;
+                auto m10 = one_c * y * x - s * z, m11 = c + one_c * y * y, m12 = one_c * y * z + s * x;
+                auto m20 = one_c * z * x + s * y, m21 = one_c * z * y - s * x, m22 = c + one_c * z * z;
+
+                // rotation center in scaled coordinates
+                auto &sc = scale[i];
+                auto &tr = translate[i];
+                auto px = center[i].x * sc.x, py = center[i].y * sc.y, pz = center[i].z * sc.z;
+
+                auto &m = matrices[i];
+                m[0] = glm::vec4(m00 * sc.x, m01 * sc.x, m02 * sc.x, 0);
+                m[1] = glm::vec4(m10 * sc.y, m11 * sc.y, m12 * sc.y, 0);
+                m[2] = glm::vec4(m20 * sc.z, m21 * sc.z, m22 * sc.z, 0);
+                m[3] = glm::vec4(tr.x + px - (m00 * px + m10 * py + m20 * pz),
+                                 tr.y + py - (m01 * px + m11 * py + m21 * pz),
+                                 tr.z + pz - (m02 * px + m12 * py + m22 * pz), 1);
+            }
+            return n;
+        }
+
+        /**
+         * \brief Indices of the entries recomputed by the last call of `compute_matrices`.
+         */
+        const std::vector<int> &last_changed() const
+        {
+            return changed;
+        }
+
+        /**
+         * \brief The matrix for each entry, valid after `compute_matrices`.
+         */
+        std::vector<glm::mat4> matrices;
+
+    private:
+
+        std::vector<glm::vec3> center;
+        std::vector<glm::vec3> axis;
+        std::vector<float> angle;
+        std::vector<glm::vec3> translate;
+        std::vector<glm::vec3> scale;
+        std::vector<std::uint8_t> dirty;
+
+        // scratch space for compute_matrices
+        std::vector<int> changed;
+        std::vector<float> sines, cosines;
+    };
+
+
+    /**
+     * \brief Multiply two affine matrices, `a * b`.
+     *
+     * The last row of both matrices is taken to be (0, 0, 0, 1), as it is for every matrix from
+     * `transform`, so the last row of `b` is not read and the product takes three column
+     * operations per column instead of four.
+     */
+    inline glm::mat4 affine_multiply(const glm::mat4 &a, const glm::mat4 &b)
+    {
+        return glm::mat4(a[0] * b[0][0] + a[1] * b[0][1] + a[2] * b[0][2],
+                         a[0] * b[1][0] + a[1] * b[1][1] + a[2] * b[1][2],
+                         a[0] * b[2][0] + a[1] * b[2][1] + a[2] * b[2][2],
+                         a[0] * b[3][0] + a[1] * b[3][1] + a[2] * b[3][2] + a[3]);
+    }
+
+
+    /**
+     * \brief The model transforms of a list of artifacts, `animation_transform * world_transform`.
+     *
+     * World and animation transforms are kept in two `transform_store`s.
+     * `update` copies the current transforms of each artifact into the stores, recomputes only
+     * the matrices whose parameters changed, and recomposes only the model matrices that depend on them.
+     * In the usual case, where artifacts move only through their animation, the world matrices
+     * are computed once.
+     */
+    class model_transform_system {
+    public:
+
+        model_transform_system() = default;
+
+        explicit model_transform_system(const std::vector<artifact *> &artifact_list)
+        {
+            for (auto *artf: artifact_list) {
+                add(artf);
+            }
+        }
+
+        /**
+         * \brief Add an artifact, its model matrix has the same index as it has in `artifacts`.
+         */
+        void add(artifact *artf)
+        {
+            artifacts.push_back(artf);
+            world.add(artf->world_transform);
+            animation.add(artf->animation_transform);
+            model_matrices.emplace_back(1.0f);
+            recompose.push_back(1);
+        }
+
+        /**
+         * \brief Call `animate` on each artifact and bring the model matrices up to date.
+         */
+        void update(double time, double delta_time)
+        {
+            for (auto i = 0; i < static_cast<int>(artifacts.size()); ++i) {
+                artifacts[i]->animate(time, delta_time);
+                world.set(i, artifacts[i]->world_transform);
+                animation.set(i, artifacts[i]->animation_transform);
+            }
+            world.compute_matrices();
+            for (auto i: world.last_changed()) {
+                recompose[i] = 1;
+            }
+            animation.compute_matrices();
+            for (auto i: animation.last_changed()) {
+                recompose[i] = 1;
+            }
+            recomposed.clear();
+            for (auto i = 0; i < static_cast<int>(artifacts.size()); ++i) {
+                if (recompose[i]) {
+                    model_matrices[i] = affine_multiply(animation.matrices[i], world.matrices[i]);
+                    recompose[i] = 0;
+                    recomposed.push_back(i);
+                }
+            }
+        }
+
+        /**
+         * \brief Indices of the model matrices that changed in the last call of `update`.
+         */
+        const std::vector<int> &last_changed() const
+        {
+            return recomposed;
+        }
+
+        std::vector<artifact *> artifacts;
+        transform_store world;
+        transform_store animation;
+
+        /**
+         * \brief `animation_transform.matrix() * world_transform.matrix()` for each artifact.
+         */
+        std::vector<glm::mat4> model_matrices;
+
+    private:
+        std::vector<std::uint8_t> recompose;
+        std::vector<int> recomposed;
+    };
+
+}
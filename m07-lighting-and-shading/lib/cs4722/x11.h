@@ -1,5 +1,6 @@
 #pragma once
 #include <GLFW/glfw3.h>
+#include <array>
 #include <sstream>
 #include <iostream>
 #include <memory>
@@ -13,18 +14,18 @@ namespace cs4722 {
 
 		~color() = default;
 		
-		color(const GLubyte r, const GLubyte g, const GLubyte b)
+		constexpr color(const GLubyte r, const GLubyte g, const GLubyte b)
 			: color(r, g, b, 255)
 		{
 		}
 
 
-		color(const GLubyte r, const GLubyte g, const GLubyte b, const GLubyte a)
+		constexpr color(const GLubyte r, const GLubyte g, const GLubyte b, const GLubyte a)
 			: r(r), g(g), b(b), a(a)
 		{
 		}
 
-		color() : color(0, 0, 0, 0) {}
+		constexpr color() : color(0, 0, 0, 0) {}
 
 //		color(const color& c) = default;
 
@@ -37,6 +38,19 @@ namespace cs4722 {
 
 		GLfloat* as_float() const;
 
+		/**
+		 * \brief The color as four floats in the range 0 to 1.
+		 *
+		 * Unlike `as_float`, nothing is allocated, the array is returned by value.
+		 * This is the form to use inside a display loop:
+		 *
+		 * `glUniform4fv(location, 1, c.as_array().data());`
+		 */
+		constexpr std::array<GLfloat, 4> as_array() const
+		{
+			return {r / 255.0f, g / 255.0f, b / 255.0f, a / 255.0f};
+		}
+
         std::unique_ptr<GLfloat[]> as_float_up() const;
 
         void as_float(GLfloat* color) const;
@@ -20,6 +20,7 @@
 #include "cs4722/window.h"
 #include "cs4722/callbacks.h"
 #include "cs4722/compile_shaders.h"
+#include "cs4722/render_context.h"
 
 static cs4722::view *the_view;
 static GLuint program;
@@ -154,7 +155,7 @@ void display()
 
         glUniformMatrix4fv(transform_loc, 1, GL_FALSE, glm::value_ptr(  transform));
 
-        glUniform4fv(diffuse_color_loc, 1, artf->surface_material.diffuse_color.as_float());
+        glUniform4fv(diffuse_color_loc, 1, artf->surface_material.diffuse_color.as_array().data());
 
         glDrawArrays(GL_TRIANGLES, artf->the_shape->buffer_start,
 			artf->the_shape->buffer_size);
@@ -168,9 +169,8 @@ void display()
 int
 main(int argc, char** argv)
 {
-	glfwInit();
-	auto *window = cs4722::setup_window("Stripes", 0.9);
-    gladLoadGL(glfwGetProcAddress);
+	auto context = cs4722::render_context(argc, argv, "Stripes", 0.9);
+	auto *window = context.window;
 	cs4722::setup_debug_callbacks();
 
 	init();
@@ -178,17 +178,12 @@ main(int argc, char** argv)
 	glfwSetWindowUserPointer(window, the_view);
 	cs4722::setup_user_callbacks(window);
 
-	while (!glfwWindowShouldClose(window))
+	while (context.running())
 	{
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray25.as_float());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray25.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
 
         display();
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		context.end_frame();
 	}
-
-	glfwDestroyWindow(window);
-
-	glfwTerminate();
 }
@@ -1,5 +1,15 @@
 
-
+/*
+ * The Newton fractal for z^3 = 1, computed in the fragment shader or, after pressing G, on the CPU.
+ *
+ * The shader works in float, so zooming in with W soon turns the image into blocks.
+ * The CPU renderer, cs4722::fractal_tile_cache, switches to double and then double-double arithmetic
+ *      as the pixels get smaller, and fills the image in tile by tile while the window stays responsive.
+ * It keeps the tiles it has computed, so panning only computes the part of the plane that comes into view,
+ *      and going back to an earlier view or zoom is immediate.
+ * I doubles the iteration limit and K halves it, the CPU renderer continues from where it stopped.
+ * Run with --cpu to start with the CPU renderer.
+ */
 
 //#include <GLM/glm.hpp>
 #include <GLM/gtc/type_ptr.hpp>
@@ -11,22 +21,29 @@
 #include <glad/gl.h>
 
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
 #include <vector>
 
 
 #include "cs4722/x11.h"
 #include "cs4722/compile_shaders.h"
+#include "cs4722/render_context.h"
+#include "fractal_tile_cache.h"
 
 
 const auto  number_of_vertices = 6;
 
 GLuint program;
+GLuint texture_program;
 
 void
 init1(void)
 {
 	
     program = cs4722::compile_shaders("vertex_shader02.glsl","fragment_shader02.glsl");
+    texture_program = cs4722::compile_shaders("vertex_shader02.glsl","fragment_shader02_texture.glsl");
     glUseProgram(program);
 
     glEnable(GL_PROGRAM_POINT_SIZE);
@@ -61,18 +78,71 @@ init1(void)
 // display
 //
 
-static glm::vec2 center = glm::vec2(0, 0);//  glm::vec2(-.5, -.5);
-static glm::vec2 range = glm::vec2(1.0, 1.0);
+/*
+ * The center is kept in double-double precision so the CPU renderer can zoom far in.
+ * The shader only gets it as floats.
+ */
+static cs4722::fractal_view the_view;
+static bool view_changed = true;
+static int iteration_limit = 300;
+
+static bool use_cpu_engine = false;
+static std::unique_ptr<cs4722::fractal_tile_cache> tile_cache;
+static GLuint image_texture = 0;
+
+/*
+ * Make the CPU renderer and the texture it fills, again whenever the window size changes.
+ */
+void
+size_cpu_engine(int width, int height)
+{
+    if (!tile_cache || tile_cache->width != width || tile_cache->height != height) {
+        tile_cache = std::make_unique<cs4722::fractal_tile_cache>(width, height);
+        if (image_texture) {
+            glDeleteTextures(1, &image_texture);
+        }
+        glCreateTextures(GL_TEXTURE_2D, 1, &image_texture);
+        glTextureStorage2D(image_texture, 1, GL_RGBA8, tile_cache->texture_width(), tile_cache->texture_height());
+        glTextureParameteri(image_texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(image_texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glClearTexImage(image_texture, 0, GL_RGBA, GL_FLOAT, cs4722::x11::gray50.as_array().data());
+        view_changed = true;
+    }
+}
 
 void
-display(void)
+display(int width, int height, bool wait_for_cpu)
 {
-    glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_float());
+    glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_array().data());
 
-    auto center_loc = glGetUniformLocation(program, "center");
-    auto range_loc = glGetUniformLocation(program, "range");
-    glUniform2fv(center_loc, 1, glm::value_ptr(center));
-    glUniform2fv(range_loc, 1, glm::value_ptr(range));
+    if (use_cpu_engine) {
+        size_cpu_engine(width, height);
+        if (view_changed) {
+            tile_cache->iteration_limit = iteration_limit;
+            tile_cache->start(the_view);
+        }
+        if (wait_for_cpu) {
+            tile_cache->wait();
+        }
+        tile_cache->upload_tiles(image_texture);
+        view_changed = false;
+
+        // the texture holds whole tiles around the view, the placement picks out the part in view
+        auto placement = tile_cache->texture_placement();
+        glUseProgram(texture_program);
+        glBindTextureUnit(0, image_texture);
+        glUniform2fv(glGetUniformLocation(texture_program, "center"), 1, glm::value_ptr(placement.center));
+        glUniform2fv(glGetUniformLocation(texture_program, "range"), 1, glm::value_ptr(placement.range));
+    } else {
+        glUseProgram(program);
+        auto center = glm::vec2(static_cast<double>(the_view.center_x), static_cast<double>(the_view.center_y));
+        auto range = glm::vec2(the_view.range_x, the_view.range_y);
+        auto center_loc = glGetUniformLocation(program, "center");
+        auto range_loc = glGetUniformLocation(program, "range");
+        glUniform2fv(center_loc, 1, glm::value_ptr(center));
+        glUniform2fv(range_loc, 1, glm::value_ptr(range));
+        glUniform1i(glGetUniformLocation(program, "iteration_limit"), iteration_limit);
+    }
 
     glDrawArrays(GL_TRIANGLES, 0, number_of_vertices);
 }
@@ -81,37 +151,53 @@ display(void)
 
 void general_key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
-    const auto scaleSlide = .1f;
-    const auto scaleZoom = .9f;
+    const auto scaleSlide = .1;
+    const auto scaleZoom = .9;
 	
     if(action == GLFW_PRESS || action == GLFW_REPEAT)
     {
 	    switch (key)
 	    {
         case GLFW_KEY_LEFT:
-            center.x -= scaleSlide * range.x;
+            the_view.center_x = the_view.center_x - scaleSlide * the_view.range_x;
 	    	break;
         case GLFW_KEY_RIGHT:
-            center.x += scaleSlide * range.x;
+            the_view.center_x = the_view.center_x + scaleSlide * the_view.range_x;
             break;
         case GLFW_KEY_UP:
-            center.y += scaleSlide * range.y;
+            the_view.center_y = the_view.center_y + scaleSlide * the_view.range_y;
             break;
         case GLFW_KEY_DOWN:
-            center.y -= scaleSlide * range.y;
+            the_view.center_y = the_view.center_y - scaleSlide * the_view.range_y;
             break;
         case GLFW_KEY_S:
-            range /= scaleZoom;
+            the_view.range_x /= scaleZoom;
+            the_view.range_y /= scaleZoom;
             break;
         case GLFW_KEY_W:
-            range *= scaleZoom;
+            the_view.range_x *= scaleZoom;
+            the_view.range_y *= scaleZoom;
+            break;
+        case GLFW_KEY_I:
+            iteration_limit *= 2;
+            printf("iteration limit %d\n", iteration_limit);
+            break;
+        case GLFW_KEY_K:
+            iteration_limit = std::max(iteration_limit / 2, 1);
+            printf("iteration limit %d\n", iteration_limit);
+            break;
+        case GLFW_KEY_G:
+            use_cpu_engine = !use_cpu_engine;
+            printf("drawing on the %s\n", use_cpu_engine ? "CPU" : "GPU");
             break;
         case GLFW_KEY_ESCAPE:
             glfwSetWindowShouldClose(window, GLFW_TRUE);
 	    }
+        view_changed = true;
 
-        printf("center(%g, %g)  range(%g, %g)\n", center.x, center.y,
-        range.x, range.y);
+        printf("center(%.17g, %.17g)  range(%g, %g)\n",
+        static_cast<double>(the_view.center_x), static_cast<double>(the_view.center_y),
+        the_view.range_x, the_view.range_y);
 	    
     }
     else
@@ -128,30 +214,13 @@ void general_key_callback(GLFWwindow* window, int key, int scancode, int action,
 int
 main(int argc, char** argv)
 {
-    glfwInit();
-
-    GLFWmonitor* primary = glfwGetPrimaryMonitor();
-    int xpos, ypos, width, height;
-    glfwGetMonitorWorkarea(primary, &xpos, &ypos, &width, &height);
-    //std::cout << xpos << " " << ypos << " " << width << " " << height << std::endl;
-    int size = glm::min(width, height);
-    float ratio = .9f;
-    int w_width = int(ratio * size);
-    int w_height = w_width;
-    int w_x = int(size * (1 - ratio) / 2);
-    int w_y = w_x;
-
-
-    GLFWwindow* window = glfwCreateWindow(w_width, w_height, "Square", NULL, NULL);
-    glfwSetWindowPos(window, w_x, w_y);
-
-    glfwMakeContextCurrent(window);
-    gladLoadGL(glfwGetProcAddress);
+    auto context = cs4722::render_context(argc, argv, "Square", .9);
+    auto *window = context.window;
 
     init1();
 
     auto iteration_limit_loc = glGetUniformLocation(program, "iteration_limit");
-    glUniform1i(iteration_limit_loc, 300);
+    glUniform1i(iteration_limit_loc, iteration_limit);
 
     auto colors_loc = glGetUniformLocation(program, "colors");
     auto num_colors_loc = glGetUniformLocation(program, "num_colors");
@@ -165,7 +234,7 @@ main(int argc, char** argv)
     auto* colors_fl = new std::vector<float>();
     for (auto i = colors->begin(); i != colors->end(); ++i)
     {
-        float* cf = i->as_float();
+        auto cf = i->as_array();
         for (int j = 0; j < 4; j++)
         {
             colors_fl->push_back(cf[j]);
@@ -176,15 +245,19 @@ main(int argc, char** argv)
 
     glfwSetKeyCallback(window, general_key_callback);
 
-
-    while (!glfwWindowShouldClose(window))
-    {
-        display();
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    for (auto a = 1; a < argc; ++a) {
+        if (std::strcmp(argv[a], "--cpu") == 0) {
+            use_cpu_engine = true;
+        }
     }
 
-    glfwDestroyWindow(window);
 
-    glfwTerminate();
+    while (context.running())
+    {
+        int width, height;
+        context.framebuffer_size(&width, &height);
+        // frames are not shown when headless, so each one waits for the whole image
+        display(width, height, context.headless());
+        context.end_frame();
+    }
 }
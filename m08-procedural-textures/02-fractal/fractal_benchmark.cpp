@@ -0,0 +1,168 @@
+/*
+ * Measure the speed of the CPU renderer for the Newton fractal, cs4722::fractal_engine.
+ *
+ * A 256 by 256 image is rendered with each precision at several iteration limits, and the time is
+ *      reported in millions of pixels per second.
+ * The first view is the whole fractal, as fractal.cpp starts.
+ * The second is a deep zoom, a range of 1e-20, around one of the points where the three basins meet,
+ *      which only the double-double arithmetic can resolve.
+ * The number of threads can be given on the command line, the default is the hardware concurrency.
+ *
+ * The deep zoom is also checked: an image that is all one color means the precision was not enough
+ *      to tell the pixels apart.
+ *
+ * Then the tile cache, cs4722::fractal_tile_cache, is timed on the steps of exploring with fractal.cpp:
+ *      a first view, a pan right by five presses of the arrow key, a pan back, zooming in and back out,
+ *      and raising the iteration limit from 300 to 600.
+ * Each is compared with rendering the same view from scratch, and the first view is checked against
+ *      the image from fractal_engine.
+ *
+ * The exit code is 1 if the double-double deep zoom image is all one color or if the cache's first view
+ *      differs from fractal_engine's in more than 0.1% of the pixels.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <vector>
+
+#include "fractal_engine.h"
+#include "fractal_tile_cache.h"
+
+
+template<typename F>
+static double time_of(F &&f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+static int count_colors(const std::vector<std::uint8_t> &image)
+{
+    auto colors = std::set<std::uint32_t>();
+    for (size_t i = 0; i < image.size(); i += 4) {
+        colors.insert(image[i] | image[i + 1] << 8 | image[i + 2] << 16);
+    }
+    return static_cast<int>(colors.size());
+}
+
+
+int
+main(int argc, char **argv)
+{
+    auto threads = argc > 1 ? std::atoi(argv[1]) : 0;
+    const auto size = 256;
+    auto engine = cs4722::fractal_engine(size, size, threads);
+
+    /*
+     * The iteration sends -(1/2)^(1/3) to 0 and 0 to infinity, so all three basins meet around it
+     *      at every scale.
+     * The point is found to double-double precision with two Newton steps for 2x^3 + 1 = 0.
+     */
+    auto root = cs4722::double_double(-0.7937005259840998);
+    for (auto step = 0; step < 2; ++step) {
+        root = root - (cs4722::double_double(2) * root * root * root + 1) / (cs4722::double_double(6) * root * root);
+    }
+    auto deep = cs4722::fractal_view();
+    deep.center_x = root;
+    deep.range_x = deep.range_y = 1e-20;
+
+    struct test_view {
+        const char *name;
+        cs4722::fractal_view view;
+    };
+    auto views = std::vector<test_view>{{"full view", cs4722::fractal_view()}, {"deep zoom", deep}};
+    auto precisions = std::vector<std::pair<const char *, cs4722::fractal_precision>>{
+            {"float", cs4722::fractal_precision::single},
+            {"double", cs4722::fractal_precision::double_precision},
+            {"double-double", cs4722::fractal_precision::double_double}};
+    auto name_of = [&](cs4722::fractal_precision precision) {
+        for (auto &[precision_name, p]: precisions) {
+            if (p == precision) return precision_name;
+        }
+        return "automatic";
+    };
+
+    auto deep_colors = 0;
+    std::cout << std::fixed << std::setprecision(2);
+    for (auto &[name, view]: views) {
+        engine.precision = cs4722::fractal_precision::automatic;
+        std::cout << name << ", automatic precision chooses " << name_of(engine.precision_for(view))
+                  << std::endl;
+        for (auto limit: {50, 300, 1000}) {
+            for (auto &[precision_name, precision]: precisions) {
+                engine.precision = precision;
+                engine.iteration_limit = limit;
+                engine.render(view);
+
+                const auto repeats = 3;
+                auto start = std::chrono::steady_clock::now();
+                auto image = std::vector<std::uint8_t>();
+                for (auto r = 0; r < repeats; ++r) {
+                    image = engine.render(view);
+                }
+                auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                auto colors = count_colors(image);
+                if (view.range_x < 1e-15 && precision == cs4722::fractal_precision::double_double) {
+                    deep_colors = std::max(deep_colors, colors);
+                }
+                std::cout << "  limit " << std::setw(4) << limit << "  " << std::setw(13) << precision_name
+                          << "  " << std::setw(8) << size * size * repeats / seconds / 1e6 << " Mpixel/s  "
+                          << colors << " colors" << std::endl;
+            }
+        }
+    }
+
+    engine.precision = cs4722::fractal_precision::automatic;
+    engine.iteration_limit = 300;
+    auto cache = cs4722::fractal_tile_cache(size, size, threads);
+    auto view = cs4722::fractal_view();
+    auto cache_image = std::vector<std::uint8_t>();
+    auto engine_image = std::vector<std::uint8_t>();
+
+    std::cout << "tile cache, milliseconds from the change to the finished image" << std::endl;
+    auto report = [&](const char *step, double cache_ms, double scratch_ms) {
+        std::cout << "  " << std::setw(16) << step << "  cache " << std::setw(8) << cache_ms
+                  << "  from scratch " << std::setw(8) << scratch_ms << "  pixels iterated "
+                  << cache.pixels_iterated << ", tiles reused " << cache.tiles_reused << std::endl;
+    };
+
+    auto cache_ms = time_of([&] { cache_image = cache.render(view); });
+    auto scratch_ms = time_of([&] { engine_image = engine.render(view); });
+    report("first view", cache_ms, scratch_ms);
+    auto differences = 0;
+    for (size_t i = 0; i < cache_image.size(); i += 4) {
+        differences += !std::equal(&cache_image[i], &cache_image[i] + 4, &engine_image[i]);
+    }
+
+    auto step = [&](const char *name) {
+        auto c = time_of([&] { cache.render(view); });
+        auto s = time_of([&] { engine.render(view); });
+        report(name, c, s);
+    };
+    for (auto press = 0; press < 5; ++press) {
+        view.center_x = view.center_x + 0.1 * view.range_x;
+    }
+    step("pan right");
+    for (auto press = 0; press < 5; ++press) {
+        view.center_x = view.center_x - 0.1 * view.range_x;
+    }
+    step("pan back");
+    view.range_x = view.range_y = 0.9;
+    step("zoom in");
+    view.range_x = view.range_y = 1;
+    step("zoom out");
+
+    cache.iteration_limit = engine.iteration_limit = 600;
+    step("limit 600");
+
+    std::cout << "first view pixels that differ from fractal_engine: " << differences << std::endl;
+    auto differences_allowed = size * size / 1000;
+    return deep_colors > 1 && differences <= differences_allowed ? 0 : 1;
+}
@@ -0,0 +1,517 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "cs4722/parallel_for.h"
+#include "cs4722/x11.h"
+
+/**
+ * \file
+ *
+ * A CPU renderer for the Newton fractal drawn by fragment_shader02.glsl.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief A number stored as the unevaluated sum of two doubles, giving about 32 significant digits.
+     *
+     * Only the operations needed by the fractal iteration are provided.
+     * The algorithms are the usual error free transformations, with `std::fma` for exact products.
+     */
+    struct double_double {
+        double hi = 0;
+        double lo = 0;
+
+        constexpr double_double() = default;
+        constexpr double_double(double hi) : hi(hi), lo(0) {}
+        constexpr double_double(double hi, double lo) : hi(hi), lo(lo) {}
+
+        explicit operator double() const
+        {
+            return hi + lo;
+        }
+
+        static double_double quick_two_sum(double a, double b)
+        {
+            auto s = a + b;
+            return {s, b - (s - a)};
+        }
+
+        static double_double two_sum(double a, double b)
+        {
+            auto s = a + b;
+            auto v = s - a;
+            return {s, (a - (s - v)) + (b - v)};
+        }
+
+        friend double_double operator+(const double_double &a, const double_double &b)
+        {
+            auto s = two_sum(a.hi, b.hi);
+            auto t = two_sum(a.lo, b.lo);
+            s.lo += t.hi;
+            s = quick_two_sum(s.hi, s.lo);
+            s.lo += t.lo;
+            return quick_two_sum(s.hi, s.lo);
+        }
+
+        friend double_double operator-(const double_double &a)
+        {
+            return {-a.hi, -a.lo};
+        }
+
+        friend double_double operator-(const double_double &a, const double_double &b)
+        {
+            return a + -b;
+        }
+
+        friend double_double operator*(const double_double &a, const double_double &b)
+        {
+            auto p = a.hi * b.hi;
+            auto e = std::fma(a.hi, b.hi, -p);
+            e += a.hi * b.lo + a.lo * b.hi;
+            return quick_two_sum(p, e);
+        }
+
+        friend double_double operator/(const double_double &a, const double_double &b)
+        {
+            auto q1 = a.hi / b.hi;
+            auto r = a - b * q1;
+            auto q2 = r.hi / b.hi;
+            r = r - b * q2;
+            auto q3 = r.hi / b.hi;
+            return quick_two_sum(q1, q2) + q3;
+        }
+    };
+
+
+    /**
+     * \brief The part of the complex plane shown, with the same meaning as the `center` and `range`
+     * uniforms of vertex_shader02.glsl: the image covers `center - range` to `center + range`.
+     *
+     * The center is kept in double-double precision so it can be placed accurately at any zoom.
+     */
+    struct fractal_view {
+        double_double center_x = 0;
+        double_double center_y = 0;
+        double range_x = 1;
+        double range_y = 1;
+    };
+
+
+    enum class fractal_precision {
+        automatic, single, double_precision, double_double
+    };
+
+
+    /**
+     * \brief The precision needed so neighboring pixels of size `pixel` near `x`, `y` start at different points.
+     */
+    inline fractal_precision precision_for_pixel(double pixel, double x, double y)
+    {
+        auto magnitude = std::max({1.0, std::abs(x), std::abs(y)});
+        auto relative = pixel / magnitude;
+        if (relative > 1e-5) return fractal_precision::single;
+        if (relative > 1e-13) return fractal_precision::double_precision;
+        return fractal_precision::double_double;
+    }
+
+
+    /**
+     * \brief Convert a double-double to the type used for the iteration.
+     */
+    template<typename T>
+    T narrow_to(const double_double &value)
+    {
+        if constexpr (std::is_same_v<T, double_double>) {
+            return value;
+        } else {
+            return static_cast<T>(value.hi);
+        }
+    }
+
+    template<typename T>
+    double_double widen(const T &value)
+    {
+        if constexpr (std::is_same_v<T, double_double>) {
+            return value;
+        } else {
+            return double_double(value);
+        }
+    }
+
+
+    /**
+     * \brief The leading part of a value, enough for comparisons.
+     */
+    inline float leading(float value)
+    {
+        return value;
+    }
+
+    inline double leading(double value)
+    {
+        return value;
+    }
+
+    inline double leading(const double_double &value)
+    {
+        return value.hi;
+    }
+
+
+    /**
+     * \brief Continue the Newton iteration for `lanes` points at once.
+     *
+     * On entry lane `l` is at (`zr[l]`, `zi[l]`) after `steps[l]` steps, and `root[l]` is the root it
+     * has reached, or -1.
+     * Each unresolved lane is checked against the three roots and, if it is not within 0.00001 of one,
+     * stepped with `z = (2z^3 + 1) / (3z^2)`, until every lane has reached a root or taken
+     * `iteration_limit` steps.
+     * A lane that reaches a root is left with the number of steps taken before it got there, so it is
+     * colored for any limit above that.
+     * A lane that does not is left at its last point, so a later call with a higher limit carries on
+     * from there.
+     *
+     * Every lane goes through the same arithmetic in loops with no branches, which the compiler turns
+     * into SIMD instructions.
+     */
+    template<typename T, int lanes>
+    void newton_iterate(std::array<T, lanes> &zr_inout, std::array<T, lanes> &zi_inout,
+                        std::array<int, lanes> &steps_inout, std::array<int, lanes> &root_inout, int iteration_limit)
+    {
+        // local copies, which the compiler knows are not aliased, so it keeps them in vector registers
+        auto zr = zr_inout, zi = zi_inout;
+        auto steps = steps_inout, root = root_inout;
+
+        // the convergence test does not need the extra precision of double-double
+        using test_type = std::conditional_t<std::is_same_v<T, float>, float, double>;
+        const auto eps2 = test_type(0.00001 * 0.00001);
+        const auto root_y = test_type(std::sqrt(3.0) / 2);
+        const auto half = test_type(0.5);
+
+        std::array<int, lanes> active;
+        while (true) {
+            // check for convergence first, as the shader does
+            auto active_count = 0;
+            for (auto l = 0; l < lanes; ++l) {
+                auto x = leading(zr[l]), y = leading(zi[l]);
+                auto d0 = (x - 1) * (x - 1) + y * y;
+                auto d1 = (x + half) * (x + half) + (y - root_y) * (y - root_y);
+                auto d2 = (x + half) * (x + half) + (y + root_y) * (y + root_y);
+                // the roots are far apart, so at most one of these is 1
+                auto found = int(d0 < eps2) + 2 * int(d1 < eps2) + 3 * int(d2 < eps2) - 1;
+                auto unresolved = int(root[l] < 0) & int(steps[l] < iteration_limit);
+                root[l] += unresolved * (found + 1);
+                active[l] = unresolved & int(found < 0);
+                steps[l] += active[l];
+                active_count += active[l];
+            }
+            if (active_count == 0) {
+                zr_inout = zr;
+                zi_inout = zi;
+                steps_inout = steps;
+                root_inout = root;
+                return;
+            }
+
+            // step every lane, keeping the new point only for the active ones
+            for (auto l = 0; l < lanes; ++l) {
+                auto x = zr[l], y = zi[l];
+                auto x2 = x * x - y * y, y2 = T(2) * x * y;
+                auto x3 = x2 * x - y2 * y, y3 = x2 * y + y2 * x;
+                auto nr = T(2) * x3 + T(1), ni = T(2) * y3;
+                auto dr = T(3) * x2, di = T(3) * y2;
+                auto scale = T(1) / (dr * dr + di * di);
+                zr[l] = active[l] ? (nr * dr + ni * di) * scale : x;
+                zi[l] = active[l] ? (ni * dr - nr * di) * scale : y;
+            }
+        }
+    }
+
+
+    /**
+     * \brief Renders the Newton fractal for z^3 = 1 on the CPU, in tiles, with a pool of worker threads.
+     *
+     * Each pixel starts at the point of the plane at its center and iterates `z = (2z^3 + 1) / (3z^2)`,
+     * checking before each step whether `z` is within 0.00001 of one of the three roots, as the shader does.
+     * The pixel gets the color of the root reached, or `no_root_color` if none is reached within
+     * `iteration_limit` steps.
+     *
+     * The pixels of a row are iterated in groups of `lanes` at once with `newton_iterate`, and a group
+     * stops when all of its lanes have reached a root.
+     *
+     * The arithmetic is done in float, double, or double-double depending on the size of a pixel, so the
+     * image stays sharp when zooming far past the point where the shader's floats break down.
+     *
+     * `start` begins rendering a view in the background and returns immediately.
+     * Starting a new view abandons the tiles of the previous one.
+     * `upload_finished_tiles` copies the tiles completed so far into a texture, so the image can be shown
+     * while it is being computed.
+     * `render` computes a whole image and waits for it.
+     */
+    class fractal_engine {
+    public:
+
+        static constexpr int tile_size = 64;
+
+        /**
+         * @param width  Width of the image in pixels
+         * @param height  Height of the image in pixels
+         * @param number_of_threads  Number of worker threads, 0 means use the hardware concurrency
+         */
+        fractal_engine(int width, int height, int number_of_threads = 0)
+                : width(width), height(height)
+        {
+            for (auto t = 0; t < thread_count(number_of_threads); ++t) {
+                workers.emplace_back([this] { work(); });
+            }
+        }
+
+        fractal_engine(const fractal_engine &) = delete;
+        fractal_engine &operator=(const fractal_engine &) = delete;
+
+        ~fractal_engine()
+        {
+            {
+                auto lock = std::lock_guard(mutex);
+                stopping = true;
+                ++generation;
+            }
+            work_available.notify_all();
+            for (auto &worker: workers) {
+                worker.join();
+            }
+        }
+
+        /**
+         * \brief The precision needed so neighboring pixels start at different points.
+         */
+        fractal_precision precision_for(const fractal_view &view) const
+        {
+            auto pixel = 2 * std::min(view.range_x / width, view.range_y / height);
+            return precision_for_pixel(pixel, view.center_x.hi, view.center_y.hi);
+        }
+
+        /**
+         * \brief Begin rendering `view` in the background, abandoning any render in progress.
+         */
+        void start(const fractal_view &view)
+        {
+            {
+                auto lock = std::lock_guard(mutex);
+                ++generation;
+                job.view = view;
+                job.precision = precision == fractal_precision::automatic ? precision_for(view) : precision;
+                job.iteration_limit = iteration_limit;
+                job.colors = {to_bytes(root_colors[0]), to_bytes(root_colors[1]), to_bytes(root_colors[2]),
+                              to_bytes(no_root_color)};
+                tiles_x = (width + tile_size - 1) / tile_size;
+                tiles_y = (height + tile_size - 1) / tile_size;
+                next_tile = 0;
+                tiles_done = 0;
+                finished_tiles.clear();
+                last_precision = job.precision;
+            }
+            work_available.notify_all();
+        }
+
+        /**
+         * \brief Copy the tiles finished since the last call into `texture`, an RGBA8 texture of the
+         * same size as the image.
+         *
+         * @return The number of tiles copied
+         */
+        int upload_finished_tiles(GLuint texture)
+        {
+            auto tiles = take_finished_tiles();
+            for (auto &t: tiles) {
+                glTextureSubImage2D(texture, 0, t.x, t.y, t.width, t.height, GL_RGBA, GL_UNSIGNED_BYTE,
+                                    t.pixels.data());
+            }
+            return static_cast<int>(tiles.size());
+        }
+
+        /**
+         * \brief True when every tile of the last view started has been computed.
+         */
+        bool finished()
+        {
+            auto lock = std::lock_guard(mutex);
+            return tiles_done == tiles_x * tiles_y;
+        }
+
+        /**
+         * \brief Render `view` and wait for it.
+         *
+         * @return RGBA8 pixels, rows from the bottom up as OpenGL stores them
+         */
+        std::vector<std::uint8_t> render(const fractal_view &view)
+        {
+            start(view);
+            {
+                auto lock = std::unique_lock(mutex);
+                tile_finished.wait(lock, [this] { return tiles_done == tiles_x * tiles_y; });
+            }
+            auto image = std::vector<std::uint8_t>(static_cast<size_t>(width) * height * 4);
+            for (auto &t: take_finished_tiles()) {
+                for (auto row = 0; row < t.height; ++row) {
+                    std::copy_n(t.pixels.begin() + row * t.width * 4, t.width * 4,
+                                image.begin() + ((t.y + row) * static_cast<size_t>(width) + t.x) * 4);
+                }
+            }
+            return image;
+        }
+
+        int iteration_limit = 300;
+        fractal_precision precision = fractal_precision::automatic;
+
+        /**
+         * \brief The precision chosen for the last view started.
+         */
+        fractal_precision last_precision = fractal_precision::single;
+
+        /**
+         * \brief Colors for the roots 1, (-1 + i sqrt(3)) / 2, and (-1 - i sqrt(3)) / 2.
+         */
+        std::array<color, 3> root_colors = {x11::navajo_white1, x11::sky_blue1, x11::orange1};
+        color no_root_color = color(0, 0, 0, 255);
+
+        const int width;
+        const int height;
+
+    private:
+
+        using rgba = std::array<std::uint8_t, 4>;
+
+        struct job_settings {
+            fractal_view view;
+            fractal_precision precision = fractal_precision::single;
+            int iteration_limit = 0;
+            std::array<rgba, 4> colors;
+        };
+
+        struct tile {
+            int x, y, width, height;
+            std::vector<std::uint8_t> pixels;
+        };
+
+        static rgba to_bytes(const color &c)
+        {
+            return {c.r, c.g, c.b, c.a};
+        }
+
+        std::vector<tile> take_finished_tiles()
+        {
+            auto lock = std::lock_guard(mutex);
+            auto tiles = std::vector<tile>(std::make_move_iterator(finished_tiles.begin()),
+                                           std::make_move_iterator(finished_tiles.end()));
+            finished_tiles.clear();
+            return tiles;
+        }
+
+        void work()
+        {
+            auto lock = std::unique_lock(mutex);
+            while (true) {
+                work_available.wait(lock, [this] { return stopping || next_tile < tiles_x * tiles_y; });
+                if (stopping) {
+                    return;
+                }
+                auto index = next_tile++;
+                auto my_generation = generation.load();
+                auto settings = job;
+                auto t = tile{index % tiles_x * tile_size, index / tiles_x * tile_size, 0, 0, {}};
+                t.width = std::min(tile_size, width - t.x);
+                t.height = std::min(tile_size, height - t.y);
+                lock.unlock();
+
+                auto complete = false;
+                switch (settings.precision) {
+                    case fractal_precision::double_double:
+                        complete = render_tile<double_double, 2>(t, settings, my_generation);
+                        break;
+                    case fractal_precision::double_precision:
+                        complete = render_tile<double, 4>(t, settings, my_generation);
+                        break;
+                    default:
+                        complete = render_tile<float, 8>(t, settings, my_generation);
+                        break;
+                }
+
+                lock.lock();
+                if (complete && generation == my_generation) {
+                    finished_tiles.push_back(std::move(t));
+                    ++tiles_done;
+                    tile_finished.notify_all();
+                }
+            }
+        }
+
+        /**
+         * \brief Compute the pixels of `t`, returning false if the render was abandoned part way.
+         */
+        template<typename T, int lanes>
+        bool render_tile(tile &t, const job_settings &settings, std::uint64_t my_generation)
+        {
+            t.pixels.resize(static_cast<size_t>(t.width) * t.height * 4);
+            auto &view = settings.view;
+            auto center_x = narrow_to<T>(view.center_x);
+            auto center_y = narrow_to<T>(view.center_y);
+
+            std::array<T, lanes> zr, zi;
+            std::array<int, lanes> steps, root;
+            for (auto row = 0; row < t.height; ++row) {
+                if (generation != my_generation) {
+                    return false;
+                }
+                auto py = t.y + row;
+                auto offset_y = T((2 * (py + 0.5) / height - 1) * view.range_y);
+                for (auto col = 0; col < t.width; col += lanes) {
+                    for (auto l = 0; l < lanes; ++l) {
+                        auto px = t.x + std::min(col + l, t.width - 1);
+                        zr[l] = center_x + T((2 * (px + 0.5) / width - 1) * view.range_x);
+                        zi[l] = center_y + offset_y;
+                        steps[l] = 0;
+                        root[l] = -1;
+                    }
+                    newton_iterate<T, lanes>(zr, zi, steps, root, settings.iteration_limit);
+
+                    for (auto l = 0; l < lanes && col + l < t.width; ++l) {
+                        auto &c = settings.colors[root[l] >= 0 ? root[l] : 3];
+                        std::copy(c.begin(), c.end(), t.pixels.begin() + (row * t.width + col + l) * 4);
+                    }
+                }
+            }
+            return true;
+        }
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable work_available;
+        std::condition_variable tile_finished;
+        std::atomic<std::uint64_t> generation = 0;
+        bool stopping = false;
+
+        // guarded by mutex
+        job_settings job;
+        int tiles_x = 0;
+        int tiles_y = 0;
+        int next_tile = 0;
+        int tiles_done = 0;
+        std::deque<tile> finished_tiles;
+    };
+
+}
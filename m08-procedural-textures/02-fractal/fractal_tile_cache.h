@@ -0,0 +1,668 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "GLM/vec2.hpp"
+
+#include "cs4722/parallel_for.h"
+#include "cs4722/x11.h"
+#include "fractal_engine.h"
+
+/**
+ * \file
+ *
+ * A CPU renderer for the Newton fractal that keeps the tiles it computes, for exploring with fractal.cpp.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief Renders the Newton fractal on the CPU and keeps the tiles it has computed, so that panning,
+     * zooming back out, and changing the iteration limit reuse earlier work.
+     *
+     * Tiles are fixed squares of the complex plane rather than of the window.
+     * Zoom level `n` has a horizontal range of `zoom_step` to the power `n`, which is the range fractal.cpp
+     * reaches after `n` presses of W, and pixels of width `2 * range / width`.
+     * The height of the pixels keeps the ratio of `range_y` to `range_x` of the view, spread over the height
+     * of the window, as in `fractal_engine` and fragment_shader02.glsl, so pixels are only square when the
+     * window is.
+     * The tiles of a level form a grid anchored at the lower left corner of the first view seen at that
+     * level, and a tile is found in the cache by its level and its column and row in that grid.
+     * After a pan only the tiles that came into view are computed.
+     *
+     * A new tile is refined from coarse to fine.
+     * First every 8th pixel of every 8th row is computed and shown as an 8 by 8 block, then every 4th,
+     * every 2nd, and finally every pixel, each pass reusing the pixels computed before it.
+     * Every tile in view gets a pass before any tile gets the next one, so the whole window fills in quickly.
+     *
+     * The iteration limit is not part of the key.
+     * A tile records the limit it was computed to and, for each pixel, the root reached and the number
+     * of steps taken to get there, or the point where the iteration stopped.
+     * A lower limit only needs the colors redone, and a higher limit continues each unresolved pixel
+     * from where it stopped.
+     *
+     * As in `fractal_engine`, the arithmetic is float, double, or double-double depending on the pixel
+     * size, chosen once for each level.
+     *
+     * The texture filled by `upload_tiles` is one tile wider and taller than the window and holds the tiles
+     * in view at their grid positions.
+     * `texture_placement` gives the `center` and `range` for vertex_shader02.glsl that put the part of the
+     * texture in view on the square, when it is drawn with fragment_shader02_texture.glsl.
+     */
+    class fractal_tile_cache {
+    public:
+
+        static constexpr int tile_size = 64;
+        static constexpr int coarsest_stride = 8;
+
+        /**
+         * @param width  Width of the window in pixels
+         * @param height  Height of the window in pixels
+         * @param number_of_threads  Number of worker threads, 0 means use the hardware concurrency
+         * @param capacity  Number of tiles kept, the least recently used tiles out of view are dropped beyond this
+         */
+        fractal_tile_cache(int width, int height, int number_of_threads = 0, int capacity = 512)
+                : width(width), height(height), capacity(capacity),
+                  texture_tiles_x((width + tile_size - 1) / tile_size + 1),
+                  texture_tiles_y((height + tile_size - 1) / tile_size + 1)
+        {
+            for (auto t = 0; t < thread_count(number_of_threads); ++t) {
+                workers.emplace_back([this] { work(); });
+            }
+        }
+
+        fractal_tile_cache(const fractal_tile_cache &) = delete;
+        fractal_tile_cache &operator=(const fractal_tile_cache &) = delete;
+
+        ~fractal_tile_cache()
+        {
+            {
+                auto lock = std::lock_guard(mutex);
+                stopping = true;
+                ++generation;
+            }
+            work_available.notify_all();
+            for (auto &worker: workers) {
+                worker.join();
+            }
+        }
+
+        /**
+         * \brief The zoom level whose range is nearest the horizontal range of `view`.
+         */
+        int level_of(const fractal_view &view) const
+        {
+            return static_cast<int>(std::lround(std::log(view.range_x) / std::log(zoom_step)));
+        }
+
+        /**
+         * \brief Show `view`, computing the tiles of it that are not in the cache in the background.
+         *
+         * Tiles still being computed for the previous view that are out of this one are set aside,
+         * the work done on them is kept.
+         */
+        void start(const fractal_view &view)
+        {
+            {
+                auto lock = std::lock_guard(mutex);
+                ++generation;
+                job.iteration_limit = iteration_limit;
+                job.colors = {to_bytes(root_colors[0]), to_bytes(root_colors[1]), to_bytes(root_colors[2]),
+                              to_bytes(no_root_color)};
+                pixels_iterated = 0;
+                tiles_reused = 0;
+
+                auto level = level_of(view);
+                auto level_range = std::pow(zoom_step, level);
+                auto pixel_x = 2 * level_range / width;
+                auto pixel_y = 2 * level_range * (view.range_y / view.range_x) / height;
+                auto left = view.center_x - pixel_x * width / 2;
+                auto bottom = view.center_y - pixel_y * height / 2;
+                auto found = levels.find(level);
+                if (found == levels.end()) {
+                    auto chosen = precision == fractal_precision::automatic
+                            ? precision_for_pixel(std::min(pixel_x, pixel_y), view.center_x.hi, view.center_y.hi)
+                            : precision;
+                    found = levels.emplace(level, level_info{left, bottom, pixel_x, pixel_y, chosen}).first;
+                }
+                auto &info = found->second;
+                last_precision = info.precision;
+
+                // position of the view in pixels of the level's grid
+                auto u = static_cast<double>(left - info.anchor_x) / info.pixel_x;
+                auto v = static_cast<double>(bottom - info.anchor_y) / info.pixel_y;
+                auto origin = tile_key{level, static_cast<std::int64_t>(std::floor(u / tile_size)),
+                                       static_cast<std::int64_t>(std::floor(v / tile_size))};
+                offset_x = u - static_cast<double>(origin.x * tile_size);
+                offset_y = v - static_cast<double>(origin.y * tile_size);
+
+                // the texture holds the tiles at new positions, so every tile in view is uploaded again
+                if (!(origin == texture_origin)) {
+                    texture_origin = origin;
+                    clear_texture = true;
+                    updated.clear();
+                }
+
+                // the tiles the window overlaps, nearest the middle of the window first
+                auto keys = std::vector<tile_key>();
+                auto last_col = static_cast<int>(std::floor((offset_x + width - 0.5) / tile_size));
+                auto last_row = static_cast<int>(std::floor((offset_y + height - 0.5) / tile_size));
+                for (auto row = 0; row <= last_row; ++row) {
+                    for (auto col = 0; col <= last_col; ++col) {
+                        keys.push_back({level, origin.x + col, origin.y + row});
+                    }
+                }
+                auto middle_x = (offset_x + width / 2.0) / tile_size - 0.5;
+                auto middle_y = (offset_y + height / 2.0) / tile_size - 0.5;
+                auto distance = [&](const tile_key &k) {
+                    auto dx = static_cast<double>(k.x - origin.x) - middle_x;
+                    auto dy = static_cast<double>(k.y - origin.y) - middle_y;
+                    return dx * dx + dy * dy;
+                };
+                std::sort(keys.begin(), keys.end(),
+                          [&](const tile_key &a, const tile_key &b) { return distance(a) < distance(b); });
+
+                queue.clear();
+                ++use_count;
+                for (auto &key: keys) {
+                    auto [entry, inserted] = tiles.try_emplace(key);
+                    auto &t = entry->second;
+                    t.queued = false;
+                    t.last_used = use_count;
+                    if (inserted) {
+                        t.allocate();
+                    } else if (!t.pixels.empty()) {
+                        if (clear_texture) {
+                            updated.push_back(key);
+                        }
+                        if (t.stride_done == 1 && t.limit >= job.iteration_limit) {
+                            ++tiles_reused;
+                        }
+                    }
+                    if (needs_work(t)) {
+                        t.queued = true;
+                        queue.push_back(key);
+                    }
+                }
+                evict();
+            }
+            work_available.notify_all();
+        }
+
+        /**
+         * \brief Copy the tiles that changed since the last call into `texture`, an RGBA8 texture of
+         * size `texture_width()` by `texture_height()`.
+         *
+         * @return The number of tiles copied
+         */
+        int upload_tiles(GLuint texture)
+        {
+            auto lock = std::lock_guard(mutex);
+            if (clear_texture) {
+                auto background = to_bytes(pending_color);
+                glClearTexImage(texture, 0, GL_RGBA, GL_UNSIGNED_BYTE, background.data());
+                clear_texture = false;
+            }
+            auto count = 0;
+            for (auto &key: updated) {
+                auto found = tiles.find(key);
+                if (found == tiles.end() || found->second.pixels.empty() || !in_texture(key)) {
+                    continue;
+                }
+                glTextureSubImage2D(texture, 0, static_cast<GLint>(key.x - texture_origin.x) * tile_size,
+                                    static_cast<GLint>(key.y - texture_origin.y) * tile_size, tile_size, tile_size,
+                                    GL_RGBA, GL_UNSIGNED_BYTE, found->second.pixels.data());
+                ++count;
+            }
+            updated.clear();
+            return count;
+        }
+
+        int texture_width() const
+        {
+            return texture_tiles_x * tile_size;
+        }
+
+        int texture_height() const
+        {
+            return texture_tiles_y * tile_size;
+        }
+
+        struct placement {
+            glm::vec2 center;
+            glm::vec2 range;
+        };
+
+        /**
+         * \brief The `center` and `range` uniforms that show the part of the texture in view on the square.
+         *
+         * The texture is sampled at `(vPos + 1) / 2`, so the square must map to the window's part of it,
+         * which starts `offset` pixels into the first tile.
+         */
+        placement texture_placement()
+        {
+            auto lock = std::lock_guard(mutex);
+            auto range = glm::vec2(static_cast<float>(width) / texture_width(),
+                                   static_cast<float>(height) / texture_height());
+            auto center = range - 1.0f + glm::vec2(2 * offset_x / texture_width(), 2 * offset_y / texture_height());
+            return {center, range};
+        }
+
+        /**
+         * \brief True when every tile in view is computed to the current iteration limit.
+         */
+        bool finished()
+        {
+            auto lock = std::lock_guard(mutex);
+            return queue.empty() && busy_count == 0;
+        }
+
+        /**
+         * \brief Wait until every tile in view is computed.
+         */
+        void wait()
+        {
+            auto lock = std::unique_lock(mutex);
+            tile_finished.wait(lock, [this] { return queue.empty() && busy_count == 0; });
+        }
+
+        /**
+         * \brief Show `view` and wait for it.
+         *
+         * @return RGBA8 pixels of the window, rows from the bottom up as OpenGL stores them
+         */
+        std::vector<std::uint8_t> render(const fractal_view &view)
+        {
+            start(view);
+            wait();
+            auto lock = std::lock_guard(mutex);
+            auto image = std::vector<std::uint8_t>(static_cast<size_t>(width) * height * 4);
+            // the texture pixel nearest the center of each window pixel, as the texture sampling picks
+            auto first_x = static_cast<int>(std::floor(offset_x + 0.5));
+            auto first_y = static_cast<int>(std::floor(offset_y + 0.5));
+            for (auto y = 0; y < height; ++y) {
+                auto ty = first_y + y;
+                for (auto x = 0; x < width;) {
+                    auto tx = first_x + x;
+                    auto &t = tiles.at({texture_origin.level, texture_origin.x + tx / tile_size,
+                                        texture_origin.y + ty / tile_size});
+                    auto run = std::min(tile_size - tx % tile_size, width - x);
+                    std::copy_n(t.pixels.begin() + (ty % tile_size * tile_size + tx % tile_size) * 4, run * 4,
+                                image.begin() + (static_cast<size_t>(y) * width + x) * 4);
+                    x += run;
+                }
+            }
+            return image;
+        }
+
+        int iteration_limit = 300;
+        fractal_precision precision = fractal_precision::automatic;
+
+        /**
+         * \brief Each zoom level has this times the range of the one before.
+         */
+        double zoom_step = 0.9;
+
+        /**
+         * \brief The precision of the level of the last view started.
+         */
+        fractal_precision last_precision = fractal_precision::single;
+
+        /**
+         * \brief Pixels computed or continued since the last view started.
+         */
+        std::atomic<long> pixels_iterated = 0;
+
+        /**
+         * \brief Tiles in the last view started that were already complete in the cache.
+         */
+        int tiles_reused = 0;
+
+        std::array<color, 3> root_colors = {x11::navajo_white1, x11::sky_blue1, x11::orange1};
+        color no_root_color = color(0, 0, 0, 255);
+
+        /**
+         * \brief Color of the parts of the texture whose tiles have not been computed yet.
+         */
+        color pending_color = color(127, 127, 127, 255);
+
+        const int width;
+        const int height;
+
+    private:
+
+        using rgba = std::array<std::uint8_t, 4>;
+
+        struct tile_key {
+            int level;
+            std::int64_t x, y;
+
+            bool operator==(const tile_key &other) const
+            {
+                return level == other.level && x == other.x && y == other.y;
+            }
+        };
+
+        struct tile_key_hash {
+            size_t operator()(const tile_key &k) const
+            {
+                auto h = std::hash<std::int64_t>()(k.x);
+                h = h * 31 + std::hash<std::int64_t>()(k.y);
+                return h * 31 + std::hash<int>()(k.level);
+            }
+        };
+
+        struct tile {
+            /**
+             * \brief Limit the computed pixels were taken to.
+             */
+            int limit = 0;
+            /**
+             * \brief Smallest stride whose pass is complete at `limit`, twice the coarsest if none is.
+             */
+            int stride_done = 2 * coarsest_stride;
+            /**
+             * \brief Smallest stride whose pixels have all been computed, at this or a lower limit.
+             */
+            int stride_computed = 2 * coarsest_stride;
+            /**
+             * \brief Limit used for the colors in `pixels`.
+             */
+            int colored_limit = -1;
+            bool busy = false;
+            bool queued = false;
+            std::uint64_t last_used = 0;
+
+            /**
+             * \brief For each pixel, the steps taken, or -1 if it has not been computed.
+             */
+            std::vector<int> steps;
+            std::vector<std::int8_t> root;
+            std::vector<double_double> zr, zi;
+            /**
+             * \brief RGBA8 colors, empty until the first pass is done.
+             */
+            std::vector<std::uint8_t> pixels;
+
+            void allocate()
+            {
+                steps.assign(tile_size * tile_size, -1);
+                root.assign(tile_size * tile_size, -1);
+                zr.resize(tile_size * tile_size);
+                zi.resize(tile_size * tile_size);
+            }
+        };
+
+        struct level_info {
+            double_double anchor_x;
+            double_double anchor_y;
+            double pixel_x;
+            double pixel_y;
+            fractal_precision precision;
+        };
+
+        struct job_settings {
+            int iteration_limit = 0;
+            std::array<rgba, 4> colors;
+        };
+
+        static rgba to_bytes(const color &c)
+        {
+            return {c.r, c.g, c.b, c.a};
+        }
+
+        bool needs_work(const tile &t) const
+        {
+            return t.stride_done > 1 || t.limit < job.iteration_limit || t.colored_limit != job.iteration_limit;
+        }
+
+        bool in_texture(const tile_key &key) const
+        {
+            return key.level == texture_origin.level
+                   && key.x >= texture_origin.x && key.x < texture_origin.x + texture_tiles_x
+                   && key.y >= texture_origin.y && key.y < texture_origin.y + texture_tiles_y;
+        }
+
+        /**
+         * \brief Drop the least recently used tiles that are out of view until at most `capacity` are left.
+         */
+        void evict()
+        {
+            if (static_cast<int>(tiles.size()) <= capacity) {
+                return;
+            }
+            auto candidates = std::vector<std::pair<std::uint64_t, tile_key>>();
+            for (auto &[key, t]: tiles) {
+                if (!t.busy && t.last_used != use_count) {
+                    candidates.emplace_back(t.last_used, key);
+                }
+            }
+            std::sort(candidates.begin(), candidates.end(),
+                      [](const auto &a, const auto &b) { return a.first < b.first; });
+            for (auto &candidate: candidates) {
+                if (static_cast<int>(tiles.size()) <= capacity) {
+                    break;
+                }
+                tiles.erase(candidate.second);
+            }
+        }
+
+        void work()
+        {
+            auto lock = std::unique_lock(mutex);
+            while (true) {
+                auto next = queue.end();
+                work_available.wait(lock, [&] {
+                    next = std::find_if(queue.begin(), queue.end(),
+                                        [&](const tile_key &k) { return !tiles.at(k).busy; });
+                    return stopping || next != queue.end();
+                });
+                if (stopping) {
+                    return;
+                }
+                auto key = *next;
+                queue.erase(next);
+                auto my_generation = generation.load();
+                auto settings = job;
+                auto info = levels.at(key.level);
+                auto &t = tiles.at(key);
+                t.queued = false;
+                t.busy = true;
+                ++busy_count;
+                if (t.limit < settings.iteration_limit) {
+                    // the computed pixels are continued to the new limit, pass by pass, and until then
+                    // the pixels not yet continued show as they were
+                    t.limit = settings.iteration_limit;
+                    t.stride_done = 2 * coarsest_stride;
+                }
+                auto stride = t.stride_done > 1 ? t.stride_done / 2 : 0;
+                auto shown_stride = t.stride_computed;
+                lock.unlock();
+
+                // the tile is busy, so no other thread touches its pixel state
+                auto complete = stride == 0;
+                if (stride > 0) {
+                    switch (info.precision) {
+                        case fractal_precision::double_double:
+                            complete = compute_pass<double_double, 2>(t, key, info, stride, my_generation);
+                            break;
+                        case fractal_precision::double_precision:
+                            complete = compute_pass<double, 4>(t, key, info, stride, my_generation);
+                            break;
+                        default:
+                            complete = compute_pass<float, 8>(t, key, info, stride, my_generation);
+                            break;
+                    }
+                    if (complete) {
+                        shown_stride = std::min(shown_stride, stride);
+                    }
+                }
+                auto colors = std::vector<std::uint8_t>();
+                if (shown_stride <= coarsest_stride) {
+                    colors = color_tile(t, shown_stride, settings);
+                }
+
+                lock.lock();
+                t.busy = false;
+                --busy_count;
+                if (complete && stride > 0) {
+                    t.stride_done = stride;
+                    t.stride_computed = std::min(t.stride_computed, stride);
+                }
+                if (!colors.empty()) {
+                    t.pixels = std::move(colors);
+                    t.colored_limit = settings.iteration_limit;
+                    if (in_texture(key)) {
+                        updated.push_back(key);
+                    }
+                }
+                if (generation == my_generation && !t.queued && needs_work(t)) {
+                    t.queued = true;
+                    queue.push_back(key);
+                }
+                work_available.notify_all();
+                tile_finished.notify_all();
+            }
+        }
+
+        /**
+         * \brief Compute or continue the pixels of `t` in every `stride`th row and column, returning
+         * false if a new view was started part way through.
+         *
+         * The state of each group of pixels is saved as soon as it is done, so a pass that is cut short
+         * keeps its work.
+         */
+        template<typename T, int lanes>
+        bool compute_pass(tile &t, const tile_key &key, const level_info &info, int stride,
+                          std::uint64_t my_generation)
+        {
+            auto base_x = static_cast<double>(key.x * tile_size);
+            auto base_y = static_cast<double>(key.y * tile_size);
+            auto point = [&](const double_double &anchor, double base, int p, double pixel) {
+                return narrow_to<T>(anchor + (base + p + 0.5) * pixel);
+            };
+            std::array<T, tile_size> column_x;
+            for (auto col = 0; col < tile_size; col += stride) {
+                column_x[col] = point(info.anchor_x, base_x, col, info.pixel_x);
+            }
+
+            std::array<T, lanes> zr, zi;
+            std::array<int, lanes> steps, root;
+            std::array<int, lanes> index;
+            auto count = 0;
+            auto flush = [&] {
+                for (auto l = count; l < lanes; ++l) {
+                    zr[l] = zr[0];
+                    zi[l] = zi[0];
+                    steps[l] = t.limit;
+                    root[l] = -1;
+                }
+                newton_iterate<T, lanes>(zr, zi, steps, root, t.limit);
+                for (auto l = 0; l < count; ++l) {
+                    auto i = index[l];
+                    t.zr[i] = widen(zr[l]);
+                    t.zi[i] = widen(zi[l]);
+                    t.steps[i] = steps[l];
+                    t.root[i] = static_cast<std::int8_t>(root[l]);
+                }
+                pixels_iterated += count;
+                count = 0;
+            };
+
+            for (auto row = 0; row < tile_size; row += stride) {
+                if (generation != my_generation) {
+                    return false;
+                }
+                auto y = point(info.anchor_y, base_y, row, info.pixel_y);
+                for (auto col = 0; col < tile_size; col += stride) {
+                    auto i = row * tile_size + col;
+                    if (t.steps[i] < 0) {
+                        zr[count] = column_x[col];
+                        zi[count] = y;
+                        steps[count] = 0;
+                        root[count] = -1;
+                    } else if (t.root[i] < 0 && t.steps[i] < t.limit) {
+                        zr[count] = narrow_to<T>(t.zr[i]);
+                        zi[count] = narrow_to<T>(t.zi[i]);
+                        steps[count] = t.steps[i];
+                        root[count] = -1;
+                    } else {
+                        continue;
+                    }
+                    index[count++] = i;
+                    if (count == lanes) {
+                        flush();
+                    }
+                }
+            }
+            if (count > 0) {
+                flush();
+            }
+            return true;
+        }
+
+        /**
+         * \brief Colors for `t`, each pixel taking the color of the computed pixel at the corner of its
+         * `stride` by `stride` block.
+         */
+        std::vector<std::uint8_t> color_tile(const tile &t, int stride, const job_settings &settings) const
+        {
+            auto colors = std::vector<std::uint8_t>(tile_size * tile_size * 4);
+            auto *out = colors.data();
+            // strides are powers of two, so the corner of a block is found with a mask
+            auto mask = ~(stride - 1);
+            for (auto row = 0; row < tile_size; ++row) {
+                auto corner_row = (row & mask) * tile_size;
+                for (auto col = 0; col < tile_size; ++col) {
+                    auto i = corner_row + (col & mask);
+                    auto reached = t.root[i] >= 0 && t.steps[i] < settings.iteration_limit;
+                    auto &c = settings.colors[reached ? t.root[i] : 3];
+                    out[0] = c[0];
+                    out[1] = c[1];
+                    out[2] = c[2];
+                    out[3] = c[3];
+                    out += 4;
+                }
+            }
+            return colors;
+        }
+
+        const int capacity;
+        const int texture_tiles_x;
+        const int texture_tiles_y;
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable work_available;
+        std::condition_variable tile_finished;
+        std::atomic<std::uint64_t> generation = 0;
+        bool stopping = false;
+
+        // guarded by mutex
+        job_settings job;
+        std::unordered_map<tile_key, tile, tile_key_hash> tiles;
+        std::unordered_map<int, level_info> levels;
+        std::deque<tile_key> queue;
+        std::vector<tile_key> updated;
+        tile_key texture_origin = {0, 0, 0};
+        bool clear_texture = true;
+        double offset_x = 0;
+        double offset_y = 0;
+        std::uint64_t use_count = 0;
+        int busy_count = 0;
+    };
+
+}
@@ -0,0 +1,20 @@
+#version 430 core
+
+precision highp float;
+
+/*
+ * Shows the image computed on the CPU by cs4722::fractal_tile_cache.
+ * vPos runs from -1 to 1 across the square when center is (0,0) and range is (1,1).
+ */
+
+in vec2 vPos;
+
+layout (binding = 0) uniform sampler2D image;
+
+out vec4 fColor;
+
+void
+main()
+{
+    fColor = texture(image, (vPos + 1.0) / 2.0);
+}
@@ -4,6 +4,7 @@
 #include <GLM/gtc/type_ptr.hpp>
 #include <GLM/gtc/matrix_inverse.hpp>
 
+#include <cstring>
 #include <iostream>
 
 
@@ -22,6 +23,9 @@
 #include "cs4722/callbacks.h"
 #include "cs4722/light.h"
 #include "cs4722/compile_shaders.h"
+#include "cs4722/render_context.h"
+#include "cs4722/normal_map_baker.h"
+#include "cs4722/gpu_timer.h"
 
 static cs4722::view *the_view;
 static GLuint program;
@@ -43,6 +47,9 @@ static std::vector<cs4722::artifact*> artifact_list;
 
 static cs4722::light a_light;
 
+static bool use_baked_normals = false;
+static cs4722::gpu_timer *draw_timer;
+
 void init()
 {
     the_view = new cs4722::view();
@@ -52,7 +59,7 @@ void init()
         ///< in world coordinates
 
 	program = cs4722::compile_shaders("vertex_shader03.glsl",
-                                   "fragment_shader03.glsl");
+                                   use_baked_normals ? "fragment_shader03_baked.glsl" : "fragment_shader03.glsl");
 	glUseProgram(program);
 
 
@@ -129,6 +136,31 @@ void init()
 
 
 
+/*
+ * With --baked the bumps are looked up in a normal map instead of being worked out on every fragment.
+ * The heights are the ones fragment_shader03.glsl implies: within BumpSize of the center of a cell
+ * the surface is the dome whose slope at p is (-p.x, -p.y), and outside it is flat.
+ * The map covers one cell and repeats.
+ */
+void init_normal_map()
+{
+    const auto map_size = 256;
+    const auto bump_size = 0.15f;  // BumpSize in fragment_shader03.glsl
+
+    auto baker = cs4722::normal_map_baker(map_size, map_size);
+    auto heights = baker.sample_heights([=](float s, float t) {
+        auto px = s - 0.5f;
+        auto py = t - 0.5f;
+        auto d = px * px + py * py;
+        return d < bump_size ? (bump_size - d) / 2 : 0.0f;
+    });
+    auto texture = baker.create_texture(heights);
+    glBindTextureUnit(1, texture);
+    glUniform1i(glGetUniformLocation(program, "NormalMap"), 1);
+}
+
+
+
 void display()
 {
     static auto last_time = 0.0;
@@ -152,6 +184,8 @@ void display()
     auto time = glfwGetTime();
 	auto delta_time = time - last_time;
 
+	// the time the GPU takes for the objects, to compare the procedural and baked bumps
+	draw_timer->begin();
 	for (auto artf: artifact_list) {
 
 		artf->animate(time, delta_time);
@@ -181,6 +215,7 @@ void display()
 			artf->the_shape->buffer_size);
 		
 	}
+	draw_timer->end();
 }
 
 
@@ -189,27 +224,42 @@ void display()
 int
 main(int argc, char** argv)
 {
-	glfwInit();
-	auto *window = cs4722::setup_window("No Lighting", 0.9);
-    gladLoadGL(glfwGetProcAddress);
+	auto context = cs4722::render_context(argc, argv, "No Lighting", 0.9);
+	auto *window = context.window;
 	cs4722::setup_debug_callbacks();
 
+	for (auto a = 1; a < argc; ++a) {
+		if (std::strcmp(argv[a], "--baked") == 0) {
+			use_baked_normals = true;
+		}
+	}
 	init();
+	if (use_baked_normals) {
+		init_normal_map();
+	}
+	draw_timer = new cs4722::gpu_timer();
+	const auto *mode = use_baked_normals ? "baked" : "procedural";
 
 	glfwSetWindowUserPointer(window, the_view);
 	cs4722::setup_user_callbacks(window);
 
-	while (!glfwWindowShouldClose(window))
+	while (context.running())
 	{
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray25.as_float());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray25.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
 
         display();
-		glfwSwapBuffers(window);
-		glfwPollEvents();
-	}
-
-	glfwDestroyWindow(window);
+		context.end_frame();
 
-	glfwTerminate();
+		if (draw_timer->sample_count() >= 300) {
+			std::cout << "objects drawn in " << draw_timer->average_milliseconds() << " ms on the GPU, "
+				<< mode << " bumps" << std::endl;
+			draw_timer->reset();
+		}
+	}
+	if (draw_timer->sample_count() > 0) {
+		std::cout << "objects drawn in " << draw_timer->average_milliseconds() << " ms on the GPU, "
+			<< mode << " bumps" << std::endl;
+	}
+	delete draw_timer;
 }
@@ -0,0 +1,57 @@
+#version 430 core
+
+out vec4 fColor;
+
+//in vec4 vNormal;
+in vec4 vPosition;
+
+uniform vec4 ambient_product;
+uniform vec4 specular_product;
+uniform vec4 diffuse_product;
+
+uniform vec4 light_position;  // in view coordinates
+uniform float specular_shininess;     // exponent for sharpening highlights
+uniform float specular_strength;      // extra factor to adjust shininess
+
+uniform vec4 SurfaceColor = vec4(0.7, 0.6, 0.18, 1.0);
+uniform float BumpDensity = 5.0;
+// with --baked, the bumps come from a normal map baked on the CPU, one bump across the map
+uniform sampler2D NormalMap;
+uniform float SpecularFactor = 0.5;
+
+
+in vec3 LightDir;
+in vec3 EyeDir;
+in vec2 TexCoord;
+
+void main()
+{
+    vec3 normDelta = normalize(texture(NormalMap, BumpDensity * TexCoord.st).xyz * 2.0 - 1.0);
+
+    vec3 light_direction = LightDir;
+    //vec4 light_direction = vPosition - light_position;
+    vec3 half_vector = normalize(normalize(-light_direction.xyz) - normalize(vPosition.xyz));
+    
+    vec3 vnn = normalize(normDelta);
+
+    float diffuse_factor = max(0.0, dot(vnn, -normalize(light_direction)));
+
+    vec3 reflectDir = reflect(LightDir, normDelta);
+    float specular_factor = max(dot(EyeDir, reflectDir), 0.0);
+//    float specular_factor = max(0.0, dot(vnn.xyz, half_vector));
+
+    if (diffuse_factor == 0.0)
+        specular_factor = 0.0;
+    else
+       specular_factor = pow(specular_factor, specular_shininess) * specular_strength;  // sharpen the highlight
+
+
+    vec4 ambient_component = ambient_product;
+    vec4 diffuse_component = diffuse_factor * diffuse_product;
+    vec4 specular_component = specular_factor * specular_product;
+
+    vec4 total = ambient_component + diffuse_component + specular_component;
+
+    fColor = vec4(total.rgb, 1.0);
+  
+}
@@ -0,0 +1,140 @@
+/*
+ * Measure the time cs4722::mip_builder takes to build the mip chains of the noise textures.
+ *
+ * A 512 by 512 2D texture and a 128 cubed 3D texture of four octaves of noise are baked as in the examples.
+ * The chain of each is built with the box and the Kaiser filter, on one thread and on all of them,
+ *      and the time for each level is printed along with the memory the levels below the base add.
+ *
+ * Two checks are made:
+ *      the chain built on several threads must be identical to the one built on one thread,
+ *      and a texture of a single color must keep that color in every level.
+ * The exit code is 1 if either check fails.
+ *
+ * No window is opened, this program only does CPU work.
+ */
+
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+#include "cs4722/mip_builder.h"
+#include "cs4722/noise_volume_baker.h"
+
+
+static std::vector<GLubyte> bake_noise(int width, int height, int depth)
+{
+    auto volume = std::vector<GLubyte>(4ull * width * height * depth);
+    FastNoiseLite noise;
+    noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+    auto frequency = 4.0f;
+    auto amp = 0.5f;
+    for (auto f = 0; f < 4; ++f) {
+        noise.SetFrequency(frequency);
+        auto *ptr = volume.data() + f;
+        for (auto i = 0; i < depth; ++i) {
+            for (auto j = 0; j < height; ++j) {
+                for (auto k = 0; k < width; ++k) {
+                    auto sample = depth == 1 ? noise.GetNoise(float(j) / height, float(k) / width)
+                                             : noise.GetNoise(float(i) / depth, float(j) / height, float(k) / width);
+                    *ptr = static_cast<GLubyte>((sample + 1.0f) * amp * 128.0f);
+                    ptr += 4;
+                }
+            }
+        }
+        frequency *= 2;
+        amp *= 0.5f;
+    }
+    return volume;
+}
+
+
+static bool same_levels(const std::vector<cs4722::mip_level> &a, const std::vector<cs4722::mip_level> &b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].texels != b[i].texels) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+int
+main()
+{
+    auto exit_code = 0;
+
+    struct test_image {
+        const char *name;
+        int width, height, depth;
+    };
+    for (auto &image: {test_image{"2D 512x512", 512, 512, 1}, test_image{"3D 128^3", 128, 128, 128}}) {
+        auto base = bake_noise(image.width, image.height, image.depth);
+
+        for (auto filter: {cs4722::mip_filter::box, cs4722::mip_filter::kaiser}) {
+            auto single = cs4722::mip_builder(filter, 1);
+            auto single_levels = single.build(base.data(), image.width, image.height, image.depth);
+            auto threaded = cs4722::mip_builder(filter);
+            auto threaded_levels = threaded.build(base.data(), image.width, image.height, image.depth);
+
+            auto match = same_levels(single_levels, threaded_levels);
+            if (!match) {
+                exit_code = 1;
+            }
+
+            auto chain_bytes = 0.0;
+            for (auto &level: threaded_levels) {
+                chain_bytes += level.texels.size();
+            }
+            std::cout << image.name << (filter == cs4722::mip_filter::box ? ", box" : ", Kaiser")
+                      << " filter, threads give the same levels: " << (match ? "yes" : "NO") << std::endl;
+            std::cout << std::setw(8) << "level" << std::setw(16) << "size"
+                      << std::setw(14) << "1 thread ms" << std::setw(14) << "threads ms" << std::endl;
+            for (size_t i = 0; i < threaded_levels.size(); ++i) {
+                auto &level = threaded_levels[i];
+                auto size = std::to_string(level.width) + "x" + std::to_string(level.height)
+                            + (image.depth > 1 ? "x" + std::to_string(level.depth) : "");
+                std::cout << std::setw(8) << i + 1 << std::setw(16) << size << std::fixed << std::setprecision(3)
+                          << std::setw(14) << single.level_milliseconds[i]
+                          << std::setw(14) << threaded.level_milliseconds[i] << std::endl;
+            }
+            auto total = [](const std::vector<double> &times) {
+                return std::accumulate(times.begin(), times.end(), 0.0);
+            };
+            std::cout << std::setw(24) << "total" << std::setw(14) << total(single.level_milliseconds)
+                      << std::setw(14) << total(threaded.level_milliseconds) << std::endl;
+            std::cout << "memory added by the levels below the base: " << std::setprecision(0) << chain_bytes
+                      << " bytes, " << std::setprecision(1) << 100 * chain_bytes / base.size()
+                      << "% of the base" << std::endl << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+        }
+    }
+
+    // a single color must come through every level unchanged, for either filter
+    for (auto filter: {cs4722::mip_filter::box, cs4722::mip_filter::kaiser}) {
+        auto flat = std::vector<GLubyte>(4 * 37 * 20 * 9);
+        for (size_t i = 0; i < flat.size(); i += 4) {
+            flat[i] = 200;
+            flat[i + 1] = 17;
+            flat[i + 2] = 0;
+            flat[i + 3] = 255;
+        }
+        auto levels = cs4722::mip_builder(filter).build(flat.data(), 37, 20, 9);
+        for (auto &level: levels) {
+            for (size_t i = 0; i < level.texels.size(); ++i) {
+                if (level.texels[i] != flat[i % 4]) {
+                    std::cout << "a single color changed in a level of size " << level.width << "x"
+                              << level.height << "x" << level.depth << std::endl;
+                    exit_code = 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    return exit_code;
+}
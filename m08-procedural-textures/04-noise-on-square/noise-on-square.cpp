@@ -18,6 +18,10 @@
 #include "cs4722/compile_shaders.h"
 #include "cs4722/window.h"
 #include "cs4722/callbacks.h"
+#include "cs4722/noise_volume_baker.h"
+#include "cs4722/mip_builder.h"
+#include "cs4722/texture_cache.h"
+#include "cs4722/render_context.h"
 
 
 #include "FastNoiseLite.h"
@@ -128,22 +132,11 @@ void init_texture3D() {
 
     // initialize texture and sampler
 
-    GLuint texture;
-    glCreateTextures(GL_TEXTURE_3D, 1, &texture);
-
-    auto number_of_levels = 1;
-    auto internal_format = GL_RGBA8;
-    auto external_format = GL_RGBA;
-
-   
-    glTextureStorage3D(texture, number_of_levels, internal_format, texture_size, texture_size, texture_size);
-    glTextureSubImage3D(texture, 0, 0, 0, 0, texture_size, texture_size, texture_size, 
-       external_format, GL_UNSIGNED_BYTE, texture_data);
+    auto texture = cs4722::create_mipmapped_texture3D(texture_data, texture_size, texture_size, texture_size);
     delete texture_data;
     glBindTextureUnit(3, texture);
 
-    glTextureParameterfv(texture, GL_TEXTURE_BORDER_COLOR, cs4722::x11::aquamarine.as_float());
-    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameterfv(texture, GL_TEXTURE_BORDER_COLOR, cs4722::x11::aquamarine.as_array().data());
     // auto mag_filter = GL_NEAREST;
     auto mag_filter = GL_LINEAR;
     glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, mag_filter);
@@ -167,74 +160,46 @@ void init_texture3D_F() {
 
 
     const auto texture_size = 128;
-    auto* texture_data = new GLubyte[4 * texture_size * texture_size * texture_size];
-
-
-    auto const number_of_octaves = 1;
 
 
     auto  frequency = 4.0f;
     auto amp = 0.5f;
-    //int inc = 0;
 
     FastNoiseLite noise;
     noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
     noise.SetFrequency(frequency);
 
-    for (auto f = 0; f < number_of_octaves; ++f)
-    {
-        // auto ni = glm::vec3(0.0);
-        auto inc = 1.0f / (texture_size / frequency);
+    /*
+     * The baker fills the volume on several threads.
+     * It produces exactly the same texels as the triple loop that used to be here.
+     *
+     * The result is kept in an on-disk cache keyed by every parameter that affects the texels,
+     *      so later runs just map the file instead of computing the noise again.
+     */
+    auto baker = cs4722::noise_volume_baker(texture_size);
+    baker.add_octave(noise, 1.0f / (texture_size / frequency), amp);
 
-        auto* ptr = texture_data;
-
-        for (auto i = 0; i < texture_size; ++i)
-        {
-            for (auto j = 0; j < texture_size; ++j)
-            {
-                for (auto k = 0; k < texture_size; ++k)
-                {
-                    //(GLubyte)(((noise3(ni)+1.0) * amp) * 128.0);
-
-                    auto sample = noise.GetNoise(i * inc, j * inc, k * inc);
-                	
-                    *(ptr + f) = static_cast<GLubyte>((sample + 1.0f) * amp * 128.0f);
-                    // *(ptr + f) = static_cast<GLubyte>(glm::perlin(ni / frequency) * amp * 128.0f);
-                    // ni.z += inc;
-                    ptr += 4;
-                }
-                // ni.y += inc;
-            }
-            // ni.x += inc;
-        }
-
-
-        frequency *= 2;
-        ++inc;
-        amp *= 0.5;
-    }
+    auto key = cs4722::texture_cache_key("noise-on-square 3D FastNoiseLite")
+            .add(texture_size).add(frequency).add(amp)
+            .add(FastNoiseLite::NoiseType_OpenSimplex2)
+            .add(cs4722::mip_filter::kaiser);
+    // the entry holds the whole mip chain, so a warm start does no filtering either
+    auto texture_data = cs4722::texture_cache().load_or_bake(key,
+            cs4722::mip_builder::chain_byte_size(texture_size, texture_size, texture_size),
+            [&](GLubyte* data) {
+                baker.bake(data);
+                cs4722::mip_builder().build_chain(data, texture_size, texture_size, texture_size);
+            });
 
 
 
 
     // initialize texture and sampler
 
-    GLuint texture;
-    glCreateTextures(GL_TEXTURE_3D, 1, &texture);
-
-    auto number_of_levels = 1;
-    auto internal_format = GL_RGBA8;
-    auto external_format = GL_RGBA;
-
-
-    glTextureStorage3D(texture, number_of_levels, internal_format, texture_size, texture_size, texture_size);
-    glTextureSubImage3D(texture, 0, 0, 0, 0, texture_size, texture_size, texture_size,
-        external_format, GL_UNSIGNED_BYTE, texture_data);
-    delete texture_data;
+    auto texture = cs4722::create_texture3D_from_chain(texture_data->data(), texture_size, texture_size, texture_size);
     glBindTextureUnit(4, texture);
 
-    glTextureParameterfv(texture, GL_TEXTURE_BORDER_COLOR, cs4722::x11::aquamarine.as_float());
-    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameterfv(texture, GL_TEXTURE_BORDER_COLOR, cs4722::x11::aquamarine.as_array().data());
     // auto mag_filter = GL_NEAREST;
     auto mag_filter = GL_LINEAR;
     glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, mag_filter);
@@ -304,22 +269,11 @@ void init_texture2D() {
 
     // initialize texture and sampler
 
-    GLuint texture;
-    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
-
-    auto number_of_levels = 1;
-    auto internal_format = GL_RGBA8;
-    auto external_format = GL_RGBA;
-
-
-    glTextureStorage2D(texture, number_of_levels, internal_format, texture_size, texture_size);
-    glTextureSubImage2D(texture, 0, 0, 0, texture_size, texture_size,
-        external_format, GL_UNSIGNED_BYTE, texture_data);
+    auto texture = cs4722::create_mipmapped_texture2D(texture_data, texture_size, texture_size);
     delete texture_data;
     glBindTextureUnit(2, texture);
 
-    glTextureParameterfv(texture, GL_TEXTURE_BORDER_COLOR, cs4722::x11::aquamarine.as_float());
-    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameterfv(texture, GL_TEXTURE_BORDER_COLOR, cs4722::x11::aquamarine.as_array().data());
     // auto mag_filter = GL_NEAREST;
     auto mag_filter = GL_LINEAR;
     glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, mag_filter);
@@ -348,18 +302,14 @@ void init_texture2D() {
 void
 display(void)
 {
-    glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_float());
+    glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_array().data());
     glDrawArrays(GL_TRIANGLES, 0, NumVertices);
 }
 
 int
 main(int argc, char** argv)
 {
-    glfwInit();
-
-    auto *window = cs4722::setup_window("Noise on Square", .9);
-
-    gladLoadGL(glfwGetProcAddress);
+    auto context = cs4722::render_context(argc, argv, "Noise on Square", .9);
     cs4722::setup_debug_callbacks();
 
 
@@ -379,14 +329,9 @@ main(int argc, char** argv)
 //    std::cout << "max texture size " << max_texture_size << std::endl;
 	
 
-    while (!glfwWindowShouldClose(window))
+    while (context.running())
     {
         display();
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        context.end_frame();
     }
-
-    glfwDestroyWindow(window);
-
-    glfwTerminate();
 }
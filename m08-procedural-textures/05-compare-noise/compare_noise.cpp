@@ -18,6 +18,9 @@
 #include "cs4722/window.h"
 
 #include "FastNoiseLite.h"
+#include "cs4722/texture_cache.h"
+#include "cs4722/mip_builder.h"
+#include "cs4722/render_context.h"
 
 static GLuint program;
 static cs4722::view *the_view;
@@ -133,22 +136,11 @@ void init_texture2D() {
 
 	// initialize texture and sampler
 
-	GLuint texture;
-	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
-
-	auto number_of_levels = 1;
-	auto internal_format = GL_RGBA8;
-	auto external_format = GL_RGBA;
-
-
-	glTextureStorage2D(texture, number_of_levels, internal_format, texture_size, texture_size);
-	glTextureSubImage2D(texture, 0, 0, 0, texture_size, texture_size,
-		external_format, GL_UNSIGNED_BYTE, texture_data);
+	auto texture = cs4722::create_mipmapped_texture2D(texture_data, texture_size, texture_size);
 	delete texture_data;
 	glBindTextureUnit(2, texture);
 
-	glTextureParameterfv(texture, GL_TEXTURE_BORDER_COLOR, cs4722::x11::aquamarine.as_float());
-	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameterfv(texture, GL_TEXTURE_BORDER_COLOR, cs4722::x11::aquamarine.as_array().data());
 	// auto mag_filter = GL_NEAREST;
 	auto mag_filter = GL_LINEAR;
 	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, mag_filter);
@@ -173,7 +165,6 @@ void init_texture2D_alt() {
 
 
 	const auto texture_size = 512;
-	auto* texture_data = new GLubyte[4 * texture_size * texture_size];
 
 
 	auto const number_of_octaves = 4;
@@ -183,56 +174,67 @@ void init_texture2D_alt() {
 	auto amp = 1.0f;// 0.5f;
 	//int inc = 0;
 
-	FastNoiseLite noise;
-	noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+	/*
+	 * The texels only depend on these parameters, so they are kept in an on-disk cache.
+	 * The noise is computed only when the cache has no entry for this key.
+	 */
+	auto key = cs4722::texture_cache_key("compare-noise 2D FastNoiseLite")
+		.add(texture_size).add(number_of_octaves).add(frequency).add(amp)
+		.add(FastNoiseLite::NoiseType_OpenSimplex2)
+		.add(cs4722::mip_filter::kaiser);
 
+	auto bake = [=](GLubyte* texture_data) {
+		auto  frequency_f = frequency;
+		auto amp_f = amp;
 
-	for (auto f = 0; f < number_of_octaves; ++f)
-	{
-		noise.SetFrequency(frequency);
+		FastNoiseLite noise;
+		noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
 
-		// auto inc = 1.0f / (texture_size / frequency);
-		auto inc = 1.0f / texture_size;
+		for (auto f = 0; f < number_of_octaves; ++f)
+		{
+			noise.SetFrequency(frequency_f);
 
-		auto* ptr = texture_data;
+			// auto inc = 1.0f / (texture_size / frequency);
+			auto inc = 1.0f / texture_size;
 
-		for (auto i = 0; i < texture_size; ++i)
-		{
-			for (auto j = 0; j < texture_size; ++j)
+			auto* ptr = texture_data;
+
+			for (auto i = 0; i < texture_size; ++i)
 			{
-				auto sample = noise.GetNoise(i * inc, j * inc);
-				*(ptr + f) = static_cast<GLubyte>((sample + 1.0f) * amp * 128.0f);
+				for (auto j = 0; j < texture_size; ++j)
+				{
+					auto sample = noise.GetNoise(i * inc, j * inc);
+					*(ptr + f) = static_cast<GLubyte>((sample + 1.0f) * amp_f * 128.0f);
 
-				ptr += 4;
+					ptr += 4;
+				}
 			}
-		}
-
-
-		frequency *= 2;
-		amp *= 0.5f;
-	}
 
 
+			frequency_f *= 2;
+			amp_f *= 0.5f;
+		}
+	};
 
+	/*
+	 * The cache entry holds the whole mip chain, so a warm start does no filtering either.
+	 */
+	auto texture_data = cs4722::texture_cache().load_or_bake(key,
+		cs4722::mip_builder::chain_byte_size(texture_size, texture_size),
+		[&](GLubyte* data) {
+			bake(data);
+			cs4722::mip_builder().build_chain(data, texture_size, texture_size);
+		});
 
-	// initialize texture and sampler
 
-	GLuint texture;
-	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
 
-	auto number_of_levels = 1;
-	auto internal_format = GL_RGBA8;
-	auto external_format = GL_RGBA;
 
+	// initialize texture and sampler
 
-	glTextureStorage2D(texture, number_of_levels, internal_format, texture_size, texture_size);
-	glTextureSubImage2D(texture, 0, 0, 0, texture_size, texture_size,
-		external_format, GL_UNSIGNED_BYTE, texture_data);
-	delete texture_data;
+	auto texture = cs4722::create_texture2D_from_chain(texture_data->data(), texture_size, texture_size);
 	glBindTextureUnit(2, texture);
 
-	glTextureParameterfv(texture, GL_TEXTURE_BORDER_COLOR, cs4722::x11::aquamarine.as_float());
-	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameterfv(texture, GL_TEXTURE_BORDER_COLOR, cs4722::x11::aquamarine.as_array().data());
 	// auto mag_filter = GL_NEAREST;
 	auto mag_filter = GL_LINEAR;
 	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, mag_filter);
@@ -285,9 +287,8 @@ void display()
 int
 main(int argc, char** argv)
 {
-	glfwInit();
-    auto *window = cs4722::setup_window("Compare Noise", .9);
-    gladLoadGL(glfwGetProcAddress);
+    auto context = cs4722::render_context(argc, argv, "Compare Noise", .9);
+    auto *window = context.window;
     cs4722::setup_debug_callbacks();
     init();
 	the_view->set_flup(glm::vec3(0, 0, -1), glm::vec3(-1, 0, 0),
@@ -297,14 +298,11 @@ main(int argc, char** argv)
 	glfwSetWindowUserPointer(window, the_view);
     cs4722::setup_user_callbacks(window);
 
-	while (!glfwWindowShouldClose(window))
+	while (context.running())
 	{
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_float());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
         display();
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		context.end_frame();
 	}
-	glfwDestroyWindow(window);
-	glfwTerminate();
 }
@@ -0,0 +1,426 @@
+/*
+ * Measure the noise generators the examples use, for speed and for quality, to choose one for a bake.
+ *
+ * The generators are glm::perlin and glm::simplex, every FastNoiseLite noise type (in 3D with each
+ *      rotation type as well), the port of the GLSL snoise of 07-clouds-glsl in cs4722/snoise.h, one point
+ *      at a time and in batches, and cs4722::simplex_noise4 in 4D.
+ * FastNoiseLite has no 4D noise.
+ *
+ * Each generator fills 2D, 3D or 4D grids at two sizes, with samples 1/16 of a noise unit apart,
+ *      so there are 16 samples across each lattice cell.
+ * The larger grid is filled on 1, 2, 4, ... threads up to the number of hardware threads,
+ *      rows claimed in turn as the baker does, and the time per sample is printed for each.
+ *
+ * The quality table is in order of cost on one thread, cheapest first.
+ * It comes from a 256 by 256 slice of each generator:
+ *      the smallest and largest values, the mean and standard deviation,
+ *      a histogram of [-1, 1] in 16 bins, drawn with characters from ' ' for an empty bin to '@' for the
+ *          fullest, and the share of values outside [-1, 1],
+ *      and the share of the energy of the slice, less its mean, in bands of frequency, in cycles per
+ *          sample, 1/16 being the lattice frequency.
+ * Energy at 1/4 and above is detail much finer than the lattice, where the value noises and
+ *      the creases of cellular noise show up.
+ *
+ * The two versions of snoise are compared last, the exit code is 1 if they differ by more than 1e-4.
+ *
+ * No window is opened, this program only does CPU work.
+ *
+ * Usage: 05-noise-benchmark [largest number of threads]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <GLM/gtc/noise.hpp>
+
+#include "FastNoiseLite.h"
+#include "cs4722/parallel_for.h"
+#include "cs4722/simplex_noise4.h"
+#include "cs4722/snoise.h"
+
+
+const auto spacing = 1.0f / 16;
+
+
+/*
+ * A noise generator, filled in a row at a time so the cost of the virtual call is spread over the row.
+ */
+class generator {
+public:
+    generator(std::string name, int dimensions) : name(std::move(name)), dimensions(dimensions) {}
+
+    virtual ~generator() = default;
+
+    /*
+     * `count` samples at x = 0, step, 2 step, ..., with the other coordinates fixed.
+     */
+    virtual void row(float step, float y, float z, float w, int count, float *values) const = 0;
+
+    std::string name;
+    int dimensions;
+    std::vector<double> nanoseconds;
+};
+
+
+template<typename F>
+class point_generator : public generator {
+public:
+    point_generator(std::string name, int dimensions, F f) : generator(std::move(name), dimensions), f(f) {}
+
+    void row(float step, float y, float z, float w, int count, float *values) const override
+    {
+        for (auto i = 0; i < count; ++i) {
+            values[i] = f(static_cast<float>(i) * step, y, z, w);
+        }
+    }
+
+private:
+    F f;
+};
+
+
+template<typename F>
+static std::unique_ptr<generator> make_generator(std::string name, int dimensions, F f)
+{
+    return std::make_unique<point_generator<F>>(std::move(name), dimensions, f);
+}
+
+
+/*
+ * snoise in batches, the coordinates of a row put in arrays for the vectorized version.
+ */
+class snoise_batch_generator : public generator {
+public:
+    snoise_batch_generator() : generator("snoise, batches", 3) {}
+
+    void row(float step, float y, float z, float, int count, float *values) const override
+    {
+        constexpr auto batch = 64;
+        float xs[batch], ys[batch], zs[batch];
+        std::fill(ys, ys + batch, y);
+        std::fill(zs, zs + batch, z);
+        for (auto i0 = 0; i0 < count; i0 += batch) {
+            auto n = std::min(batch, count - i0);
+            for (auto i = 0; i < n; ++i) {
+                xs[i] = static_cast<float>(i0 + i) * step;
+            }
+            cs4722::snoise(xs, ys, zs, values + i0, n);
+        }
+    }
+};
+
+
+/*
+ * Fill a grid with `size` samples along each axis on `threads` threads, returning nanoseconds per sample.
+ */
+static double time_grid(const generator &g, int size, int threads)
+{
+    auto rows = 1L;
+    for (auto d = 1; d < g.dimensions; ++d) {
+        rows *= size;
+    }
+    const auto rows_per_claim = 16L;
+    auto claims = static_cast<int>((rows + rows_per_claim - 1) / rows_per_claim);
+    auto make_values = [&]() { return std::vector<float>(size); };
+
+    auto start = std::chrono::steady_clock::now();
+    cs4722::parallel_for(claims, threads, make_values, [&](int claim, std::vector<float> &values) {
+        auto first = claim * rows_per_claim;
+        for (auto r = first; r < std::min(rows, first + rows_per_claim); ++r) {
+            auto y = static_cast<float>(r % size) * spacing;
+            auto z = static_cast<float>(r / size % size) * spacing;
+            auto w = static_cast<float>(r / size / size) * spacing;
+            g.row(spacing, y, z, w, size, values.data());
+        }
+    });
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds * 1e9 / (static_cast<double>(rows) * size);
+}
+
+
+/*
+ * In place radix 2 FFT, `values.size()` a power of two.
+ */
+static void fft(std::vector<std::complex<double>> &values)
+{
+    const auto n = values.size();
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        auto bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(values[i], values[j]);
+        }
+    }
+    for (size_t length = 2; length <= n; length <<= 1) {
+        auto angle = -2 * M_PI / static_cast<double>(length);
+        auto root = std::complex<double>(std::cos(angle), std::sin(angle));
+        for (size_t i = 0; i < n; i += length) {
+            auto w = std::complex<double>(1);
+            for (size_t k = 0; k < length / 2; ++k) {
+                auto u = values[i + k];
+                auto v = values[i + k + length / 2] * w;
+                values[i + k] = u + v;
+                values[i + k + length / 2] = u - v;
+                w *= root;
+            }
+        }
+    }
+}
+
+
+struct quality {
+    double low, high, mean, deviation, outside;
+    int histogram[16];
+    double bands[5];
+};
+
+// upper edges of the frequency bands, in cycles per sample
+const double band_edges[5] = {1.0 / 32, 1.0 / 16, 1.0 / 8, 1.0 / 4, 1.0};
+const char *band_names[5] = {"<1/32", "<1/16", "<1/8", "<1/4", ">=1/4"};
+
+
+static quality measure_quality(const generator &g)
+{
+    const auto n = 256;
+    auto slice = std::vector<float>(n * n);
+    for (auto j = 0; j < n; ++j) {
+        g.row(spacing, static_cast<float>(j) * spacing, 0.37f, 0.61f, n, &slice[j * n]);
+    }
+
+    auto q = quality{};
+    q.low = *std::min_element(slice.begin(), slice.end());
+    q.high = *std::max_element(slice.begin(), slice.end());
+    auto sum = 0.0, squares = 0.0;
+    for (auto v: slice) {
+        sum += v;
+        squares += static_cast<double>(v) * v;
+        if (v < -1.0f || v > 1.0f) {
+            q.outside += 1;
+        } else {
+            ++q.histogram[std::min(15, static_cast<int>((v + 1.0f) * 8))];
+        }
+    }
+    q.mean = sum / (n * n);
+    q.deviation = std::sqrt(std::max(0.0, squares / (n * n) - q.mean * q.mean));
+    q.outside /= n * n;
+
+    // rows then columns, then the energy of each frequency by its distance from 0
+    auto spectrum = std::vector<std::complex<double>>(n * n);
+    for (auto i = 0; i < n * n; ++i) {
+        spectrum[i] = slice[i] - q.mean;
+    }
+    auto line = std::vector<std::complex<double>>(n);
+    for (auto pass = 0; pass < 2; ++pass) {
+        for (auto a = 0; a < n; ++a) {
+            for (auto b = 0; b < n; ++b) {
+                line[b] = pass == 0 ? spectrum[a * n + b] : spectrum[b * n + a];
+            }
+            fft(line);
+            for (auto b = 0; b < n; ++b) {
+                (pass == 0 ? spectrum[a * n + b] : spectrum[b * n + a]) = line[b];
+            }
+        }
+    }
+    auto total = 0.0;
+    for (auto j = 0; j < n; ++j) {
+        for (auto i = 0; i < n; ++i) {
+            auto fx = static_cast<double>(i <= n / 2 ? i : i - n) / n;
+            auto fy = static_cast<double>(j <= n / 2 ? j : j - n) / n;
+            auto energy = std::norm(spectrum[j * n + i]);
+            auto band = 0;
+            while (band < 4 && std::hypot(fx, fy) >= band_edges[band]) {
+                ++band;
+            }
+            q.bands[band] += energy;
+            total += energy;
+        }
+    }
+    for (auto &band: q.bands) {
+        band = total > 0 ? band / total : 0;
+    }
+    return q;
+}
+
+
+static std::string histogram_string(const quality &q)
+{
+    const auto shades = std::string(" .:-=+*#%@");
+    auto fullest = *std::max_element(q.histogram, q.histogram + 16);
+    auto text = std::string();
+    for (auto count: q.histogram) {
+        auto shade = count == 0 ? 0 : 1 + static_cast<int>((shades.size() - 2) * static_cast<double>(count) / fullest);
+        text += shades[std::min(shade, static_cast<int>(shades.size()) - 1)];
+    }
+    return text;
+}
+
+
+int main(int argc, char **argv)
+{
+    auto max_threads = cs4722::thread_count(argc > 1 ? std::atoi(argv[1]) : 0);
+    auto thread_counts = std::vector<int>();
+    for (auto t = 1; t < max_threads; t *= 2) {
+        thread_counts.push_back(t);
+    }
+    thread_counts.push_back(max_threads);
+
+    auto generators = std::vector<std::unique_ptr<generator>>();
+
+    generators.push_back(make_generator("glm::perlin", 2, [](float x, float y, float, float) {
+        return glm::perlin(glm::vec2(x, y));
+    }));
+    generators.push_back(make_generator("glm::simplex", 2, [](float x, float y, float, float) {
+        return glm::simplex(glm::vec2(x, y));
+    }));
+    generators.push_back(make_generator("glm::perlin", 3, [](float x, float y, float z, float) {
+        return glm::perlin(glm::vec3(x, y, z));
+    }));
+    generators.push_back(make_generator("glm::simplex", 3, [](float x, float y, float z, float) {
+        return glm::simplex(glm::vec3(x, y, z));
+    }));
+    generators.push_back(make_generator("glm::perlin", 4, [](float x, float y, float z, float w) {
+        return glm::perlin(glm::vec4(x, y, z, w));
+    }));
+    generators.push_back(make_generator("glm::simplex", 4, [](float x, float y, float z, float w) {
+        return glm::simplex(glm::vec4(x, y, z, w));
+    }));
+
+    const std::pair<const char *, FastNoiseLite::NoiseType> noise_types[] = {
+            {"OpenSimplex2", FastNoiseLite::NoiseType_OpenSimplex2},
+            {"OpenSimplex2S", FastNoiseLite::NoiseType_OpenSimplex2S},
+            {"Cellular", FastNoiseLite::NoiseType_Cellular},
+            {"Perlin", FastNoiseLite::NoiseType_Perlin},
+            {"ValueCubic", FastNoiseLite::NoiseType_ValueCubic},
+            {"Value", FastNoiseLite::NoiseType_Value},
+    };
+    const std::pair<const char *, FastNoiseLite::RotationType3D> rotation_types[] = {
+            {"", FastNoiseLite::RotationType3D_None},
+            {", XY planes", FastNoiseLite::RotationType3D_ImproveXYPlanes},
+            {", XZ planes", FastNoiseLite::RotationType3D_ImproveXZPlanes},
+    };
+    for (auto &[type_name, type]: noise_types) {
+        FastNoiseLite noise;
+        noise.SetNoiseType(type);
+        noise.SetFrequency(1.0f);
+        generators.push_back(make_generator(std::string("FNL ") + type_name, 2,
+                                            [noise](float x, float y, float, float) {
+                                                return noise.GetNoise(x, y);
+                                            }));
+        for (auto &[rotation_name, rotation]: rotation_types) {
+            noise.SetRotationType3D(rotation);
+            generators.push_back(make_generator(std::string("FNL ") + type_name + rotation_name, 3,
+                                                [noise](float x, float y, float z, float) {
+                                                    return noise.GetNoise(x, y, z);
+                                                }));
+        }
+    }
+
+    generators.push_back(make_generator("snoise, one point", 3, [](float x, float y, float z, float) {
+        return cs4722::snoise(glm::vec3(x, y, z));
+    }));
+    generators.push_back(std::make_unique<snoise_batch_generator>());
+    auto noise4 = cs4722::simplex_noise4();
+    generators.push_back(make_generator("cs4722::simplex_noise4", 4, [noise4](float x, float y, float z, float w) {
+        return noise4.noise(x, y, z, w);
+    }));
+
+    const int sizes[5][2] = {{0, 0}, {0, 0}, {256, 1024}, {32, 128}, {16, 32}};
+    auto qualities = std::vector<quality>();
+    for (auto &g: generators) {
+        qualities.push_back(measure_quality(*g));
+    }
+
+    for (auto d = 2; d <= 4; ++d) {
+        std::cout << std::endl << d << "D grids, ns per sample" << std::endl;
+        std::cout << std::setw(32) << "generator" << std::setw(11)
+                  << (std::to_string(sizes[d][0]) + "^" + std::to_string(d));
+        for (auto t: thread_counts) {
+            std::cout << std::setw(11) << (std::to_string(sizes[d][1]) + "^" + std::to_string(d)
+                                           + " x" + std::to_string(t));
+        }
+        std::cout << std::endl;
+        for (auto &g: generators) {
+            if (g->dimensions != d) {
+                continue;
+            }
+            g->nanoseconds.push_back(time_grid(*g, sizes[d][0], 1));
+            for (auto t: thread_counts) {
+                g->nanoseconds.push_back(time_grid(*g, sizes[d][1], t));
+            }
+            std::cout << std::setw(32) << g->name << std::fixed << std::setprecision(1);
+            for (auto ns: g->nanoseconds) {
+                std::cout << std::setw(11) << ns;
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    for (auto d = 2; d <= 4; ++d) {
+        std::cout << std::endl << d << "D quality, cheapest first" << std::endl;
+        std::cout << std::setw(32) << "generator" << std::setw(8) << "ns" << std::setw(8) << "min"
+                  << std::setw(8) << "max" << std::setw(8) << "mean" << std::setw(8) << "stddev"
+                  << "  histogram [-1, 1]  outside ";
+        for (auto name: band_names) {
+            std::cout << std::setw(7) << name;
+        }
+        std::cout << std::endl;
+        auto order = std::vector<size_t>();
+        for (size_t i = 0; i < generators.size(); ++i) {
+            if (generators[i]->dimensions == d) {
+                order.push_back(i);
+            }
+        }
+        // the larger grid on one thread
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return generators[a]->nanoseconds[1] < generators[b]->nanoseconds[1];
+        });
+        for (auto i: order) {
+            auto &q = qualities[i];
+            std::cout << std::setw(32) << generators[i]->name << std::fixed << std::setprecision(1)
+                      << std::setw(8) << generators[i]->nanoseconds[1] << std::setprecision(3)
+                      << std::setw(8) << q.low << std::setw(8) << q.high << std::setw(8) << q.mean
+                      << std::setw(8) << q.deviation << "  |" << histogram_string(q) << "|  "
+                      << std::setprecision(1) << std::setw(6) << q.outside * 100 << "%";
+            for (auto band: q.bands) {
+                std::cout << std::setw(6) << band * 100 << "%";
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    // the batches are only worth having if they give the same noise
+    auto largest = 0.0f;
+    auto one = std::vector<float>(1024), batches = std::vector<float>(1024);
+    auto &batch_generator = *std::find_if(generators.begin(), generators.end(), [](const auto &g) {
+        return g->name == "snoise, batches";
+    });
+    for (auto j = 0; j < 64; ++j) {
+        auto y = static_cast<float>(j) * 0.37f - 7.0f;
+        for (auto i = 0; i < 1024; ++i) {
+            one[i] = cs4722::snoise(glm::vec3(static_cast<float>(i) * 0.05f, y, 3.1f));
+        }
+        batch_generator->row(0.05f, y, 3.1f, 0, 1024, batches.data());
+        for (auto i = 0; i < 1024; ++i) {
+            largest = std::max(largest, std::abs(one[i] - batches[i]));
+        }
+    }
+    auto one_point = std::find_if(generators.begin(), generators.end(), [](const auto &g) {
+        return g->name == "snoise, one point";
+    });
+    std::cout << std::endl << "snoise in batches is " << std::setprecision(2)
+              << (*one_point)->nanoseconds[1] / batch_generator->nanoseconds[1]
+              << " times as fast as one point at a time, largest difference " << std::scientific << largest
+              << std::endl;
+    return largest <= 1e-4f ? 0 : 1;
+}
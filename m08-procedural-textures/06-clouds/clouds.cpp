@@ -7,6 +7,8 @@
 #include <GLM/gtc/matrix_inverse.hpp>
 
 
+#include <chrono>
+#include <cstring>
 #include <iostream>
 
 #include <glad/gl.h>
@@ -22,17 +24,27 @@
 #include "cs4722/light.h"
 #include "cs4722/window.h"
 #include "cs4722/callbacks.h"
+#include "cs4722/noise_volume_baker.h"
+#include "cs4722/mip_builder.h"
+#include "cs4722/noise_volume_stream.h"
+#include "cs4722/virtual_noise_volume.h"
+#include "cs4722/texture_cache.h"
+#include "cs4722/render_context.h"
 
 static GLuint program;
 static cs4722::view* the_view;
 static std::vector<cs4722::artifact*> artifact_list;
 static cs4722::light the_light;
+static cs4722::noise_volume_stream* noise_stream = nullptr;
+static cs4722::virtual_noise_volume* virtual_volume = nullptr;
+static bool use_virtual_volume = false;
 
 void init()
 {
 
 
-    program = cs4722::compile_shaders("vertex_shader06.glsl","fragment_shader06.glsl");
+    program = cs4722::compile_shaders("vertex_shader06.glsl",
+        use_virtual_volume ? "fragment_shader06_virtual.glsl" : "fragment_shader06.glsl");
     glUseProgram(program);
 
     glEnable(GL_PROGRAM_POINT_SIZE);
@@ -97,7 +109,6 @@ void init_texture3D() {
 
 
 	const auto texture_size = 128;
-	auto* texture_data = new GLubyte[4 * texture_size * texture_size * texture_size];
 
 
 	auto const number_of_octaves = 4;
@@ -105,74 +116,50 @@ void init_texture3D() {
 
 	auto  frequency = 4.0f;
 	auto amp = 0.5f;
-	//int inc = 0;
-
-	// auto* noise_gen = new SimplexNoise();
 
 	FastNoiseLite noise;
 	noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
 	noise.SetRotationType3D(FastNoiseLite::RotationType3D_ImproveXZPlanes);
 
+	/*
+	 * Each octave goes into its own channel of the texture.
+	 * The baker evaluates all of them on several threads.
+	 */
+	auto baker = cs4722::noise_volume_baker(texture_size);
+	auto key = cs4722::texture_cache_key("clouds 3D FastNoiseLite")
+		.add(texture_size).add(number_of_octaves).add(frequency).add(amp)
+		.add(FastNoiseLite::NoiseType_OpenSimplex2)
+		.add(FastNoiseLite::RotationType3D_ImproveXZPlanes)
+		.add(cs4722::mip_filter::kaiser);
 	for (auto f = 0; f < number_of_octaves; ++f)
 	{
-
 		noise.SetFrequency(frequency);
-
-		// auto ni = glm::vec3(0.0);
-		// auto inc = 1.0f / (texture_size / frequency);
-		auto inc =  4.0f / texture_size;
-
-		auto* ptr = texture_data;
-
-		for (auto i = 0; i < texture_size; ++i)
-		{
-			for (auto j = 0; j < texture_size; ++j)
-			{
-				for (auto k = 0; k < texture_size; ++k)
-				{
-					//(GLubyte)(((noise3(ni)+1.0) * amp) * 128.0);
-
-					// *(ptr + f) = static_cast<GLubyte>((glm::simplex(glm::vec3(i, j, k) * inc) + 1.0f) * amp * 128.0f);
-					// *(ptr + f) = static_cast<GLubyte>(glm::perlin(ni / frequency) * amp * 128.0f);
-					// ni.z += inc;
-					
-					auto sample = noise.GetNoise(i * inc, j * inc, k * inc);
-					*(ptr + f) = static_cast<GLubyte>((sample + 1.0f) * amp * 128.0f);
-
-					ptr += 4;
-				}
-				// ni.y += inc;
-			}
-			// ni.x += inc;
-		}
-
+		baker.add_octave(noise, 4.0f / texture_size, amp);
 
 		frequency *= 2;
-		++inc;
 		amp *= 0.5;
 	}
 
+	/*
+	 * Only bake when the texels are not already in the on-disk cache.
+	 * The cache entry holds the whole mip chain, so a warm start does no filtering either.
+	 */
+	auto texture_data = cs4722::texture_cache().load_or_bake(key,
+		cs4722::mip_builder::chain_byte_size(texture_size, texture_size, texture_size),
+		[&](GLubyte* data) {
+			baker.bake(data);
+			cs4722::mip_builder().build_chain(data, texture_size, texture_size, texture_size);
+		});
 
 
 
-	// initialize texture and sampler
-
-	GLuint texture;
-	glCreateTextures(GL_TEXTURE_3D, 1, &texture);
-
-	auto number_of_levels = 1;
-	auto internal_format = GL_RGBA8;
-	auto external_format = GL_RGBA;
 
+	// initialize texture and sampler
 
-	glTextureStorage3D(texture, number_of_levels, internal_format, texture_size, texture_size, texture_size);
-	glTextureSubImage3D(texture, 0, 0, 0, 0, texture_size, texture_size, texture_size,
-		external_format, GL_UNSIGNED_BYTE, texture_data);
-	delete texture_data;
+	auto texture = cs4722::create_texture3D_from_chain(texture_data->data(), texture_size, texture_size, texture_size);
 	glBindTextureUnit(3, texture);
 
-	glTextureParameterfv(texture, GL_TEXTURE_BORDER_COLOR, cs4722::x11::aquamarine.as_float());
-	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameterfv(texture, GL_TEXTURE_BORDER_COLOR, cs4722::x11::aquamarine.as_array().data());
 	// auto mag_filter = GL_NEAREST;
 	auto mag_filter = GL_LINEAR;
 	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, mag_filter);
@@ -187,6 +174,79 @@ void init_texture3D() {
 	auto sampler_loc = glGetUniformLocation(program, "Noise");
 	std::cout << "sampler_loc " << sampler_loc << std::endl;
 	glUniform1i(sampler_loc, 3);
+	// the same volume stands in for the next time slice, with a blend of 0
+	glUniform1i(glGetUniformLocation(program, "NextNoise"), 3);
+
+}
+
+
+/*
+ * With --animate the clouds change over time.
+ * The volume is a time slice of 4D noise, with the same octaves as init_texture3D.
+ * Later slices are made on a background thread while the clouds are drawn, and the shader
+ * blends between the two slices on either side of the current time.
+ */
+void init_noise_stream() {
+
+
+	const auto texture_size = 128;
+
+
+	auto const number_of_octaves = 4;
+
+
+	auto  frequency = 4.0f;
+	auto amp = 0.5f;
+
+	noise_stream = new cs4722::noise_volume_stream(texture_size, 4.0f / texture_size);
+	for (auto f = 0; f < number_of_octaves; ++f)
+	{
+		noise_stream->add_octave(frequency, amp);
+
+		frequency *= 2;
+		amp *= 0.5;
+	}
+	noise_stream->start();
+
+	glUniform1i(glGetUniformLocation(program, "Noise"), 3);
+	glUniform1i(glGetUniformLocation(program, "NextNoise"), 4);
+
+}
+
+
+/*
+ * With --virtual the volume is 1024 texels along each edge, eight times the resolution of init_texture3D,
+ * with the same octaves.
+ * Baked, it would take 4 GB.
+ * Only the bricks the shader reaches are generated, at the level of detail it needs, and a pool of
+ * 256 bricks holds the ones most recently drawn.
+ */
+void init_virtual_texture3D() {
+
+
+	const auto texture_size = 1024;
+
+
+	auto const number_of_octaves = 4;
+
+
+	auto  frequency = 4.0f;
+	auto amp = 0.5f;
+
+	FastNoiseLite noise;
+	noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+	noise.SetRotationType3D(FastNoiseLite::RotationType3D_ImproveXZPlanes);
+
+	virtual_volume = new cs4722::virtual_noise_volume(texture_size, 256);
+	for (auto f = 0; f < number_of_octaves; ++f)
+	{
+		virtual_volume->add_octave(noise, frequency, 4.0f / texture_size, amp);
+
+		frequency *= 2;
+		amp *= 0.5;
+	}
+	virtual_volume->start();
+	virtual_volume->set_uniforms(program, 3, 4);
 
 }
 
@@ -201,7 +261,7 @@ display()
 {
     // static const float black[] = { 0.0f, 0.0f, 0.0f, 0.0f };
 
-    glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_float());
+    glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_array().data());
     glClear(GL_DEPTH_BUFFER_BIT);
     // glBindVertexArray(VAOs[0]);
 
@@ -223,8 +283,8 @@ display()
     // const auto u_ambient = glGetUniformLocation(the_scene->program, "u_ambient");
 
 
-    // glUniform4fv(u_ambient, 1, the_scene->the_light.ambient_light.as_float());
-    // glUniform4fv(light_color, 1, the_scene->the_light.light_color.as_float());
+    // glUniform4fv(u_ambient, 1, the_scene->the_light.ambient_light.as_array().data());
+    // glUniform4fv(light_color, 1, the_scene->the_light.light_color.as_array().data());
     glUniform4fv(light_position, 1, glm::value_ptr(the_light.light_direction_position));
 
 
@@ -247,6 +307,16 @@ display()
     auto time = glfwGetTime();
     auto delta_time = time - last_time;
 
+    if (noise_stream) {
+        noise_stream->update(time);
+        noise_stream->bind(3, 4);
+        glUniform1f(glGetUniformLocation(program, "Blend"), noise_stream->blend());
+    }
+    if (virtual_volume) {
+        virtual_volume->update();
+        virtual_volume->bind(3, 4);
+    }
+
     for (auto *artf: artifact_list) {
 
         artf->animate(time, delta_time);
@@ -260,8 +330,8 @@ display()
         // 	glm::value_ptr(projection_transform * mv_transform));
 
         // glUniform1i(uSampler, artf->texture_unit());
-        glUniform4fv(SkyColor, 1, artf->surface_material.diffuse_color.as_float());
-        glUniform4fv(CloudColor, 1, artf->surface_material.ambient_color.as_float());
+        glUniform4fv(SkyColor, 1, artf->surface_material.diffuse_color.as_array().data());
+        glUniform4fv(CloudColor, 1, artf->surface_material.ambient_color.as_array().data());
         glUniformMatrix4fv(n_transform, 1, GL_FALSE,
                            glm::value_ptr(glm::inverseTranspose(mv_transform)));
         // glUniform1f(u_shininess, artf->shininess);
@@ -283,10 +353,8 @@ main(int argc, char** argv)
     the_view->set_camera_position(glm::vec3(0, 0, 1));
 
 
-	glfwInit();
-    auto *window = cs4722::setup_window("Clouds", .9);
-
-    gladLoadGL(glfwGetProcAddress);
+    auto context = cs4722::render_context(argc, argv, "Clouds", .9);
+    auto *window = context.window;
     cs4722::setup_debug_callbacks();
 
 //	the_view->perspective_aspect = (static_cast<float>(1.0 * w_width / w_height));
@@ -298,9 +366,24 @@ main(int argc, char** argv)
 
 
 	
+	auto animate = false;
+	for (auto a = 1; a < argc; ++a) {
+		if (std::strcmp(argv[a], "--animate") == 0) {
+			animate = true;
+		}
+		if (std::strcmp(argv[a], "--virtual") == 0) {
+			use_virtual_volume = true;
+		}
+	}
 	init();
 	// auto* the_scene = init_buffers();
-	init_texture3D();
+	if (use_virtual_volume) {
+		init_virtual_texture3D();
+	} else if (animate) {
+		init_noise_stream();
+	} else {
+		init_texture3D();
+	}
 
 	const auto cloud_scale = glGetUniformLocation(program, "Scale");
 	glUniform1f(cloud_scale, 0.2f);
@@ -314,14 +397,33 @@ main(int argc, char** argv)
 
 
 
-	while (!glfwWindowShouldClose(window))
+	auto frames = 0;
+	// steady_clock rather than glfwGetTime, which stays at 0 when headless
+	auto report_time = std::chrono::steady_clock::now();
+	while (context.running())
 	{
 		display();
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		context.end_frame();
+
+		++frames;
+		auto now = std::chrono::steady_clock::now();
+		auto seconds = std::chrono::duration<double>(now - report_time).count();
+		if (noise_stream && seconds > 5.0) {
+			std::cout << frames / seconds << " frames per second, "
+				<< noise_stream->slice_milliseconds << " ms per slice, "
+				<< noise_stream->stall_count << " stalls" << std::endl;
+			frames = 0;
+			report_time = now;
+		}
+		if (virtual_volume && seconds > 5.0) {
+			std::cout << frames / seconds << " frames per second, "
+				<< virtual_volume->resident_count() << " bricks resident, "
+				<< virtual_volume->bricks_generated << " generated, "
+				<< virtual_volume->evictions << " evicted" << std::endl;
+			frames = 0;
+			report_time = now;
+		}
 	}
-
-	glfwDestroyWindow(window);
-
-	glfwTerminate();
+	delete noise_stream;
+	delete virtual_volume;
 }
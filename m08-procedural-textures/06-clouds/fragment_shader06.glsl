@@ -1,6 +1,9 @@
 #version 450 core
 
 uniform sampler3D Noise; 
+// with --animate, the next time slice of the noise and how far the animation is towards it
+uniform sampler3D NextNoise;
+uniform float Blend;
 uniform vec4 SkyColor; // (0.0, 0.0, 0.8) 
 uniform vec4 CloudColor; // (0.8, 0.8, 0.8) 
 
@@ -11,7 +14,7 @@ out vec4 FragColor;
 
 void main() { 
 
-	vec4 noisevec = texture(Noise, MCposition); 
+	vec4 noisevec = mix(texture(Noise, MCposition), texture(NextNoise, MCposition), Blend); 
 	float intensity = (noisevec[0] + noisevec[1] + noisevec[2] + noisevec[3] + 0.03125) * 1.5; 
 	vec4 color = mix(SkyColor, CloudColor, intensity) * LightIntensity; 
 	FragColor = vec4(color.rgb, 1.0); 
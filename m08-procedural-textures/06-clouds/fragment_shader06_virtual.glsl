@@ -0,0 +1,67 @@
+#version 450 core
+
+// with --virtual, the noise comes from bricks of a cs4722::virtual_noise_volume
+// the brick table holds the pool slot of each resident brick, one mip level per level of the volume
+uniform usampler3D BrickTable;
+uniform sampler3D BrickPool;
+uniform int Levels;
+uniform float VolumeSize;
+uniform vec3 PoolSize;
+uniform int LevelStart[16];
+uniform vec4 SkyColor; // (0.0, 0.0, 0.8)
+uniform vec4 CloudColor; // (0.8, 0.8, 0.8)
+
+// one bit for each brick drawn this frame, read back to decide which bricks to make
+layout(std430, binding = 1) buffer BrickRequests {
+	uint requests[];
+};
+
+in float LightIntensity;
+in vec3 MCposition;
+
+out vec4 FragColor;
+
+const int BrickSize = 32;
+const int SlotSize = BrickSize + 2;
+
+void request(ivec3 brick, int level) {
+	int across = int(VolumeSize) / BrickSize >> level;
+	uint id = uint(LevelStart[level] + (brick.z * across + brick.y) * across + brick.x);
+	uint bit = 1u << (id & 31u);
+	// most fragments find the bit already set, so skip the atomic
+	if ((requests[id >> 5] & bit) == 0u) {
+		atomicOr(requests[id >> 5], bit);
+	}
+}
+
+vec4 virtual_noise(vec3 p) {
+	// the level with texels about a pixel apart
+	vec3 texel = p * VolumeSize;
+	float footprint = max(length(dFdx(texel)), length(dFdy(texel)));
+	int wanted = clamp(int(floor(log2(max(footprint, 1.0)) + 0.5)), 0, Levels - 1);
+
+	// wrap as GL_REPEAT does, then fall back to coarser levels until a resident brick is found
+	vec3 wrapped = fract(p);
+	for (int level = wanted; level < Levels; ++level) {
+		float size = VolumeSize / float(1 << level);
+		vec3 t = wrapped * size;
+		ivec3 brick = min(ivec3(t) / BrickSize, ivec3(int(size) / BrickSize - 1));
+		if (level == wanted) {
+			request(brick, level);
+		}
+		uvec4 entry = texelFetch(BrickTable, brick, level);
+		if (entry.w != 0u) {
+			vec3 at = vec3(entry.xyz) * float(SlotSize) + 1.0 + (t - vec3(brick * BrickSize));
+			return textureLod(BrickPool, at / PoolSize, 0.0);
+		}
+	}
+	return vec4(0.5);
+}
+
+void main() {
+
+	vec4 noisevec = virtual_noise(MCposition);
+	float intensity = (noisevec[0] + noisevec[1] + noisevec[2] + noisevec[3] + 0.03125) * 1.5;
+	vec4 color = mix(SkyColor, CloudColor, intensity) * LightIntensity;
+	FragColor = vec4(color.rgb, 1.0);
+}
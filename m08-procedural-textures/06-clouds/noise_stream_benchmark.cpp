@@ -0,0 +1,107 @@
+/*
+ * Check that cs4722::noise_volume_stream keeps an animated noise volume going without holding up the frames.
+ *
+ * A stream with the octaves of the clouds example runs for a number of seconds, 10 by default, in a headless
+ *      context, with frames paced at 60 per second as if the window were synchronized to the display.
+ * Each frame only calls update and clears the framebuffer, so the time left over is what the background
+ *      thread has to work with.
+ * The number of slices, the time to fill one, the longest update and the number of stalls are printed,
+ *      along with what the longest frame would have been had each slice been filled on the render thread.
+ *
+ * The slices filled by the stream are also compared with slices filled on a single thread.
+ * The exit code is 1 if they differ.
+ *
+ * Usage: 06-noise-stream-benchmark [seconds [texture size]]
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "cs4722/render_context.h"
+#include "cs4722/noise_volume_stream.h"
+
+
+static void add_cloud_octaves(cs4722::noise_volume_stream &stream)
+{
+    auto frequency = 4.0f;
+    auto amp = 0.5f;
+    for (auto f = 0; f < 4; ++f) {
+        stream.add_octave(frequency, amp);
+        frequency *= 2;
+        amp *= 0.5f;
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    auto seconds = argc > 1 ? std::atof(argv[1]) : 10.0;
+    auto texture_size = argc > 2 ? std::atoi(argv[2]) : 128;
+
+    char program_name[] = "06-noise-stream-benchmark";
+    char headless[] = "--headless";
+    char size[] = "--size=64x64";
+    char *context_argv[] = {program_name, headless, size};
+    auto context = cs4722::render_context(3, context_argv, "Noise stream", 1.0);
+
+    auto stream = cs4722::noise_volume_stream(texture_size, 4.0f / texture_size);
+    add_cloud_octaves(stream);
+
+    auto start = std::chrono::steady_clock::now();
+    stream.start();
+    auto start_milliseconds = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    std::cout << texture_size << " cubed volume, " << stream.octaves.size() << " octaves, "
+              << stream.seconds_per_slice << " s per slice" << std::endl;
+    std::cout << "first two slices filled and uploaded in " << start_milliseconds << " ms" << std::endl;
+
+    const auto frame_time = std::chrono::duration<double>(1.0 / 60);
+    auto frames = 0;
+    auto longest_frame = 0.0;
+    auto start_time = std::chrono::steady_clock::now();
+    auto next_frame = start_time;
+    while (true) {
+        auto frame_start = std::chrono::steady_clock::now();
+        auto time = std::chrono::duration<double>(frame_start - start_time).count();
+        if (time > seconds) {
+            break;
+        }
+        stream.update(time);
+        stream.bind(3, 4);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glFinish();
+        ++frames;
+        longest_frame = std::max(longest_frame, std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - frame_start).count());
+
+        next_frame += std::chrono::duration_cast<std::chrono::steady_clock::duration>(frame_time);
+        std::this_thread::sleep_until(next_frame);
+    }
+
+    std::cout << frames << " frames in " << seconds << " s, longest frame " << longest_frame << " ms" << std::endl;
+    std::cout << stream.slices_uploaded << " slices uploaded, " << seconds / stream.seconds_per_slice + 2
+              << " needed to keep up" << std::endl;
+    std::cout << "last slice filled in " << stream.slice_milliseconds << " ms on the background thread"
+              << std::endl;
+    std::cout << "longest update " << stream.longest_update_milliseconds << " ms" << std::endl;
+    std::cout << stream.stall_count << " stalls" << std::endl;
+
+    // what a frame would cost if the render thread filled and uploaded each slice itself
+    auto texels = std::vector<GLubyte>(stream.byte_size());
+    auto single = cs4722::noise_volume_stream(texture_size, 4.0f / texture_size, stream.seconds_per_slice, 1);
+    add_cloud_octaves(single);
+    start = std::chrono::steady_clock::now();
+    single.fill_slice(texels.data(), 3);
+    std::cout << "filling a slice on the render thread would hold one frame for "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+              << " ms on one thread" << std::endl;
+
+    auto threaded = std::vector<GLubyte>(stream.byte_size());
+    stream.fill_slice(threaded.data(), 3);
+    auto same = threaded == texels;
+    std::cout << (same ? "threaded slices match" : "threaded slices DIFFER") << std::endl;
+    return same ? 0 : 1;
+}
@@ -0,0 +1,201 @@
+/*
+ * Check cs4722::virtual_noise_volume and measure how it keeps up with a moving view.
+ *
+ * First the bricks of a 128 cubed volume are compared with the same volume made by cs4722::noise_volume_baker,
+ *      the inside of each brick with the texels of the volume and the border with the texels across
+ *      the edge, wrapping around.
+ *
+ * Then a volume of 2048 texels along each edge, by default, runs in a headless context, with frames paced
+ *      at 60 per second.
+ * A view is panned across level 0, asking for a block of 6 by 6 by 2 bricks each frame and moving one
+ *      brick along every 10 frames, then zoomed out by asking for the matching block a level coarser.
+ * The requests are made on the CPU, as if read back from the shader.
+ * The time for each block to become resident, the generation and upload counts, the evictions and the
+ *      memory taken compared with the whole volume are printed.
+ * Last, the bricks in the pool are read back and compared with bricks made on the CPU.
+ *
+ * The exit code is 1 if any comparison fails.
+ *
+ * Usage: 06-virtual-noise-benchmark [texture size [pool bricks]]
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "FastNoiseLite.h"
+
+#include "cs4722/render_context.h"
+#include "cs4722/noise_volume_baker.h"
+#include "cs4722/virtual_noise_volume.h"
+
+
+/*
+ * The octaves of the clouds example, scaled to `texture_size`.
+ */
+template<typename V, typename A>
+static void add_cloud_octaves(V &volume, int texture_size, A add)
+{
+    FastNoiseLite noise;
+    noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+    noise.SetRotationType3D(FastNoiseLite::RotationType3D_ImproveXZPlanes);
+    auto frequency = 4.0f;
+    auto amp = 0.5f;
+    for (auto f = 0; f < 4; ++f) {
+        noise.SetFrequency(frequency);
+        add(volume, noise, frequency, 4.0f / static_cast<float>(texture_size), amp);
+        frequency *= 2;
+        amp *= 0.5f;
+    }
+}
+
+
+static bool bricks_match_baker()
+{
+    const auto size = 128;
+    auto baker = cs4722::noise_volume_baker(size);
+    add_cloud_octaves(baker, size, [](auto &b, auto &noise, float, float scale, float amp) {
+        b.add_octave(noise, scale, amp);
+    });
+    auto baked = baker.bake();
+
+    auto volume = cs4722::virtual_noise_volume(size);
+    add_cloud_octaves(volume, size, [](auto &v, auto &noise, float frequency, float scale, float amp) {
+        v.add_octave(noise, frequency, scale, amp);
+    });
+    auto texels = std::vector<GLubyte>(volume.brick_byte_size());
+    const auto b = cs4722::virtual_noise_volume::brick_size;
+    const auto s = cs4722::virtual_noise_volume::slot_size;
+    auto mismatches = 0;
+    for (auto z = 0; z < size / b; ++z) {
+        for (auto y = 0; y < size / b; ++y) {
+            for (auto x = 0; x < size / b; ++x) {
+                volume.fill_brick(texels.data(), 0, x, y, z);
+                for (auto c = 0; c < s; ++c) {
+                    for (auto r = 0; r < s; ++r) {
+                        for (auto a = 0; a < s; ++a) {
+                            auto i = (z * b + c - 1 + size) % size;
+                            auto j = (y * b + r - 1 + size) % size;
+                            auto k = (x * b + a - 1 + size) % size;
+                            auto *expected = &baked[4 * ((static_cast<size_t>(i) * size + j) * size + k)];
+                            auto *actual = &texels[4 * ((static_cast<size_t>(c) * s + r) * s + a)];
+                            mismatches += !std::equal(expected, expected + 4, actual);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    std::cout << "bricks of a " << size << " cubed volume "
+              << (mismatches == 0 ? "match the baked volume" : "DIFFER from the baked volume") << std::endl;
+    return mismatches == 0;
+}
+
+
+int main(int argc, char **argv)
+{
+    auto texture_size = argc > 1 ? std::atoi(argv[1]) : 2048;
+    auto pool_bricks = argc > 2 ? std::atoi(argv[2]) : 256;
+
+    auto ok = bricks_match_baker();
+
+    char program_name[] = "06-virtual-noise-benchmark";
+    char headless[] = "--headless";
+    char size[] = "--size=64x64";
+    char *context_argv[] = {program_name, headless, size};
+    auto context = cs4722::render_context(3, context_argv, "Virtual noise", 1.0);
+
+    auto volume = cs4722::virtual_noise_volume(texture_size, pool_bricks);
+    add_cloud_octaves(volume, texture_size, [](auto &v, auto &noise, float frequency, float scale, float amp) {
+        v.add_octave(noise, frequency, scale, amp);
+    });
+    volume.start();
+    auto megabytes = [](size_t bytes) { return static_cast<double>(bytes) / (1 << 20); };
+    std::cout << texture_size << " cubed volume, " << volume.level_count() << " levels, "
+              << volume.pool_capacity() << " bricks in the pool" << std::endl;
+    std::cout << "GPU memory " << megabytes(volume.pool_byte_size()) << " MB, the whole volume would take "
+              << megabytes(volume.logical_byte_size()) << " MB" << std::endl;
+
+    const auto frame_time = std::chrono::duration<double>(1.0 / 60);
+    const auto frames_per_step = 10;
+    const auto steps = 24;
+    auto frames = 0;
+    auto longest_wait = 0;
+    auto total_wait = 0;
+    auto waits = 0;
+    auto block_level = 0;
+    auto block_x = 0;
+    auto waiting_since = 0;
+    auto start_time = std::chrono::steady_clock::now();
+    auto next_frame = start_time;
+    // pan along x for `steps` steps, then zoom out a level and pan back
+    for (auto step = 0; step < 2 * steps; ++step) {
+        if (step == steps) {
+            block_level = 1;
+        }
+        block_x = step < steps ? step : (2 * steps - 1 - step) / 2;
+        waiting_since = frames;
+        auto arrived = false;
+        for (auto f = 0; f < frames_per_step; ++f) {
+            auto across = volume.bricks_across(block_level);
+            auto all_resident = true;
+            for (auto z = 0; z < 2; ++z) {
+                for (auto y = 0; y < 6; ++y) {
+                    for (auto x = 0; x < 6; ++x) {
+                        auto bx = (block_x + x) % across;
+                        volume.request(block_level, bx, y % across, z % across);
+                        all_resident = all_resident && volume.resident(block_level, bx, y % across, z % across);
+                    }
+                }
+            }
+            if (all_resident && !arrived) {
+                arrived = true;
+                longest_wait = std::max(longest_wait, frames - waiting_since);
+                total_wait += frames - waiting_since;
+                ++waits;
+            }
+            volume.update();
+            glClear(GL_COLOR_BUFFER_BIT);
+            glFinish();
+            ++frames;
+
+            next_frame += std::chrono::duration_cast<std::chrono::steady_clock::duration>(frame_time);
+            std::this_thread::sleep_until(next_frame);
+        }
+    }
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    std::cout << frames << " frames in " << seconds << " s" << std::endl;
+    std::cout << waits << " of " << 2 * steps << " blocks resident within " << frames_per_step
+              << " frames, on average after " << (waits ? static_cast<double>(total_wait) / waits : 0.0)
+              << " frames, at most " << longest_wait << std::endl;
+    std::cout << volume.bricks_generated << " bricks generated, " << volume.bricks_generated / seconds
+              << " per second" << std::endl;
+    std::cout << volume.bricks_uploaded << " bricks uploaded, " << volume.evictions << " evicted, "
+              << volume.resident_count() << " resident" << std::endl;
+    std::cout << volume.pool_full_count << " times the pool was full of bricks in view" << std::endl;
+    std::cout << "longest update " << volume.longest_update_milliseconds << " ms" << std::endl;
+
+    // the bricks of the last block, as copied into the pool
+    auto expected = std::vector<GLubyte>(volume.brick_byte_size());
+    auto actual = std::vector<GLubyte>(volume.brick_byte_size());
+    const auto s = cs4722::virtual_noise_volume::slot_size;
+    auto checked = 0, differ = 0;
+    for (auto x = 0; x < 6; ++x) {
+        auto bx = (block_x + x) % volume.bricks_across(block_level);
+        if (!volume.resident(block_level, bx, 0, 0)) {
+            continue;
+        }
+        auto slot = volume.slot_of(block_level, bx, 0, 0);
+        volume.fill_brick(expected.data(), block_level, bx, 0, 0);
+        glGetTextureSubImage(volume.pool_texture(), 0, slot[0] * s, slot[1] * s, slot[2] * s, s, s, s,
+                             GL_RGBA, GL_UNSIGNED_BYTE, static_cast<GLsizei>(actual.size()), actual.data());
+        ++checked;
+        differ += actual != expected;
+    }
+    std::cout << checked << " bricks read back from the pool, " << differ << " differ" << std::endl;
+    ok = ok && checked > 0 && differ == 0;
+    return ok ? 0 : 1;
+}
@@ -19,6 +19,7 @@
 #include "cs4722/light.h"
 #include "cs4722/window.h"
 #include "cs4722/callbacks.h"
+#include "cs4722/render_context.h"
 
 static GLuint program;
 static cs4722::view* the_view;
@@ -123,8 +124,8 @@ display()
         auto model_transform = artf->animation_transform.matrix() * artf->world_transform.matrix();
         auto mv_transform = view_transform * model_transform;
         glUniformMatrix4fv(mv_transform_loc, 1, GL_FALSE, glm::value_ptr(mv_transform));
-        glUniform4fv(SkyColor, 1, artf->surface_material.diffuse_color.as_float());
-        glUniform4fv(CloudColor, 1, artf->surface_material.ambient_color.as_float());
+        glUniform4fv(SkyColor, 1, artf->surface_material.diffuse_color.as_array().data());
+        glUniform4fv(CloudColor, 1, artf->surface_material.ambient_color.as_array().data());
         glUniformMatrix4fv(n_transform, 1, GL_FALSE,
                            glm::value_ptr(glm::inverseTranspose(mv_transform)));
 
@@ -142,10 +143,8 @@ main(int argc, char** argv)
     the_view = new cs4722::view();
     the_view->set_camera_position(glm::vec3(0, 0, 1));
 
-	glfwInit();
-    auto *window = cs4722::setup_window("Clouds", .9);
-
-    gladLoadGL(glfwGetProcAddress);
+    auto context = cs4722::render_context(argc, argv, "Clouds", .9);
+    auto *window = context.window;
     cs4722::setup_debug_callbacks();
 
 	the_light.light_direction_position = glm::vec4(0, -1, 0, 1);
@@ -163,16 +162,11 @@ main(int argc, char** argv)
 
 
 
-	while (!glfwWindowShouldClose(window))
+	while (context.running())
 	{
-        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_float());
+        glClearBufferfv(GL_COLOR, 0, cs4722::x11::gray50.as_array().data());
         glClear(GL_DEPTH_BUFFER_BIT);
         display();
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		context.end_frame();
 	}
-
-	glfwDestroyWindow(window);
-
-	glfwTerminate();
 }
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+
+#include <glad/gl.h>
+
+/**
+ * \file
+ *
+ * Measuring how long the GPU spends on a part of a frame.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief Times the GPU work between `begin` and `end` with `GL_TIME_ELAPSED` queries.
+     *
+     * A query result is only ready some frames after the query ends, so the timer cycles through
+     * `depth` queries and collects the result of each one when it comes around again.
+     * With the default of 4 the result is almost always ready and collecting it does not wait.
+     *
+     * Needs a current OpenGL context when constructed.
+     */
+    class gpu_timer {
+    public:
+
+        explicit gpu_timer(int depth = 4)
+                : queries(depth), pending(depth, false)
+        {
+            glCreateQueries(GL_TIME_ELAPSED, depth, queries.data());
+        }
+
+        gpu_timer(const gpu_timer &) = delete;
+        gpu_timer &operator=(const gpu_timer &) = delete;
+
+        ~gpu_timer()
+        {
+            glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+        }
+
+        void begin()
+        {
+            auto slot = next % queries.size();
+            collect(slot);
+            glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+        }
+
+        void end()
+        {
+            glEndQuery(GL_TIME_ELAPSED);
+            pending[next % queries.size()] = true;
+            ++next;
+        }
+
+        /**
+         * \brief Average time of the results collected since the last `reset`, in milliseconds.
+         */
+        double average_milliseconds() const
+        {
+            return count > 0 ? total_nanoseconds / 1e6 / static_cast<double>(count) : 0.0;
+        }
+
+        /**
+         * \brief Number of results collected since the last `reset`.
+         */
+        long sample_count() const
+        {
+            return count;
+        }
+
+        void reset()
+        {
+            total_nanoseconds = 0;
+            count = 0;
+        }
+
+    private:
+
+        void collect(size_t slot)
+        {
+            if (!pending[slot]) {
+                return;
+            }
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &nanoseconds);
+            total_nanoseconds += static_cast<double>(nanoseconds);
+            ++count;
+            pending[slot] = false;
+        }
+
+        std::vector<GLuint> queries;
+        std::vector<bool> pending;
+        size_t next = 0;
+        double total_nanoseconds = 0;
+        long count = 0;
+    };
+
+}
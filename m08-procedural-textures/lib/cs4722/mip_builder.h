@@ -0,0 +1,429 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "cs4722/parallel_for.h"
+
+namespace cs4722 {
+
+    /**
+     * \brief Filter used to reduce one mip level to the next.
+     *
+     * `box` averages the texels each smaller texel covers.
+     * `kaiser` is a windowed sinc, sharper than the box with less aliasing, the usual choice for
+     * offline mip generation.
+     */
+    enum class mip_filter {
+        box, kaiser
+    };
+
+    /**
+     * \brief One level of a mip chain, RGBA8 texels in the order OpenGL expects.
+     */
+    struct mip_level {
+        int width;
+        int height;
+        int depth;
+        std::vector<GLubyte> texels;
+    };
+
+    /**
+     * \brief Builds the mip levels of an RGBA8 2D or 3D image on the CPU.
+     *
+     * Each level is made from the one before with a separable filter, applied along x, then y, then z,
+     * with float intermediate values that are rounded to bytes at the end.
+     * A 2D image is a volume of depth 1, and a pass along an axis that is already 1 texel long is skipped.
+     * Every level halves each dimension that is larger than 1, as OpenGL sizes the levels of a texture,
+     * so odd sizes are handled with filter weights computed for each output texel.
+     *
+     * Each pass is split into slabs, such as rows, output lines or z slices.
+     * As in `noise_volume_baker`, worker threads repeatedly claim the next unfinished slab until none remain.
+     * The inner loops run over whole rows of floats with no dependencies between iterations, so the
+     * compiler vectorizes them.
+     *
+     * The image is treated as repeating, matching the `GL_REPEAT` wrap mode the noise textures use,
+     * unless `wrap` is false, in which case the edge texels are repeated instead.
+     */
+    class mip_builder {
+    public:
+
+        /**
+         * @param filter  Filter used between levels
+         * @param number_of_threads  Number of worker threads, 0 means use the hardware concurrency
+         */
+        explicit mip_builder(mip_filter filter = mip_filter::kaiser, int number_of_threads = 0)
+                : filter(filter), number_of_threads(number_of_threads)
+        {}
+
+        /**
+         * \brief Number of levels in a full chain, including the base level.
+         */
+        static int level_count(int width, int height, int depth = 1)
+        {
+            auto largest = std::max({width, height, depth});
+            auto count = 1;
+            while (largest > 1) {
+                largest /= 2;
+                ++count;
+            }
+            return count;
+        }
+
+        /**
+         * \brief Build every level below the base, smallest last.
+         *
+         * @param base  RGBA8 texels of the base level, `width * height * depth` of them
+         */
+        std::vector<mip_level> build(const GLubyte *base, int width, int height, int depth = 1)
+        {
+            auto levels = std::vector<mip_level>();
+            level_milliseconds.clear();
+            auto *source = base;
+            auto w = width, h = height, d = depth;
+            for (auto level = 1; level < level_count(width, height, depth); ++level) {
+                auto start = std::chrono::steady_clock::now();
+                auto next = mip_level{std::max(w / 2, 1), std::max(h / 2, 1), std::max(d / 2, 1), {}};
+                next.texels.resize(4ull * next.width * next.height * next.depth);
+                reduce(source, w, h, d, next);
+                levels.push_back(std::move(next));
+                level_milliseconds.push_back(std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start).count());
+                source = levels.back().texels.data();
+                w = levels.back().width;
+                h = levels.back().height;
+                d = levels.back().depth;
+            }
+            return levels;
+        }
+
+        /**
+         * \brief Number of bytes in a full RGBA8 chain, every level one after the other, the base first.
+         */
+        static size_t chain_byte_size(int width, int height, int depth = 1)
+        {
+            auto size = size_t(0);
+            auto levels = level_count(width, height, depth);
+            for (auto level = 0; level < levels; ++level) {
+                size += 4ull * width * height * depth;
+                width = std::max(width / 2, 1);
+                height = std::max(height / 2, 1);
+                depth = std::max(depth / 2, 1);
+            }
+            return size;
+        }
+
+        /**
+         * \brief Fill in a whole chain laid out as `chain_byte_size` describes.
+         *
+         * The base level must already be at the start of `chain`, the other levels are written after it.
+         * A chain in this layout can be kept in a `texture_cache` entry and uploaded with
+         * `create_texture2D_from_chain` or `create_texture3D_from_chain`.
+         */
+        void build_chain(GLubyte *chain, int width, int height, int depth = 1)
+        {
+            auto *to = chain + 4ull * width * height * depth;
+            for (auto &level: build(chain, width, height, depth)) {
+                std::memcpy(to, level.texels.data(), level.texels.size());
+                to += level.texels.size();
+            }
+        }
+
+        mip_filter filter;
+        int number_of_threads;
+        bool wrap = true;
+
+        /**
+         * \brief Support of the Kaiser filter, in texels of the smaller level on each side.
+         */
+        float kaiser_width = 3.0f;
+        /**
+         * \brief Shape of the Kaiser window, larger values give a smoother window with a wider main lobe.
+         */
+        float kaiser_alpha = 4.0f;
+
+        /**
+         * \brief Time taken for each level by the last call of `build`.
+         */
+        std::vector<double> level_milliseconds;
+
+    private:
+
+        /**
+         * \brief The source texels that make up one output texel along an axis, and their weights.
+         */
+        struct taps {
+            std::vector<int> first;
+            std::vector<int> count;
+            std::vector<int> index;
+            std::vector<float> weight;
+        };
+
+        static float bessel_i0(float x)
+        {
+            // power series, converges quickly for the arguments used here
+            auto sum = 1.0, term = 1.0;
+            auto half_x_squared = 0.25 * x * x;
+            for (auto k = 1; k < 30; ++k) {
+                term *= half_x_squared / (k * k);
+                sum += term;
+            }
+            return static_cast<float>(sum);
+        }
+
+        float kaiser_weight(float t) const
+        {
+            auto x = t / kaiser_width;
+            if (std::abs(x) >= 1) {
+                return 0;
+            }
+            const auto pi = 3.14159265358979f;
+            auto sinc = t == 0 ? 1.0f : std::sin(pi * t) / (pi * t);
+            return sinc * bessel_i0(kaiser_alpha * std::sqrt(1 - x * x)) / bessel_i0(kaiser_alpha);
+        }
+
+        /**
+         * \brief Weights for reducing `source_size` texels to `output_size` along one axis.
+         *
+         * Positions are measured in source texels, the output texel `i` is centered at
+         * `(i + 0.5) * scale` where `scale` is the ratio of the sizes.
+         */
+        taps make_taps(int source_size, int output_size) const
+        {
+            auto result = taps();
+            auto scale = static_cast<float>(source_size) / output_size;
+            for (auto i = 0; i < output_size; ++i) {
+                auto center = (i + 0.5f) * scale;
+                auto radius = filter == mip_filter::box ? scale / 2 : kaiser_width * scale;
+                auto low = static_cast<int>(std::floor(center - radius));
+                auto high = static_cast<int>(std::ceil(center + radius));
+                auto first = static_cast<int>(result.weight.size());
+                auto total = 0.0f;
+                for (auto j = low; j < high; ++j) {
+                    float w;
+                    if (filter == mip_filter::box) {
+                        // the part of source texel j inside the output texel
+                        w = std::max(0.0f, std::min(j + 1.0f, center + radius) - std::max(float(j), center - radius));
+                    } else {
+                        w = kaiser_weight((j + 0.5f - center) / scale);
+                    }
+                    if (w == 0) {
+                        continue;
+                    }
+                    auto wrapped = wrap ? (j % source_size + source_size) % source_size
+                                        : std::clamp(j, 0, source_size - 1);
+                    result.index.push_back(wrapped);
+                    result.weight.push_back(w);
+                    total += w;
+                }
+                for (auto k = first; k < static_cast<int>(result.weight.size()); ++k) {
+                    result.weight[k] /= total;
+                }
+                result.first.push_back(first);
+                result.count.push_back(static_cast<int>(result.weight.size()) - first);
+            }
+            return result;
+        }
+
+        /**
+         * \brief Filter along x, rows of `source_width` RGBA texels to rows of `output_width`.
+         *
+         * The source is either the bytes of the level or floats from an earlier pass.
+         */
+        template<typename S>
+        void filter_x(const S *source, int source_width, float *output, int output_width, int rows) const
+        {
+            auto t = make_taps(source_width, output_width);
+            parallel_for(rows, number_of_threads, [&](int row) {
+                auto *in = source + 4ll * source_width * row;
+                auto *out = output + 4ll * output_width * row;
+                for (auto i = 0; i < output_width; ++i) {
+                    float sum[4] = {0, 0, 0, 0};
+                    for (auto k = t.first[i]; k < t.first[i] + t.count[i]; ++k) {
+                        auto *texel = in + 4 * t.index[k];
+                        auto w = t.weight[k];
+                        for (auto c = 0; c < 4; ++c) {
+                            sum[c] += w * texel[c];
+                        }
+                    }
+                    for (auto c = 0; c < 4; ++c) {
+                        out[4 * i + c] = sum[c];
+                    }
+                }
+            });
+        }
+
+        /**
+         * \brief Filter along the axis whose lines are `line_length` floats apart, in each of `slabs`
+         * slabs of `source_lines` lines, giving slabs of `output_lines` lines.
+         *
+         * For y the lines are rows and the slabs are z slices, for z the lines are slices and there is one slab.
+         * Each output line is a weighted sum of whole input lines.
+         */
+        void filter_lines(const float *source, int source_lines, float *output, int output_lines,
+                          long long line_length, int slabs) const
+        {
+            auto t = make_taps(source_lines, output_lines);
+            // one job per output line of each slab, so a single slab still spreads over the threads
+            parallel_for(slabs * output_lines, number_of_threads, [&](int job) {
+                auto slab = job / output_lines;
+                auto i = job % output_lines;
+                auto *out = output + (static_cast<long long>(slab) * output_lines + i) * line_length;
+                std::fill(out, out + line_length, 0.0f);
+                for (auto k = t.first[i]; k < t.first[i] + t.count[i]; ++k) {
+                    auto *in = source + (static_cast<long long>(slab) * source_lines + t.index[k]) * line_length;
+                    auto w = t.weight[k];
+                    for (auto n = 0ll; n < line_length; ++n) {
+                        out[n] += w * in[n];
+                    }
+                }
+            });
+        }
+
+        void reduce(const GLubyte *source, int w, int h, int d, mip_level &next)
+        {
+            auto nw = next.width, nh = next.height, nd = next.depth;
+
+            // the x pass reads the bytes directly, if x is already down to one texel they are only converted
+            auto after_x = std::vector<float>(4ull * nw * h * d);
+            if (nw != w) {
+                filter_x(source, w, after_x.data(), nw, h * d);
+            } else {
+                parallel_for(d, number_of_threads, [&](int z) {
+                    auto n = 4ll * w * h;
+                    std::copy(source + n * z, source + n * (z + 1), after_x.begin() + n * z);
+                });
+            }
+
+            // an axis already down to one texel is left as it is
+            auto *result = after_x.data();
+            auto after_y = std::vector<float>();
+            if (nh != h) {
+                after_y.resize(4ull * nw * nh * d);
+                filter_lines(result, h, after_y.data(), nh, 4ll * nw, d);
+                result = after_y.data();
+            }
+            auto after_z = std::vector<float>();
+            if (nd != d) {
+                after_z.resize(4ull * nw * nh * nd);
+                filter_lines(result, d, after_z.data(), nd, 4ll * nw * nh, 1);
+                result = after_z.data();
+            }
+
+            // round back to bytes, the Kaiser filter can overshoot so the values are clamped
+            parallel_for(nd, number_of_threads, [&](int z) {
+                auto n = 4ll * nw * nh;
+                auto *in = result + n * z;
+                auto *out = next.texels.data() + n * z;
+                for (auto i = 0ll; i < n; ++i) {
+                    out[i] = static_cast<GLubyte>(std::clamp(in[i] + 0.5f, 0.0f, 255.0f));
+                }
+            });
+        }
+    };
+
+
+    /**
+     * \brief Create a 2D RGBA8 texture with a full mip chain built from `texels`.
+     *
+     * Every level is built on the CPU with `filter`, so noise seen from far away is filtered rather than
+     * aliased, as it is when a texture with only the full size level is minified.
+     * The minification filter is set to `GL_LINEAR_MIPMAP_LINEAR` so the levels are used.
+     */
+    inline GLuint create_mipmapped_texture2D(const GLubyte *texels, int width, int height,
+                                             mip_filter filter = mip_filter::kaiser)
+    {
+        auto levels = mip_builder(filter).build(texels, width, height);
+
+        GLuint texture;
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+        glTextureStorage2D(texture, mip_builder::level_count(width, height), GL_RGBA8, width, height);
+        glTextureSubImage2D(texture, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+        for (auto level = 0; level < static_cast<int>(levels.size()); ++level) {
+            auto &l = levels[level];
+            glTextureSubImage2D(texture, level + 1, 0, 0, l.width, l.height, GL_RGBA, GL_UNSIGNED_BYTE,
+                                l.texels.data());
+        }
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        return texture;
+    }
+
+    /**
+     * \brief Create a 3D RGBA8 texture with a full mip chain built from `texels`.
+     *
+     * As `create_mipmapped_texture2D`, for volumes.
+     * The minification filter is set to `GL_LINEAR_MIPMAP_LINEAR` so the levels are used.
+     */
+    inline GLuint create_mipmapped_texture3D(const GLubyte *texels, int width, int height, int depth,
+                                             mip_filter filter = mip_filter::kaiser)
+    {
+        auto levels = mip_builder(filter).build(texels, width, height, depth);
+
+        GLuint texture;
+        glCreateTextures(GL_TEXTURE_3D, 1, &texture);
+        glTextureStorage3D(texture, mip_builder::level_count(width, height, depth), GL_RGBA8,
+                           width, height, depth);
+        glTextureSubImage3D(texture, 0, 0, 0, 0, width, height, depth, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+        for (auto level = 0; level < static_cast<int>(levels.size()); ++level) {
+            auto &l = levels[level];
+            glTextureSubImage3D(texture, level + 1, 0, 0, 0, l.width, l.height, l.depth, GL_RGBA,
+                                GL_UNSIGNED_BYTE, l.texels.data());
+        }
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        return texture;
+    }
+
+    /**
+     * \brief Create a 2D RGBA8 texture from a chain made by `mip_builder::build_chain`.
+     *
+     * Nothing is computed, each level is uploaded from its place in `chain`, so a chain mapped from
+     * the texture cache goes straight to OpenGL.
+     * The minification filter is set to `GL_LINEAR_MIPMAP_LINEAR` so the levels are used.
+     */
+    inline GLuint create_texture2D_from_chain(const GLubyte *chain, int width, int height)
+    {
+        auto levels = mip_builder::level_count(width, height);
+
+        GLuint texture;
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+        glTextureStorage2D(texture, levels, GL_RGBA8, width, height);
+        for (auto level = 0; level < levels; ++level) {
+            glTextureSubImage2D(texture, level, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, chain);
+            chain += 4ull * width * height;
+            width = std::max(width / 2, 1);
+            height = std::max(height / 2, 1);
+        }
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        return texture;
+    }
+
+    /**
+     * \brief Create a 3D RGBA8 texture from a chain made by `mip_builder::build_chain`.
+     *
+     * As `create_texture2D_from_chain`, for volumes.
+     */
+    inline GLuint create_texture3D_from_chain(const GLubyte *chain, int width, int height, int depth)
+    {
+        auto levels = mip_builder::level_count(width, height, depth);
+
+        GLuint texture;
+        glCreateTextures(GL_TEXTURE_3D, 1, &texture);
+        glTextureStorage3D(texture, levels, GL_RGBA8, width, height, depth);
+        for (auto level = 0; level < levels; ++level) {
+            glTextureSubImage3D(texture, level, 0, 0, 0, width, height, depth, GL_RGBA, GL_UNSIGNED_BYTE,
+                                chain);
+            chain += 4ull * width * height * depth;
+            width = std::max(width / 2, 1);
+            height = std::max(height / 2, 1);
+            depth = std::max(depth / 2, 1);
+        }
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        return texture;
+    }
+
+}
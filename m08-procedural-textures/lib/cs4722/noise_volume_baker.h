@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "FastNoiseLite.h"
+#include "cs4722/parallel_for.h"
+
+namespace cs4722 {
+
+    /**
+     * \brief One octave of a baked noise volume.
+     *
+     * The octave is written into one channel of an RGBA8 texel.
+     * The value stored for the texel at `(i, j, k)` is
+     *
+     *      (generator.GetNoise(i * coordinate_scale, j * coordinate_scale, k * coordinate_scale) + 1) * amplitude * 128
+     *
+     * which is the same expression the examples used when filling the volume by hand.
+     */
+    struct noise_octave {
+        FastNoiseLite generator;
+        float coordinate_scale = 1.0f;
+        float amplitude = 0.5f;
+    };
+
+    /**
+     * \brief Fills an RGBA8 3D texture with up to four octaves of FastNoiseLite noise.
+     *
+     * The volume is split into slabs along the slowest moving index (the first index of the triple loop
+     * used by the examples).
+     * Worker threads repeatedly claim the next unfinished slab until none remain, so a thread that finishes
+     * early picks up work that would otherwise wait for a slower thread.
+     *
+     * Within a slab, a row of `batch_size` samples is evaluated into a small float buffer before the samples
+     * are quantized and stored.
+     * The quantizing loop has no dependencies between iterations so the compiler is free to vectorize it.
+     *
+     * Each sample is computed with exactly the same floating point expression as the scalar loops,
+     * so `bake` and `bake_scalar` produce identical bytes.
+     *
+     * Channels that have no octave assigned are set to 0.
+     */
+    class noise_volume_baker {
+    public:
+
+        /**
+         * \brief Number of samples evaluated together before they are quantized.
+         */
+        static constexpr int batch_size = 16;
+
+        /**
+         * \brief Create a baker for a cube shaped volume.
+         *
+         * @param texture_size  Number of texels along each edge of the volume
+         * @param number_of_threads  Number of worker threads, 0 means use the hardware concurrency
+         */
+        explicit noise_volume_baker(int texture_size, int number_of_threads = 0)
+                : texture_size(texture_size), number_of_threads(number_of_threads)
+        {}
+
+        /**
+         * \brief Add an octave, it will be written to the next unused channel.
+         *
+         * At most four octaves can be used, additional octaves are ignored.
+         */
+        void add_octave(const FastNoiseLite &generator, float coordinate_scale, float amplitude)
+        {
+            if (octaves.size() < 4) {
+                octaves.push_back({generator, coordinate_scale, amplitude});
+            }
+        }
+
+        /**
+         * \brief Number of bytes needed to hold the baked volume.
+         */
+        size_t byte_size() const
+        {
+            return 4ull * texture_size * texture_size * texture_size;
+        }
+
+        /**
+         * \brief Bake the volume into `texture_data`, which must hold at least `byte_size()` bytes.
+         */
+        void bake(GLubyte *texture_data) const
+        {
+            parallel_for(texture_size, number_of_threads, [&](int i) {
+                bake_slab(texture_data, i);
+            });
+        }
+
+        /**
+         * \brief Bake the volume into a newly allocated vector.
+         */
+        std::vector<GLubyte> bake() const
+        {
+            auto texture_data = std::vector<GLubyte>(byte_size());
+            bake(texture_data.data());
+            return texture_data;
+        }
+
+        /**
+         * \brief Reference implementation, a single threaded triple loop per octave as in the original examples.
+         */
+        void bake_scalar(GLubyte *texture_data) const
+        {
+            std::fill(texture_data, texture_data + byte_size(), 0);
+            for (auto f = 0; f < static_cast<int>(octaves.size()); ++f) {
+                const auto &octave = octaves[f];
+                auto inc = octave.coordinate_scale;
+                auto *ptr = texture_data;
+                for (auto i = 0; i < texture_size; ++i) {
+                    for (auto j = 0; j < texture_size; ++j) {
+                        for (auto k = 0; k < texture_size; ++k) {
+                            auto sample = octave.generator.GetNoise(i * inc, j * inc, k * inc);
+                            *(ptr + f) = static_cast<GLubyte>((sample + 1.0f) * octave.amplitude * 128.0f);
+                            ptr += 4;
+                        }
+                    }
+                }
+            }
+        }
+
+        int texture_size;
+        int number_of_threads;
+        std::vector<noise_octave> octaves;
+
+    private:
+
+        void bake_slab(GLubyte *texture_data, int i) const
+        {
+            const auto row_texels = static_cast<size_t>(texture_size);
+            auto *slab = texture_data + 4 * row_texels * row_texels * i;
+            std::fill(slab, slab + 4 * row_texels * row_texels, 0);
+
+            float samples[batch_size];
+            for (auto f = 0; f < static_cast<int>(octaves.size()); ++f) {
+                const auto &octave = octaves[f];
+                const auto inc = octave.coordinate_scale;
+                const auto scale = octave.amplitude;
+                for (auto j = 0; j < texture_size; ++j) {
+                    auto *row = slab + 4 * row_texels * j;
+                    for (auto k0 = 0; k0 < texture_size; k0 += batch_size) {
+                        const auto count = std::min(batch_size, texture_size - k0);
+                        for (auto b = 0; b < count; ++b) {
+                            samples[b] = octave.generator.GetNoise(i * inc, j * inc, (k0 + b) * inc);
+                        }
+                        auto *texel = row + 4 * k0 + f;
+                        for (auto b = 0; b < count; ++b) {
+                            texel[4 * b] = static_cast<GLubyte>((samples[b] + 1.0f) * scale * 128.0f);
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+}
@@ -0,0 +1,358 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "cs4722/mip_builder.h"
+#include "cs4722/parallel_for.h"
+#include "cs4722/simplex_noise4.h"
+
+/**
+ * \file
+ *
+ * Animated noise volumes, generated in the background and streamed to the GPU.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief An RGBA8 3D noise texture that changes over time, filled with time slices of 4D noise.
+     *
+     * Slice `n` is the volume at time `n * seconds_per_slice`.
+     * Each octave goes into its own channel, as with `noise_volume_baker`, and the value stored for the
+     * texel at `(i, j, k)` of slice `n` is
+     *
+     *      (noise(i * s * f, j * s * f, k * s * f, n * seconds_per_slice * speed * f) + 1) * amplitude * 128
+     *
+     * where `s` is `coordinate_scale` and `f` is the frequency of the octave.
+     *
+     * Two slices are drawn at once and the shader blends between them, with `blend()` as the weight of the
+     * second, see `bind`.
+     * A background thread fills the next slice directly into one of two regions of a persistently mapped
+     * pixel unpack buffer, on `number_of_threads` threads.
+     * Meanwhile the render thread uploads the slice in the other region into one of three textures, the
+     * two being drawn and the one for the slice after them.
+     * Uploads come from the buffer so they are copies on the GPU, and the mip levels are made there too,
+     * with `glGenerateTextureMipmap`.
+     * A region is given back to the background thread once a fence shows the GPU has finished reading it.
+     *
+     * `update` is called once per frame and never waits, neither for the background thread nor for a fence.
+     * If the animation reaches the end of the newest uploaded slice, it is held there for the frame and
+     * `stall_count` is incremented, so a count of 0 shows generation kept up.
+     *
+     * Requires an OpenGL 4.5 context, and `start` must be called before anything else.
+     */
+    class noise_volume_stream {
+    public:
+
+        struct octave {
+            float frequency;
+            float amplitude;
+        };
+
+        /**
+         * @param texture_size  Number of texels along each edge of the volume
+         * @param coordinate_scale  Noise coordinate change from one texel to the next, before the frequency
+         * @param seconds_per_slice  Time from one slice to the next
+         * @param number_of_threads  Threads filling a slice, 0 means all but one of the hardware threads
+         */
+        noise_volume_stream(int texture_size, float coordinate_scale, double seconds_per_slice = 2.0,
+                            int number_of_threads = 0)
+                : texture_size(texture_size), coordinate_scale(coordinate_scale),
+                  seconds_per_slice(seconds_per_slice), number_of_threads(number_of_threads)
+        {}
+
+        noise_volume_stream(const noise_volume_stream &) = delete;
+        noise_volume_stream &operator=(const noise_volume_stream &) = delete;
+
+        ~noise_volume_stream()
+        {
+            if (worker.joinable()) {
+                {
+                    auto lock = std::lock_guard<std::mutex>(mutex);
+                    stopping = true;
+                }
+                job_ready.notify_one();
+                worker.join();
+            }
+            for (auto &r: regions) {
+                if (r.fence) glDeleteSync(r.fence);
+            }
+            if (buffer) {
+                glUnmapNamedBuffer(buffer);
+                glDeleteBuffers(1, &buffer);
+                glDeleteTextures(3, textures);
+            }
+        }
+
+        /**
+         * \brief Add an octave, it will be written to the next unused channel.
+         *
+         * At most four octaves can be used, additional octaves are ignored.
+         */
+        void add_octave(float frequency, float amplitude)
+        {
+            if (octaves.size() < 4) {
+                octaves.push_back({frequency, amplitude});
+            }
+        }
+
+        /**
+         * \brief Number of bytes in one slice.
+         */
+        size_t byte_size() const
+        {
+            return 4ull * texture_size * texture_size * texture_size;
+        }
+
+        /**
+         * \brief Fill `texels`, at least `byte_size()` bytes, with slice `slice`.
+         *
+         * The volume is split into slabs along the slowest moving index, claimed in turn by the threads.
+         */
+        void fill_slice(GLubyte *texels, long long slice) const
+        {
+            auto w = static_cast<float>(slice * seconds_per_slice * speed);
+            // one thread is left for drawing the frames
+            parallel_for(texture_size, thread_count(number_of_threads, 1), [&](int i) {
+                fill_slab(texels, i, w);
+            });
+        }
+
+        /**
+         * \brief Create the textures and the unpack buffer, fill the first two slices and start the
+         * background thread.
+         *
+         * The first two slices are filled on the calling thread, since there is nothing to draw without them.
+         */
+        void start()
+        {
+            glCreateTextures(GL_TEXTURE_3D, 3, textures);
+            for (auto texture: textures) {
+                glTextureStorage3D(texture, mip_builder::level_count(texture_size, texture_size, texture_size),
+                                   GL_RGBA8, texture_size, texture_size, texture_size);
+                glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+                glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+                glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+                glTextureParameteri(texture, GL_TEXTURE_WRAP_R, GL_REPEAT);
+            }
+
+            auto flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glCreateBuffers(1, &buffer);
+            glNamedBufferStorage(buffer, 2 * byte_size(), nullptr, flags);
+            mapped = static_cast<GLubyte *>(glMapNamedBufferRange(buffer, 0, 2 * byte_size(), flags));
+
+            for (auto r = 0; r < 2; ++r) {
+                regions[r].slice = r;
+                fill_slice(mapped + byte_size() * r, r);
+                upload(r);
+            }
+            next_slice = 2;
+            worker = std::thread([this]() { generate(); });
+        }
+
+        /**
+         * \brief Advance the animation to `time`, in seconds, and move finished slices along.
+         */
+        void update(double time)
+        {
+            auto started = std::chrono::steady_clock::now();
+            {
+                // the background thread only holds the lock to pick up or hand back a slice
+                auto lock = std::lock_guard<std::mutex>(mutex);
+                for (auto r = 0; r < 2; ++r) {
+                    auto &region = regions[r];
+                    if (region.state == region_state::uploading
+                        && glClientWaitSync(region.fence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+                        glDeleteSync(region.fence);
+                        region.fence = nullptr;
+                        region.state = region_state::free;
+                    }
+                }
+                // in slice order, and only into a texture no longer drawn
+                for (auto pass = 0; pass < 2; ++pass) {
+                    for (auto r = 0; r < 2; ++r) {
+                        if (regions[r].state == region_state::filled && regions[r].slice == newest_slice + 1
+                            && regions[r].slice <= current_slice + 2) {
+                            upload(r);
+                        }
+                    }
+                }
+                for (auto r = 0; r < 2 && job_region < 0; ++r) {
+                    if (regions[r].state == region_state::free) {
+                        regions[r].state = region_state::generating;
+                        regions[r].slice = next_slice++;
+                        job_region = r;
+                        job_ready.notify_one();
+                    }
+                }
+            }
+
+            if (last_time >= 0) {
+                clock += time - last_time;
+            }
+            last_time = time;
+            // the drawn pair of slices must both be uploaded, so the newest can at most be fully blended in
+            auto limit = static_cast<double>(newest_slice) * seconds_per_slice;
+            if (clock > limit) {
+                clock = limit;
+                ++stall_count;
+            }
+            current_slice = std::min(static_cast<long long>(clock / seconds_per_slice), newest_slice - 1);
+            current_blend = static_cast<float>(clock / seconds_per_slice - static_cast<double>(current_slice));
+
+            auto milliseconds = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - started).count();
+            longest_update_milliseconds = std::max(longest_update_milliseconds, milliseconds);
+        }
+
+        /**
+         * \brief Bind the current slice to `unit` and the one after it to `next_unit`.
+         */
+        void bind(GLuint unit, GLuint next_unit) const
+        {
+            glBindTextureUnit(unit, textures[current_slice % 3]);
+            glBindTextureUnit(next_unit, textures[(current_slice + 1) % 3]);
+        }
+
+        /**
+         * \brief Weight of the second slice, from 0 to 1.
+         */
+        float blend() const
+        {
+            return current_blend;
+        }
+
+        /**
+         * \brief Number of frames the animation was held because the next slice was not ready.
+         */
+        long stall_count = 0;
+
+        /**
+         * \brief Number of slices uploaded to the textures, including the first two.
+         */
+        long slices_uploaded = 0;
+
+        /**
+         * \brief Longest time spent in `update`, which shows the render thread was not kept waiting.
+         */
+        double longest_update_milliseconds = 0;
+
+        /**
+         * \brief Time the background thread took for the most recent slice.
+         */
+        std::atomic<double> slice_milliseconds{0};
+
+        /**
+         * \brief Rate along the time axis of the noise, in noise units per second at frequency 1.
+         */
+        float speed = 0.125f;
+
+        int texture_size;
+        float coordinate_scale;
+        double seconds_per_slice;
+        int number_of_threads;
+        std::vector<octave> octaves;
+
+    private:
+
+        enum class region_state {
+            free, generating, filled, uploading
+        };
+
+        struct region {
+            region_state state = region_state::free;
+            long long slice = -1;
+            GLsync fence = nullptr;
+        };
+
+        void fill_slab(GLubyte *texels, int i, float w) const
+        {
+            auto *slab = texels + 4ull * texture_size * texture_size * i;
+            std::fill(slab, slab + 4ull * texture_size * texture_size, 0);
+            for (auto f = 0; f < static_cast<int>(octaves.size()); ++f) {
+                auto step = coordinate_scale * octaves[f].frequency;
+                auto scale = octaves[f].amplitude * 128.0f;
+                auto x = i * step;
+                auto t = w * octaves[f].frequency;
+                auto *texel = slab + f;
+                for (auto j = 0; j < texture_size; ++j) {
+                    for (auto k = 0; k < texture_size; ++k) {
+                        *texel = static_cast<GLubyte>((noise.noise(x, j * step, k * step, t) + 1.0f) * scale);
+                        texel += 4;
+                    }
+                }
+            }
+        }
+
+        /**
+         * \brief Copy the slice in region `r` into its texture and fence the copy, lock held.
+         */
+        void upload(int r)
+        {
+            auto &region = regions[r];
+            auto texture = textures[region.slice % 3];
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+            glTextureSubImage3D(texture, 0, 0, 0, 0, texture_size, texture_size, texture_size,
+                                GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<const void *>(byte_size() * r));
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glGenerateTextureMipmap(texture);
+            region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            region.state = region_state::uploading;
+            newest_slice = region.slice;
+            ++slices_uploaded;
+        }
+
+        void generate()
+        {
+            auto lock = std::unique_lock<std::mutex>(mutex);
+            while (true) {
+                job_ready.wait(lock, [this]() { return stopping || job_region >= 0; });
+                if (stopping) {
+                    return;
+                }
+                auto r = job_region;
+                auto slice = regions[r].slice;
+                lock.unlock();
+
+                auto started = std::chrono::steady_clock::now();
+                fill_slice(mapped + byte_size() * r, slice);
+                slice_milliseconds = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - started).count();
+
+                lock.lock();
+                regions[r].state = region_state::filled;
+                job_region = -1;
+            }
+        }
+
+        simplex_noise4 noise;
+        GLuint textures[3] = {0, 0, 0};
+        GLuint buffer = 0;
+        GLubyte *mapped = nullptr;
+        region regions[2];
+
+        long long current_slice = 0;
+        long long newest_slice = -1;
+        long long next_slice = 0;
+        float current_blend = 0;
+        double clock = 0;
+        double last_time = -1;
+
+        std::thread worker;
+        std::mutex mutex;
+        std::condition_variable job_ready;
+        int job_region = -1;
+        bool stopping = false;
+    };
+
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "cs4722/mip_builder.h"
+#include "cs4722/parallel_for.h"
+
+/**
+ * \file
+ *
+ * Baking a height field into a tangent space normal map, so a shader can look bumps up rather than work
+ * them out on every fragment.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief How the slope of the height field is estimated at each texel.
+     *
+     * `central_difference` uses the two neighbors along each axis.
+     * `sobel` also weighs in the rows on either side, 1 2 1, which smooths the slopes across the axis
+     * and keeps a height texture's noise from showing as much.
+     */
+    enum class normal_filter {
+        central_difference, sobel
+    };
+
+    /**
+     * \brief Makes RGBA8 tangent space normal maps from height fields, on several threads.
+     *
+     * The map covers one unit of texture coordinates in each direction, and heights are in the same units.
+     * A texel holds the normal `normalize(-dh/ds, -dh/dt, 1)` mapped from [-1, 1] to [0, 255] in its
+     * red, green and blue, and 255 in alpha.
+     * x is along the tangent, the direction of increasing s, and y along increasing t, which is what the
+     * bump map shaders expect with the tangent and bitangent from `init_buffers`.
+     *
+     * Row 0 of the heights and of the map is at t = 0, the order OpenGL expects texels in.
+     * The edges wrap, so the map should be drawn with `GL_REPEAT`.
+     *
+     * The rows of each pass are claimed in turn by the threads, as in `noise_volume_baker`.
+     */
+    class normal_map_baker {
+    public:
+
+        /**
+         * @param width  Width of the map in texels
+         * @param height  Height of the map in texels
+         * @param filter  How slopes are estimated
+         * @param number_of_threads  Number of threads, 0 means use the hardware concurrency
+         */
+        normal_map_baker(int width, int height, normal_filter filter = normal_filter::sobel,
+                         int number_of_threads = 0)
+                : width(width), height(height), filter(filter), number_of_threads(number_of_threads)
+        {}
+
+        /**
+         * \brief Heights at the texel centers from `height_at(s, t)`, which is called from several threads.
+         */
+        template<typename F>
+        std::vector<float> sample_heights(F height_at) const
+        {
+            auto heights = std::vector<float>(static_cast<size_t>(width) * height);
+            parallel_for(height, number_of_threads, [&](int j) {
+                auto t = (static_cast<float>(j) + 0.5f) / static_cast<float>(height);
+                for (auto i = 0; i < width; ++i) {
+                    auto s = (static_cast<float>(i) + 0.5f) / static_cast<float>(width);
+                    heights[static_cast<size_t>(j) * width + i] = height_at(s, t);
+                }
+            });
+            return heights;
+        }
+
+        /**
+         * \brief Heights from one channel of a texture the size of the map, 0 to 255 becoming 0 to 1.
+         */
+        std::vector<float> heights_from_texels(const GLubyte *texels, int channels, int channel = 0) const
+        {
+            auto heights = std::vector<float>(static_cast<size_t>(width) * height);
+            for (size_t k = 0; k < heights.size(); ++k) {
+                heights[k] = static_cast<float>(texels[k * channels + channel]) / 255.0f;
+            }
+            return heights;
+        }
+
+        /**
+         * \brief The normal map of `heights` scaled by `scale`.
+         */
+        std::vector<GLubyte> bake(const std::vector<float> &heights, float scale = 1.0f) const
+        {
+            auto texels = std::vector<GLubyte>(4ull * width * height);
+            // slopes per unit of texture coordinate, from differences over two texels
+            const auto sx = scale * static_cast<float>(width) / 2.0f;
+            const auto sy = scale * static_cast<float>(height) / 2.0f;
+            auto at = [&](int i, int j) {
+                i = (i + width) % width;
+                j = (j + height) % height;
+                return heights[static_cast<size_t>(j) * width + i];
+            };
+            parallel_for(height, number_of_threads, [&](int j) {
+                for (auto i = 0; i < width; ++i) {
+                    float dx, dy;
+                    if (filter == normal_filter::sobel) {
+                        dx = ((at(i + 1, j - 1) - at(i - 1, j - 1)) + 2.0f * (at(i + 1, j) - at(i - 1, j))
+                              + (at(i + 1, j + 1) - at(i - 1, j + 1))) / 4.0f;
+                        dy = ((at(i - 1, j + 1) - at(i - 1, j - 1)) + 2.0f * (at(i, j + 1) - at(i, j - 1))
+                              + (at(i + 1, j + 1) - at(i + 1, j - 1))) / 4.0f;
+                    } else {
+                        dx = at(i + 1, j) - at(i - 1, j);
+                        dy = at(i, j + 1) - at(i, j - 1);
+                    }
+                    auto nx = -dx * sx, ny = -dy * sy;
+                    auto length = std::sqrt(nx * nx + ny * ny + 1.0f);
+                    auto *texel = &texels[4 * (static_cast<size_t>(j) * width + i)];
+                    texel[0] = to_byte(nx / length);
+                    texel[1] = to_byte(ny / length);
+                    texel[2] = to_byte(1.0f / length);
+                    texel[3] = 255;
+                }
+            });
+            return texels;
+        }
+
+        /**
+         * \brief Bake `heights` and upload the map with a full mip chain, set to repeat.
+         */
+        GLuint create_texture(const std::vector<float> &heights, float scale = 1.0f) const
+        {
+            auto texels = bake(heights, scale);
+            auto texture = create_mipmapped_texture2D(texels.data(), width, height);
+            glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            return texture;
+        }
+
+        int width;
+        int height;
+        normal_filter filter;
+        int number_of_threads;
+
+    private:
+
+        static GLubyte to_byte(float component)
+        {
+            return static_cast<GLubyte>(std::lround((component + 1.0f) * 127.5f));
+        }
+    };
+
+}
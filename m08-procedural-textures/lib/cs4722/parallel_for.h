@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+ * \file
+ *
+ * Spreading a loop over threads, as the CPU bakers, filters and worker pools of cs4722 do.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief `number_of_threads` if it is more than 0, otherwise one for each hardware thread less `reserved`,
+     * and at least one.
+     *
+     * Workers that run beside the thread drawing the frames reserve one for it.
+     */
+    inline int thread_count(int number_of_threads, int reserved = 0)
+    {
+        if (number_of_threads > 0) {
+            return number_of_threads;
+        }
+        return std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - reserved);
+    }
+
+    /**
+     * \brief Call `work(i, state)` for each `i` below `count`, on `thread_count(number_of_threads)` threads
+     * at most, the calling thread among them, and return when all are done.
+     *
+     * The threads claim the next `i` in turn, so a slow `i` does not hold up the others.
+     * Each thread makes its own `state` with `make_state()` before it starts, for buffers it reuses from
+     * one `i` to the next.
+     */
+    template<typename S, typename F>
+    void parallel_for(int count, int number_of_threads, S &&make_state, F &&work)
+    {
+        auto threads_used = std::min(thread_count(number_of_threads), count);
+        std::atomic<int> next(0);
+        auto worker = [&]() {
+            auto state = make_state();
+            for (auto i = next++; i < count; i = next++) {
+                work(i, state);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (auto t = 1; t < threads_used; ++t) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto &thread: threads) {
+            thread.join();
+        }
+    }
+
+    /**
+     * \brief Call `work(i)` for each `i` below `count`, as the other `parallel_for` does.
+     */
+    template<typename F>
+    void parallel_for(int count, int number_of_threads, F &&work)
+    {
+        parallel_for(count, number_of_threads, [] { return 0; }, [&](int i, int) { work(i); });
+    }
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * \file
+ *
+ * A small PNG writer with no dependencies.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief Write an 8 bit RGBA image to a PNG file.
+     *
+     * The image data is stored without compression, which keeps the writer short and is fine for
+     * screenshots and test images.
+     *
+     * @param path  File to write
+     * @param width  Width of the image in pixels
+     * @param height  Height of the image in pixels
+     * @param rgba  `width * height * 4` bytes, rows from top to bottom
+     * @return  True if the file was written
+     */
+    inline bool write_png(const std::string &path, int width, int height, const std::vector<std::uint8_t> &rgba)
+    {
+        static const auto crc_table = [] {
+            auto table = std::array<std::uint32_t, 256>();
+            for (std::uint32_t n = 0; n < 256; ++n) {
+                auto c = n;
+                for (auto k = 0; k < 8; ++k) {
+                    c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                table[n] = c;
+            }
+            return table;
+        }();
+
+        auto out = std::ofstream(path, std::ios::binary);
+        if (!out) {
+            return false;
+        }
+
+        auto put32 = [](std::vector<std::uint8_t> &bytes, std::uint32_t value) {
+            for (auto shift = 24; shift >= 0; shift -= 8) {
+                bytes.push_back(static_cast<std::uint8_t>(value >> shift));
+            }
+        };
+        auto write_chunk = [&](const char *type, const std::vector<std::uint8_t> &data) {
+            auto chunk = std::vector<std::uint8_t>();
+            put32(chunk, static_cast<std::uint32_t>(data.size()));
+            chunk.insert(chunk.end(), type, type + 4);
+            chunk.insert(chunk.end(), data.begin(), data.end());
+            auto crc = 0xffffffffu;
+            for (auto i = 4u; i < chunk.size(); ++i) {
+                crc = crc_table[(crc ^ chunk[i]) & 0xff] ^ (crc >> 8);
+            }
+            put32(chunk, crc ^ 0xffffffffu);
+            out.write(reinterpret_cast<const char *>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+        };
+
+        static const std::uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        out.write(reinterpret_cast<const char *>(signature), sizeof(signature));
+
+        auto header = std::vector<std::uint8_t>();
+        put32(header, width);
+        put32(header, height);
+        header.insert(header.end(), {8, 6, 0, 0, 0});  // 8 bits, RGBA, deflate, no filtering, no interlace
+        write_chunk("IHDR", header);
+
+        // each row starts with a filter type byte, 0 for none
+        auto row_bytes = static_cast<size_t>(width) * 4;
+        auto raw = std::vector<std::uint8_t>();
+        raw.reserve((row_bytes + 1) * height);
+        for (auto y = 0; y < height; ++y) {
+            raw.push_back(0);
+            raw.insert(raw.end(), rgba.begin() + y * row_bytes, rgba.begin() + (y + 1) * row_bytes);
+        }
+
+        // zlib stream made of stored deflate blocks of at most 65535 bytes
+        auto compressed = std::vector<std::uint8_t>({0x78, 0x01});
+        for (size_t start = 0; start < raw.size() || start == 0; start += 65535) {
+            auto length = std::min<size_t>(65535, raw.size() - start);
+            auto last = start + length >= raw.size();
+            compressed.push_back(last ? 1 : 0);
+            compressed.push_back(static_cast<std::uint8_t>(length));
+            compressed.push_back(static_cast<std::uint8_t>(length >> 8));
+            compressed.push_back(static_cast<std::uint8_t>(~length));
+            compressed.push_back(static_cast<std::uint8_t>(~length >> 8));
+            compressed.insert(compressed.end(), raw.begin() + start, raw.begin() + start + length);
+            if (last) {
+                break;
+            }
+        }
+        std::uint32_t a = 1, b = 0;
+        for (auto byte: raw) {
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+        put32(compressed, (b << 16) | a);
+        write_chunk("IDAT", compressed);
+        write_chunk("IEND", {});
+
+        return static_cast<bool>(out);
+    }
+
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+/**
+ * \file
+ *
+ * Four dimensional simplex noise, for animating a 3D noise volume over time.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief Simplex noise in four dimensions, following Stefan Gustavson's "Simplex noise demystified".
+     *
+     * FastNoiseLite only goes up to three dimensions and `glm::simplex` for a `vec4` takes close to half a
+     * microsecond per sample, which is too slow to refill a volume every second or so.
+     * This version uses a permutation table and float arithmetic and is about four times faster.
+     *
+     * The permutation comes from `seed`, shuffled with a fixed generator, so the same seed gives the same
+     * noise on every platform.
+     * Values are in about [-1, 1], like `FastNoiseLite::GetNoise`.
+     */
+    class simplex_noise4 {
+    public:
+
+        explicit simplex_noise4(std::uint32_t seed = 1337)
+        {
+            for (auto i = 0; i < 256; ++i) {
+                perm[i] = static_cast<std::uint8_t>(i);
+            }
+            // Fisher-Yates with xorshift32, std::shuffle is not the same on every standard library
+            auto state = seed ? seed : 1u;
+            for (auto i = 255; i > 0; --i) {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                auto j = static_cast<int>(state % static_cast<std::uint32_t>(i + 1));
+                std::swap(perm[i], perm[j]);
+            }
+            for (auto i = 0; i < 256; ++i) {
+                perm[i + 256] = perm[i];
+            }
+        }
+
+        float noise(float x, float y, float z, float w) const
+        {
+            constexpr auto F4 = 0.309016994f;  // (sqrt(5) - 1) / 4
+            constexpr auto G4 = 0.138196601f;  // (5 - sqrt(5)) / 20
+
+            // skew to find the hypercube cell, then unskew back to the cell origin
+            auto s = (x + y + z + w) * F4;
+            auto i = static_cast<int>(std::floor(x + s));
+            auto j = static_cast<int>(std::floor(y + s));
+            auto k = static_cast<int>(std::floor(z + s));
+            auto l = static_cast<int>(std::floor(w + s));
+            auto t = static_cast<float>(i + j + k + l) * G4;
+            float d[5][4];
+            d[0][0] = x - (static_cast<float>(i) - t);
+            d[0][1] = y - (static_cast<float>(j) - t);
+            d[0][2] = z - (static_cast<float>(k) - t);
+            d[0][3] = w - (static_cast<float>(l) - t);
+
+            // the order of the offsets along each axis picks the simplex, the largest one is stepped first
+            int rank[4] = {0, 0, 0, 0};
+            for (auto a = 0; a < 4; ++a) {
+                for (auto b = a + 1; b < 4; ++b) {
+                    auto greater = static_cast<int>(d[0][a] > d[0][b]);
+                    rank[a] += greater;
+                    rank[b] += 1 - greater;
+                }
+            }
+            int corner[5][4];
+            for (auto a = 0; a < 4; ++a) {
+                corner[0][a] = 0;
+                for (auto c = 1; c < 4; ++c) {
+                    corner[c][a] = rank[a] >= 4 - c ? 1 : 0;
+                }
+                corner[4][a] = 1;
+            }
+            for (auto c = 1; c < 5; ++c) {
+                for (auto a = 0; a < 4; ++a) {
+                    d[c][a] = d[0][a] - static_cast<float>(corner[c][a]) + static_cast<float>(c) * G4;
+                }
+            }
+
+            auto ii = i & 255, jj = j & 255, kk = k & 255, ll = l & 255;
+            auto total = 0.0f;
+            for (auto c = 0; c < 5; ++c) {
+                // clamped rather than skipped, a branch on it is mispredicted about half the time
+                auto falloff = std::max(0.0f, 0.6f - d[c][0] * d[c][0] - d[c][1] * d[c][1] - d[c][2] * d[c][2]
+                                              - d[c][3] * d[c][3]);
+                auto hash = perm[ii + corner[c][0] + perm[jj + corner[c][1] + perm[kk + corner[c][2]
+                                                                                  + perm[ll + corner[c][3]]]]];
+                const auto &g = gradients[hash & 31];
+                falloff *= falloff;
+                total += falloff * falloff * (g[0] * d[c][0] + g[1] * d[c][1] + g[2] * d[c][2] + g[3] * d[c][3]);
+            }
+            return 27.0f * total;
+        }
+
+    private:
+
+        // the midpoints of the 32 edges of a 4D hypercube
+        static constexpr float gradients[32][4] = {
+                {0, 1, 1, 1}, {0, 1, 1, -1}, {0, 1, -1, 1}, {0, 1, -1, -1},
+                {0, -1, 1, 1}, {0, -1, 1, -1}, {0, -1, -1, 1}, {0, -1, -1, -1},
+                {1, 0, 1, 1}, {1, 0, 1, -1}, {1, 0, -1, 1}, {1, 0, -1, -1},
+                {-1, 0, 1, 1}, {-1, 0, 1, -1}, {-1, 0, -1, 1}, {-1, 0, -1, -1},
+                {1, 1, 0, 1}, {1, 1, 0, -1}, {1, -1, 0, 1}, {1, -1, 0, -1},
+                {-1, 1, 0, 1}, {-1, 1, 0, -1}, {-1, -1, 0, 1}, {-1, -1, 0, -1},
+                {1, 1, 1, 0}, {1, 1, -1, 0}, {1, -1, 1, 0}, {1, -1, -1, 0},
+                {-1, 1, 1, 0}, {-1, 1, -1, 0}, {-1, -1, 1, 0}, {-1, -1, -1, 0},
+        };
+
+        std::array<std::uint8_t, 512> perm{};
+    };
+
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "GLM/vec2.hpp"
+#include "GLM/vec3.hpp"
+#include "GLM/vec4.hpp"
+#include "GLM/geometric.hpp"
+#include "GLM/common.hpp"
+
+/**
+ * \file
+ *
+ * The GLSL simplex noise of 07-clouds-glsl, ported to C++ so it can be measured and baked on the CPU.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief 3D simplex noise, `snoise` from fragment_shader07.glsl by Ian McEwan, Ashima Arts.
+     *
+     * The port follows the shader line by line with GLM standing in for the GLSL vector types,
+     * so it gives the same values as the shader, up to rounding.
+     * Values are in about [-1, 1].
+     */
+    inline float snoise(const glm::vec3 &v)
+    {
+        auto permute = [](const glm::vec4 &x) { return glm::mod(((x * 34.0f) + 1.0f) * x, 289.0f); };
+        auto taylor_inv_sqrt = [](const glm::vec4 &r) { return 1.79284291400159f - 0.85373472095314f * r; };
+
+        const auto C = glm::vec2(1.0f / 6.0f, 1.0f / 3.0f);
+        const auto D = glm::vec4(0.0f, 0.5f, 1.0f, 2.0f);
+
+        // first corner
+        auto i = glm::floor(v + glm::dot(v, glm::vec3(C.y)));
+        auto x0 = v - i + glm::dot(i, glm::vec3(C.x));
+
+        // other corners
+        auto g = glm::step(glm::vec3(x0.y, x0.z, x0.x), x0);
+        auto l = 1.0f - g;
+        auto i1 = glm::min(g, glm::vec3(l.z, l.x, l.y));
+        auto i2 = glm::max(g, glm::vec3(l.z, l.x, l.y));
+
+        auto x1 = x0 - i1 + 1.0f * C.x;
+        auto x2 = x0 - i2 + 2.0f * C.x;
+        auto x3 = x0 - 1.0f + 3.0f * C.x;
+
+        // permutations
+        i = glm::mod(i, 289.0f);
+        auto p = permute(permute(permute(
+                i.z + glm::vec4(0.0f, i1.z, i2.z, 1.0f))
+                                 + i.y + glm::vec4(0.0f, i1.y, i2.y, 1.0f))
+                         + i.x + glm::vec4(0.0f, i1.x, i2.x, 1.0f));
+
+        // gradients, N*N points uniformly over a square, mapped onto an octahedron
+        auto n_ = 1.0f / 7.0f;
+        auto ns = n_ * glm::vec3(D.w, D.y, D.z) - glm::vec3(D.x, D.z, D.x);
+
+        auto j = p - 49.0f * glm::floor(p * ns.z * ns.z);
+
+        auto x_ = glm::floor(j * ns.z);
+        auto y_ = glm::floor(j - 7.0f * x_);
+
+        auto x = x_ * ns.x + ns.y;
+        auto y = y_ * ns.x + ns.y;
+        auto h = 1.0f - glm::abs(x) - glm::abs(y);
+
+        auto b0 = glm::vec4(x.x, x.y, y.x, y.y);
+        auto b1 = glm::vec4(x.z, x.w, y.z, y.w);
+
+        auto s0 = glm::floor(b0) * 2.0f + 1.0f;
+        auto s1 = glm::floor(b1) * 2.0f + 1.0f;
+        auto sh = -glm::step(h, glm::vec4(0.0f));
+
+        auto a0 = glm::vec4(b0.x, b0.z, b0.y, b0.w) + glm::vec4(s0.x, s0.z, s0.y, s0.w) * glm::vec4(sh.x, sh.x, sh.y, sh.y);
+        auto a1 = glm::vec4(b1.x, b1.z, b1.y, b1.w) + glm::vec4(s1.x, s1.z, s1.y, s1.w) * glm::vec4(sh.z, sh.z, sh.w, sh.w);
+
+        auto p0 = glm::vec3(a0.x, a0.y, h.x);
+        auto p1 = glm::vec3(a0.z, a0.w, h.y);
+        auto p2 = glm::vec3(a1.x, a1.y, h.z);
+        auto p3 = glm::vec3(a1.z, a1.w, h.w);
+
+        // normalize gradients
+        auto norm = taylor_inv_sqrt(glm::vec4(glm::dot(p0, p0), glm::dot(p1, p1), glm::dot(p2, p2), glm::dot(p3, p3)));
+        p0 *= norm.x;
+        p1 *= norm.y;
+        p2 *= norm.z;
+        p3 *= norm.w;
+
+        // mix final noise value
+        auto m = glm::max(0.6f - glm::vec4(glm::dot(x0, x0), glm::dot(x1, x1), glm::dot(x2, x2), glm::dot(x3, x3)),
+                          0.0f);
+        m = m * m;
+        return 42.0f * glm::dot(m * m, glm::vec4(glm::dot(p0, x0), glm::dot(p1, x1),
+                                                 glm::dot(p2, x2), glm::dot(p3, x3)));
+    }
+
+    /**
+     * \brief `snoise` at `count` points, given as separate arrays of coordinates, into `values`.
+     *
+     * The same steps as the single point version, written with a float for each vector component and
+     * without branches, so the loop over the points is vectorized by the compiler.
+     * The arithmetic is done in the same order, so the results are the same as the single point version
+     * unless the compiler fuses multiplies and adds differently in the two, which changes them by about 1e-5.
+     */
+    inline void snoise(const float *xs, const float *ys, const float *zs, float *values, int count)
+    {
+        // GLSL mod, floor, step and max, on floats
+        auto mod289 = [](float a) { return a - 289.0f * std::floor(a / 289.0f); };
+        auto permute = [&](float a) { return mod289((a * 34.0f + 1.0f) * a); };
+        auto step = [](float edge, float a) { return a < edge ? 0.0f : 1.0f; };
+        const auto ns_x = 2.0f / 7.0f, ns_y = 0.5f / 7.0f - 1.0f, ns_z = 1.0f / 7.0f;
+
+        for (auto n = 0; n < count; ++n) {
+            auto vx = xs[n], vy = ys[n], vz = zs[n];
+
+            // the sums in the order glm::dot adds them, so the two versions round alike
+            const auto third = 1.0f / 3.0f, sixth = 1.0f / 6.0f;
+            auto s = vx * third + vy * third + vz * third;
+            auto ix = std::floor(vx + s), iy = std::floor(vy + s), iz = std::floor(vz + s);
+            auto t = ix * sixth + iy * sixth + iz * sixth;
+            auto x0x = vx - ix + t, x0y = vy - iy + t, x0z = vz - iz + t;
+
+            auto gx = step(x0y, x0x), gy = step(x0z, x0y), gz = step(x0x, x0z);
+            auto lx = 1.0f - gx, ly = 1.0f - gy, lz = 1.0f - gz;
+            auto i1x = std::min(gx, lz), i1y = std::min(gy, lx), i1z = std::min(gz, ly);
+            auto i2x = std::max(gx, lz), i2y = std::max(gy, lx), i2z = std::max(gz, ly);
+
+            const auto c = 1.0f / 6.0f;
+            auto x1x = x0x - i1x + c, x1y = x0y - i1y + c, x1z = x0z - i1z + c;
+            auto x2x = x0x - i2x + 2.0f * c, x2y = x0y - i2y + 2.0f * c, x2z = x0z - i2z + 2.0f * c;
+            auto x3x = x0x - 1.0f + 3.0f * c, x3y = x0y - 1.0f + 3.0f * c, x3z = x0z - 1.0f + 3.0f * c;
+
+            ix = mod289(ix);
+            iy = mod289(iy);
+            iz = mod289(iz);
+            float p[4] = {
+                    permute(permute(permute(iz) + iy) + ix),
+                    permute(permute(permute(iz + i1z) + iy + i1y) + ix + i1x),
+                    permute(permute(permute(iz + i2z) + iy + i2y) + ix + i2x),
+                    permute(permute(permute(iz + 1.0f) + iy + 1.0f) + ix + 1.0f),
+            };
+            const float cx[4] = {x0x, x1x, x2x, x3x};
+            const float cy[4] = {x0y, x1y, x2y, x3y};
+            const float cz[4] = {x0z, x1z, x2z, x3z};
+
+            float corner[4];
+            for (auto k = 0; k < 4; ++k) {
+                auto j = p[k] - 49.0f * std::floor(p[k] * ns_z * ns_z);
+                auto x_ = std::floor(j * ns_z);
+                auto y_ = std::floor(j - 7.0f * x_);
+                auto x = x_ * ns_x + ns_y;
+                auto y = y_ * ns_x + ns_y;
+                auto h = 1.0f - std::fabs(x) - std::fabs(y);
+                auto sh = -step(h, 0.0f);
+                auto gx_ = x + (std::floor(x) * 2.0f + 1.0f) * sh;
+                auto gy_ = y + (std::floor(y) * 2.0f + 1.0f) * sh;
+                auto norm = 1.79284291400159f - 0.85373472095314f * (gx_ * gx_ + gy_ * gy_ + h * h);
+                gx_ *= norm;
+                gy_ *= norm;
+                h *= norm;
+                auto m = std::max(0.6f - (cx[k] * cx[k] + cy[k] * cy[k] + cz[k] * cz[k]), 0.0f);
+                m = m * m;
+                corner[k] = m * m * (gx_ * cx[k] + gy_ * cy[k] + h * cz[k]);
+            }
+            values[n] = 42.0f * ((corner[0] + corner[1]) + (corner[2] + corner[3]));
+        }
+    }
+
+}
@@ -0,0 +1,338 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <glad/gl.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cs4722 {
+
+    /**
+     * \brief Identifies a baked texture by the parameters used to generate it.
+     *
+     * Every parameter that affects the texels should be added to the key, including a name for the
+     * generating function so that two different generators with the same numeric parameters do not collide.
+     * The key is a 64 bit FNV-1a hash of the bytes of the parameters in the order they were added.
+     *
+     * Example:
+     *
+     * `auto key = cs4722::texture_cache_key("clouds").add(texture_size).add(frequency).add(number_of_octaves);`
+     */
+    class texture_cache_key {
+    public:
+
+        explicit texture_cache_key(const std::string &name)
+        {
+            add(name);
+        }
+
+        texture_cache_key &add(const std::string &value)
+        {
+            return add_bytes(value.data(), value.size());
+        }
+
+        template<typename T>
+        texture_cache_key &add(const T &value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>, "cache key values must be plain data");
+            return add_bytes(&value, sizeof(value));
+        }
+
+        /**
+         * \brief The file name used for this key in the cache directory.
+         */
+        std::string file_name() const
+        {
+            static const char *digits = "0123456789abcdef";
+            auto name = std::string(16, '0');
+            for (auto i = 0; i < 16; ++i) {
+                name[15 - i] = digits[(hash >> (4 * i)) & 0xf];
+            }
+            return name + ".texels";
+        }
+
+        uint64_t hash = 14695981039346656037ull;
+
+    private:
+
+        texture_cache_key &add_bytes(const void *data, size_t size)
+        {
+            auto *bytes = static_cast<const unsigned char *>(data);
+            for (size_t i = 0; i < size; ++i) {
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            }
+            return *this;
+        }
+    };
+
+
+    /**
+     * \brief Texel data that is either mapped from a cache file or held in memory.
+     *
+     * When the data comes from the cache, `data()` points directly into the memory mapped file, so
+     * it can be handed to `glTextureSubImage*` without copying.
+     * The mapping is released when this object goes away.
+     */
+    class baked_texels {
+    public:
+
+        baked_texels() = default;
+        baked_texels(const baked_texels &) = delete;
+        baked_texels &operator=(const baked_texels &) = delete;
+
+        ~baked_texels()
+        {
+            unmap();
+        }
+
+        const GLubyte *data() const
+        {
+            return mapped_base ? mapped_base + header_size : owned.data();
+        }
+
+        size_t size() const
+        {
+            return mapped_base ? mapped_size - header_size : owned.size();
+        }
+
+        /**
+         * \brief True if the texels were read from the cache rather than computed.
+         */
+        bool from_cache() const
+        {
+            return mapped_base != nullptr;
+        }
+
+        /**
+         * \brief Size of the file header, texel data starts at this offset.
+         *
+         * 64 bytes keeps the texel data aligned for any upload path.
+         */
+        static constexpr size_t header_size = 64;
+
+    private:
+
+        friend class texture_cache;
+
+        std::vector<GLubyte> owned;
+        const GLubyte *mapped_base = nullptr;
+        size_t mapped_size = 0;
+#ifdef _WIN32
+        HANDLE file_handle = INVALID_HANDLE_VALUE;
+        HANDLE mapping_handle = nullptr;
+#endif
+
+        bool map(const std::filesystem::path &path)
+        {
+#ifdef _WIN32
+            file_handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file_handle == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+            LARGE_INTEGER file_size;
+            GetFileSizeEx(file_handle, &file_size);
+            mapping_handle = CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping_handle == nullptr) {
+                unmap();
+                return false;
+            }
+            auto *base = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+            if (base == nullptr) {
+                unmap();
+                return false;
+            }
+            mapped_base = static_cast<const GLubyte *>(base);
+            mapped_size = static_cast<size_t>(file_size.QuadPart);
+#else
+            auto fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat file_stat{};
+            if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+                close(fd);
+                return false;
+            }
+            auto *base = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (base == MAP_FAILED) {
+                return false;
+            }
+            mapped_base = static_cast<const GLubyte *>(base);
+            mapped_size = static_cast<size_t>(file_stat.st_size);
+#endif
+            return true;
+        }
+
+        void unmap()
+        {
+#ifdef _WIN32
+            if (mapped_base) {
+                UnmapViewOfFile(mapped_base);
+            }
+            if (mapping_handle) {
+                CloseHandle(mapping_handle);
+            }
+            if (file_handle != INVALID_HANDLE_VALUE) {
+                CloseHandle(file_handle);
+            }
+            mapping_handle = nullptr;
+            file_handle = INVALID_HANDLE_VALUE;
+#else
+            if (mapped_base) {
+                munmap(const_cast<GLubyte *>(mapped_base), mapped_size);
+            }
+#endif
+            mapped_base = nullptr;
+            mapped_size = 0;
+        }
+    };
+
+
+    /**
+     * \brief An on-disk cache of baked texture data keyed by the generator parameters.
+     *
+     * Each entry is a file named after the key hash in the cache directory.
+     * The file starts with a 64 byte header holding a tag, the full key hash and the texel byte count,
+     * followed by the raw texels.
+     * A file whose header does not match the request is ignored and rebaked.
+     *
+     * The time taken to produce the texels is printed, so the cost of a cold start (bake and store) can be
+     * compared with a warm start (map the file).
+     */
+    class texture_cache {
+    public:
+
+        /**
+         * \brief Use the cache in the directory `directory`, which is created if needed.
+         *
+         * The environment variable `CS4722_TEXTURE_CACHE` overrides the directory.
+         * Setting it to `off` disables the cache so every call bakes.
+         */
+        explicit texture_cache(const std::string &directory = "texture_cache")
+        {
+            auto *env = std::getenv("CS4722_TEXTURE_CACHE");
+            if (env && std::string(env) == "off") {
+                enabled = false;
+            } else {
+                cache_directory = env && *env ? std::filesystem::path(env) : std::filesystem::path(directory);
+            }
+        }
+
+        /**
+         * \brief Return the texels for `key`, baking and storing them if they are not cached.
+         *
+         * @param key  Parameters of the generator
+         * @param byte_size  Number of bytes of texel data
+         * @param bake  Function that fills a buffer of `byte_size` bytes with the texels
+         */
+        std::unique_ptr<baked_texels> load_or_bake(const texture_cache_key &key, size_t byte_size,
+                                                   const std::function<void(GLubyte *)> &bake)
+        {
+            auto start = std::chrono::steady_clock::now();
+            auto texels = std::make_unique<baked_texels>();
+            auto path = cache_directory / key.file_name();
+
+            if (enabled && texels->map(path) && header_matches(texels->mapped_base, texels->mapped_size,
+                                                                key, byte_size)) {
+                report("warm start, mapped", path, start);
+                return texels;
+            }
+            texels->unmap();
+
+            texels->owned.resize(byte_size);
+            bake(texels->owned.data());
+            if (enabled) {
+                store(path, key, texels->owned);
+            }
+            report("cold start, baked", path, start);
+            return texels;
+        }
+
+        bool enabled = true;
+        std::filesystem::path cache_directory;
+
+    private:
+
+        static constexpr char tag[8] = {'c', 's', '4', '7', '2', '2', 't', 'x'};
+
+        static bool header_matches(const GLubyte *base, size_t size, const texture_cache_key &key,
+                                   size_t byte_size)
+        {
+            if (size != baked_texels::header_size + byte_size) {
+                return false;
+            }
+            uint64_t stored_hash, stored_size;
+            std::memcpy(&stored_hash, base + sizeof(tag), sizeof(stored_hash));
+            std::memcpy(&stored_size, base + sizeof(tag) + sizeof(stored_hash), sizeof(stored_size));
+            return std::memcmp(base, tag, sizeof(tag)) == 0 && stored_hash == key.hash
+                   && stored_size == byte_size;
+        }
+
+        void store(const std::filesystem::path &path, const texture_cache_key &key,
+                   const std::vector<GLubyte> &texels) const
+        {
+            std::error_code error;
+            std::filesystem::create_directories(cache_directory, error);
+
+            char header[baked_texels::header_size] = {};
+            uint64_t stored_size = texels.size();
+            std::memcpy(header, tag, sizeof(tag));
+            std::memcpy(header + sizeof(tag), &key.hash, sizeof(key.hash));
+            std::memcpy(header + sizeof(tag) + sizeof(key.hash), &stored_size, sizeof(stored_size));
+
+            // write to a temporary file and rename so a partly written file is never mapped
+            auto temporary = path;
+            temporary += ".tmp";
+            {
+                std::ofstream out(temporary, std::ios::binary);
+                out.write(header, sizeof(header));
+                out.write(reinterpret_cast<const char *>(texels.data()),
+                          static_cast<std::streamsize>(texels.size()));
+                if (!out) {
+                    std::cerr << "texture cache: unable to write " << temporary << std::endl;
+                    return;
+                }
+            }
+            std::filesystem::rename(temporary, path, error);
+            if (error) {
+                std::filesystem::remove(temporary, error);
+            }
+        }
+
+        static void report(const char *what, const std::filesystem::path &path,
+                           std::chrono::steady_clock::time_point start)
+        {
+            auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+            std::cout << "texture " << path.filename().string() << ": " << what << " in "
+                      << elapsed.count() << " ms" << std::endl;
+        }
+    };
+
+}
@@ -0,0 +1,694 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "FastNoiseLite.h"
+#include "cs4722/noise_volume_baker.h"
+#include "cs4722/parallel_for.h"
+
+/**
+ * \file
+ *
+ * Noise volumes too large to bake, generated a brick at a time as the shader reaches them.
+ */
+
+namespace cs4722 {
+
+    /**
+     * \brief A virtual RGBA8 3D noise texture whose bricks are only generated once a shader samples them.
+     *
+     * The volume is `texture_size` texels along each edge, a power of two no smaller than `brick_size`,
+     * and has mip levels down to a single brick.
+     * Each octave goes into its own channel, and on level 0 the texel at `(x, y, z)` holds the same value
+     * `noise_volume_baker` would store there,
+     *
+     *      (generator.GetNoise(z * coordinate_scale, y * coordinate_scale, x * coordinate_scale) + 1) * amplitude * 128
+     *
+     * A texel of level `l` is the noise at the center of the `2^l` texels of level 0 it covers.
+     * Octaves too fine for a level fade to their average rather than alias, starting when a texel
+     * steps a quarter of a noise unit and gone by half a unit.
+     *
+     * Every level is split into bricks of `brick_size` cubed texels.
+     * Bricks are generated by worker threads, with a border of one texel on each side so they can be
+     * filtered, and kept in the slots of a pool texture, `BrickPool`.
+     * An RGBA8UI brick table, `BrickTable`, with one texel per brick and one mip level per level, holds
+     * the slot of each resident brick in `xyz` and 1 in `w`.
+     * See fragment_shader06_virtual.glsl for how a shader looks up and samples a brick.
+     *
+     * The shader chooses a level from the screen size of a texel and writes a bit into a shader storage
+     * buffer for each brick it wants, see `feedback_binding`.
+     * `update`, called once per frame before drawing, reads the bits the GPU finished writing a frame or
+     * two earlier, never waiting on a fence, and queues the bricks not yet resident, coarsest first.
+     * A brick that is wanted but not resident is drawn from the nearest resident coarser level.
+     * The single brick of the coarsest level is generated in `start` and kept, so there always is one.
+     *
+     * When the pool is full, the least recently requested brick that was not requested in the latest
+     * feedback is dropped to make room.
+     * So host and GPU memory follow the bricks in view and not the size of the volume.
+     *
+     * Requires an OpenGL 4.5 context, and `start` must be called before anything else.
+     */
+    class virtual_noise_volume {
+    public:
+
+        static constexpr int brick_size = 32;
+
+        /**
+         * \brief Edge of a slot in the pool, a brick with its border.
+         */
+        static constexpr int slot_size = brick_size + 2;
+
+        /**
+         * @param texture_size  Number of texels along each edge of level 0, a power of two
+         * @param pool_bricks  Number of bricks the pool holds, rounded up to fill a box of slots
+         * @param number_of_threads  Threads generating bricks, 0 means all but one of the hardware threads
+         */
+        explicit virtual_noise_volume(int texture_size, int pool_bricks = 256, int number_of_threads = 0)
+                : texture_size(texture_size), number_of_threads(number_of_threads)
+        {
+            levels = 1;
+            while ((texture_size >> levels) >= brick_size) {
+                ++levels;
+            }
+            for (auto l = 0; l < levels; ++l) {
+                level_start.push_back(total_bricks);
+                auto n = bricks_across(l);
+                total_bricks += static_cast<std::uint32_t>(n * n * n);
+            }
+
+            pool_x = std::max(1, static_cast<int>(std::ceil(std::cbrt(static_cast<double>(pool_bricks)) - 1e-9)));
+            pool_y = pool_x;
+            pool_z = (pool_bricks + pool_x * pool_y - 1) / (pool_x * pool_y);
+        }
+
+        virtual_noise_volume(const virtual_noise_volume &) = delete;
+        virtual_noise_volume &operator=(const virtual_noise_volume &) = delete;
+
+        ~virtual_noise_volume()
+        {
+            {
+                auto lock = std::lock_guard<std::mutex>(mutex);
+                stopping = true;
+            }
+            work_available.notify_all();
+            for (auto &worker: workers) {
+                worker.join();
+            }
+            for (auto &f: feedback) {
+                if (f.fence) glDeleteSync(f.fence);
+                if (f.buffer) {
+                    glUnmapNamedBuffer(f.buffer);
+                    glDeleteBuffers(1, &f.buffer);
+                }
+            }
+            if (pool) {
+                glDeleteTextures(1, &pool);
+                glDeleteTextures(1, &table);
+            }
+        }
+
+        /**
+         * \brief Add an octave, it will be written to the next unused channel.
+         *
+         * The frequency is set on a copy of `generator` and is needed to fade the octave on coarse levels.
+         * At most four octaves can be used, additional octaves are ignored.
+         */
+        void add_octave(const FastNoiseLite &generator, float frequency, float coordinate_scale, float amplitude)
+        {
+            if (octaves.size() < 4) {
+                octaves.push_back({generator, coordinate_scale, amplitude});
+                octaves.back().generator.SetFrequency(frequency);
+                frequencies.push_back(frequency);
+            }
+        }
+
+        int level_count() const
+        {
+            return levels;
+        }
+
+        /**
+         * \brief Number of bricks along each edge of level `level`.
+         */
+        int bricks_across(int level) const
+        {
+            return (texture_size >> level) / brick_size;
+        }
+
+        /**
+         * \brief Number of slots in the pool.
+         */
+        int pool_capacity() const
+        {
+            return pool_x * pool_y * pool_z;
+        }
+
+        /**
+         * \brief Number of bytes in a brick with its border.
+         */
+        size_t brick_byte_size() const
+        {
+            return 4ull * slot_size * slot_size * slot_size;
+        }
+
+        /**
+         * \brief Bytes on the GPU for the pool and the brick table.
+         */
+        size_t pool_byte_size() const
+        {
+            auto table_bytes = size_t(0);
+            for (auto l = 0; l < levels; ++l) {
+                auto n = static_cast<size_t>(bricks_across(l));
+                table_bytes += 4 * n * n * n;
+            }
+            return brick_byte_size() * pool_capacity() + table_bytes;
+        }
+
+        /**
+         * \brief Bytes the whole volume would take baked, with its mip levels.
+         */
+        size_t logical_byte_size() const
+        {
+            auto total = size_t(0);
+            for (auto l = 0; l < levels; ++l) {
+                auto n = static_cast<size_t>(texture_size >> l);
+                total += 4 * n * n * n;
+            }
+            return total;
+        }
+
+        /**
+         * \brief Fill `texels`, at least `brick_byte_size()` bytes, with the brick at `(x, y, z)` of `level`
+         * and its border.
+         *
+         * x varies fastest.
+         * The border wraps around the edges of the level, as `GL_REPEAT` does.
+         */
+        void fill_brick(GLubyte *texels, int level, int x, int y, int z) const
+        {
+            std::fill(texels, texels + brick_byte_size(), 0);
+            const auto size = texture_size >> level;
+            const auto step = static_cast<float>(1 << level);
+            // level 0 samples at whole texels, exactly where the baker does
+            const auto offset = (step - 1.0f) / 2.0f;
+            float position[3][slot_size];
+            const int origin[3] = {x * brick_size - 1, y * brick_size - 1, z * brick_size - 1};
+            for (auto axis = 0; axis < 3; ++axis) {
+                for (auto t = 0; t < slot_size; ++t) {
+                    auto texel = ((origin[axis] + t) % size + size) % size;
+                    position[axis][t] = static_cast<float>(texel) * step + offset;
+                }
+            }
+
+            for (auto f = 0; f < static_cast<int>(octaves.size()); ++f) {
+                const auto &octave = octaves[f];
+                const auto inc = octave.coordinate_scale;
+                const auto scale = octave.amplitude;
+                const auto weight = fade(f, level);
+                if (weight == 0.0f) {
+                    for (size_t t = 0; t < brick_byte_size(); t += 4) {
+                        texels[t + f] = static_cast<GLubyte>(1.0f * scale * 128.0f);
+                    }
+                    continue;
+                }
+                auto *texel = texels + f;
+                for (auto c = 0; c < slot_size; ++c) {
+                    for (auto b = 0; b < slot_size; ++b) {
+                        for (auto a = 0; a < slot_size; ++a) {
+                            auto sample = octave.generator.GetNoise(position[2][c] * inc, position[1][b] * inc,
+                                                                    position[0][a] * inc);
+                            if (weight != 1.0f) {
+                                sample *= weight;
+                            }
+                            *texel = static_cast<GLubyte>((sample + 1.0f) * scale * 128.0f);
+                            texel += 4;
+                        }
+                    }
+                }
+            }
+        }
+
+        /**
+         * \brief Create the textures and feedback buffers, make the coarsest brick and start the workers.
+         */
+        void start()
+        {
+            glCreateTextures(GL_TEXTURE_3D, 1, &pool);
+            glTextureStorage3D(pool, 1, GL_RGBA8, pool_x * slot_size, pool_y * slot_size, pool_z * slot_size);
+            glTextureParameteri(pool, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTextureParameteri(pool, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTextureParameteri(pool, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTextureParameteri(pool, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTextureParameteri(pool, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+            // integer textures can only be complete with nearest filtering
+            auto across = bricks_across(0);
+            glCreateTextures(GL_TEXTURE_3D, 1, &table);
+            glTextureStorage3D(table, levels, GL_RGBA8UI, across, across, across);
+            glTextureParameteri(table, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+            glTextureParameteri(table, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            for (auto l = 0; l < levels; ++l) {
+                glClearTexImage(table, l, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+            }
+
+            auto flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            auto words = (total_bricks + 31) / 32;
+            for (auto &f: feedback) {
+                glCreateBuffers(1, &f.buffer);
+                glNamedBufferStorage(f.buffer, 4ull * words, nullptr, flags);
+                f.bits = static_cast<const std::uint32_t *>(
+                        glMapNamedBufferRange(f.buffer, 0, 4ull * words, flags));
+            }
+
+            for (auto s = pool_capacity() - 1; s >= 0; --s) {
+                free_slots.push_back(s);
+            }
+            auto coarsest = level_start[levels - 1];
+            auto texels = std::vector<GLubyte>(brick_byte_size());
+            fill_brick(texels.data(), levels - 1, 0, 0, 0);
+            bricks[coarsest] = brick{brick_state::generated};
+            ++bricks_generated;
+            upload(coarsest, texels);
+
+            queues.resize(levels);
+            // one thread is left for drawing the frames
+            for (auto t = 0; t < thread_count(number_of_threads, 1); ++t) {
+                workers.emplace_back([this] { work(); });
+            }
+        }
+
+        /**
+         * \brief Read the requests the GPU has finished, queue the bricks they need, and upload up to
+         * `max_uploads_per_frame` generated bricks.
+         *
+         * Call once per frame before drawing, it also binds the feedback buffer for the frame.
+         */
+        void update()
+        {
+            auto started = std::chrono::steady_clock::now();
+            // the draws of the previous frame are done writing to its buffer once this fence is
+            if (current_feedback >= 0) {
+                glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+                feedback[current_feedback].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            }
+
+            {
+                auto lock = std::lock_guard<std::mutex>(mutex);
+                ++frame;
+                for (auto r = 1; r <= 3; ++r) {
+                    auto &f = feedback[(current_feedback + r) % 3];
+                    if (f.fence && glClientWaitSync(f.fence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+                        glDeleteSync(f.fence);
+                        f.fence = nullptr;
+                        read_feedback(f.bits);
+                    }
+                }
+                upload_finished();
+            }
+            work_available.notify_all();
+
+            // a buffer the GPU still has is cleared without being read, it is two frames old
+            current_feedback = (current_feedback + 1) % 3;
+            auto &next = feedback[current_feedback];
+            if (next.fence) {
+                glDeleteSync(next.fence);
+                next.fence = nullptr;
+                ++feedback_dropped;
+            }
+            glClearNamedBufferData(next.buffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, feedback_binding, next.buffer);
+
+            auto milliseconds = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - started).count();
+            longest_update_milliseconds = std::max(longest_update_milliseconds, milliseconds);
+        }
+
+        /**
+         * \brief Ask for the brick at `(x, y, z)` of `level` as the shader would, it is queued by the next
+         * `update` if it is not resident.
+         */
+        void request(int level, int x, int y, int z)
+        {
+            auto n = bricks_across(level);
+            cpu_requests.push_back(level_start[level] + static_cast<std::uint32_t>((z * n + y) * n + x));
+        }
+
+        /**
+         * \brief Whether the brick at `(x, y, z)` of `level` is in the pool.
+         */
+        bool resident(int level, int x, int y, int z) const
+        {
+            auto n = bricks_across(level);
+            auto lock = std::lock_guard<std::mutex>(mutex);
+            auto found = bricks.find(level_start[level] + static_cast<std::uint32_t>((z * n + y) * n + x));
+            return found != bricks.end() && found->second.state == brick_state::resident;
+        }
+
+        /**
+         * \brief Slot in the pool of a resident brick, as its position in slots along x, y and z.
+         */
+        std::array<int, 3> slot_of(int level, int x, int y, int z) const
+        {
+            auto n = bricks_across(level);
+            auto lock = std::lock_guard<std::mutex>(mutex);
+            auto slot = bricks.at(level_start[level] + static_cast<std::uint32_t>((z * n + y) * n + x)).slot;
+            return {slot % pool_x, slot / pool_x % pool_y, slot / (pool_x * pool_y)};
+        }
+
+        int resident_count() const
+        {
+            return pool_capacity() - static_cast<int>(free_slots.size());
+        }
+
+        /**
+         * \brief Bind the brick table to `table_unit` and the pool to `pool_unit`.
+         */
+        void bind(GLuint table_unit, GLuint pool_unit) const
+        {
+            glBindTextureUnit(table_unit, table);
+            glBindTextureUnit(pool_unit, pool);
+        }
+
+        GLuint pool_texture() const
+        {
+            return pool;
+        }
+
+        /**
+         * \brief Set the uniforms fragment_shader06_virtual.glsl uses to find bricks, `program` must be in use.
+         */
+        void set_uniforms(GLuint program, GLuint table_unit, GLuint pool_unit) const
+        {
+            glUniform1i(glGetUniformLocation(program, "BrickTable"), static_cast<GLint>(table_unit));
+            glUniform1i(glGetUniformLocation(program, "BrickPool"), static_cast<GLint>(pool_unit));
+            glUniform1i(glGetUniformLocation(program, "Levels"), levels);
+            glUniform1f(glGetUniformLocation(program, "VolumeSize"), static_cast<float>(texture_size));
+            glUniform3f(glGetUniformLocation(program, "PoolSize"), static_cast<float>(pool_x * slot_size),
+                        static_cast<float>(pool_y * slot_size), static_cast<float>(pool_z * slot_size));
+            auto starts = std::vector<GLint>(level_start.begin(), level_start.end());
+            glUniform1iv(glGetUniformLocation(program, "LevelStart"), levels, starts.data());
+        }
+
+        /**
+         * \brief Binding of the shader storage buffer the shader writes its requests into.
+         */
+        GLuint feedback_binding = 1;
+
+        /**
+         * \brief Most bricks copied into the pool in one `update`.
+         */
+        int max_uploads_per_frame = 8;
+
+        /**
+         * \brief Frames without a request after which a brick still waiting to be generated is dropped.
+         */
+        int stale_frames = 30;
+
+        /**
+         * \brief Number of bricks the workers have filled, which they count while the caller reads it.
+         */
+        std::atomic<long> bricks_generated = 0;
+        long bricks_uploaded = 0;
+        long evictions = 0;
+
+        /**
+         * \brief Number of generated bricks left waiting because every slot held a brick in view.
+         */
+        long pool_full_count = 0;
+
+        /**
+         * \brief Number of feedback buffers the GPU had not finished with when they were needed again.
+         */
+        long feedback_dropped = 0;
+
+        double longest_update_milliseconds = 0;
+
+        int texture_size;
+        int number_of_threads;
+        std::vector<noise_octave> octaves;
+        std::vector<float> frequencies;
+
+    private:
+
+        enum class brick_state {
+            queued, generating, generated, resident
+        };
+
+        struct brick {
+            brick_state state = brick_state::queued;
+            int slot = -1;
+            std::uint64_t last_used = 0;
+        };
+
+        struct feedback_buffer {
+            GLuint buffer = 0;
+            const std::uint32_t *bits = nullptr;
+            GLsync fence = nullptr;
+        };
+
+        struct finished_brick {
+            std::uint32_t id;
+            std::vector<GLubyte> texels;
+        };
+
+        float fade(int f, int level) const
+        {
+            if (level == 0) {
+                return 1.0f;
+            }
+            auto step = octaves[f].coordinate_scale * frequencies[f] * static_cast<float>(1 << level);
+            return std::clamp((0.5f - step) * 4.0f, 0.0f, 1.0f);
+        }
+
+        int level_of(std::uint32_t id) const
+        {
+            auto level = levels - 1;
+            while (id < level_start[level]) {
+                --level;
+            }
+            return level;
+        }
+
+        /**
+         * \brief Mark the brick and the coarser bricks containing it as used, queueing any not yet made.
+         */
+        void note(std::uint32_t id)
+        {
+            auto level = level_of(id);
+            auto index = id - level_start[level];
+            while (true) {
+                auto n = static_cast<std::uint32_t>(bricks_across(level));
+                auto found = bricks.find(id);
+                if (found != bricks.end()) {
+                    found->second.last_used = frame;
+                } else {
+                    bricks[id] = brick{brick_state::queued, -1, frame};
+                    queues[level].push_back(id);
+                }
+                if (level == levels - 1) {
+                    return;
+                }
+                auto x = index % n, y = index / n % n, z = index / (n * n);
+                n /= 2;
+                index = (z / 2 * n + y / 2) * n + x / 2;
+                ++level;
+                id = level_start[level] + index;
+            }
+        }
+
+        /**
+         * \brief Note every brick requested in `bits` and by `request`, lock held.
+         */
+        void read_feedback(const std::uint32_t *bits)
+        {
+            latest_feedback = frame;
+            for (std::uint32_t w = 0; w < (total_bricks + 31) / 32; ++w) {
+                for (auto word = bits[w]; word != 0; word &= word - 1) {
+                    note(w * 32 + static_cast<std::uint32_t>(std::countr_zero(word)));
+                }
+            }
+        }
+
+        /**
+         * \brief Copy generated bricks into the pool, lock held.
+         */
+        void upload_finished()
+        {
+            if (!cpu_requests.empty()) {
+                latest_feedback = frame;
+                for (auto id: cpu_requests) {
+                    note(id);
+                }
+                cpu_requests.clear();
+            }
+            auto uploads = 0;
+            while (!finished.empty() && uploads < max_uploads_per_frame) {
+                auto &done = finished.front();
+                auto &b = bricks.at(done.id);
+                if (b.last_used + stale_frames < frame) {
+                    bricks.erase(done.id);
+                } else if (!upload(done.id, done.texels)) {
+                    ++pool_full_count;
+                    return;
+                } else {
+                    ++uploads;
+                }
+                spare_texels.push_back(std::move(done.texels));
+                finished.pop_front();
+            }
+        }
+
+        /**
+         * \brief Put a generated brick into a slot and point its table texel at it, lock held.
+         */
+        bool upload(std::uint32_t id, const std::vector<GLubyte> &texels)
+        {
+            auto slot = take_slot();
+            if (slot < 0) {
+                return false;
+            }
+            auto level = level_of(id);
+            auto n = static_cast<std::uint32_t>(bricks_across(level));
+            auto index = id - level_start[level];
+            auto sx = slot % pool_x, sy = slot / pool_x % pool_y, sz = slot / (pool_x * pool_y);
+            glTextureSubImage3D(pool, 0, sx * slot_size, sy * slot_size, sz * slot_size,
+                                slot_size, slot_size, slot_size, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+            GLubyte entry[4] = {static_cast<GLubyte>(sx), static_cast<GLubyte>(sy), static_cast<GLubyte>(sz), 1};
+            glTextureSubImage3D(table, level, static_cast<GLint>(index % n), static_cast<GLint>(index / n % n),
+                                static_cast<GLint>(index / (n * n)), 1, 1, 1, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE,
+                                entry);
+            auto &b = bricks.at(id);
+            b.state = brick_state::resident;
+            b.slot = slot;
+            ++bricks_uploaded;
+            return true;
+        }
+
+        /**
+         * \brief A free slot, made by dropping the least recently used brick not in the latest feedback
+         * if need be, or -1 when every brick is in use, lock held.
+         */
+        int take_slot()
+        {
+            if (!free_slots.empty()) {
+                auto slot = free_slots.back();
+                free_slots.pop_back();
+                return slot;
+            }
+            auto coarsest = level_start[levels - 1];
+            auto victim = bricks.end();
+            for (auto it = bricks.begin(); it != bricks.end(); ++it) {
+                auto &b = it->second;
+                if (b.state == brick_state::resident && it->first != coarsest && b.last_used < latest_feedback
+                    && (victim == bricks.end() || b.last_used < victim->second.last_used)) {
+                    victim = it;
+                }
+            }
+            if (victim == bricks.end()) {
+                return -1;
+            }
+            auto level = level_of(victim->first);
+            auto n = static_cast<std::uint32_t>(bricks_across(level));
+            auto index = victim->first - level_start[level];
+            GLubyte empty[4] = {0, 0, 0, 0};
+            glTextureSubImage3D(table, level, static_cast<GLint>(index % n), static_cast<GLint>(index / n % n),
+                                static_cast<GLint>(index / (n * n)), 1, 1, 1, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE,
+                                empty);
+            auto slot = victim->second.slot;
+            bricks.erase(victim);
+            ++evictions;
+            return slot;
+        }
+
+        bool job_waiting() const
+        {
+            if (finished.size() >= max_finished) {
+                return false;
+            }
+            return std::any_of(queues.begin(), queues.end(), [](const auto &q) { return !q.empty(); });
+        }
+
+        void work()
+        {
+            auto lock = std::unique_lock<std::mutex>(mutex);
+            while (true) {
+                work_available.wait(lock, [this] { return stopping || job_waiting(); });
+                if (stopping) {
+                    return;
+                }
+                // coarse bricks first, they stand in for the finer ones until those arrive
+                auto level = levels - 1;
+                while (queues[level].empty()) {
+                    --level;
+                }
+                auto id = queues[level].front();
+                queues[level].pop_front();
+                auto &b = bricks.at(id);
+                if (b.last_used + stale_frames < frame) {
+                    bricks.erase(id);
+                    continue;
+                }
+                b.state = brick_state::generating;
+                auto texels = std::vector<GLubyte>();
+                if (!spare_texels.empty()) {
+                    texels = std::move(spare_texels.back());
+                    spare_texels.pop_back();
+                } else {
+                    texels.resize(brick_byte_size());
+                }
+                lock.unlock();
+
+                auto n = static_cast<std::uint32_t>(bricks_across(level));
+                auto index = id - level_start[level];
+                fill_brick(texels.data(), level, static_cast<int>(index % n), static_cast<int>(index / n % n),
+                           static_cast<int>(index / (n * n)));
+
+                lock.lock();
+                bricks.at(id).state = brick_state::generated;
+                finished.push_back({id, std::move(texels)});
+                ++bricks_generated;
+            }
+        }
+
+        static constexpr size_t max_finished = 64;
+
+        int levels;
+        std::vector<std::uint32_t> level_start;
+        std::uint32_t total_bricks = 0;
+        int pool_x, pool_y, pool_z;
+
+        GLuint pool = 0;
+        GLuint table = 0;
+        feedback_buffer feedback[3];
+        int current_feedback = -1;
+
+        std::unordered_map<std::uint32_t, brick> bricks;
+        std::vector<int> free_slots;
+        std::vector<std::deque<std::uint32_t>> queues;
+        std::deque<finished_brick> finished;
+        std::vector<std::vector<GLubyte>> spare_texels;
+        std::vector<std::uint32_t> cpu_requests;
+        std::uint64_t frame = 0;
+        std::uint64_t latest_feedback = 0;
+
+        std::vector<std::thread> workers;
+        mutable std::mutex mutex;
+        std::condition_variable work_available;
+        bool stopping = false;
+    };
+
+}